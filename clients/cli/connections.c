@@ -2559,6 +2559,7 @@ typedef struct {
     NmCli *             nmc;
     NMDevice *          device;
     NMActiveConnection *active;
+    guint               timeout_id;
 } ActivateConnectionInfo;
 
 static void
@@ -2670,6 +2671,7 @@ activate_connection_timeout_cb(gpointer user_data)
     ActivateConnectionInfo *info = user_data;
 
     /* Time expired -> exit nmcli */
+    info->timeout_id = 0;
     set_nmc_error_timeout(info->nmc);
     activate_connection_info_finish(info);
     return FALSE;
@@ -2716,6 +2718,9 @@ progress_active_connection_cb(gpointer user_data)
 static void
 activate_connection_info_finish(ActivateConnectionInfo *info)
 {
+    /* in batch mode, the main loop keeps running for the next command. */
+    nm_clear_g_source(&info->timeout_id);
+
     if (info->device) {
         g_signal_handlers_disconnect_by_func(info->device, G_CALLBACK(device_state_cb), info);
         g_object_unref(info->device);
@@ -2780,12 +2785,6 @@ activate_connection_cb(GObject *client, GAsyncResult *result, gpointer user_data
                                  "notify::" NM_DEVICE_STATE,
                                  G_CALLBACK(device_state_cb),
                                  info);
-            /* Both active_connection_state_cb () and device_state_cb () will just
-             * call check_activated (info). So, just call it once directly after
-             * connecting on both the signals of the objects and skip the call to
-             * the callbacks.
-             */
-            check_activated(info);
 
             /* Start progress indication showing VPN states */
             if (nmc->nmc_config.print_output == NMC_PRINT_PRETTY) {
@@ -2795,7 +2794,15 @@ activate_connection_cb(GObject *client, GAsyncResult *result, gpointer user_data
             }
 
             /* Start timer not to loop forever when signals are not emitted */
-            g_timeout_add_seconds(nmc->timeout, activate_connection_timeout_cb, info);
+            info->timeout_id =
+                g_timeout_add_seconds(nmc->timeout, activate_connection_timeout_cb, info);
+
+            /* Both active_connection_state_cb () and device_state_cb () will just
+             * call check_activated (info). So, just call it once directly after
+             * connecting on both the signals of the objects and skip the call to
+             * the callbacks. It may already finish @info.
+             */
+            check_activated(info);
         }
     }
 }
@@ -2012,6 +2012,7 @@ typedef struct {
     NMDevice *          device;
     NMActiveConnection *active;
     char *              specific_object;
+    guint               timeout_id;
     bool                hotspot : 1;
     bool                create : 1;
 } AddAndActivateInfo;
@@ -2039,6 +2040,7 @@ add_and_activate_info_new(NmCli *     nmc,
 static void
 add_and_activate_info_free(AddAndActivateInfo *info)
 {
+    nm_clear_g_source(&info->timeout_id);
     g_object_unref(info->device);
     g_clear_object(&info->active);
     g_free(info->specific_object);
@@ -2088,6 +2090,21 @@ connected_state_cb(AddAndActivateInfo *info)
     quit();
 }
 
+static gboolean
+connected_timeout_cb(gpointer user_data)
+{
+    AddAndActivateInfo *info = user_data;
+
+    /* Time expired -> exit nmcli */
+    info->timeout_id = 0;
+    timeout_cb(info->nmc);
+
+    g_signal_handlers_disconnect_by_func(info->active, G_CALLBACK(connected_state_cb), info);
+    g_signal_handlers_disconnect_by_func(info->device, G_CALLBACK(connected_state_cb), info);
+    add_and_activate_info_free(info);
+    return G_SOURCE_REMOVE;
+}
+
 static void
 add_and_activate_cb(GObject *client, GAsyncResult *result, gpointer user_data)
 {
@@ -2131,9 +2148,9 @@ add_and_activate_cb(GObject *client, GAsyncResult *result, gpointer user_data)
     info->active = g_steal_pointer(&active);
     g_signal_connect_swapped(info->device, "notify::state", G_CALLBACK(connected_state_cb), info);
     g_signal_connect_swapped(info->active, "notify::state", G_CALLBACK(connected_state_cb), info);
+    /* Exit if timeout expires */
+    info->timeout_id = g_timeout_add_seconds(nmc->timeout, connected_timeout_cb, info);
     connected_state_cb(g_steal_pointer(&info));
-
-    g_timeout_add_seconds(nmc->timeout, timeout_cb, nmc); /* Exit if timeout expires */
 }
 
 static void
@@ -2199,10 +2216,9 @@ connect_device_cb(GObject *client, GAsyncResult *result, gpointer user_data)
     info->active = g_steal_pointer(&active);
     g_signal_connect_swapped(info->device, "notify::state", G_CALLBACK(connected_state_cb), info);
     g_signal_connect_swapped(info->active, "notify::state", G_CALLBACK(connected_state_cb), info);
-    connected_state_cb(g_steal_pointer(&info));
-
     /* Start timer not to loop forever if "notify::state" signal is not issued */
-    g_timeout_add_seconds(nmc->timeout, timeout_cb, nmc);
+    info->timeout_id = g_timeout_add_seconds(nmc->timeout, connected_timeout_cb, info);
+    connected_state_cb(g_steal_pointer(&info));
 }
 
 static void
@@ -454,9 +454,13 @@ usage_monitor(void)
                  "Prints a line whenever a change occurs in NetworkManager\n\n"));
 }
 
+static guint permissions_timeout_id = 0; /* ID of the timeout for "general permissions" */
+
 static void
 quit(void)
 {
+    /* in batch mode, the main loop keeps running for the next command. */
+    nm_clear_g_source(&permissions_timeout_id);
     g_main_loop_quit(loop);
 }
 
@@ -506,6 +510,7 @@ timeout_cb(gpointer user_data)
 {
     NmCli *nmc = (NmCli *) user_data;
 
+    permissions_timeout_id = 0;
     g_signal_handlers_disconnect_by_func(nmc->client, G_CALLBACK(permission_changed), nmc);
 
     g_string_printf(nmc->return_text, _("Error: Timeout %d sec expired."), nmc->timeout);
@@ -589,7 +594,7 @@ show_nm_permissions(NmCli *nmc)
 
     if (nmc->timeout == -1)
         nmc->timeout = 10;
-    g_timeout_add_seconds(nmc->timeout, timeout_cb, nmc);
+    permissions_timeout_id = g_timeout_add_seconds(nmc->timeout, timeout_cb, nmc);
 
     nmc->should_wait++;
 
@@ -241,11 +241,13 @@ usage(void)
         "\n"
         "OPTIONS\n"
         "  -a, --ask                                ask for missing parameters\n"
+        "  -b, --batch <file>|-                     run the commands in a file, one per line\n"
         "  -c, --colors auto|yes|no                 whether to use colors in output\n"
         "  -e, --escape yes|no                      escape columns separators in values\n"
         "  -f, --fields <field,...>|all|common      specify fields to output\n"
         "  -g, --get-values <field,...>|all|common  shortcut for -m tabular -t -f\n"
         "  -h, --help                               print this help\n"
+        "  -j, --json                               JSON output\n"
         "  -m, --mode tabular|multiline             output mode\n"
         "  -o, --overview                           overview mode\n"
         "  -p, --pretty                             pretty output\n"
@@ -713,6 +715,113 @@ set_colors(NmcColorOption   color_option,
 
 /*************************************************************************************/
 
+/* Runs the commands from @batch_file (or stdin for "-"), one per line, one
+ * after the other. All commands share the same NMClient instance, so only
+ * the first command needs to wait for the client to initialize. Each command
+ * starts with the options that were given on the command line. Failures are
+ * reported for each line and don't stop the batch. */
+static void
+process_batch(NmCli *nmc, const NMCCommand *cmds, const char *batch_file)
+{
+    gs_unref_ptrarray GPtrArray *argvs        = NULL;
+    gs_free char *               fields       = g_steal_pointer(&nmc->required_fields);
+    const NmcConfig              nmc_config   = nmc->nmc_config;
+    const int                    timeout      = nmc->timeout;
+    const gboolean               nowait_flag  = nmc->nowait_flag;
+    NMCResultCode                first_error  = NMC_RESULT_SUCCESS;
+    gs_free char *               line         = NULL;
+    size_t                       line_alloc   = 0;
+    guint                        line_no      = 0;
+    guint                        n_cmds       = 0;
+    guint                        n_failed     = 0;
+    FILE *                       f;
+
+    if (nm_streq(batch_file, "-"))
+        f = stdin;
+    else {
+        f = fopen(batch_file, "re");
+        if (!f) {
+            int errsv = errno;
+
+            g_string_printf(nmc->return_text,
+                            _("Error: failed to open batch file '%s': %s."),
+                            batch_file,
+                            nm_strerror_native(errsv));
+            nmc->return_value    = NMC_RESULT_ERROR_USER_INPUT;
+            nmc->required_fields = g_steal_pointer(&fields);
+            return;
+        }
+    }
+
+    argvs = g_ptr_array_new_with_free_func((GDestroyNotify) g_strfreev);
+
+    while (getline(&line, &line_alloc, f) != -1) {
+        gs_free_error GError *error = NULL;
+        char **               argv;
+        int                   argc;
+
+        line_no++;
+
+        g_strstrip(line);
+        if (NM_IN_SET(line[0], '\0', '#'))
+            continue;
+
+        n_cmds++;
+
+        if (!g_shell_parse_argv(line, &argc, &argv, &error)) {
+            g_printerr(_("Error: %s:%u: %s\n"), batch_file, line_no, error->message);
+            if (first_error == NMC_RESULT_SUCCESS)
+                first_error = NMC_RESULT_ERROR_USER_INPUT;
+            n_failed++;
+            continue;
+        }
+
+        /* the command handlers may keep pointers to the arguments, until the
+         * end of the program. */
+        g_ptr_array_add(argvs, argv);
+
+        nmc->return_value = NMC_RESULT_SUCCESS;
+        g_string_assign(nmc->return_text, _("Success"));
+        nmc->should_wait        = 0;
+        nmc->nmc_config_mutable = nmc_config;
+        nmc->timeout            = timeout;
+        nmc->nowait_flag        = nowait_flag;
+        nmc->required_fields    = g_strdup(fields);
+
+        nmc_do_cmd(nmc, cmds, argv[0], argc, (const char *const *) argv);
+        g_main_loop_run(loop);
+
+        nm_clear_g_free(&nmc->required_fields);
+
+        if (nmc->return_value != NMC_RESULT_SUCCESS) {
+            g_printerr("%s:%u: %s\n", batch_file, line_no, nmc->return_text->str);
+            if (first_error == NMC_RESULT_SUCCESS)
+                first_error = nmc->return_value;
+            n_failed++;
+            if (nmc->return_value == 0x80 + SIGINT) {
+                /* interrupted by the user. Stop here. */
+                break;
+            }
+        }
+    }
+
+    if (f != stdin)
+        fclose(f);
+
+    nmc->required_fields = g_steal_pointer(&fields);
+
+    if (n_failed > 0) {
+        nmc->return_value = first_error;
+        g_string_printf(nmc->return_text,
+                        _("Error: %u of %u batch commands failed."),
+                        n_failed,
+                        n_cmds);
+    } else {
+        nmc->return_value = NMC_RESULT_SUCCESS;
+        g_string_assign(nmc->return_text, _("Success"));
+    }
+}
+
 static gboolean
 process_command_line(NmCli *nmc, int argc, char **argv_orig)
 {
@@ -726,9 +835,11 @@ process_command_line(NmCli *nmc, int argc, char **argv_orig)
         {"agent", nmc_command_func_agent, NULL, FALSE, FALSE},
         {NULL, nmc_command_func_overview, usage, TRUE, TRUE},
     };
-    NmcColorOption     colors = NMC_USE_COLOR_AUTO;
+    NmcColorOption     colors     = NMC_USE_COLOR_AUTO;
+    gs_free char *     batch_file = NULL;
     const char *       base;
     const char *const *argv;
+    gboolean           get_values = FALSE;
 
     base = strrchr(argv_orig[0], '/');
     if (base == NULL)
@@ -758,6 +869,7 @@ process_command_line(NmCli *nmc, int argc, char **argv_orig)
             nmc_complete_strings(argv[0],
                                  "--terse",
                                  "--pretty",
+                                 "--json",
                                  "--mode",
                                  "--overview",
                                  "--colors",
@@ -766,6 +878,7 @@ process_command_line(NmCli *nmc, int argc, char **argv_orig)
                                  "--nocheck",
                                  "--get-values",
                                  "--wait",
+                                 "--batch",
                                  "--version",
                                  "--help");
         }
@@ -790,6 +903,11 @@ process_command_line(NmCli *nmc, int argc, char **argv_orig)
                     _("Error: Option '--terse' is mutually exclusive with '--pretty'."));
                 nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
                 return FALSE;
+            } else if (nmc->nmc_config.print_output == NMC_PRINT_JSON) {
+                g_string_printf(nmc->return_text,
+                                _("Error: Option '--terse' is mutually exclusive with '--json'."));
+                nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+                return FALSE;
             } else
                 nmc->nmc_config_mutable.print_output = NMC_PRINT_TERSE;
         } else if (matches_arg(nmc, &argc, &argv, "-pretty", NULL)) {
@@ -804,13 +922,53 @@ process_command_line(NmCli *nmc, int argc, char **argv_orig)
                     _("Error: Option '--pretty' is mutually exclusive with '--terse'."));
                 nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
                 return FALSE;
+            } else if (nmc->nmc_config.print_output == NMC_PRINT_JSON) {
+                g_string_printf(nmc->return_text,
+                                _("Error: Option '--pretty' is mutually exclusive with '--json'."));
+                nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+                return FALSE;
             } else
                 nmc->nmc_config_mutable.print_output = NMC_PRINT_PRETTY;
+        } else if (matches_arg(nmc, &argc, &argv, "-json", NULL)) {
+            if (nmc->nmc_config.print_output == NMC_PRINT_JSON) {
+                g_string_printf(nmc->return_text,
+                                _("Error: Option '--json' is specified the second time."));
+                nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+                return FALSE;
+            } else if (get_values) {
+                g_string_printf(
+                    nmc->return_text,
+                    _("Error: Option '--json' is mutually exclusive with '--get-values'."));
+                nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+                return FALSE;
+            } else if (nmc->mode_specified) {
+                g_string_printf(nmc->return_text,
+                                _("Error: Option '--json' is mutually exclusive with '--mode'."));
+                nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+                return FALSE;
+            } else if (nmc->nmc_config.print_output == NMC_PRINT_TERSE) {
+                g_string_printf(nmc->return_text,
+                                _("Error: Option '--json' is mutually exclusive with '--terse'."));
+                nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+                return FALSE;
+            } else if (nmc->nmc_config.print_output == NMC_PRINT_PRETTY) {
+                g_string_printf(nmc->return_text,
+                                _("Error: Option '--json' is mutually exclusive with '--pretty'."));
+                nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+                return FALSE;
+            } else
+                nmc->nmc_config_mutable.print_output = NMC_PRINT_JSON;
         } else if (matches_arg(nmc, &argc, &argv, "-mode", &value)) {
             nmc->mode_specified = TRUE;
             if (argc == 1 && nmc->complete)
                 complete_option_with_value(argv[0], value, "tabular", "multiline", NULL);
-            if (matches(value, "tabular"))
+            if (nmc->nmc_config.print_output == NMC_PRINT_JSON) {
+                /* JSON output has no tabular or multiline mode. */
+                g_string_printf(nmc->return_text,
+                                _("Error: Option '--mode' is mutually exclusive with '--json'."));
+                nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+                return FALSE;
+            } else if (matches(value, "tabular"))
                 nmc->nmc_config_mutable.multiline_output = FALSE;
             else if (matches(value, "multiline"))
                 nmc->nmc_config_mutable.multiline_output = TRUE;
@@ -861,6 +1019,14 @@ process_command_line(NmCli *nmc, int argc, char **argv_orig)
         } else if (matches_arg(nmc, &argc, &argv, "-get-values", &value)) {
             if (argc == 1 && nmc->complete)
                 complete_fields(argv[0], value);
+            if (nmc->nmc_config.print_output == NMC_PRINT_JSON) {
+                g_string_printf(
+                    nmc->return_text,
+                    _("Error: Option '--get-values' is mutually exclusive with '--json'."));
+                nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+                return FALSE;
+            }
+            get_values                           = TRUE;
             nmc->required_fields                 = g_strdup(value);
             nmc->nmc_config_mutable.print_output = NMC_PRINT_TERSE;
             /* We want fixed tabular mode here, but just set the mode specified and rely on defaults:
@@ -879,6 +1045,8 @@ process_command_line(NmCli *nmc, int argc, char **argv_orig)
                 return FALSE;
             }
             nmc->timeout = (int) timeout;
+        } else if (matches_arg(nmc, &argc, &argv, "-batch", &value)) {
+            nm_utils_strdup_reset(&batch_file, value);
         } else if (matches_arg(nmc, &argc, &argv, "-version", NULL)) {
             if (!nmc->complete)
                 g_print(_("nmcli tool, version %s\n"), NMCLI_VERSION);
@@ -909,6 +1077,18 @@ process_command_line(NmCli *nmc, int argc, char **argv_orig)
                &nmc->palette_buffer,
                &nmc->nmc_config_mutable.palette);
 
+    if (batch_file) {
+        if (argc > 0) {
+            g_string_printf(nmc->return_text,
+                            _("Error: no command is allowed together with '--batch'."));
+            nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+            return FALSE;
+        }
+        if (!nmc->complete)
+            process_batch(nmc, nmcli_cmds, batch_file);
+        return FALSE;
+    }
+
     /* Now run the requested command */
     nmc_do_cmd(nmc, nmcli_cmds, *argv, argc, argv);
 
@@ -52,7 +52,12 @@ typedef enum {
     NMC_RESULT_COMPLETE_FILE = 65,
 } NMCResultCode;
 
-typedef enum { NMC_PRINT_TERSE = 0, NMC_PRINT_NORMAL = 1, NMC_PRINT_PRETTY = 2 } NMCPrintOutput;
+typedef enum {
+    NMC_PRINT_TERSE  = 0,
+    NMC_PRINT_NORMAL = 1,
+    NMC_PRINT_PRETTY = 2,
+    NMC_PRINT_JSON   = 3,
+} NMCPrintOutput;
 
 static inline NMMetaAccessorGetType
 nmc_print_output_to_accessor_get_type(NMCPrintOutput print_output)
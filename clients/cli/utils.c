@@ -16,6 +16,8 @@
 #include <sys/auxv.h>
 #include <sys/prctl.h>
 
+#include "nm-glib-aux/nm-json-aux.h"
+#include "nm-glib-aux/nm-str-buf.h"
 #include "nm-client-utils.h"
 #include "nm-meta-setting-access.h"
 
@@ -992,21 +994,11 @@ _print_data_cell_clear(gpointer cell_p)
     _print_data_cell_clear_text(cell);
 }
 
-static void
-_print_fill(const NmcConfig *   nmc_config,
-            gpointer const *    targets,
-            gpointer            targets_data,
-            const PrintDataCol *cols,
-            guint               cols_len,
-            GArray **           out_header_row,
-            GArray **           out_cells)
+static GArray *
+_print_fill_header_row(const NmcConfig *nmc_config, const PrintDataCol *cols, guint cols_len)
 {
-    GArray *               cells;
-    GArray *               header_row;
-    guint                  i_row, i_col;
-    guint                  targets_len;
-    NMMetaAccessorGetType  text_get_type;
-    NMMetaAccessorGetFlags text_get_flags;
+    GArray *header_row;
+    guint   i_col;
 
     header_row = g_array_sized_new(FALSE, TRUE, sizeof(PrintDataHeaderCell), cols_len);
     g_array_set_clear_func(header_row, _print_data_header_cell_clear);
@@ -1048,6 +1040,27 @@ _print_fill(const NmcConfig *   nmc_config,
         }
     }
 
+    return header_row;
+}
+
+static void
+_print_fill(const NmcConfig *   nmc_config,
+            gpointer const *    targets,
+            gpointer            targets_data,
+            const PrintDataCol *cols,
+            guint               cols_len,
+            GArray **           out_header_row,
+            GArray **           out_cells)
+{
+    GArray *               cells;
+    GArray *               header_row;
+    guint                  i_row, i_col;
+    guint                  targets_len;
+    NMMetaAccessorGetType  text_get_type;
+    NMMetaAccessorGetFlags text_get_flags;
+
+    header_row = _print_fill_header_row(nmc_config, cols, cols_len);
+
     targets_len = NM_PTRARRAY_LEN(targets);
 
     cells = g_array_sized_new(FALSE, TRUE, sizeof(PrintDataCell), targets_len * header_row->len);
@@ -1384,6 +1397,350 @@ _print_do(const NmcConfig *          nmc_config,
     }
 }
 
+/* Whether the output can be written row by row, while the targets are
+ * visited. That is the case for the terse tabular form, which has no header
+ * and doesn't align the columns. But we cannot stream if a column may get
+ * hidden, because that can only be decided after looking at all rows. */
+static gboolean
+_print_stream_supported(const NmcConfig *nmc_config, const GArray *header_row)
+{
+    guint i_col;
+
+    if (nmc_config->print_output != NMC_PRINT_TERSE || nmc_config->multiline_output
+        || nmc_config->overview)
+        return FALSE;
+
+    for (i_col = 0; i_col < header_row->len; i_col++) {
+        const PrintDataHeaderCell *header_cell =
+            &g_array_index(header_row, PrintDataHeaderCell, i_col);
+        const NMMetaAbstractInfo *info = header_cell->col->selection_item->info;
+
+        if (info->meta_type == &nm_meta_type_property_info
+            && ((const NMMetaPropertyInfo *) info)->hide_if_default)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+_print_stream(const NmcConfig *nmc_config,
+              gpointer const * targets,
+              gpointer         targets_data,
+              GArray *         header_row)
+{
+    nm_auto_str_buf NMStrBuf row_buf  = NM_STR_BUF_INIT(NM_UTILS_GET_NEXT_REALLOC_SIZE_1000, FALSE);
+    nm_auto_str_buf NMStrBuf cell_buf = NM_STR_BUF_INIT(NM_UTILS_GET_NEXT_REALLOC_SIZE_104, FALSE);
+    NMMetaAccessorGetFlags   text_get_flags;
+    guint                    i_row, i_col;
+    guint                    targets_len;
+
+    nm_assert(_print_stream_supported(nmc_config, header_row));
+
+    /* no cell can be hidden, so every column gets printed. Compare with
+     * _print_fill(). */
+    for (i_col = 0; i_col < header_row->len; i_col++)
+        g_array_index(header_row, PrintDataHeaderCell, i_col).to_print = TRUE;
+
+    text_get_flags = NM_META_ACCESSOR_GET_FLAGS_ACCEPT_STRV;
+    if (nmc_config->show_secrets)
+        text_get_flags |= NM_META_ACCESSOR_GET_FLAGS_SHOW_SECRETS;
+
+    targets_len = NM_PTRARRAY_LEN(targets);
+
+    for (i_row = 0; i_row < targets_len; i_row++) {
+        gpointer target = targets[i_row];
+
+        nm_str_buf_reset(&row_buf, NULL);
+
+        for (i_col = 0; i_col < header_row->len; i_col++) {
+            const PrintDataHeaderCell *header_cell =
+                &g_array_index(header_row, PrintDataHeaderCell, i_col);
+            const NMMetaAbstractInfo *info = header_cell->col->selection_item->info;
+            gs_free char *            text_to_free = NULL;
+            gpointer                  to_free      = NULL;
+            NMMetaAccessorGetOutFlags text_out_flags, color_out_flags;
+            gconstpointer             value;
+            NMMetaColor               color;
+            const char *              text;
+            gboolean                  is_default;
+
+            if (_print_skip_column(nmc_config, header_cell))
+                continue;
+
+            value = nm_meta_abstract_info_get(info,
+                                              nmc_meta_environment,
+                                              (gpointer) nmc_meta_environment_arg,
+                                              target,
+                                              targets_data,
+                                              NM_META_ACCESSOR_GET_TYPE_PARSABLE,
+                                              text_get_flags,
+                                              &text_out_flags,
+                                              &is_default,
+                                              &to_free);
+
+            nm_assert(!to_free || value == to_free);
+
+            nm_str_buf_reset(&cell_buf, NULL);
+            if (NM_FLAGS_HAS(text_out_flags, NM_META_ACCESSOR_GET_OUT_FLAGS_STRV)) {
+                const char *const *strv = value;
+
+                for (; strv && *strv; strv++) {
+                    if (cell_buf.len > 0)
+                        nm_str_buf_append(&cell_buf, " | ");
+                    nm_str_buf_append(&cell_buf, *strv);
+                }
+                if (to_free)
+                    g_strfreev(to_free);
+            } else {
+                if (value)
+                    nm_str_buf_append(&cell_buf, value);
+                g_free(to_free);
+            }
+
+            color = GPOINTER_TO_INT(nm_meta_abstract_info_get(info,
+                                                              nmc_meta_environment,
+                                                              (gpointer) nmc_meta_environment_arg,
+                                                              target,
+                                                              targets_data,
+                                                              NM_META_ACCESSOR_GET_TYPE_COLOR,
+                                                              NM_META_ACCESSOR_GET_FLAGS_NONE,
+                                                              &color_out_flags,
+                                                              NULL,
+                                                              NULL));
+
+            text = colorize_string(nmc_config, color, nm_str_buf_get_str(&cell_buf), &text_to_free);
+
+            if (nmc_config->escape_values) {
+                for (; *text; text++) {
+                    if (NM_IN_SET(*text, ':', '\\'))
+                        nm_str_buf_append_c(&row_buf, '\\');
+                    nm_str_buf_append_c(&row_buf, *text);
+                }
+            } else
+                nm_str_buf_append(&row_buf, text);
+            nm_str_buf_append_c(&row_buf, ':');
+        }
+
+        /* Chop off last column separator */
+        if (row_buf.len > 0)
+            nm_str_buf_set_size(&row_buf, row_buf.len - 1, FALSE, FALSE);
+        nm_str_buf_append_c(&row_buf, '\n');
+        g_print("%s", nm_str_buf_get_str(&row_buf));
+    }
+}
+
+/* Returns the GObject property behind @info, or NULL if there is none, like
+ * for the generic infos. */
+static GParamSpec *
+_print_json_get_pspec(const NMMetaAbstractInfo *info, gpointer target)
+{
+    if (!info || info->meta_type != &nm_meta_type_property_info || !NM_IS_SETTING(target))
+        return NULL;
+
+    return g_object_class_find_property(G_OBJECT_GET_CLASS(target),
+                                        ((const NMMetaPropertyInfo *) info)->property_name);
+}
+
+/* Appends the value of a boolean or integer property as JSON boolean or number
+ * and returns TRUE. The value is taken from the property itself, because the
+ * parsable text of some integer properties is not a plain number. */
+static gboolean
+_print_json_append_typed(GString *str, gpointer target, GParamSpec *pspec)
+{
+    nm_auto_unset_gvalue GValue val = G_VALUE_INIT;
+
+    if (!pspec
+        || !NM_IN_SET(G_PARAM_SPEC_VALUE_TYPE(pspec),
+                      G_TYPE_BOOLEAN,
+                      G_TYPE_INT,
+                      G_TYPE_UINT,
+                      G_TYPE_INT64,
+                      G_TYPE_UINT64))
+        return FALSE;
+
+    g_value_init(&val, G_PARAM_SPEC_VALUE_TYPE(pspec));
+    g_object_get_property(target, pspec->name, &val);
+
+    switch (G_VALUE_TYPE(&val)) {
+    case G_TYPE_BOOLEAN:
+        g_string_append(str, g_value_get_boolean(&val) ? "true" : "false");
+        break;
+    case G_TYPE_INT:
+        g_string_append_printf(str, "%d", g_value_get_int(&val));
+        break;
+    case G_TYPE_UINT:
+        g_string_append_printf(str, "%u", g_value_get_uint(&val));
+        break;
+    case G_TYPE_INT64:
+        g_string_append_printf(str, "%" G_GINT64_FORMAT, g_value_get_int64(&val));
+        break;
+    default:
+        g_string_append_printf(str, "%" G_GUINT64_FORMAT, g_value_get_uint64(&val));
+        break;
+    }
+    return TRUE;
+}
+
+/* Appends @value as JSON. Only boolean and integer setting properties are typed,
+ * all other values are strings as printed in parsable form. */
+static void
+_print_json_append_value(GString *     str,
+                         gconstpointer value,
+                         gboolean      is_strv,
+                         gpointer      target,
+                         GParamSpec *  pspec)
+{
+    const char *const *strv;
+
+    if (!is_strv && _print_json_append_typed(str, target, pspec))
+        return;
+
+    if (!value) {
+        g_string_append(str, is_strv ? "[ ]" : "null");
+        return;
+    }
+
+    if (!is_strv) {
+        nm_json_gstr_append_string(str, value);
+        return;
+    }
+
+    g_string_append(str, "[ ");
+    for (strv = value; *strv; strv++) {
+        if (strv != value)
+            nm_json_gstr_append_delimiter(str);
+        nm_json_gstr_append_string(str, *strv);
+    }
+    g_string_append(str, " ]");
+}
+
+#define PRINT_JSON_MAX_DEPTH 8
+
+/* Prints one JSON object per target, on a separate line. The values are taken
+ * directly from the meta data accessors. Columns of a sub-selection (like the
+ * properties of a setting) are grouped in a nested object. */
+static void
+_print_json(const NmcConfig *nmc_config,
+            gpointer const * targets,
+            gpointer         targets_data,
+            GArray *         header_row)
+{
+    nm_auto_free_gstring GString *str = g_string_sized_new(NM_UTILS_GET_NEXT_REALLOC_SIZE_1000);
+    NMMetaAccessorGetFlags        text_get_flags;
+    guint                         i_row, i_col;
+    guint                         targets_len;
+
+    text_get_flags = NM_META_ACCESSOR_GET_FLAGS_ACCEPT_STRV;
+    if (nmc_config->show_secrets)
+        text_get_flags |= NM_META_ACCESSOR_GET_FLAGS_SHOW_SECRETS;
+
+    for (i_col = 0; i_col < header_row->len; i_col++)
+        g_array_index(header_row, PrintDataHeaderCell, i_col).to_print = TRUE;
+
+    targets_len = NM_PTRARRAY_LEN(targets);
+
+    for (i_row = 0; i_row < targets_len; i_row++) {
+        gpointer            target = targets[i_row];
+        const PrintDataCol *open_cols[PRINT_JSON_MAX_DEPTH];
+        bool                has_members[PRINT_JSON_MAX_DEPTH + 1];
+        guint               n_open = 0;
+
+        g_string_truncate(str, 0);
+        g_string_append_c(str, '{');
+        has_members[0] = FALSE;
+
+        for (i_col = 0; i_col < header_row->len; i_col++) {
+            const PrintDataHeaderCell *header_cell =
+                &g_array_index(header_row, PrintDataHeaderCell, i_col);
+            const PrintDataCol *      col  = header_cell->col;
+            const NMMetaAbstractInfo *info = col->selection_item->info;
+            const PrintDataCol *      parents[PRINT_JSON_MAX_DEPTH];
+            const PrintDataCol *      p;
+            gpointer                  to_free = NULL;
+            NMMetaAccessorGetOutFlags text_out_flags;
+            gconstpointer             value;
+            gboolean                  is_default;
+            gboolean                  is_strv;
+            guint                     n_parents;
+            guint                     i;
+
+            if (_print_skip_column(nmc_config, header_cell))
+                continue;
+
+            value = nm_meta_abstract_info_get(info,
+                                              nmc_meta_environment,
+                                              (gpointer) nmc_meta_environment_arg,
+                                              target,
+                                              targets_data,
+                                              NM_META_ACCESSOR_GET_TYPE_PARSABLE,
+                                              text_get_flags,
+                                              &text_out_flags,
+                                              &is_default,
+                                              &to_free);
+
+            nm_assert(!to_free || value == to_free);
+
+            is_strv = NM_FLAGS_HAS(text_out_flags, NM_META_ACCESSOR_GET_OUT_FLAGS_STRV);
+
+            if ((is_default && nmc_config->overview)
+                || NM_FLAGS_HAS(text_out_flags, NM_META_ACCESSOR_GET_OUT_FLAGS_HIDE)) {
+                /* a hidden value just omits the member. */
+                goto next;
+            }
+
+            n_parents = 0;
+            for (p = col->parent_col; p; p = p->parent_col) {
+                nm_assert(n_parents < PRINT_JSON_MAX_DEPTH);
+                parents[n_parents++] = p;
+            }
+
+            /* close the objects of the previous column, that are not also
+             * parents of this column. Then open the missing parents. */
+            for (i = 0; i < n_open && i < n_parents; i++) {
+                if (open_cols[i] != parents[n_parents - 1 - i])
+                    break;
+            }
+            for (; n_open > i; n_open--)
+                g_string_append(str, " }");
+            for (; n_open < n_parents; n_open++) {
+                p = parents[n_parents - 1 - n_open];
+                g_string_append(str, has_members[n_open] ? ", " : " ");
+                has_members[n_open] = TRUE;
+                nm_json_gstr_append_obj_name(
+                    str,
+                    nm_meta_abstract_info_get_name(p->selection_item->info, FALSE),
+                    '\0');
+                g_string_append_c(str, '{');
+                open_cols[n_open]       = p;
+                has_members[n_open + 1] = FALSE;
+            }
+
+            g_string_append(str, has_members[n_open] ? ", " : " ");
+            has_members[n_open] = TRUE;
+            nm_json_gstr_append_obj_name(str, nm_meta_abstract_info_get_name(info, FALSE), '\0');
+            _print_json_append_value(str,
+                                     value,
+                                     is_strv,
+                                     target,
+                                     _print_json_get_pspec(info, target));
+
+next:
+            if (to_free) {
+                if (is_strv)
+                    g_strfreev(to_free);
+                else
+                    g_free(to_free);
+            }
+        }
+
+        for (; n_open > 0; n_open--)
+            g_string_append(str, " }");
+        g_string_append(str, " }\n");
+        g_print("%s", str->str);
+    }
+}
+
 gboolean
 nmc_print(const NmcConfig *                nmc_config,
           gpointer const *                 targets,
@@ -1402,6 +1759,17 @@ nmc_print(const NmcConfig *                nmc_config,
     if (!_output_selection_parse(fields, fields_str, &cols_data, &cols_len, &gfree_keeper, error))
         return FALSE;
 
+    header_row = _print_fill_header_row(nmc_config, cols_data, cols_len);
+    if (nmc_config->print_output == NMC_PRINT_JSON) {
+        _print_json(nmc_config, targets, targets_data, header_row);
+        return TRUE;
+    }
+    if (_print_stream_supported(nmc_config, header_row)) {
+        _print_stream(nmc_config, targets, targets_data, header_row);
+        return TRUE;
+    }
+    nm_clear_pointer(&header_row, g_array_unref);
+
     _print_fill(nmc_config, targets, targets_data, cols_data, cols_len, &header_row, &cells);
 
     _print_do(nmc_config,
@@ -1451,7 +1819,8 @@ nmc_terminal_spawn_pager(const NmcConfig *nmc_config)
     int         fd[2];
     int         errsv;
 
-    if (nmc_config->in_editor || nmc_config->print_output == NMC_PRINT_TERSE
+    if (nmc_config->in_editor
+        || NM_IN_SET(nmc_config->print_output, NMC_PRINT_TERSE, NMC_PRINT_JSON)
         || !nmc_config->use_colors || g_strcmp0(pager, "") == 0 || getauxval(AT_SECURE))
         return 0;
 
@@ -1568,6 +1937,47 @@ get_value_to_print(const NmcConfig *     nmc_config,
  * Various flags influencing the output of fields are set up in the first item
  * of 'field_values' array.
  */
+static void
+_print_required_fields_json(const GArray *        indices,
+                            gboolean              section_prefix,
+                            const NmcOutputField *field_values)
+{
+    nm_auto_free_gstring GString *str = g_string_sized_new(NM_UTILS_GET_NEXT_REALLOC_SIZE_1000);
+    gboolean                      has_members = FALSE;
+    int                           i;
+
+    g_string_append(str, "{ ");
+
+    if (section_prefix) {
+        /* the first field is the section name. Nest the other fields. */
+        nm_json_gstr_append_obj_name(str, field_values[0].value ?: "", '{');
+    }
+
+    for (i = 0; i < indices->len; i++) {
+        int idx = g_array_index(indices, int, i);
+
+        if (section_prefix && idx == 0)
+            continue;
+
+        if (has_members)
+            nm_json_gstr_append_delimiter(str);
+        has_members = TRUE;
+        nm_json_gstr_append_obj_name(str,
+                                     nm_meta_abstract_info_get_name(field_values[idx].info, FALSE),
+                                     '\0');
+        _print_json_append_value(str,
+                                 field_values[idx].value,
+                                 field_values[idx].value_is_array,
+                                 NULL,
+                                 NULL);
+    }
+
+    if (section_prefix)
+        g_string_append(str, " }");
+    g_string_append(str, " }\n");
+    g_print("%s", str->str);
+}
+
 void
 print_required_fields(const NmcConfig *     nmc_config,
                       NmcPagerData *        pager_data,
@@ -1589,6 +1999,13 @@ print_required_fields(const NmcConfig *     nmc_config,
 
     nm_cli_spawn_pager(nmc_config, pager_data);
 
+    if (nmc_config->print_output == NMC_PRINT_JSON) {
+        /* There are no headers in JSON output. */
+        if (!main_header_only && !field_names)
+            _print_required_fields_json(indices, section_prefix, field_values);
+        return;
+    }
+
     /* --- Main header --- */
     if (nmc_config->print_output == NMC_PRINT_PRETTY && (main_header_add || main_header_only)) {
         gs_free char *line = NULL;
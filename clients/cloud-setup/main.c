@@ -376,137 +376,436 @@ _config_data_get_num_valid(GHashTable *config_dict)
     return n;
 }
 
-static gboolean
-_config_one(GCancellable *                        sigterm_cancellable,
-            NMClient *                            nmc,
-            gboolean                              is_single_nic,
-            const char *                          hwaddr,
-            const NMCSProviderGetConfigIfaceData *config_data)
+static guint64
+_config_data_hash(const NMCSProviderGetConfigIfaceData *config_data)
 {
-    gs_unref_object NMDevice *device                 = NULL;
-    gs_unref_object NMConnection *applied_connection = NULL;
-    guint64                       applied_version_id;
-    gs_free_error GError *error = NULL;
-    gboolean              changed;
-    gboolean              version_id_changed;
-    guint                 try_count;
-    gboolean              any_changes = FALSE;
+    NMHashState h;
+    gsize       i;
+    guint       j;
+
+    nm_hash_init(&h, 1468093069u);
+    nm_hash_update_vals(&h,
+                        config_data->iface_idx,
+                        config_data->cidr_addr,
+                        config_data->cidr_prefix,
+                        config_data->ipv4s_len,
+                        config_data->iproutes_len,
+                        NM_HASH_COMBINE_BOOLS(guint8,
+                                              config_data->has_ipv4s,
+                                              config_data->has_cidr));
+    if (config_data->ipv4s_len > 0)
+        nm_hash_update(&h, config_data->ipv4s_arr, config_data->ipv4s_len * sizeof(in_addr_t));
+
+    for (i = 0; i < config_data->iproutes_len; i++) {
+        NMIPRoute *        route = config_data->iproutes_arr[i];
+        gs_strfreev char **names = NULL;
+
+        nm_hash_update_str0(&h, nm_ip_route_get_dest(route));
+        nm_hash_update_str0(&h, nm_ip_route_get_next_hop(route));
+        nm_hash_update_vals(&h, nm_ip_route_get_prefix(route), nm_ip_route_get_metric(route));
+
+        names = nm_ip_route_get_attribute_names(route);
+        for (j = 0; names[j]; j++) {
+            nm_hash_update_str(&h, names[j]);
+            nm_hash_update_val(&h, g_variant_hash(nm_ip_route_get_attribute(route, names[j])));
+        }
+    }
 
-    g_main_context_iteration(NULL, FALSE);
+    return nm_hash_complete_u64(&h);
+}
 
-    if (g_cancellable_is_cancelled(sigterm_cancellable))
-        return FALSE;
+/* In persistent mode, we remember for each interface the hash of the meta data
+ * and the version-id of the applied connection that we left behind last time.
+ * NetworkManager bumps the version-id on every Reapply() and activation, also
+ * those done by others. As long as neither changed, there is nothing to do. */
+typedef struct {
+    guint64 config_hash;
+    guint64 applied_version_id;
+} IfaceState;
 
-    device = nm_g_object_ref(_nmc_get_device_by_hwaddr(nmc, hwaddr));
-    if (!device) {
-        _LOGD("config device %s: skip because device not found", hwaddr);
-        return FALSE;
+static void
+_iface_state_update(GHashTable *iface_states,
+                    const char *hwaddr,
+                    guint64     config_hash,
+                    guint64     applied_version_id)
+{
+    IfaceState *iface_state;
+
+    if (!iface_states)
+        return;
+
+    if (applied_version_id == 0) {
+        /* try again next time. */
+        g_hash_table_remove(iface_states, hwaddr);
+        return;
     }
 
-    if (!nmcs_provider_get_config_iface_data_is_valid(config_data)) {
-        _LOGD("config device %s: skip because meta data not successfully fetched", hwaddr);
-        return FALSE;
+    iface_state = g_hash_table_lookup(iface_states, hwaddr);
+    if (!iface_state) {
+        iface_state = g_slice_new0(IfaceState);
+        g_hash_table_insert(iface_states, g_strdup(hwaddr), iface_state);
     }
+    iface_state->config_hash        = config_hash;
+    iface_state->applied_version_id = applied_version_id;
+}
 
-    _LOGD("config device %s: configuring \"%s\" (%s)...",
-          hwaddr,
-          nm_device_get_iface(device) ?: "/unknown/",
-          nm_object_get_path(NM_OBJECT(device)));
+/*****************************************************************************/
 
-    try_count = 0;
+/* The maximum number of devices for which we have a GetAppliedConnection()
+ * or Reapply() call pending at the same time. */
+#define CONFIG_MAX_PARALLEL 8
 
-try_again:
+typedef struct {
+    GCancellable *sigterm_cancellable;
+    NMClient *    nmc;
+    GMainLoop *   main_loop;
+    GHashTable *  iface_states;
+    GQueue        queue;
+    guint         n_running;
+    bool          is_single_nic : 1;
+    bool          any_changes : 1;
+} ConfigAllData;
 
-    applied_connection = nmcs_device_get_applied_connection(device,
-                                                            sigterm_cancellable,
-                                                            &applied_version_id,
-                                                            &error);
-    if (!applied_connection) {
-        if (!nm_utils_error_is_cancelled(error))
-            _LOGD("config device %s: device has no applied connection (%s). Skip",
-                  hwaddr,
+typedef struct {
+    ConfigAllData *                       all_data;
+    const char *                          hwaddr;
+    const NMCSProviderGetConfigIfaceData *config_data;
+    NMDevice *                            device;
+    NMConnection *                        applied_connection;
+    guint64                               config_hash;
+    guint64                               applied_version_id;
+
+    /* if not zero, the version-id of the applied connection that we left
+     * behind last time, for the same meta data. */
+    guint64 unchanged_version_id;
+
+    guint try_count;
+} ConfigOneData;
+
+static void _config_one_start(ConfigOneData *one_data);
+
+static void
+_config_all_start_next(ConfigAllData *all_data)
+{
+    ConfigOneData *one_data;
+
+    while (all_data->n_running < CONFIG_MAX_PARALLEL
+           && (one_data = g_queue_pop_head(&all_data->queue))) {
+        all_data->n_running++;
+        _config_one_start(one_data);
+    }
+}
+
+static void
+_config_one_done(ConfigOneData *one_data, gboolean done)
+{
+    ConfigAllData *all_data = one_data->all_data;
+
+    /* only remember the state if we know the applied connection that
+     * we leave behind. */
+    _iface_state_update(all_data->iface_states,
+                        one_data->hwaddr,
+                        one_data->config_hash,
+                        done && one_data->applied_connection ? one_data->applied_version_id : 0);
+
+    g_clear_object(&one_data->device);
+    g_clear_object(&one_data->applied_connection);
+    nm_g_slice_free(one_data);
+
+    nm_assert(all_data->n_running > 0);
+    all_data->n_running--;
+
+    _config_all_start_next(all_data);
+    if (all_data->n_running == 0)
+        g_main_loop_quit(all_data->main_loop);
+}
+
+static void
+_config_one_reapply_cb(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    ConfigOneData *       one_data = user_data;
+    gs_free_error GError *error    = NULL;
+
+    if (!nm_device_reapply_finish(NM_DEVICE(source), result, &error)) {
+        if (g_error_matches(error, NM_DEVICE_ERROR, NM_DEVICE_ERROR_VERSION_ID_MISMATCH)
+            && one_data->try_count < 5) {
+            _LOGD("config device %s: applied connection changed in the meantime. Retry...",
+                  one_data->hwaddr);
+            g_clear_object(&one_data->applied_connection);
+            one_data->try_count++;
+            _config_one_start(one_data);
+            return;
+        }
+
+        if (!nm_utils_error_is_cancelled(error)) {
+            _LOGD("config device %s: failure to reapply connection \"%s\" (%s): %s",
+                  one_data->hwaddr,
+                  nm_connection_get_id(one_data->applied_connection),
+                  nm_connection_get_uuid(one_data->applied_connection),
                   error->message);
-        return any_changes;
+        }
+        _config_one_done(one_data, FALSE);
+        return;
+    }
+
+    _LOGD("config device %s: connection \"%s\" (%s) reapplied",
+          one_data->hwaddr,
+          nm_connection_get_id(one_data->applied_connection),
+          nm_connection_get_uuid(one_data->applied_connection));
+
+    if (!one_data->all_data->iface_states || one_data->try_count >= 5) {
+        _config_one_done(one_data, TRUE);
+        return;
+    }
+
+    /* Reapply() bumped the version-id. Fetch the applied connection once more
+     * to learn it. That also verifies that our changes are in place. */
+    g_clear_object(&one_data->applied_connection);
+    one_data->unchanged_version_id = 0;
+    one_data->try_count++;
+    _config_one_start(one_data);
+}
+
+static void
+_config_one_get_applied_connection_cb(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    ConfigOneData *       one_data = user_data;
+    ConfigAllData *       all_data = one_data->all_data;
+    gs_free_error GError *error    = NULL;
+    gboolean              changed;
+
+    one_data->applied_connection =
+        nm_device_get_applied_connection_finish(NM_DEVICE(source),
+                                                result,
+                                                &one_data->applied_version_id,
+                                                &error);
+    if (!one_data->applied_connection) {
+        if (nm_utils_error_is_cancelled(error)) {
+            _config_one_done(one_data, FALSE);
+            return;
+        }
+        _LOGD("config device %s: device has no applied connection (%s). Skip",
+              one_data->hwaddr,
+              error->message);
+        _config_one_done(one_data, TRUE);
+        return;
+    }
+
+    if (one_data->unchanged_version_id != 0
+        && one_data->unchanged_version_id == one_data->applied_version_id) {
+        _LOGT("config device %s: meta data and applied connection unchanged. Skip",
+              one_data->hwaddr);
+        _config_one_done(one_data, TRUE);
+        return;
     }
 
-    if (_nmc_skip_connection(applied_connection)) {
+    if (_nmc_skip_connection(one_data->applied_connection)) {
         _LOGD("config device %s: skip applied connection due to user data %s",
-              hwaddr,
+              one_data->hwaddr,
               USER_TAG_SKIP);
-        return any_changes;
+        _config_one_done(one_data, TRUE);
+        return;
     }
 
-    if (!_nmc_mangle_connection(device, applied_connection, config_data, &changed)) {
-        _LOGD("config device %s: device has no suitable applied connection. Skip", hwaddr);
-        return any_changes;
+    if (!_nmc_mangle_connection(one_data->device,
+                                one_data->applied_connection,
+                                one_data->config_data,
+                                &changed)) {
+        _LOGD("config device %s: device has no suitable applied connection. Skip",
+              one_data->hwaddr);
+        _config_one_done(one_data, TRUE);
+        return;
     }
 
     if (!changed) {
         _LOGD("config device %s: device needs no update to applied connection \"%s\" (%s). Skip",
-              hwaddr,
-              nm_connection_get_id(applied_connection),
-              nm_connection_get_uuid(applied_connection));
-        return any_changes;
+              one_data->hwaddr,
+              nm_connection_get_id(one_data->applied_connection),
+              nm_connection_get_uuid(one_data->applied_connection));
+        _config_one_done(one_data, TRUE);
+        return;
     }
 
     _LOGD("config device %s: reapply connection \"%s\" (%s)",
-          hwaddr,
-          nm_connection_get_id(applied_connection),
-          nm_connection_get_uuid(applied_connection));
+          one_data->hwaddr,
+          nm_connection_get_id(one_data->applied_connection),
+          nm_connection_get_uuid(one_data->applied_connection));
 
     /* we are about to call Reapply(). If if that fails, it counts as if we changed something. */
-    any_changes = TRUE;
+    all_data->any_changes = TRUE;
+
+    nm_device_reapply_async(one_data->device,
+                            one_data->applied_connection,
+                            one_data->applied_version_id,
+                            0,
+                            all_data->sigterm_cancellable,
+                            _config_one_reapply_cb,
+                            one_data);
+}
 
-    if (!nmcs_device_reapply(device,
-                             sigterm_cancellable,
-                             applied_connection,
-                             applied_version_id,
-                             &version_id_changed,
-                             &error)) {
-        if (version_id_changed && try_count < 5) {
-            _LOGD("config device %s: applied connection changed in the meantime. Retry...", hwaddr);
-            g_clear_object(&applied_connection);
-            g_clear_error(&error);
-            try_count++;
-            goto try_again;
+static void
+_config_one_start(ConfigOneData *one_data)
+{
+    nm_device_get_applied_connection_async(one_data->device,
+                                           0,
+                                           one_data->all_data->sigterm_cancellable,
+                                           _config_one_get_applied_connection_cb,
+                                           one_data);
+}
+
+static gboolean
+_config_all(GCancellable *sigterm_cancellable,
+            NMClient *    nmc,
+            GHashTable *  config_dict,
+            GHashTable *  iface_states)
+{
+    nm_auto_unref_gmainloop GMainLoop *main_loop = g_main_loop_new(NULL, FALSE);
+    ConfigAllData                      all_data  = {
+        .sigterm_cancellable = sigterm_cancellable,
+        .nmc                 = nmc,
+        .main_loop           = main_loop,
+        .iface_states        = iface_states,
+        .queue               = G_QUEUE_INIT,
+        .is_single_nic       = (_config_data_get_num_valid(config_dict) <= 1),
+    };
+    GHashTableIter                        h_iter;
+    const NMCSProviderGetConfigIfaceData *c_config_data;
+    const char *                          c_hwaddr;
+
+    g_hash_table_iter_init(&h_iter, config_dict);
+    while (g_hash_table_iter_next(&h_iter, (gpointer *) &c_hwaddr, (gpointer *) &c_config_data)) {
+        ConfigOneData *   one_data;
+        NMDevice *        device;
+        const IfaceState *iface_state;
+        guint64           config_hash          = 0;
+        guint64           unchanged_version_id = 0;
+
+        device = _nmc_get_device_by_hwaddr(nmc, c_hwaddr);
+        if (!device) {
+            _LOGD("config device %s: skip because device not found", c_hwaddr);
+            _iface_state_update(iface_states, c_hwaddr, 0, 0);
+            continue;
         }
 
-        if (!nm_utils_error_is_cancelled(error)) {
-            _LOGD("config device %s: failure to reapply connection \"%s\" (%s): %s",
-                  hwaddr,
-                  nm_connection_get_id(applied_connection),
-                  nm_connection_get_uuid(applied_connection),
-                  error->message);
+        if (!nmcs_provider_get_config_iface_data_is_valid(c_config_data)) {
+            _LOGD("config device %s: skip because meta data not successfully fetched", c_hwaddr);
+            _iface_state_update(iface_states, c_hwaddr, 0, 0);
+            continue;
+        }
+
+        if (iface_states) {
+            /* even if the meta data is unchanged, we still need to look at the
+             * version-id of the applied connection. */
+            config_hash = _config_data_hash(c_config_data);
+            iface_state = g_hash_table_lookup(iface_states, c_hwaddr);
+            if (iface_state && iface_state->config_hash == config_hash)
+                unchanged_version_id = iface_state->applied_version_id;
         }
-        return any_changes;
+
+        _LOGD("config device %s: configuring \"%s\" (%s)...",
+              c_hwaddr,
+              nm_device_get_iface(device) ?: "/unknown/",
+              nm_object_get_path(NM_OBJECT(device)));
+
+        one_data  = g_slice_new(ConfigOneData);
+        *one_data = (ConfigOneData){
+            .all_data             = &all_data,
+            .hwaddr               = c_hwaddr,
+            .config_data          = c_config_data,
+            .device               = g_object_ref(device),
+            .config_hash          = config_hash,
+            .unchanged_version_id = unchanged_version_id,
+        };
+        g_queue_push_tail(&all_data.queue, one_data);
     }
 
-    _LOGD("config device %s: connection \"%s\" (%s) reapplied",
-          hwaddr,
-          nm_connection_get_id(applied_connection),
-          nm_connection_get_uuid(applied_connection));
+    _config_all_start_next(&all_data);
+    if (all_data.n_running > 0)
+        g_main_loop_run(main_loop);
+
+    nm_assert(all_data.n_running == 0);
+    nm_assert(g_queue_is_empty(&all_data.queue));
+
+    if (iface_states) {
+        g_hash_table_iter_init(&h_iter, iface_states);
+        while (g_hash_table_iter_next(&h_iter, (gpointer *) &c_hwaddr, NULL)) {
+            if (!g_hash_table_contains(config_dict, c_hwaddr))
+                g_hash_table_iter_remove(&h_iter);
+        }
+    }
 
-    return any_changes;
+    return all_data.any_changes;
+}
+
+/*****************************************************************************/
+
+static void
+_persist_wait_cancelled_cb(GCancellable *cancellable, gpointer user_data)
+{
+    g_main_loop_quit(user_data);
 }
 
 static gboolean
-_config_all(GCancellable *sigterm_cancellable, NMClient *nmc, GHashTable *config_dict)
+_persist_wait_timeout_cb(gpointer user_data)
 {
-    GHashTableIter                        h_iter;
-    const NMCSProviderGetConfigIfaceData *c_config_data;
-    const char *                          c_hwaddr;
-    gboolean                              is_single_nic;
-    gboolean                              any_changes = FALSE;
+    g_main_loop_quit(user_data);
+    return G_SOURCE_CONTINUE;
+}
 
-    is_single_nic = (_config_data_get_num_valid(config_dict) <= 1);
+static void
+_persist_wait(GCancellable *sigterm_cancellable, guint interval_sec)
+{
+    nm_auto_unref_gmainloop GMainLoop *main_loop             = g_main_loop_new(NULL, FALSE);
+    nm_auto_destroy_and_unref_gsource GSource *timeout_source = NULL;
+    gulong                                     cancellable_id;
+
+    cancellable_id = g_cancellable_connect(sigterm_cancellable,
+                                           G_CALLBACK(_persist_wait_cancelled_cb),
+                                           main_loop,
+                                           NULL);
+    if (!cancellable_id)
+        return;
 
-    g_hash_table_iter_init(&h_iter, config_dict);
-    while (g_hash_table_iter_next(&h_iter, (gpointer *) &c_hwaddr, (gpointer *) &c_config_data)) {
-        if (_config_one(sigterm_cancellable, nmc, is_single_nic, c_hwaddr, c_config_data))
-            any_changes = TRUE;
-    }
+    timeout_source = nm_g_source_attach(nm_g_timeout_source_new_seconds(interval_sec,
+                                                                        G_PRIORITY_DEFAULT,
+                                                                        _persist_wait_timeout_cb,
+                                                                        main_loop,
+                                                                        NULL),
+                                        NULL);
+
+    /* while waiting, the main loop also processes the D-Bus events of NMClient. */
+    g_main_loop_run(main_loop);
+
+    nm_clear_g_signal_handler(sigterm_cancellable, &cancellable_id);
+}
+
+static void
+_persist_run(GCancellable *sigterm_cancellable,
+             NMCSProvider *provider,
+             NMClient *    nmc,
+             guint         interval_sec)
+{
+    gs_unref_hashtable GHashTable *iface_states =
+        g_hash_table_new_full(nm_str_hash, g_str_equal, g_free, nm_g_slice_free_fcn(IfaceState));
+
+    _LOGI("persistent mode: fetch meta data every %u seconds", interval_sec);
+
+    while (!g_cancellable_is_cancelled(sigterm_cancellable)) {
+        gs_unref_hashtable GHashTable *config_dict = NULL;
+
+        if (!nm_client_get_nm_running(nmc)) {
+            _LOGD("NetworkManager is not running");
+            /* when NetworkManager comes back, configure everything anew. */
+            g_hash_table_remove_all(iface_states);
+        } else {
+            config_dict = _get_config(sigterm_cancellable, provider, nmc);
+            if (config_dict && _config_all(sigterm_cancellable, nmc, config_dict, iface_states))
+                _LOGI("some changes were applied for provider %s",
+                      nmcs_provider_get_name(provider));
+        }
 
-    return any_changes;
+        _persist_wait(sigterm_cancellable, interval_sec);
+    }
 }
 
 /*****************************************************************************/
@@ -535,6 +834,7 @@ main(int argc, const char *const *argv)
     gs_unref_object NMClient *nmc                             = NULL;
     gs_unref_hashtable GHashTable *config_dict                = NULL;
     gs_free_error GError *error                               = NULL;
+    guint                 persist_interval_sec;
 
     _nm_logging_enabled_init(g_getenv(NMCS_ENV_VARIABLE("NM_CLOUD_SETUP_LOG")));
 
@@ -545,6 +845,13 @@ main(int argc, const char *const *argv)
         return EXIT_FAILURE;
     }
 
+    persist_interval_sec = _nm_utils_ascii_str_to_int64(
+        g_getenv(NMCS_ENV_VARIABLE("NM_CLOUD_SETUP_PERSIST_INTERVAL")),
+        10,
+        0,
+        G_MAXINT32 / 1000,
+        0);
+
     sigterm_cancellable = g_cancellable_new();
 
     sigterm_source = nm_g_source_attach(nm_g_unix_signal_source_new(SIGTERM,
@@ -574,6 +881,11 @@ main(int argc, const char *const *argv)
         goto done;
     }
 
+    if (persist_interval_sec > 0) {
+        _persist_run(sigterm_cancellable, provider, nmc, persist_interval_sec);
+        goto done;
+    }
+
     if (!nm_client_get_nm_running(nmc)) {
         _LOGI("NetworkManager is not running");
         goto done;
@@ -583,7 +895,7 @@ main(int argc, const char *const *argv)
     if (!config_dict)
         goto done;
 
-    if (_config_all(sigterm_cancellable, nmc, config_dict))
+    if (_config_all(sigterm_cancellable, nmc, config_dict, NULL))
         _LOGI("some changes were applied for provider %s", nmcs_provider_get_name(provider));
     else
         _LOGD("no changes were applied for provider %s", nmcs_provider_get_name(provider));
@@ -733,100 +733,3 @@ nmcs_setting_ip_replace_ipv4_rules(NMSettingIPConfig *s_ip,
 
     return any_changes;
 }
-
-/*****************************************************************************/
-
-typedef struct {
-    GMainLoop *   main_loop;
-    NMConnection *connection;
-    GError *      error;
-    guint64       version_id;
-} DeviceGetAppliedConnectionData;
-
-static void
-_nmcs_device_get_applied_connection_cb(GObject *source, GAsyncResult *result, gpointer user_data)
-{
-    DeviceGetAppliedConnectionData *data = user_data;
-
-    data->connection = nm_device_get_applied_connection_finish(NM_DEVICE(source),
-                                                               result,
-                                                               &data->version_id,
-                                                               &data->error);
-    g_main_loop_quit(data->main_loop);
-}
-
-NMConnection *
-nmcs_device_get_applied_connection(NMDevice *    device,
-                                   GCancellable *cancellable,
-                                   guint64 *     version_id,
-                                   GError **     error)
-{
-    nm_auto_unref_gmainloop GMainLoop *main_loop = g_main_loop_new(NULL, FALSE);
-    DeviceGetAppliedConnectionData     data      = {
-        .main_loop = main_loop,
-    };
-
-    nm_device_get_applied_connection_async(device,
-                                           0,
-                                           cancellable,
-                                           _nmcs_device_get_applied_connection_cb,
-                                           &data);
-
-    g_main_loop_run(main_loop);
-
-    if (data.error)
-        g_propagate_error(error, data.error);
-    NM_SET_OUT(version_id, data.version_id);
-    return data.connection;
-}
-
-/*****************************************************************************/
-
-typedef struct {
-    GMainLoop *main_loop;
-    GError *   error;
-} DeviceReapplyData;
-
-static void
-_nmcs_device_reapply_cb(GObject *source, GAsyncResult *result, gpointer user_data)
-{
-    DeviceReapplyData *data = user_data;
-
-    nm_device_reapply_finish(NM_DEVICE(source), result, &data->error);
-    g_main_loop_quit(data->main_loop);
-}
-
-gboolean
-nmcs_device_reapply(NMDevice *    device,
-                    GCancellable *sigterm_cancellable,
-                    NMConnection *connection,
-                    guint64       version_id,
-                    gboolean *    out_version_id_changed,
-                    GError **     error)
-{
-    nm_auto_unref_gmainloop GMainLoop *main_loop = g_main_loop_new(NULL, FALSE);
-    DeviceReapplyData                  data      = {
-        .main_loop = main_loop,
-    };
-
-    nm_device_reapply_async(device,
-                            connection,
-                            version_id,
-                            0,
-                            sigterm_cancellable,
-                            _nmcs_device_reapply_cb,
-                            &data);
-
-    g_main_loop_run(main_loop);
-
-    if (data.error) {
-        NM_SET_OUT(
-            out_version_id_changed,
-            g_error_matches(data.error, NM_DEVICE_ERROR, NM_DEVICE_ERROR_VERSION_ID_MISMATCH));
-        g_propagate_error(error, data.error);
-        return FALSE;
-    }
-
-    NM_SET_OUT(out_version_id_changed, FALSE);
-    return TRUE;
-}
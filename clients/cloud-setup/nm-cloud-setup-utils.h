@@ -105,18 +105,4 @@ gboolean nmcs_setting_ip_replace_ipv4_rules(NMSettingIPConfig *s_ip,
                                             NMIPRoutingRule ** entries_arr,
                                             guint              entries_len);
 
-/*****************************************************************************/
-
-NMConnection *nmcs_device_get_applied_connection(NMDevice *    device,
-                                                 GCancellable *cancellable,
-                                                 guint64 *     version_id,
-                                                 GError **     error);
-
-gboolean nmcs_device_reapply(NMDevice *    device,
-                             GCancellable *sigterm_cancellable,
-                             NMConnection *connection,
-                             guint64       version_id,
-                             gboolean *    out_version_id_changed,
-                             GError **     error);
-
 #endif /* __NM_CLOUD_SETUP_UTILS_H__ */
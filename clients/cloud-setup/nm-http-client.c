@@ -18,6 +18,10 @@ typedef struct {
     CURLM *       mhandle;
     GSource *     mhandle_source_timeout;
     GHashTable *  source_sockets_hashtable;
+
+    /* url -> EtagCacheEntry. For responses that came with an ETag, we remember the
+     * data and make the next request for the same URL conditional. */
+    GHashTable *etag_cache;
 } NMHttpClientPrivate;
 
 struct _NMHttpClient {
@@ -112,16 +116,33 @@ _get_result_free(gpointer data)
     nm_g_slice_free(get_result);
 }
 
+typedef struct {
+    char *  etag;
+    GBytes *response_data;
+} EtagCacheEntry;
+
+static void
+_etag_cache_entry_free(gpointer data)
+{
+    EtagCacheEntry *entry = data;
+
+    g_free(entry->etag);
+    g_bytes_unref(entry->response_data);
+    nm_g_slice_free(entry);
+}
+
 typedef struct {
     GTask *            task;
     GSource *          timeout_source;
     CURLcode           ehandle_result;
     CURL *             ehandle;
     char *             url;
+    char *             etag;
     NMStrBuf           recv_data;
     struct curl_slist *headers;
     gssize             max_data;
     gulong             cancellable_id;
+    bool               if_none_match : 1;
 } EHandleData;
 
 static void
@@ -148,9 +169,47 @@ _ehandle_free(EHandleData *edata)
     if (edata->headers)
         curl_slist_free_all(edata->headers);
     g_free(edata->url);
+    g_free(edata->etag);
     nm_g_slice_free(edata);
 }
 
+static void
+_ehandle_etag_cache_update(EHandleData *edata, long *response_code)
+{
+    NMHttpClient *       self = g_task_get_source_object(edata->task);
+    NMHttpClientPrivate *priv = NM_HTTP_CLIENT_GET_PRIVATE(self);
+    EtagCacheEntry *     entry;
+
+    if (*response_code == 304 && edata->if_none_match) {
+        entry = g_hash_table_lookup(priv->etag_cache, edata->url);
+        if (entry) {
+            /* Not modified. Pretend that we received the previous response again. */
+            _LOG2D(edata, "not modified (ETag %s)", entry->etag);
+            nm_str_buf_reset(&edata->recv_data, NULL);
+            nm_str_buf_append_len(&edata->recv_data,
+                                  g_bytes_get_data(entry->response_data, NULL),
+                                  g_bytes_get_size(entry->response_data));
+            *response_code = 200;
+            return;
+        }
+    }
+
+    if (*response_code != 200)
+        return;
+
+    if (!edata->etag) {
+        g_hash_table_remove(priv->etag_cache, edata->url);
+        return;
+    }
+
+    entry  = g_slice_new(EtagCacheEntry);
+    *entry = (EtagCacheEntry){
+        .etag          = g_steal_pointer(&edata->etag),
+        .response_data = g_bytes_new(nm_str_buf_get_str(&edata->recv_data), edata->recv_data.len),
+    };
+    g_hash_table_insert(priv->etag_cache, g_strdup(edata->url), entry);
+}
+
 static void
 _ehandle_complete(EHandleData *edata, GError *error_take)
 {
@@ -185,6 +244,8 @@ _ehandle_complete(EHandleData *edata, GError *error_take)
     if (curl_easy_getinfo(edata->ehandle, CURLINFO_RESPONSE_CODE, &response_code) != CURLE_OK)
         _LOG2E(edata, "failed to get response code from curl easy handle");
 
+    _ehandle_etag_cache_update(edata, &response_code);
+
     _LOG2D(edata,
            "success getting %" G_GSIZE_FORMAT " bytes (response code %ld)",
            edata->recv_data.len,
@@ -236,6 +297,31 @@ _get_writefunction_cb(char *ptr, size_t size, size_t nmemb, void *user_data)
     return nconsume;
 }
 
+static size_t
+_get_headerfunction_cb(char *ptr, size_t size, size_t nmemb, void *user_data)
+{
+    EHandleData *edata = user_data;
+    gsize        len   = size * nmemb;
+    const char * value;
+    gsize        value_len;
+
+    if (len <= NM_STRLEN("ETag:") || g_ascii_strncasecmp(ptr, "ETag:", NM_STRLEN("ETag:")) != 0)
+        return len;
+
+    value     = &ptr[NM_STRLEN("ETag:")];
+    value_len = len - NM_STRLEN("ETag:");
+    while (value_len > 0 && g_ascii_isspace(value[0])) {
+        value++;
+        value_len--;
+    }
+    while (value_len > 0 && g_ascii_isspace(value[value_len - 1]))
+        value_len--;
+
+    g_free(edata->etag);
+    edata->etag = value_len > 0 ? g_strndup(value, value_len) : NULL;
+    return len;
+}
+
 static gboolean
 _get_timeout_cb(gpointer user_data)
 {
@@ -268,6 +354,7 @@ nm_http_client_get(NMHttpClient *      self,
 {
     NMHttpClientPrivate *priv;
     EHandleData *        edata;
+    EtagCacheEntry *     etag_entry;
     guint                i;
 
     g_return_if_fail(NM_IS_HTTP_CLIENT(self));
@@ -304,6 +391,8 @@ nm_http_client_get(NMHttpClient *      self,
 
     curl_easy_setopt(edata->ehandle, CURLOPT_WRITEFUNCTION, _get_writefunction_cb);
     curl_easy_setopt(edata->ehandle, CURLOPT_WRITEDATA, edata);
+    curl_easy_setopt(edata->ehandle, CURLOPT_HEADERFUNCTION, _get_headerfunction_cb);
+    curl_easy_setopt(edata->ehandle, CURLOPT_HEADERDATA, edata);
     curl_easy_setopt(edata->ehandle, CURLOPT_PRIVATE, edata);
 
     if (http_headers) {
@@ -318,10 +407,24 @@ nm_http_client_get(NMHttpClient *      self,
             }
             edata->headers = tmp;
         }
+    }
 
-        curl_easy_setopt(edata->ehandle, CURLOPT_HTTPHEADER, edata->headers);
+    etag_entry = g_hash_table_lookup(priv->etag_cache, url);
+    if (etag_entry) {
+        gs_free char *     h = g_strdup_printf("If-None-Match: %s", etag_entry->etag);
+        struct curl_slist *tmp;
+
+        tmp = curl_slist_append(edata->headers, h);
+        if (tmp) {
+            edata->headers       = tmp;
+            edata->if_none_match = TRUE;
+        } else
+            _LOGE("curl: curl_slist_append() failed adding %s", h);
     }
 
+    if (edata->headers)
+        curl_easy_setopt(edata->ehandle, CURLOPT_HTTPHEADER, edata->headers);
+
     if (timeout_msec > 0) {
         edata->timeout_source = _source_attach(self,
                                                nm_g_timeout_source_new(timeout_msec,
@@ -732,6 +835,8 @@ nm_http_client_init(NMHttpClient *self)
                               NULL,
                               NULL,
                               (GDestroyNotify) nm_g_source_destroy_and_unref);
+    priv->etag_cache =
+        g_hash_table_new_full(nm_str_hash, g_str_equal, g_free, _etag_cache_entry_free);
 }
 
 static void
@@ -769,6 +874,7 @@ dispose(GObject *object)
 
     nm_clear_pointer(&priv->mhandle, curl_multi_cleanup);
     nm_clear_pointer(&priv->source_sockets_hashtable, g_hash_table_unref);
+    nm_clear_pointer(&priv->etag_cache, g_hash_table_unref);
 
     nm_clear_g_source_inst(&priv->mhandle_source_timeout);
 
@@ -256,7 +256,6 @@ _get_config_ips_prefix_list_cb(GObject *source, GAsyncResult *result, gpointer u
 
     nm_assert(!iface_data->iface_get_config->has_ipv4s);
     nm_assert(!iface_data->iface_get_config->ipv4s_arr);
-    nm_assert(!iface_data->iface_get_config->has_cidr);
 
     while (nm_utils_parse_next_line(&response_str, &response_len, &line, &line_len)) {
         gint64 ips_prefix_idx;
@@ -301,36 +300,19 @@ _get_config_ips_prefix_list_cb(GObject *source, GAsyncResult *result, gpointer u
         }
     }
 
+    /* the pending count also includes this request and the one for the
+     * subnet prefix, so the array is large enough for all addresses. */
     iface_data->iface_get_config->ipv4s_len = 0;
     iface_data->iface_get_config->ipv4s_arr = g_new(in_addr_t, iface_data->n_ips_prefix_pending);
 
-    {
-        gs_free const char *uri = NULL;
-        char                buf[30];
-
-        iface_data->n_ips_prefix_pending++;
-        nm_http_client_poll_get(
-            NM_HTTP_CLIENT(source),
-            (uri = _azure_uri_interfaces(
-                 nm_sprintf_buf(buf, "%" G_GSSIZE_FORMAT, iface_data->iface_idx),
-                 "/ipv4/subnet/0/prefix/")),
-            HTTP_TIMEOUT_MS,
-            512 * 1024,
-            10000,
-            1000,
-            NM_MAKE_STRV(NM_AZURE_METADATA_HEADER),
-            g_task_get_cancellable(azure_data->config_data->task),
-            NULL,
-            NULL,
-            _get_config_fetch_done_cb_subnet_cidr_prefix,
-            iface_data);
-    }
-    return;
-
 done:
-    _azure_iface_data_free(iface_data);
-    --azure_data->n_ifaces_pending;
-    _get_config_maybe_task_return(azure_data, g_steal_pointer(&error));
+    --iface_data->n_ips_prefix_pending;
+    if (iface_data->n_ips_prefix_pending == 0) {
+        _azure_iface_data_free(iface_data);
+        --azure_data->n_ifaces_pending;
+        _get_config_maybe_task_return(azure_data, g_steal_pointer(&error));
+    } else if (error)
+        _get_config_maybe_task_return(azure_data, g_steal_pointer(&error));
 }
 
 static void
@@ -339,7 +321,8 @@ _get_config_iface_cb(GObject *source, GAsyncResult *result, gpointer user_data)
     gs_unref_bytes GBytes *response   = NULL;
     AzureIfaceData *       iface_data = user_data;
     gs_free_error GError *error       = NULL;
-    gs_free const char *  uri         = NULL;
+    gs_free const char *  uri1        = NULL;
+    gs_free const char *  uri2        = NULL;
     char                  buf[100];
     AzureData *           azure_data;
 
@@ -376,10 +359,13 @@ _get_config_iface_cb(GObject *source, GAsyncResult *result, gpointer user_data)
           iface_data->iface_idx,
           iface_data->hwaddr);
 
+    /* The list of IP addresses and the subnet prefix are independent of
+     * each other. Fetch them in parallel. */
     nm_sprintf_buf(buf, "%" G_GSSIZE_FORMAT "/ipv4/ipAddress/", iface_data->iface_idx);
 
+    iface_data->n_ips_prefix_pending++;
     nm_http_client_poll_get(NM_HTTP_CLIENT(source),
-                            (uri = _azure_uri_interfaces(buf)),
+                            (uri1 = _azure_uri_interfaces(buf)),
                             HTTP_TIMEOUT_MS,
                             512 * 1024,
                             10000,
@@ -390,6 +376,22 @@ _get_config_iface_cb(GObject *source, GAsyncResult *result, gpointer user_data)
                             NULL,
                             _get_config_ips_prefix_list_cb,
                             iface_data);
+
+    nm_sprintf_buf(buf, "%" G_GSSIZE_FORMAT, iface_data->iface_idx);
+
+    iface_data->n_ips_prefix_pending++;
+    nm_http_client_poll_get(NM_HTTP_CLIENT(source),
+                            (uri2 = _azure_uri_interfaces(buf, "/ipv4/subnet/0/prefix/")),
+                            HTTP_TIMEOUT_MS,
+                            512 * 1024,
+                            10000,
+                            1000,
+                            NM_MAKE_STRV(NM_AZURE_METADATA_HEADER),
+                            g_task_get_cancellable(azure_data->config_data->task),
+                            NULL,
+                            NULL,
+                            _get_config_fetch_done_cb_subnet_cidr_prefix,
+                            iface_data);
     return;
 
 done:
@@ -168,7 +168,8 @@ _dict_idx_entries_hash(const NMDedupMultiEntry *entry)
 
     _entry_unpack(entry, &idx_type, &obj, &lookup_head);
 
-    nm_hash_init(&h, 1914869417u);
+    /* the index is internal, use the fast hash. */
+    nm_hash_init_fast(&h, 1914869417u);
     if (idx_type->klass->idx_obj_partition_hash_update) {
         nm_assert(obj);
         idx_type->klass->idx_obj_partition_hash_update(idx_type, obj, &h);
@@ -757,7 +758,7 @@ _dict_idx_objs_hash(const NMDedupMultiObj *obj)
 {
     NMHashState h;
 
-    nm_hash_init(&h, 1748638583u);
+    nm_hash_init_fast(&h, 1748638583u);
     obj->klass->obj_full_hash_update(obj, &h);
     return nm_hash_complete(&h);
 }
@@ -126,6 +126,56 @@ nm_hash_siphash42_init(CSipHash *h, guint static_seed)
     c_siphash_init(h, (const guint8 *) &seed);
 }
 
+void
+nm_hash_init_fast(NMHashState *state, guint static_seed)
+{
+    const guint8 *g;
+    guint64       seed;
+
+    nm_assert(state);
+
+    g = _get_hash_key();
+    memcpy(&seed, g, sizeof(seed));
+
+    state->_fast.acc = (seed ^ static_seed) + NM_HASH_FAST_PRIME_1;
+    state->_fast.len = 0;
+    state->_is_fast  = TRUE;
+}
+
+static inline guint64
+_hash_fast_round(guint64 acc, guint64 v)
+{
+    acc += v * NM_HASH_FAST_PRIME_2;
+    acc = (acc << 31) | (acc >> 33);
+    return acc * NM_HASH_FAST_PRIME_1;
+}
+
+void
+_nm_hash_fast_update(NMHashState *state, const void *ptr, gsize n)
+{
+    const guint8 *p   = ptr;
+    guint64       acc = state->_fast.acc;
+    guint64       v;
+
+    nm_assert(state->_is_fast);
+
+    state->_fast.len += n;
+
+    /* the keys are commonly packed structs of a few dozen bytes. Consume them
+     * in words of 64 bit. */
+    for (; n >= sizeof(v); n -= sizeof(v), p += sizeof(v)) {
+        memcpy(&v, p, sizeof(v));
+        acc = _hash_fast_round(acc, v);
+    }
+    if (n > 0) {
+        v = 0;
+        memcpy(&v, p, n);
+        acc = _hash_fast_round(acc, v ^ (((guint64) n) << 59));
+    }
+
+    state->_fast.acc = acc;
+}
+
 guint
 nm_hash_str(const char *str)
 {
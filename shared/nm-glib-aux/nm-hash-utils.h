@@ -46,7 +46,14 @@ nm_hash_siphash42(guint static_seed, const void *ptr, gsize n)
 /*****************************************************************************/
 
 struct _NMHashState {
-    CSipHash _state;
+    union {
+        CSipHash _state;
+        struct {
+            guint64 acc;
+            guint64 len;
+        } _fast;
+    };
+    bool _is_fast;
 };
 
 typedef struct _NMHashState NMHashState;
@@ -59,6 +66,38 @@ nm_hash_init(NMHashState *state, guint static_seed)
     nm_assert(state);
 
     nm_hash_siphash42_init(&state->_state, static_seed);
+    state->_is_fast = FALSE;
+}
+
+/* nm_hash_init_fast() is like nm_hash_init(), but the state uses a simple
+ * multiply-rotate hash instead of siphash24. That is much faster for the
+ * small, fixed-size keys that we commonly hash, but it's not designed to
+ * withstand hash flooding. Only use it for indexes that are not fed with
+ * data that an attacker controls.
+ *
+ * The hash is seeded with the same random per-run key like nm_hash_init().
+ * Also note that, unlike with siphash, the result depends on how the data
+ * is split into nm_hash_update() calls. That is no problem as long as equal
+ * objects are always hashed the same way. */
+void nm_hash_init_fast(NMHashState *state, guint static_seed);
+
+void _nm_hash_fast_update(NMHashState *state, const void *ptr, gsize n);
+
+#define NM_HASH_FAST_PRIME_1 ((guint64) 0x9E3779B185EBCA87ull)
+#define NM_HASH_FAST_PRIME_2 ((guint64) 0xC2B2AE3D27D4EB4Full)
+#define NM_HASH_FAST_PRIME_3 ((guint64) 0x165667B19E3779F9ull)
+
+static inline guint64
+_nm_hash_fast_finalize(const NMHashState *state)
+{
+    guint64 h = state->_fast.acc ^ (state->_fast.len * NM_HASH_FAST_PRIME_3);
+
+    h ^= h >> 33;
+    h *= NM_HASH_FAST_PRIME_2;
+    h ^= h >> 29;
+    h *= NM_HASH_FAST_PRIME_3;
+    h ^= h >> 32;
+    return h;
 }
 
 static inline guint64
@@ -73,8 +112,11 @@ nm_hash_complete_u64(NMHashState *state)
      * - nm_hash_complete() never returns zero.
      *
      * In practice, nm_hash*() API is implemented via siphash24, so this returns
-     * the siphash24 value. But that is not guaranteed by the API, and if you need
-     * siphash24 directly, use c_siphash_*() and nm_hash_siphash42*() API. */
+     * the siphash24 value (unless the state was initialized with nm_hash_init_fast()).
+     * But that is not guaranteed by the API, and if you need siphash24 directly,
+     * use c_siphash_*() and nm_hash_siphash42*() API. */
+    if (state->_is_fast)
+        return _nm_hash_fast_finalize(state);
     return c_siphash_finalize(&state->_state);
 }
 
@@ -101,8 +143,11 @@ nm_hash_update(NMHashState *state, const void *ptr, gsize n)
      * that we should nm_explicit_bzero() afterwards. However, since
      * we are using siphash24 with a random key, that is not really
      * necessary. Something to keep in mind, if we ever move away from
-     * this hash implementation. */
-    c_siphash_append(&state->_state, ptr, n);
+     * this hash implementation (or when using nm_hash_init_fast()). */
+    if (state->_is_fast)
+        _nm_hash_fast_update(state, ptr, n);
+    else
+        c_siphash_append(&state->_state, ptr, n);
 }
 
 #define nm_hash_update_val(state, val)                \
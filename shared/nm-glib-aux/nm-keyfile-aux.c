@@ -12,20 +12,42 @@
 #include <fcntl.h>
 
 #include "nm-io-utils.h"
+#include "nm-str-buf.h"
 
 /*****************************************************************************/
 
+/* Changes are not written by rewriting the entire keyfile. Instead, a record for
+ * each changed key is appended to a log file next to the keyfile ("$FILENAME.log").
+ * On start, the log is replayed on top of the keyfile. Once the log grows larger
+ * than the keyfile (but at least LOG_COMPACT_MIN_SIZE), it gets compacted by
+ * writing the full keyfile and deleting the log.
+ *
+ * Each record is one line "$CRC32 S$KEY=$VALUE" or "$CRC32 R$KEY", where
+ * the checksum covers everything after the space. Replay stops at the first record
+ * that is incomplete or has an invalid checksum (for example, after a crash during
+ * the write). A log that cannot be read, or that has invalid records before its
+ * end, is renamed to "$FILENAME.log.bad" instead of being compacted over. */
+#define LOG_COMPACT_MIN_SIZE ((gsize) (64 * 1024))
+
+#define LOG_MAX_SIZE ((gsize) (20 * 1024 * 1024))
+
 struct _NMKeyFileDB {
     NMKeyFileDBLogFcn      log_fcn;
     NMKeyFileDBGotDirtyFcn got_dirty_fcn;
     gpointer               user_data;
     const char *           group_name;
     GKeyFile *             kf;
+    char *                 log_filename;
+    GHashTable *           dirty_keys;
+    gsize                  base_size;
+    gsize                  log_size;
     guint                  ref_count;
 
     bool is_started : 1;
     bool dirty : 1;
     bool destroyed : 1;
+    bool log_needs_compact : 1;
+    bool log_broken : 1;
 
     char filename[];
 };
@@ -45,6 +67,7 @@ struct _NMKeyFileDB {
     G_STMT_END
 
 #define _LOGD(...) _NMLOG(self, LOG_DEBUG, __VA_ARGS__)
+#define _LOGW(...) _NMLOG(self, LOG_WARNING, __VA_ARGS__)
 
 static gboolean
 _IS_KEY_FILE_DB(NMKeyFileDB *self, gboolean require_is_started, gboolean allow_destroyed)
@@ -87,6 +110,7 @@ nm_key_file_db_new(const char *           filename,
     self->got_dirty_fcn = got_dirty_fcn;
     self->user_data     = user_data;
     self->kf            = g_key_file_new();
+    self->log_filename  = g_strconcat(filename, ".log", NULL);
     g_key_file_set_list_separator(self->kf, ',');
     memcpy(self->filename, filename, l_filename + 1);
     self->group_name = &self->filename[l_filename + 1];
@@ -120,6 +144,8 @@ nm_key_file_db_unref(NMKeyFileDB *self)
         return;
 
     g_key_file_unref(self->kf);
+    nm_g_hash_table_unref(self->dirty_keys);
+    g_free(self->log_filename);
 
     g_free(self);
 }
@@ -155,6 +181,158 @@ nm_key_file_db_destroy(NMKeyFileDB *self)
 
 /*****************************************************************************/
 
+static guint32
+_log_crc32(const char *buf, gsize len)
+{
+    guint32 crc = 0xFFFFFFFFu;
+    gsize   i;
+    guint   j;
+
+    /* CRC-32 (IEEE 802.3). The records are short, so there is no need for a lookup table. */
+    for (i = 0; i < len; i++) {
+        crc ^= (guint8) buf[i];
+        for (j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (0xEDB88320u & (-(crc & 1u)));
+    }
+    return ~crc;
+}
+
+static gboolean
+_log_record_parse(NMKeyFileDB *self, const char *line, gsize line_len)
+{
+    gs_free char *key   = NULL;
+    gs_free char *value = NULL;
+    const char *  payload;
+    const char *  eq;
+    gsize         payload_len;
+    guint32       crc = 0;
+    guint         i;
+
+    if (line_len < 10 || line[8] != ' ')
+        return FALSE;
+
+    for (i = 0; i < 8; i++) {
+        int v = g_ascii_xdigit_value(line[i]);
+
+        if (v < 0)
+            return FALSE;
+        crc = (crc << 4) | ((guint32) v);
+    }
+
+    payload     = &line[9];
+    payload_len = line_len - 9;
+    if (_log_crc32(payload, payload_len) != crc)
+        return FALSE;
+
+    switch (payload[0]) {
+    case 'S':
+        eq = memchr(&payload[1], '=', payload_len - 1);
+        if (!eq || eq == &payload[1])
+            return FALSE;
+        key   = g_strndup(&payload[1], eq - &payload[1]);
+        value = g_strndup(&eq[1], &payload[payload_len] - &eq[1]);
+        g_key_file_set_value(self->kf, self->group_name, key, value);
+        return TRUE;
+    case 'R':
+        if (payload_len < 2)
+            return FALSE;
+        key = g_strndup(&payload[1], payload_len - 1);
+        g_key_file_remove_key(self->kf, self->group_name, key, NULL);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gboolean
+_log_move_aside(NMKeyFileDB *self)
+{
+    gs_free char *filename_bad = NULL;
+    int           errsv;
+
+    filename_bad = g_strconcat(self->log_filename, ".bad", NULL);
+
+    if (rename(self->log_filename, filename_bad) != 0) {
+        errsv = errno;
+        _LOGW("failure to move invalid log \"%s\" aside: %s. Don't write \"%s\" anymore",
+              self->log_filename,
+              nm_strerror_native(errsv),
+              self->filename);
+        self->log_broken = TRUE;
+        return FALSE;
+    }
+
+    _LOGW("moved invalid log \"%s\" to \"%s\"", self->log_filename, filename_bad);
+    self->log_size = 0;
+    return TRUE;
+}
+
+static void
+_log_replay(NMKeyFileDB *self)
+{
+    gs_free char *contents = NULL;
+    gsize         contents_len;
+    gsize         valid_len = 0;
+    guint         n_records = 0;
+    int           errsv;
+    gs_free_error GError *error = NULL;
+
+    if (!nm_utils_file_get_contents(-1,
+                                    self->log_filename,
+                                    LOG_MAX_SIZE,
+                                    NM_UTILS_FILE_GET_CONTENTS_FLAG_NONE,
+                                    &contents,
+                                    &contents_len,
+                                    &errsv,
+                                    &error)) {
+        if (errsv != ENOENT) {
+            /* the log might still have changes that are not in the keyfile.
+             * Keep it for inspection, and start over with the keyfile alone. */
+            _LOGW("failed to read log \"%s\": %s", self->log_filename, error->message);
+            _log_move_aside(self);
+        }
+        return;
+    }
+
+    while (valid_len < contents_len) {
+        const char *line = &contents[valid_len];
+        const char *eol;
+
+        eol = memchr(line, '\n', contents_len - valid_len);
+        if (!eol || !_log_record_parse(self, line, eol - line))
+            break;
+        valid_len = (eol - contents) + 1;
+        n_records++;
+    }
+
+    self->log_size = valid_len;
+
+    _LOGD("replayed %u records from log \"%s\"", n_records, self->log_filename);
+
+    if (valid_len == contents_len)
+        return;
+
+    if (!memchr(&contents[valid_len], '\n', contents_len - valid_len)) {
+        /* only the last line is incomplete, most likely from an interrupted
+         * write. Cut it off, so that the records that we append later are not
+         * hidden behind it. */
+        _LOGD("discard %" G_GSIZE_FORMAT " bytes of an incomplete record at the end of log \"%s\"",
+              contents_len - valid_len,
+              self->log_filename);
+        if (truncate(self->log_filename, valid_len) == 0)
+            return;
+    } else {
+        _LOGW("invalid record at offset %" G_GSIZE_FORMAT " of log \"%s\"",
+              valid_len,
+              self->log_filename);
+    }
+
+    /* the valid records were replayed. Persist them with the next write,
+     * which is safe once the log is out of the way. */
+    if (_log_move_aside(self))
+        self->log_needs_compact = TRUE;
+}
+
 /* nm_key_file_db_start() is supposed to be called right away, after creating the
  * instance.
  *
@@ -180,21 +358,20 @@ nm_key_file_db_start(NMKeyFileDB *self)
                                     &contents,
                                     &contents_len,
                                     NULL,
-                                    &error)) {
+                                    &error))
         _LOGD("failed to read \"%s\": %s", self->filename, error->message);
-        return;
-    }
-
-    if (!g_key_file_load_from_data(self->kf,
-                                   contents,
-                                   contents_len,
-                                   G_KEY_FILE_KEEP_COMMENTS,
-                                   &error)) {
+    else if (!g_key_file_load_from_data(self->kf,
+                                        contents,
+                                        contents_len,
+                                        G_KEY_FILE_KEEP_COMMENTS,
+                                        &error))
         _LOGD("failed to load keyfile \"%s\": %s", self->filename, error->message);
-        return;
+    else {
+        self->base_size = contents_len;
+        _LOGD("loaded keyfile-db for \"%s\"", self->filename);
     }
 
-    _LOGD("loaded keyfile-db for \"%s\"", self->filename);
+    _log_replay(self);
 }
 
 /*****************************************************************************/
@@ -239,10 +416,17 @@ static void
 _got_dirty(NMKeyFileDB *self, const char *key)
 {
     nm_assert(_IS_KEY_FILE_DB(self, TRUE, FALSE));
-    nm_assert(!self->dirty);
 
     _LOGD("updated entry for %s.%s", self->group_name, key);
 
+    if (!self->dirty_keys)
+        self->dirty_keys = g_hash_table_new_full(nm_str_hash, g_str_equal, g_free, NULL);
+    if (!g_hash_table_contains(self->dirty_keys, key))
+        g_hash_table_add(self->dirty_keys, g_strdup(key));
+
+    if (self->dirty)
+        return;
+
     self->dirty = TRUE;
     if (self->got_dirty_fcn)
         self->got_dirty_fcn(self, self->user_data);
@@ -253,19 +437,14 @@ _got_dirty(NMKeyFileDB *self, const char *key)
 void
 nm_key_file_db_remove_key(NMKeyFileDB *self, const char *key)
 {
-    gboolean got_dirty = FALSE;
+    gboolean got_dirty;
 
     g_return_if_fail(_IS_KEY_FILE_DB(self, TRUE, FALSE));
 
     if (!key)
         return;
 
-    if (!self->dirty) {
-        gs_free_error GError *error = NULL;
-
-        g_key_file_has_key(self->kf, self->group_name, key, &error);
-        got_dirty = (error != NULL);
-    }
+    got_dirty = g_key_file_has_key(self->kf, self->group_name, key, NULL);
     g_key_file_remove_key(self->kf, self->group_name, key, NULL);
 
     if (got_dirty)
@@ -276,7 +455,7 @@ void
 nm_key_file_db_set_value(NMKeyFileDB *self, const char *key, const char *value)
 {
     gs_free char *old_value = NULL;
-    gboolean      got_dirty = FALSE;
+    gs_free char *new_value = NULL;
 
     g_return_if_fail(_IS_KEY_FILE_DB(self, TRUE, FALSE));
     g_return_if_fail(key);
@@ -286,26 +465,12 @@ nm_key_file_db_set_value(NMKeyFileDB *self, const char *key, const char *value)
         return;
     }
 
-    if (!self->dirty) {
-        gs_free_error GError *error = NULL;
-
-        old_value = g_key_file_get_value(self->kf, self->group_name, key, &error);
-        if (error)
-            got_dirty = TRUE;
-    }
+    old_value = g_key_file_get_value(self->kf, self->group_name, key, NULL);
 
     g_key_file_set_value(self->kf, self->group_name, key, value);
 
-    if (!self->dirty && !got_dirty) {
-        gs_free_error GError *error     = NULL;
-        gs_free char *        new_value = NULL;
-
-        new_value = g_key_file_get_value(self->kf, self->group_name, key, &error);
-        if (error || !new_value || !nm_streq0(old_value, new_value))
-            got_dirty = TRUE;
-    }
-
-    if (got_dirty)
+    new_value = g_key_file_get_value(self->kf, self->group_name, key, NULL);
+    if (!old_value || !new_value || !nm_streq(old_value, new_value))
         _got_dirty(self, key);
 }
 
@@ -316,7 +481,7 @@ nm_key_file_db_set_string_list(NMKeyFileDB *      self,
                                gssize             len)
 {
     gs_free char *old_value = NULL;
-    gboolean      got_dirty = FALSE;
+    gs_free char *new_value = NULL;
 
     g_return_if_fail(_IS_KEY_FILE_DB(self, TRUE, FALSE));
     g_return_if_fail(key);
@@ -326,38 +491,126 @@ nm_key_file_db_set_string_list(NMKeyFileDB *      self,
         return;
     }
 
-    if (!self->dirty) {
-        gs_free_error GError *error = NULL;
-
-        old_value = g_key_file_get_value(self->kf, self->group_name, key, &error);
-        if (error)
-            got_dirty = TRUE;
-    }
+    old_value = g_key_file_get_value(self->kf, self->group_name, key, NULL);
 
     if (len < 0)
         len = NM_PTRARRAY_LEN(value);
 
     g_key_file_set_string_list(self->kf, self->group_name, key, value, len);
 
-    if (!self->dirty && !got_dirty) {
-        gs_free_error GError *error     = NULL;
-        gs_free char *        new_value = NULL;
+    new_value = g_key_file_get_value(self->kf, self->group_name, key, NULL);
+    if (!old_value || !new_value || !nm_streq(old_value, new_value))
+        _got_dirty(self, key);
+}
 
-        new_value = g_key_file_get_value(self->kf, self->group_name, key, &error);
-        if (error || !new_value || !nm_streq0(old_value, new_value))
-            got_dirty = TRUE;
+/*****************************************************************************/
+
+static gboolean
+_log_append(NMKeyFileDB *self)
+{
+    nm_auto_str_buf NMStrBuf strbuf = NM_STR_BUF_INIT(400, FALSE);
+    nm_auto_close int        fd     = -1;
+    GHashTableIter           iter;
+    const char *             key;
+    gsize                    n_written;
+    int                      errsv;
+
+    nm_assert(self->dirty_keys && g_hash_table_size(self->dirty_keys) > 0);
+
+    g_hash_table_iter_init(&iter, self->dirty_keys);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &key, NULL)) {
+        gs_free char *value   = NULL;
+        gs_free char *payload = NULL;
+
+        value = g_key_file_get_value(self->kf, self->group_name, key, NULL);
+
+        /* a record is a line. Values with a newline can only be written
+         * by compacting. */
+        if (strchr(key, '\n') || (value && strchr(value, '\n')))
+            return FALSE;
+
+        if (value)
+            payload = g_strconcat("S", key, "=", value, NULL);
+        else
+            payload = g_strconcat("R", key, NULL);
+        nm_str_buf_append_printf(&strbuf,
+                                 "%08x %s\n",
+                                 (guint) _log_crc32(payload, strlen(payload)),
+                                 payload);
     }
 
-    if (got_dirty)
-        _got_dirty(self, key);
+    fd = open(self->log_filename, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        errsv = errno;
+        _LOGD("failure to open log \"%s\": %s", self->log_filename, nm_strerror_native(errsv));
+        return FALSE;
+    }
+
+    for (n_written = 0; n_written < strbuf.len;) {
+        gssize n;
+
+        n = write(fd, &nm_str_buf_get_str_unsafe(&strbuf)[n_written], strbuf.len - n_written);
+        if (n < 0) {
+            errsv = errno;
+            if (errsv == EINTR)
+                continue;
+            _LOGD("failure to write log \"%s\": %s", self->log_filename, nm_strerror_native(errsv));
+            return FALSE;
+        }
+        n_written += n;
+    }
+
+    if (fsync(fd) != 0) {
+        errsv = errno;
+        _LOGD("failure to sync log \"%s\": %s", self->log_filename, nm_strerror_native(errsv));
+        return FALSE;
+    }
+
+    self->log_size += strbuf.len;
+
+    _LOGD("appended %u records to log \"%s\"",
+          g_hash_table_size(self->dirty_keys),
+          self->log_filename);
+    return TRUE;
 }
 
-/*****************************************************************************/
+static void
+_compact(NMKeyFileDB *self)
+{
+    gs_free char *contents = NULL;
+    gsize         contents_len;
+    int           errsv;
+    gs_free_error GError *error = NULL;
+
+    contents = g_key_file_to_data(self->kf, &contents_len, NULL);
+
+    if (!g_file_set_contents(self->filename, contents, contents_len, &error)) {
+        _LOGD("failure to write keyfile \"%s\": %s", self->filename, error->message);
+        return;
+    }
+
+    _LOGD("write keyfile: \"%s\"", self->filename);
+
+    self->base_size = contents_len;
+
+    if (unlink(self->log_filename) != 0) {
+        errsv = errno;
+        if (errsv != ENOENT) {
+            _LOGD("failure to delete log \"%s\": %s",
+                  self->log_filename,
+                  nm_strerror_native(errsv));
+            return;
+        }
+    }
+
+    self->log_size          = 0;
+    self->log_needs_compact = FALSE;
+}
 
 void
 nm_key_file_db_to_file(NMKeyFileDB *self, gboolean force)
 {
-    gs_free_error GError *error = NULL;
+    gboolean appended = FALSE;
 
     g_return_if_fail(_IS_KEY_FILE_DB(self, TRUE, FALSE));
 
@@ -366,8 +619,26 @@ nm_key_file_db_to_file(NMKeyFileDB *self, gboolean force)
 
     self->dirty = FALSE;
 
-    if (!g_key_file_save_to_file(self->kf, self->filename, &error)) {
-        _LOGD("failure to write keyfile \"%s\": %s", self->filename, error->message);
-    } else
-        _LOGD("write keyfile: \"%s\"", self->filename);
+    if (self->log_broken) {
+        /* an unreadable log is in the way. Writing the keyfile and appending
+         * to or deleting the log would lose what is in it. */
+        if (self->dirty_keys)
+            g_hash_table_remove_all(self->dirty_keys);
+        return;
+    }
+
+    /* Also before compacting, the pending changes are first appended to an
+     * existing log. Otherwise, a crash after writing the keyfile but before
+     * deleting the log would replay outdated records on top of it. */
+    if (!self->log_needs_compact && self->dirty_keys && g_hash_table_size(self->dirty_keys) > 0
+        && (!force || self->log_size > 0))
+        appended = _log_append(self);
+
+    if (self->dirty_keys)
+        g_hash_table_remove_all(self->dirty_keys);
+
+    if (!force && appended && self->log_size < NM_MAX(self->base_size, LOG_COMPACT_MIN_SIZE))
+        return;
+
+    _compact(self);
 }
@@ -12,6 +12,7 @@
 #include "nm-glib-aux/nm-str-buf.h"
 #include "nm-glib-aux/nm-time-utils.h"
 #include "nm-glib-aux/nm-ref-string.h"
+#include "nm-glib-aux/nm-keyfile-aux.h"
 
 #include "nm-utils/nm-test-utils.h"
 
@@ -75,6 +76,42 @@ test_nmhash(void)
     g_assert(nm_hash_val(555, 4) != 0);
 }
 
+static void
+test_nmhash_fast(void)
+{
+    const guint8 buf[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17};
+    NMHashState  h1, h2;
+    guint64      v1, v2;
+    gsize        n;
+
+    for (n = 0; n <= sizeof(buf); n++) {
+        nm_hash_init_fast(&h1, 555);
+        nm_hash_update(&h1, buf, n);
+        v1 = nm_hash_complete_u64(&h1);
+
+        nm_hash_init_fast(&h2, 555);
+        nm_hash_update(&h2, buf, n);
+        g_assert_cmpint(v1, ==, nm_hash_complete_u64(&h2));
+
+        /* a different static seed, gives a different hash. */
+        nm_hash_init_fast(&h2, 556);
+        nm_hash_update(&h2, buf, n);
+        g_assert_cmpint(v1, !=, nm_hash_complete_u64(&h2));
+
+        if (n > 0) {
+            /* the length is part of the hash. */
+            nm_hash_init_fast(&h2, 555);
+            nm_hash_update(&h2, buf, n - 1);
+            v2 = nm_hash_complete_u64(&h2);
+            g_assert_cmpint(v1, !=, v2);
+        }
+    }
+
+    nm_hash_init_fast(&h1, 555);
+    nm_hash_update_val(&h1, 4);
+    g_assert(nm_hash_complete(&h1) != 0);
+}
+
 /*****************************************************************************/
 
 static const char *
@@ -1239,6 +1276,157 @@ again:
 
 /*****************************************************************************/
 
+static NMKeyFileDB *
+_key_file_db_open(const char *filename)
+{
+    NMKeyFileDB *kf_db;
+
+    kf_db = nm_key_file_db_new(filename, "group", NULL, NULL, NULL);
+    nm_key_file_db_start(kf_db);
+    return kf_db;
+}
+
+static void
+_key_file_db_assert_value(NMKeyFileDB *kf_db, const char *key, const char *expected)
+{
+    gs_free char *value = NULL;
+
+    value = nm_key_file_db_get_value(kf_db, key);
+    g_assert_cmpstr(value, ==, expected);
+}
+
+static void
+test_key_file_db(void)
+{
+    gs_free char *dir          = NULL;
+    gs_free char *filename     = NULL;
+    gs_free char *log_filename = NULL;
+    gs_free char *contents     = NULL;
+    gs_free char *contents2    = NULL;
+    NMKeyFileDB * kf_db;
+
+    dir = g_dir_make_tmp("nm-test-keyfile-db-XXXXXX", NULL);
+    g_assert(dir);
+    filename     = g_build_filename(dir, "db", NULL);
+    log_filename = g_strconcat(filename, ".log", NULL);
+
+    kf_db = _key_file_db_open(filename);
+    nm_key_file_db_set_value(kf_db, "a", "1");
+    nm_key_file_db_set_value(kf_db, "b", "2");
+    g_assert(nm_key_file_db_is_dirty(kf_db));
+    nm_key_file_db_to_file(kf_db, FALSE);
+    g_assert(!nm_key_file_db_is_dirty(kf_db));
+
+    /* changes are only appended to the log. */
+    g_assert(!g_file_test(filename, G_FILE_TEST_EXISTS));
+    g_assert(g_file_test(log_filename, G_FILE_TEST_EXISTS));
+
+    nm_key_file_db_set_value(kf_db, "b", "2");
+    g_assert(!nm_key_file_db_is_dirty(kf_db));
+    nm_key_file_db_remove_key(kf_db, "a");
+    nm_key_file_db_set_value(kf_db, "b", "3");
+    nm_key_file_db_to_file(kf_db, FALSE);
+    nm_key_file_db_destroy(kf_db);
+
+    kf_db = _key_file_db_open(filename);
+    _key_file_db_assert_value(kf_db, "a", NULL);
+    _key_file_db_assert_value(kf_db, "b", "3");
+    nm_key_file_db_destroy(kf_db);
+
+    /* an incomplete record at the end is dropped, and does not hide
+     * records that get appended later. */
+    g_assert(g_file_get_contents(log_filename, &contents, NULL, NULL));
+    contents2 = g_strconcat(contents, "0badf00d Sb=4", NULL);
+    g_assert(g_file_set_contents(log_filename, contents2, -1, NULL));
+
+    kf_db = _key_file_db_open(filename);
+    _key_file_db_assert_value(kf_db, "b", "3");
+    nm_key_file_db_set_value(kf_db, "c", "5");
+    nm_key_file_db_to_file(kf_db, FALSE);
+    nm_key_file_db_destroy(kf_db);
+
+    kf_db = _key_file_db_open(filename);
+    _key_file_db_assert_value(kf_db, "b", "3");
+    _key_file_db_assert_value(kf_db, "c", "5");
+
+    /* forcing the write compacts the log into the keyfile. */
+    nm_key_file_db_to_file(kf_db, TRUE);
+    nm_key_file_db_destroy(kf_db);
+    g_assert(g_file_test(filename, G_FILE_TEST_EXISTS));
+    g_assert(!g_file_test(log_filename, G_FILE_TEST_EXISTS));
+
+    kf_db = _key_file_db_open(filename);
+    _key_file_db_assert_value(kf_db, "a", NULL);
+    _key_file_db_assert_value(kf_db, "b", "3");
+    _key_file_db_assert_value(kf_db, "c", "5");
+    nm_key_file_db_destroy(kf_db);
+
+    nmtst_file_unlink(filename);
+    g_assert_cmpint(rmdir(dir), ==, 0);
+}
+
+static void
+test_key_file_db_corrupt_log(void)
+{
+    gs_free char *dir          = NULL;
+    gs_free char *filename     = NULL;
+    gs_free char *log_filename = NULL;
+    gs_free char *bad_filename = NULL;
+    gs_free char *contents     = NULL;
+    gs_free char *contents2    = NULL;
+    gs_free char *contents3    = NULL;
+    NMKeyFileDB * kf_db;
+
+    dir = g_dir_make_tmp("nm-test-keyfile-db-XXXXXX", NULL);
+    g_assert(dir);
+    filename     = g_build_filename(dir, "db", NULL);
+    log_filename = g_strconcat(filename, ".log", NULL);
+    bad_filename = g_strconcat(log_filename, ".bad", NULL);
+
+    kf_db = _key_file_db_open(filename);
+    nm_key_file_db_set_value(kf_db, "a", "1");
+    nm_key_file_db_to_file(kf_db, TRUE);
+    nm_key_file_db_set_value(kf_db, "b", "2");
+    nm_key_file_db_to_file(kf_db, FALSE);
+    nm_key_file_db_destroy(kf_db);
+    g_assert(g_file_test(filename, G_FILE_TEST_EXISTS));
+    g_assert(g_file_test(log_filename, G_FILE_TEST_EXISTS));
+
+    /* an invalid record that is not at the end is not an interrupted write.
+     * The log is renamed and kept, instead of being compacted over. */
+    g_assert(g_file_get_contents(log_filename, &contents, NULL, NULL));
+    contents2 = g_strconcat("0badf00d Sb=4\n", contents, NULL);
+    g_assert(g_file_set_contents(log_filename, contents2, -1, NULL));
+
+    kf_db = _key_file_db_open(filename);
+    g_assert(!g_file_test(log_filename, G_FILE_TEST_EXISTS));
+    g_assert(g_file_get_contents(bad_filename, &contents3, NULL, NULL));
+    g_assert_cmpstr(contents3, ==, contents2);
+    _key_file_db_assert_value(kf_db, "a", "1");
+    _key_file_db_assert_value(kf_db, "b", NULL);
+
+    nm_key_file_db_set_value(kf_db, "c", "3");
+    nm_key_file_db_to_file(kf_db, FALSE);
+    nm_key_file_db_destroy(kf_db);
+
+    nm_clear_g_free(&contents3);
+    g_assert(g_file_get_contents(bad_filename, &contents3, NULL, NULL));
+    g_assert_cmpstr(contents3, ==, contents2);
+
+    kf_db = _key_file_db_open(filename);
+    _key_file_db_assert_value(kf_db, "a", "1");
+    _key_file_db_assert_value(kf_db, "b", NULL);
+    _key_file_db_assert_value(kf_db, "c", "3");
+    nm_key_file_db_to_file(kf_db, TRUE);
+    nm_key_file_db_destroy(kf_db);
+
+    nmtst_file_unlink(bad_filename);
+    nmtst_file_unlink(filename);
+    g_assert_cmpint(rmdir(dir), ==, 0);
+}
+
+/*****************************************************************************/
+
 NMTST_DEFINE();
 
 int
@@ -1249,6 +1437,7 @@ main(int argc, char **argv)
     g_test_add_func("/general/test_gpid", test_gpid);
     g_test_add_func("/general/test_monotonic_timestamp", test_monotonic_timestamp);
     g_test_add_func("/general/test_nmhash", test_nmhash);
+    g_test_add_func("/general/test_nmhash_fast", test_nmhash_fast);
     g_test_add_func("/general/test_nm_make_strv", test_make_strv);
     g_test_add_func("/general/test_nm_strdup_int", test_nm_strdup_int);
     g_test_add_func("/general/test_nm_strndup_a", test_nm_strndup_a);
@@ -1267,6 +1456,8 @@ main(int argc, char **argv)
     g_test_add_func("/general/test_is_specific_hostname", test_is_specific_hostname);
     g_test_add_func("/general/test_strv_dup_packed", test_strv_dup_packed);
     g_test_add_func("/general/test_utils_hashtable_cmp", test_utils_hashtable_cmp);
+    g_test_add_func("/general/test_key_file_db", test_key_file_db);
+    g_test_add_func("/general/test_key_file_db_corrupt_log", test_key_file_db_corrupt_log);
 
     return g_test_run();
 }
@@ -24,6 +24,7 @@
 
 #include "platform/nm-platform.h"
 #include "nm-auth-utils.h"
+#include "nm-nft-utils.h"
 #include "systemd/nm-sd-utils-shared.h"
 
 /*****************************************************************************/
@@ -862,6 +863,21 @@ nm_utils_match_connection(NMConnection *const *  connections,
 
 /*****************************************************************************/
 
+static int
+_match_spec_result_to_int(NMMatchSpecMatchType m, int no_match_value)
+{
+    switch (m) {
+    case NM_MATCH_SPEC_MATCH:
+        return TRUE;
+    case NM_MATCH_SPEC_NEG_MATCH:
+        return FALSE;
+    case NM_MATCH_SPEC_NO_MATCH:
+        return no_match_value;
+    }
+    nm_assert_not_reached();
+    return no_match_value;
+}
+
 int
 nm_match_spec_device_by_pllink(const NMPlatformLink *pllink,
                                const char *          match_device_type,
@@ -884,17 +900,27 @@ nm_match_spec_device_by_pllink(const NMPlatformLink *pllink,
                              NULL,
                              NULL,
                              match_dhcp_plugin);
+    return _match_spec_result_to_int(m, no_match_value);
+}
 
-    switch (m) {
-    case NM_MATCH_SPEC_MATCH:
-        return TRUE;
-    case NM_MATCH_SPEC_NEG_MATCH:
-        return FALSE;
-    case NM_MATCH_SPEC_NO_MATCH:
-        return no_match_value;
-    }
-    nm_assert_not_reached();
-    return no_match_value;
+int
+nm_match_spec_device_compiled_by_pllink(const NMPlatformLink *   pllink,
+                                        const char *             match_device_type,
+                                        const char *             match_dhcp_plugin,
+                                        const NMMatchSpecDevice *matcher,
+                                        int                      no_match_value)
+{
+    NMMatchSpecMatchType m;
+
+    m = nm_match_spec_device_eval(matcher,
+                                  pllink ? pllink->name : NULL,
+                                  match_device_type,
+                                  pllink ? pllink->driver : NULL,
+                                  NULL,
+                                  NULL,
+                                  NULL,
+                                  match_dhcp_plugin);
+    return _match_spec_result_to_int(m, no_match_value);
 }
 
 /*****************************************************************************/
@@ -1507,6 +1533,77 @@ out:
     NM_SET_OUT(out_addresses, g_variant_builder_end(&builder_legacy));
 }
 
+/* The fields of a route that are exported in RouteData. The struct is
+ * zeroed including padding, so that it can be hashed and compared as memory. */
+typedef struct {
+    NMIPAddr network;
+    NMIPAddr gateway;
+    guint32  metric;
+    guint32  table;
+    guint8   plen;
+} RouteDBusData;
+
+static void
+_route_dbus_data_init(RouteDBusData *d, int addr_family, const NMPlatformIPXRoute *r)
+{
+    memset(d, 0, sizeof(*d));
+    nm_ip_addr_set(addr_family, &d->network, r->rx.network_ptr);
+    nm_ip_addr_set(addr_family,
+                   &d->gateway,
+                   nm_platform_ip_route_get_gateway(addr_family, &r->rx));
+    d->metric = r->rx.metric;
+    d->table  = nm_platform_route_table_uncoerce(r->rx.table_coerced, TRUE);
+    d->plen   = r->rx.plen;
+}
+
+static guint
+_route_dbus_data_hash(gconstpointer ptr)
+{
+    NMHashState h;
+
+    nm_hash_init(&h, 1408337771);
+    nm_hash_update(&h, ptr, sizeof(RouteDBusData));
+    return nm_hash_complete(&h);
+}
+
+static gboolean
+_route_dbus_data_equal(gconstpointer a, gconstpointer b)
+{
+    return memcmp(a, b, sizeof(RouteDBusData)) == 0;
+}
+
+static void
+_ip_route_data_add(GVariantBuilder *builder, int addr_family, const RouteDBusData *d)
+{
+    GVariantBuilder route_builder;
+    char            addr_str[NM_UTILS_INET_ADDRSTRLEN];
+
+    g_variant_builder_init(&route_builder, G_VARIANT_TYPE("a{sv}"));
+
+    g_variant_builder_add(
+        &route_builder,
+        "{sv}",
+        "dest",
+        g_variant_new_string(nm_utils_inet_ntop(addr_family, &d->network, addr_str)));
+
+    g_variant_builder_add(&route_builder, "{sv}", "prefix", g_variant_new_uint32(d->plen));
+
+    if (!nm_ip_addr_is_null(addr_family, &d->gateway)) {
+        g_variant_builder_add(
+            &route_builder,
+            "{sv}",
+            "next-hop",
+            g_variant_new_string(nm_utils_inet_ntop(addr_family, &d->gateway, addr_str)));
+    }
+
+    g_variant_builder_add(&route_builder, "{sv}", "metric", g_variant_new_uint32(d->metric));
+
+    if (d->table != RT_TABLE_MAIN)
+        g_variant_builder_add(&route_builder, "{sv}", "table", g_variant_new_uint32(d->table));
+
+    g_variant_builder_add(builder, "a{sv}", &route_builder);
+}
+
 void
 nm_utils_ip_routes_to_dbus(int                          addr_family,
                            const NMDedupMultiHeadEntry *head_entry,
@@ -1518,7 +1615,6 @@ nm_utils_ip_routes_to_dbus(int                          addr_family,
     const NMPObject *obj;
     GVariantBuilder  builder_data;
     GVariantBuilder  builder_legacy;
-    char             addr_str[NM_UTILS_INET_ADDRSTRLEN];
 
     nm_assert_addr_family(addr_family);
 
@@ -1552,46 +1648,10 @@ nm_utils_ip_routes_to_dbus(int                          addr_family,
             continue;
 
         if (out_route_data) {
-            GVariantBuilder route_builder;
-            gconstpointer   gateway;
-
-            g_variant_builder_init(&route_builder, G_VARIANT_TYPE("a{sv}"));
-
-            g_variant_builder_add(
-                &route_builder,
-                "{sv}",
-                "dest",
-                g_variant_new_string(nm_utils_inet_ntop(addr_family, r->rx.network_ptr, addr_str)));
-
-            g_variant_builder_add(&route_builder,
-                                  "{sv}",
-                                  "prefix",
-                                  g_variant_new_uint32(r->rx.plen));
-
-            gateway = nm_platform_ip_route_get_gateway(addr_family, &r->rx);
-            if (!nm_ip_addr_is_null(addr_family, gateway)) {
-                g_variant_builder_add(
-                    &route_builder,
-                    "{sv}",
-                    "next-hop",
-                    g_variant_new_string(nm_utils_inet_ntop(addr_family, gateway, addr_str)));
-            }
-
-            g_variant_builder_add(&route_builder,
-                                  "{sv}",
-                                  "metric",
-                                  g_variant_new_uint32(r->rx.metric));
+            RouteDBusData d;
 
-            if (!nm_platform_route_table_is_main(r->rx.table_coerced)) {
-                g_variant_builder_add(
-                    &route_builder,
-                    "{sv}",
-                    "table",
-                    g_variant_new_uint32(
-                        nm_platform_route_table_uncoerce(r->rx.table_coerced, TRUE)));
-            }
-
-            g_variant_builder_add(&builder_data, "a{sv}", &route_builder);
+            _route_dbus_data_init(&d, addr_family, r);
+            _ip_route_data_add(&builder_data, addr_family, &d);
         }
 
         if (out_routes) {
@@ -1632,13 +1692,139 @@ nm_utils_ip_routes_to_dbus(int                          addr_family,
 
 /*****************************************************************************/
 
+static gint64 _ip_routes_export_max = -1;
+
+/**
+ * nm_utils_ip_routes_set_export_max:
+ * @export_max: the maximum number of routes for which RouteData and
+ *   Routes are sent in PropertiesChanged, or -1.
+ *
+ * With a non-negative @export_max, IP configs send RoutesChanged signals
+ * with the routes that were added and removed. If an IP config has more than
+ * @export_max routes, changes to the RouteData and Routes properties are no
+ * longer announced and the properties are only serialized when they are read.
+ */
+void
+nm_utils_ip_routes_set_export_max(gint64 export_max)
+{
+    _ip_routes_export_max = export_max;
+}
+
+gint64
+nm_utils_ip_routes_get_export_max(void)
+{
+    return _ip_routes_export_max;
+}
+
+/**
+ * nm_utils_ip_routes_to_dbus_delta:
+ * @addr_family: the address family of the routes
+ * @head_entry: the current routes
+ * @exported: (inout): the routes that were announced the last time. %NULL
+ *   means none. On return, it contains the routes from @head_entry.
+ * @export_max: the maximum number of routes for which the properties
+ *   are announced in full.
+ * @out_over_max: (allow-none) (out): whether there are more than @export_max
+ *   routes now.
+ * @out_added: (allow-none) (out): the routes from @head_entry that are not
+ *   in @exported, in the format of the RouteData property.
+ * @out_removed: (allow-none) (out): the routes from @exported that are no
+ *   longer in @head_entry, in the format of the RouteData property.
+ *
+ * Routes are compared by their RouteData representation. A change to a
+ * field that is not exported is no change, and a changed field that is
+ * exported is a removed and an added route.
+ *
+ * Returns: %TRUE if any routes were added or removed.
+ */
+gboolean
+nm_utils_ip_routes_to_dbus_delta(int                          addr_family,
+                                 const NMDedupMultiHeadEntry *head_entry,
+                                 GHashTable **                exported,
+                                 guint64                      export_max,
+                                 gboolean *                   out_over_max,
+                                 GVariant **                  out_added,
+                                 GVariant **                  out_removed)
+{
+    const int                      IS_IPv4      = NM_IS_IPv4(addr_family);
+    gs_unref_hashtable GHashTable *exported_old = NULL;
+    GHashTable *                   exported_new;
+    GHashTableIter                 h_iter;
+    NMDedupMultiIter               iter;
+    const NMPObject *              obj;
+    const RouteDBusData *          d_old;
+    GVariantBuilder                builder_added;
+    GVariantBuilder                builder_removed;
+    gboolean                       changed = FALSE;
+
+    nm_assert_addr_family(addr_family);
+    nm_assert(exported);
+
+    exported_old = g_steal_pointer(exported);
+    exported_new =
+        g_hash_table_new_full(_route_dbus_data_hash, _route_dbus_data_equal, g_free, NULL);
+    *exported = exported_new;
+
+    if (out_added)
+        g_variant_builder_init(&builder_added, G_VARIANT_TYPE("aa{sv}"));
+    if (out_removed)
+        g_variant_builder_init(&builder_removed, G_VARIANT_TYPE("aa{sv}"));
+
+    nm_dedup_multi_iter_init(&iter, head_entry);
+    while (nm_platform_dedup_multi_iter_next_obj(&iter, &obj, NMP_OBJECT_TYPE_IP_ROUTE(IS_IPv4))) {
+        const NMPlatformIPXRoute *r = NMP_OBJECT_CAST_IPX_ROUTE(obj);
+        RouteDBusData             d;
+
+        /* like nm_utils_ip_routes_to_dbus(), only unicast routes are exported. */
+        if (r->rx.type_coerced != nm_platform_route_type_coerce(RTN_UNICAST))
+            continue;
+
+        _route_dbus_data_init(&d, addr_family, r);
+
+        /* routes that only differ in fields that are not exported look
+         * the same on D-Bus. */
+        if (g_hash_table_contains(exported_new, &d))
+            continue;
+
+        g_hash_table_add(exported_new, nm_memdup(&d, sizeof(d)));
+
+        if (exported_old && g_hash_table_remove(exported_old, &d))
+            continue;
+
+        changed = TRUE;
+        if (out_added)
+            _ip_route_data_add(&builder_added, addr_family, &d);
+    }
+
+    if (exported_old) {
+        g_hash_table_iter_init(&h_iter, exported_old);
+        while (g_hash_table_iter_next(&h_iter, (gpointer *) &d_old, NULL)) {
+            changed = TRUE;
+            if (out_removed)
+                _ip_route_data_add(&builder_removed, addr_family, d_old);
+        }
+    }
+
+    NM_SET_OUT(out_over_max, g_hash_table_size(exported_new) > export_max);
+    NM_SET_OUT(out_added, g_variant_builder_end(&builder_added));
+    NM_SET_OUT(out_removed, g_variant_builder_end(&builder_removed));
+    return changed;
+}
+
+/*****************************************************************************/
+
 typedef struct {
     char *table;
     char *rule;
 } ShareRule;
 
 struct _NMUtilsShareRules {
-    GArray *rules;
+    GArray *  rules;
+    char *    ip_iface;
+    in_addr_t addr;
+    guint8    plen;
+    bool      use_nftables : 1;
+    bool      nftables_applied : 1;
 };
 
 static void
@@ -1651,13 +1837,14 @@ _share_rule_clear(gpointer data)
 }
 
 NMUtilsShareRules *
-nm_utils_share_rules_new(void)
+nm_utils_share_rules_new(gboolean use_nftables)
 {
     NMUtilsShareRules *self;
 
     self  = g_slice_new(NMUtilsShareRules);
     *self = (NMUtilsShareRules){
-        .rules = g_array_sized_new(FALSE, FALSE, sizeof(ShareRule), 10),
+        .rules        = g_array_sized_new(FALSE, FALSE, sizeof(ShareRule), 10),
+        .use_nftables = use_nftables,
     };
 
     g_array_set_clear_func(self->rules, _share_rule_clear);
@@ -1671,6 +1858,7 @@ nm_utils_share_rules_free(NMUtilsShareRules *self)
         return;
 
     g_array_unref(self->rules);
+    g_free(self->ip_iface);
     nm_g_slice_free(self);
 }
 
@@ -1690,13 +1878,11 @@ nm_utils_share_rules_add_rule_take(NMUtilsShareRules *self, const char *table, c
     };
 }
 
-void
-nm_utils_share_rules_apply(NMUtilsShareRules *self, gboolean shared)
+static void
+_share_rules_apply_iptables(NMUtilsShareRules *self, gboolean shared)
 {
     guint i;
 
-    g_return_if_fail(self);
-
     if (self->rules->len == 0)
         return;
 
@@ -1754,6 +1940,52 @@ next:
     }
 }
 
+void
+nm_utils_share_rules_apply(NMUtilsShareRules *self, gboolean shared)
+{
+    int r;
+
+    g_return_if_fail(self);
+
+    if (shared) {
+        if (self->use_nftables && self->ip_iface) {
+            r = nm_nft_shared_table_add(self->ip_iface, self->addr, self->plen);
+            if (r >= 0) {
+                nm_log_info(LOGD_SHARING,
+                            "Added nftables table \"" NM_NFT_SHARED_TABLE_PREFIX "%s\"",
+                            self->ip_iface);
+                if (nm_logging_enabled(LOGL_DEBUG, LOGD_SHARING)) {
+                    gs_free char *ruleset = NULL;
+
+                    ruleset = nm_nft_shared_table_to_string(self->ip_iface, self->addr, self->plen);
+                    nm_log_dbg(LOGD_SHARING, "nftables ruleset:\n%s", ruleset);
+                }
+                self->nftables_applied = TRUE;
+                return;
+            }
+            nm_log_warn(LOGD_SHARING,
+                        "Failed to add nftables table \"" NM_NFT_SHARED_TABLE_PREFIX
+                        "%s\": %s. Falling back to iptables",
+                        self->ip_iface,
+                        nm_strerror(r));
+        }
+    } else if (self->nftables_applied) {
+        self->nftables_applied = FALSE;
+
+        r = nm_nft_shared_table_delete(self->ip_iface);
+        if (r < 0) {
+            nm_log_warn(LOGD_SHARING,
+                        "Failed to delete nftables table \"" NM_NFT_SHARED_TABLE_PREFIX
+                        "%s\": %s",
+                        self->ip_iface,
+                        nm_strerror(r));
+        }
+        return;
+    }
+
+    _share_rules_apply_iptables(self, shared);
+}
+
 void
 nm_utils_share_rules_add_all_rules(NMUtilsShareRules *self,
                                    const char *       ip_iface,
@@ -1767,6 +1999,11 @@ nm_utils_share_rules_add_all_rules(NMUtilsShareRules *self,
 
     nm_assert(self);
 
+    g_free(self->ip_iface);
+    self->ip_iface = g_strdup(ip_iface);
+    self->addr     = addr;
+    self->plen     = plen;
+
     netmask = _nm_utils_ip4_prefix_to_netmask(plen);
     _nm_utils_inet4_ntop(netmask, str_mask);
 
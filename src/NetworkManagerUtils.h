@@ -46,6 +46,12 @@ int nm_match_spec_device_by_pllink(const NMPlatformLink *pllink,
                                    const GSList *        specs,
                                    int                   no_match_value);
 
+int nm_match_spec_device_compiled_by_pllink(const NMPlatformLink *   pllink,
+                                            const char *             match_device_type,
+                                            const char *             match_dhcp_plugin,
+                                            const NMMatchSpecDevice *matcher,
+                                            int                      no_match_value);
+
 /*****************************************************************************/
 
 NMPlatformRoutingRule *nm_ip_routing_rule_to_platform(const NMIPRoutingRule *rule,
@@ -164,6 +170,17 @@ void nm_utils_ip_routes_to_dbus(int                          addr_family,
                                 GVariant **                  out_route_data,
                                 GVariant **                  out_routes);
 
+void   nm_utils_ip_routes_set_export_max(gint64 export_max);
+gint64 nm_utils_ip_routes_get_export_max(void);
+
+gboolean nm_utils_ip_routes_to_dbus_delta(int                          addr_family,
+                                          const NMDedupMultiHeadEntry *head_entry,
+                                          GHashTable **                exported,
+                                          guint64                      export_max,
+                                          gboolean *                   out_over_max,
+                                          GVariant **                  out_added,
+                                          GVariant **                  out_removed);
+
 /*****************************************************************************/
 
 /* For now, all we track about a DHCP lease is the GHashTable with
@@ -226,7 +243,7 @@ NM_AUTO_DEFINE_FCN(NMDhcpLease *, _nm_auto_unref_dhcplease, nm_dhcp_lease_unref)
 
 typedef struct _NMUtilsShareRules NMUtilsShareRules;
 
-NMUtilsShareRules *nm_utils_share_rules_new(void);
+NMUtilsShareRules *nm_utils_share_rules_new(gboolean use_nftables);
 
 void nm_utils_share_rules_free(NMUtilsShareRules *self);
 
@@ -524,21 +524,24 @@ out:
 }
 
 static const NMPlatformBridgeVlan **
-setting_vlans_to_platform(GPtrArray *array)
+setting_vlans_to_platform(GPtrArray *array, guint16 default_pvid)
 {
     NMPlatformBridgeVlan **arr;
     NMPlatformBridgeVlan * p_data;
+    gboolean               has_pvid = FALSE;
+    guint                  len;
     guint                  i;
 
-    if (!array || !array->len)
+    len = array ? array->len : 0u;
+    if (len == 0 && default_pvid == 0)
         return NULL;
 
     G_STATIC_ASSERT_EXPR(_nm_alignof(NMPlatformBridgeVlan *) >= _nm_alignof(NMPlatformBridgeVlan));
-    arr    = g_malloc((sizeof(NMPlatformBridgeVlan *) * (array->len + 1))
-                   + (sizeof(NMPlatformBridgeVlan) * (array->len)));
-    p_data = (NMPlatformBridgeVlan *) &arr[array->len + 1];
+    arr    = g_malloc((sizeof(NMPlatformBridgeVlan *) * (len + 2))
+                   + (sizeof(NMPlatformBridgeVlan) * (len + 1)));
+    p_data = (NMPlatformBridgeVlan *) &arr[len + 2];
 
-    for (i = 0; i < array->len; i++) {
+    for (i = 0; i < len; i++) {
         NMBridgeVlan *vlan = array->pdata[i];
         guint16       vid_start, vid_end;
 
@@ -551,7 +554,26 @@ setting_vlans_to_platform(GPtrArray *array)
             .untagged  = nm_bridge_vlan_is_untagged(vlan),
         };
         arr[i] = &p_data[i];
+
+        if (p_data[i].pvid)
+            has_pvid = TRUE;
+        if (default_pvid >= vid_start && default_pvid <= vid_end)
+            default_pvid = 0;
     }
+
+    if (default_pvid) {
+        /* The kernel creates a VLAN for the default PVID. It stays untagged
+         * when another VLAN takes over the PVID. */
+        p_data[i] = (NMPlatformBridgeVlan){
+            .vid_start = default_pvid,
+            .vid_end   = default_pvid,
+            .pvid      = !has_pvid,
+            .untagged  = TRUE,
+        };
+        arr[i] = &p_data[i];
+        i++;
+    }
+
     arr[i] = NULL;
     return (const NMPlatformBridgeVlan **) arr;
 }
@@ -755,7 +777,7 @@ bridge_set_vlan_options(NMDevice *device, NMSettingBridge *s_bridge)
     if (!enabled) {
         nm_platform_sysctl_master_set_option(plat, ifindex, "vlan_filtering", "0");
         nm_platform_sysctl_master_set_option(plat, ifindex, "default_pvid", "1");
-        nm_platform_link_set_bridge_vlans(plat, ifindex, FALSE, NULL);
+        nm_platform_link_sync_bridge_vlans(plat, ifindex, FALSE, NULL);
         return TRUE;
     }
 
@@ -778,10 +800,6 @@ bridge_set_vlan_options(NMDevice *device, NMSettingBridge *s_bridge)
     if (!nm_platform_sysctl_master_set_option(plat, ifindex, "default_pvid", "0"))
         return FALSE;
 
-    /* Clear all existing VLANs */
-    if (!nm_platform_link_set_bridge_vlans(plat, ifindex, FALSE, NULL))
-        return FALSE;
-
     /* Now set the default PVID. After this point the kernel creates
      * a PVID VLAN on each port, including the bridge itself. */
     pvid = nm_setting_bridge_get_vlan_default_pvid(s_bridge);
@@ -793,11 +811,12 @@ bridge_set_vlan_options(NMDevice *device, NMSettingBridge *s_bridge)
             return FALSE;
     }
 
-    /* Create VLANs only after setting the default PVID, so that
-     * any PVID VLAN overrides the bridge's default PVID. */
+    /* Sync VLANs only after setting the default PVID, so that
+     * any PVID VLAN overrides the bridge's default PVID. Only the
+     * VLANs that differ from the requested ones are removed or added. */
     g_object_get(s_bridge, NM_SETTING_BRIDGE_VLANS, &vlans, NULL);
-    plat_vlans = setting_vlans_to_platform(vlans);
-    if (plat_vlans && !nm_platform_link_set_bridge_vlans(plat, ifindex, FALSE, plat_vlans))
+    plat_vlans = setting_vlans_to_platform(vlans, pvid);
+    if (!nm_platform_link_sync_bridge_vlans(plat, ifindex, FALSE, plat_vlans))
         return FALSE;
 
     if (!nm_platform_sysctl_master_set_option(plat, ifindex, "vlan_filtering", "1"))
@@ -962,7 +981,7 @@ enslave_slave(NMDevice *device, NMDevice *slave, NMConnection *connection, gbool
             if (s_port)
                 g_object_get(s_port, NM_SETTING_BRIDGE_PORT_VLANS, &vlans, NULL);
 
-            plat_vlans = setting_vlans_to_platform(vlans);
+            plat_vlans = setting_vlans_to_platform(vlans, 0);
 
             /* Since the link was just enslaved, there are no existing VLANs
              * (except for the default one) and so there's no need to flush. */
@@ -71,6 +71,7 @@
 #include "nm-audit-manager.h"
 #include "nm-connectivity.h"
 #include "nm-dbus-interface.h"
+#include "nm-startup-trace.h"
 
 #include "nm-device-generic.h"
 #include "nm-device-vlan.h"
@@ -685,12 +686,21 @@ typedef struct _NMDevicePrivate {
     guint sriov_reset_pending;
 
     struct {
-        guint   timeout_id;
+        gint64  next_msec;
         guint   refresh_rate_ms;
         guint64 tx_bytes;
         guint64 rx_bytes;
     } stats;
 
+    struct {
+        /* memoized values of nm_config_data_get_connection_default() for
+         * this device. They are valid as long as @config_data is the current
+         * configuration and the device attributes used for matching
+         * (interface name, driver, permanent MAC address) don't change. */
+        NMConfigData *config_data;
+        GHashTable *  values;
+    } con_defaults_cache;
+
     bool mtu_force_set_done : 1;
 } NMDevicePrivate;
 
@@ -912,6 +922,53 @@ _hostname_resolver_free(HostnameResolver *resolver)
 
 /*****************************************************************************/
 
+static void
+_con_defaults_cache_clear(NMDevice *self)
+{
+    NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE(self);
+
+    if (priv->con_defaults_cache.values)
+        g_hash_table_remove_all(priv->con_defaults_cache.values);
+}
+
+/**
+ * nm_device_get_con_defaults_cache:
+ * @self: the #NMDevice
+ * @config_data: the #NMConfigData that the cached values are for.
+ *
+ * Returns: (transfer none): the hash table with the memoized connection
+ *   defaults of @self, for use by nm_config_data_get_connection_default().
+ *   The keys are the property names and the values are the (possibly %NULL)
+ *   strings. If @config_data is not the configuration that the cache was
+ *   filled for, the cache is reset.
+ */
+GHashTable *
+nm_device_get_con_defaults_cache(NMDevice *self, const NMConfigData *config_data)
+{
+    NMDevicePrivate *priv;
+
+    g_return_val_if_fail(NM_IS_DEVICE(self), NULL);
+    g_return_val_if_fail(NM_IS_CONFIG_DATA(config_data), NULL);
+
+    priv = NM_DEVICE_GET_PRIVATE(self);
+
+    if (priv->con_defaults_cache.config_data != config_data) {
+        _con_defaults_cache_clear(self);
+        g_object_ref((NMConfigData *) config_data);
+        nm_g_object_unref(priv->con_defaults_cache.config_data);
+        priv->con_defaults_cache.config_data = (NMConfigData *) config_data;
+    }
+
+    if (!priv->con_defaults_cache.values) {
+        priv->con_defaults_cache.values =
+            g_hash_table_new_full(nm_str_hash, g_str_equal, g_free, g_free);
+    }
+
+    return priv->con_defaults_cache.values;
+}
+
+/*****************************************************************************/
+
 static NMSettingIP6ConfigPrivacy
 _ip6_privacy_clamp(NMSettingIP6ConfigPrivacy use_tempaddr)
 {
@@ -3275,22 +3332,6 @@ _stats_update_counters_from_pllink(NMDevice *self, const NMPlatformLink *pllink)
     _stats_update_counters(self, pllink->tx_bytes, pllink->rx_bytes);
 }
 
-static gboolean
-_stats_timeout_cb(gpointer user_data)
-{
-    NMDevice *self = user_data;
-    int       ifindex;
-
-    ifindex = nm_device_get_ip_ifindex(self);
-
-    _LOGT(LOGD_DEVICE, "stats: refresh %d", ifindex);
-
-    if (ifindex > 0)
-        nm_platform_link_refresh(nm_device_get_platform(self), ifindex);
-
-    return G_SOURCE_CONTINUE;
-}
-
 static guint
 _stats_refresh_rate_real(guint refresh_rate_ms)
 {
@@ -3308,6 +3349,175 @@ _stats_refresh_rate_real(guint refresh_rate_ms)
     return refresh_rate_ms;
 }
 
+/*****************************************************************************/
+
+/* All devices with a statistics refresh-rate share one timer. The refresh
+ * times are aligned to multiples of the rate, so that devices with the
+ * same rate are due at the same tick and can be refreshed together. */
+static struct {
+    GHashTable *devices;
+    GSource *   timeout_source;
+    gint64      timeout_at_msec;
+} _stats_scheduler;
+
+static void _stats_scheduler_reschedule(void);
+
+static gint64
+_stats_next_msec(gint64 now_msec, guint refresh_rate_ms)
+{
+    nm_assert(refresh_rate_ms > 0);
+
+    return ((now_msec / refresh_rate_ms) + 1) * refresh_rate_ms;
+}
+
+static void
+_stats_scheduler_refresh(GPtrArray *devices)
+{
+    const NMDedupMultiHeadEntry *head_entry;
+    NMPlatform *                 platform;
+    gboolean                     dumped = FALSE;
+    guint                        n_same = 0;
+    guint                        i;
+
+    nm_assert(devices->len > 0);
+
+    platform = nm_device_get_platform(devices->pdata[0]);
+    for (i = 0; i < devices->len; i++) {
+        if (nm_device_get_platform(devices->pdata[i]) == platform)
+            n_same++;
+    }
+
+    /* A dump of all links costs one message per link, but only one round trip.
+     * Prefer it over individual requests once a good share of the links is due. */
+    head_entry = nm_platform_lookup_obj_type(platform, NMP_OBJECT_TYPE_LINK);
+    if (n_same > 1 && head_entry && n_same * 4 >= head_entry->len) {
+        nm_log_trace(LOGD_DEVICE, "stats: refresh all links for %u devices", n_same);
+        nm_platform_refresh_all(platform, NMP_OBJECT_TYPE_LINK);
+        dumped = TRUE;
+    }
+
+    for (i = 0; i < devices->len; i++) {
+        NMDevice *self = devices->pdata[i];
+        int       ifindex;
+
+        if (dumped && nm_device_get_platform(self) == platform)
+            continue;
+
+        ifindex = nm_device_get_ip_ifindex(self);
+        if (ifindex > 0)
+            nm_platform_link_refresh(nm_device_get_platform(self), ifindex);
+    }
+}
+
+static gboolean
+_stats_scheduler_timeout_cb(gpointer user_data)
+{
+    gs_unref_ptrarray GPtrArray *devices = NULL;
+    GHashTableIter               iter;
+    NMDevice *                   self;
+    gint64                       now_msec;
+    guint                        i;
+
+    nm_clear_g_source_inst(&_stats_scheduler.timeout_source);
+
+    now_msec = nm_utils_get_monotonic_timestamp_msec();
+
+    devices = g_ptr_array_new_with_free_func(g_object_unref);
+    g_hash_table_iter_init(&iter, _stats_scheduler.devices);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &self, NULL)) {
+        NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE(self);
+
+        if (priv->stats.next_msec > now_msec)
+            continue;
+
+        priv->stats.next_msec =
+            _stats_next_msec(now_msec, _stats_refresh_rate_real(priv->stats.refresh_rate_ms));
+        g_ptr_array_add(devices, g_object_ref(self));
+    }
+
+    if (devices->len > 0)
+        _stats_scheduler_refresh(devices);
+
+    /* Refreshing the platform cache already emits link changes, which update
+     * the counters via device_link_changed() in an idle handler. Update the
+     * due devices right away. */
+    for (i = 0; i < devices->len; i++) {
+        const NMPlatformLink *pllink;
+        int                   ifindex;
+
+        self = devices->pdata[i];
+        if (!g_hash_table_contains(_stats_scheduler.devices, self))
+            continue;
+
+        ifindex = nm_device_get_ip_ifindex(self);
+        if (ifindex <= 0)
+            continue;
+
+        pllink = nm_platform_link_get(nm_device_get_platform(self), ifindex);
+        if (pllink)
+            _stats_update_counters_from_pllink(self, pllink);
+    }
+
+    _stats_scheduler_reschedule();
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+_stats_scheduler_reschedule(void)
+{
+    GHashTableIter iter;
+    NMDevice *     self;
+    gint64         next_msec = G_MAXINT64;
+    gint64         now_msec;
+
+    if (_stats_scheduler.devices) {
+        g_hash_table_iter_init(&iter, _stats_scheduler.devices);
+        while (g_hash_table_iter_next(&iter, (gpointer *) &self, NULL))
+            next_msec = MIN(next_msec, NM_DEVICE_GET_PRIVATE(self)->stats.next_msec);
+    }
+
+    if (next_msec == G_MAXINT64) {
+        nm_clear_g_source_inst(&_stats_scheduler.timeout_source);
+        return;
+    }
+
+    if (_stats_scheduler.timeout_source && _stats_scheduler.timeout_at_msec == next_msec)
+        return;
+
+    nm_clear_g_source_inst(&_stats_scheduler.timeout_source);
+
+    now_msec                         = nm_utils_get_monotonic_timestamp_msec();
+    _stats_scheduler.timeout_at_msec = next_msec;
+    _stats_scheduler.timeout_source =
+        nm_g_source_attach(nm_g_timeout_source_new(NM_MAX(next_msec - now_msec, 0),
+                                                   G_PRIORITY_DEFAULT,
+                                                   _stats_scheduler_timeout_cb,
+                                                   NULL,
+                                                   NULL),
+                           NULL);
+}
+
+static void
+_stats_subscribe(NMDevice *self, gboolean active)
+{
+    NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE(self);
+    guint            rate;
+
+    rate = active ? _stats_refresh_rate_real(priv->stats.refresh_rate_ms) : 0;
+
+    if (rate == 0) {
+        if (!_stats_scheduler.devices || !g_hash_table_remove(_stats_scheduler.devices, self))
+            return;
+    } else {
+        priv->stats.next_msec = _stats_next_msec(nm_utils_get_monotonic_timestamp_msec(), rate);
+        if (!_stats_scheduler.devices)
+            _stats_scheduler.devices = g_hash_table_new(nm_direct_hash, NULL);
+        g_hash_table_add(_stats_scheduler.devices, self);
+    }
+
+    _stats_scheduler_reschedule();
+}
+
 static void
 _stats_set_refresh_rate(NMDevice *self, guint refresh_rate_ms)
 {
@@ -3333,7 +3543,7 @@ _stats_set_refresh_rate(NMDevice *self, guint refresh_rate_ms)
     if (_stats_refresh_rate_real(old_rate) == refresh_rate_ms)
         return;
 
-    nm_clear_g_source(&priv->stats.timeout_id);
+    _stats_subscribe(self, TRUE);
 
     if (!refresh_rate_ms)
         return;
@@ -3344,8 +3554,6 @@ _stats_set_refresh_rate(NMDevice *self, guint refresh_rate_ms)
     ifindex = nm_device_get_ip_ifindex(self);
     if (ifindex > 0)
         nm_platform_link_refresh(nm_device_get_platform(self), ifindex);
-
-    priv->stats.timeout_id = g_timeout_add(refresh_rate_ms, _stats_timeout_cb, self);
 }
 
 /*****************************************************************************/
@@ -5274,6 +5482,7 @@ device_link_changed(NMDevice *self)
     if (!nm_streq0(pllink->driver, priv->driver)) {
         g_free(priv->driver);
         priv->driver = g_strdup(pllink->driver);
+        _con_defaults_cache_clear(self);
         _notify(self, PROP_DRIVER);
     }
 
@@ -5304,6 +5513,7 @@ device_link_changed(NMDevice *self)
         else
             update_unmanaged_specs = TRUE;
 
+        _con_defaults_cache_clear(self);
         _notify(self, PROP_IFACE);
         if (ip_ifname_changed)
             _notify(self, PROP_IP_IFACE);
@@ -5688,13 +5898,17 @@ nm_device_update_from_platform_link(NMDevice *self, const NMPlatformLink *plink)
         _notify(self, PROP_PATH);
     }
 
-    if (plink && !nm_str_is_empty(plink->name) && nm_utils_strdup_reset(&priv->iface_, plink->name))
+    if (plink && !nm_str_is_empty(plink->name)
+        && nm_utils_strdup_reset(&priv->iface_, plink->name)) {
+        _con_defaults_cache_clear(self);
         _notify(self, PROP_IFACE);
+    }
 
     str = plink ? plink->driver : NULL;
     if (!nm_streq0(str, priv->driver)) {
         g_free(priv->driver);
         priv->driver = g_strdup(str);
+        _con_defaults_cache_clear(self);
         _notify(self, PROP_DRIVER);
     }
 
@@ -5905,7 +6119,6 @@ realize_start_setup(NMDevice *            self,
     NMPlatform *         platform;
     NMDeviceCapabilities capabilities = 0;
     NMConfig *           config;
-    guint                real_rate;
     gboolean             unmanaged;
 
     /* plink is a NMPlatformLink type, however, we require it to come from the platform
@@ -5964,8 +6177,10 @@ realize_start_setup(NMDevice *            self,
                                          NULL,
                                          &priv->driver_version,
                                          &priv->firmware_version);
-        if (priv->driver_version)
+        if (priv->driver_version) {
+            _con_defaults_cache_clear(self);
             _notify(self, PROP_DRIVER_VERSION);
+        }
         if (priv->firmware_version)
             _notify(self, PROP_FIRMWARE_VERSION);
 
@@ -6013,10 +6228,7 @@ realize_start_setup(NMDevice *            self,
 
     nm_device_set_carrier_from_platform(self);
 
-    nm_assert(!priv->stats.timeout_id);
-    real_rate = _stats_refresh_rate_real(priv->stats.refresh_rate_ms);
-    if (real_rate)
-        priv->stats.timeout_id = g_timeout_add(real_rate, _stats_timeout_cb, self);
+    _stats_subscribe(self, TRUE);
 
     klass->realize_start_notify(self, plink);
 
@@ -6181,6 +6393,7 @@ nm_device_unrealize(NMDevice *self, gboolean remove_resources, GError **error)
 
     if (priv->driver_version) {
         nm_clear_g_free(&priv->driver_version);
+        _con_defaults_cache_clear(self);
         _notify(self, PROP_DRIVER_VERSION);
     }
     if (priv->firmware_version) {
@@ -6200,15 +6413,17 @@ nm_device_unrealize(NMDevice *self, gboolean remove_resources, GError **error)
         _notify(self, PROP_PHYSICAL_PORT_ID);
     }
 
-    nm_clear_g_source(&priv->stats.timeout_id);
+    _stats_subscribe(self, FALSE);
     _stats_update_counters(self, 0, 0);
 
     priv->hw_addr_len_ = 0;
     if (nm_clear_g_free(&priv->hw_addr))
         _notify(self, PROP_HW_ADDRESS);
     priv->hw_addr_type = HW_ADDR_TYPE_UNSET;
-    if (nm_clear_g_free(&priv->hw_addr_perm))
+    if (nm_clear_g_free(&priv->hw_addr_perm)) {
+        _con_defaults_cache_clear(self);
         _notify(self, PROP_PERM_HW_ADDRESS);
+    }
     nm_clear_g_free(&priv->hw_addr_initial);
 
     priv->capabilities = NM_DEVICE_CAP_NM_SUPPORTED;
@@ -7095,7 +7310,6 @@ _get_maybe_ipv6_disabled(NMDevice *self)
 {
     NMPlatform *platform;
     int         ifindex;
-    const char *path;
     char        ifname[IFNAMSIZ];
 
     ifindex = nm_device_get_ip_ifindex(self);
@@ -7106,8 +7320,15 @@ _get_maybe_ipv6_disabled(NMDevice *self)
     if (!nm_platform_if_indextoname(platform, ifindex, ifname))
         return FALSE;
 
-    path = nm_sprintf_bufa(128, "/proc/sys/net/ipv6/conf/%s/disable_ipv6", ifname);
-    return (nm_platform_sysctl_get_int32(platform, NMP_SYSCTL_PATHID_ABSOLUTE(path), 0) == 0);
+    return (nm_platform_sysctl_ip_conf_get_int_checked(platform,
+                                                       AF_INET6,
+                                                       ifname,
+                                                       "disable_ipv6",
+                                                       10,
+                                                       G_MININT32,
+                                                       G_MAXINT32,
+                                                       0)
+            == 0);
 }
 
 NMConnection *
@@ -11565,8 +11786,10 @@ share_init(NMDevice *self, GError **error)
               nm_strerror_native(errsv));
     }
 
+    /* The helpers are only needed once the first connections get tracked,
+     * don't wait for modprobe. */
     for (i = 0; i < G_N_ELEMENTS(modules); i++)
-        nm_utils_modprobe(NULL, FALSE, modules[i], NULL);
+        nm_utils_modprobe_async(modules[i], NULL, NULL);
 
     return TRUE;
 }
@@ -11583,6 +11806,7 @@ start_sharing(NMDevice *self, NMIP4Config *config, GError **error)
     NMSettingConnection *       s_con;
     gboolean                    announce_android_metered;
     NMUtilsShareRules *         share_rules;
+    gs_free char *              firewall_backend = NULL;
 
     g_return_val_if_fail(config, FALSE);
 
@@ -11607,12 +11831,16 @@ start_sharing(NMDevice *self, NMIP4Config *config, GError **error)
     req = nm_device_get_act_request(self);
     g_return_val_if_fail(req, FALSE);
 
-    share_rules = nm_utils_share_rules_new();
+    firewall_backend = nm_config_data_get_value(NM_CONFIG_GET_DATA,
+                                                NM_CONFIG_KEYFILE_GROUP_MAIN,
+                                                NM_CONFIG_KEYFILE_KEY_MAIN_FIREWALL_BACKEND,
+                                                NM_CONFIG_GET_VALUE_STRIP
+                                                    | NM_CONFIG_GET_VALUE_NO_EMPTY);
+    share_rules      = nm_utils_share_rules_new(nm_streq0(firewall_backend, "nftables"));
 
     nm_utils_share_rules_add_all_rules(share_rules, ip_iface, ip4_addr->address, ip4_addr->plen);
 
-    nm_utils_share_rules_apply(share_rules, TRUE);
-
+    /* this also applies the rules. */
     nm_act_request_set_shared(req, share_rules);
 
     conn  = nm_act_request_get_applied_connection(req);
@@ -14759,6 +14987,11 @@ _set_unmanaged_flags(NMDevice *          self,
     if (old_flags == priv->unmanaged_flags && old_mask == priv->unmanaged_mask)
         return;
 
+    if (NM_FLAGS_HAS(old_flags ^ priv->unmanaged_flags, NM_UNMANAGED_PLATFORM_INIT)) {
+        /* the permanent MAC address used for matching depends on the flag. */
+        _con_defaults_cache_clear(self);
+    }
+
     transition_state =
         allow_state_transition && was_managed != nm_device_get_managed(self, FALSE)
         && (was_managed
@@ -15556,6 +15789,8 @@ nm_device_add_pending_action(NMDevice *self, const char *action, gboolean assert
 
     _LOGD(LOGD_DEVICE, "add_pending_action (%d): '%s'", count, action);
 
+    nm_startup_trace_async_begin(self, action, nm_device_get_iface(self));
+
     if (count == 1)
         _notify(self, PROP_HAS_PENDING_ACTION);
 
@@ -15594,6 +15829,7 @@ nm_device_remove_pending_action(NMDevice *self, const char *action, gboolean ass
                   count + g_slist_length(iter->next), /* length excluding 'iter' */
                   action);
             priv->pending_actions = g_slist_delete_link(priv->pending_actions, iter);
+            nm_startup_trace_async_end(self, action);
             if (priv->pending_actions == NULL)
                 _notify(self, PROP_HAS_PENDING_ACTION);
             return TRUE;
@@ -16902,6 +17138,7 @@ nm_device_update_permanent_hw_address(NMDevice *self, gboolean force_freeze)
     priv->hw_addr_perm = g_strdup(priv->hw_addr);
 
 notify_and_out:
+    _con_defaults_cache_clear(self);
     _notify(self, PROP_PERM_HW_ADDRESS);
 }
 
@@ -17402,12 +17639,16 @@ nm_device_spec_match_list(NMDevice *self, const GSList *specs)
     return nm_device_spec_match_list_full(self, specs, FALSE);
 }
 
-int
-nm_device_spec_match_list_full(NMDevice *self, const GSList *specs, int no_match_value)
+static int
+_spec_match_full(NMDevice *               self,
+                 const GSList *           specs,
+                 const NMMatchSpecDevice *matcher,
+                 int                      no_match_value)
 {
     NMDeviceClass *      klass;
     NMMatchSpecMatchType m;
     const char *         hw_address = NULL;
+    const char *         s390_subchannels;
     gboolean             is_fake;
 
     g_return_val_if_fail(NM_IS_DEVICE(self), FALSE);
@@ -17418,14 +17659,29 @@ nm_device_spec_match_list_full(NMDevice *self, const GSList *specs, int no_match
         !nm_device_get_unmanaged_flags(self, NM_UNMANAGED_PLATFORM_INIT),
         &is_fake);
 
-    m = nm_match_spec_device(specs,
-                             nm_device_get_iface(self),
-                             nm_device_get_type_description(self),
-                             nm_device_get_driver(self),
-                             nm_device_get_driver_version(self),
-                             is_fake ? NULL : hw_address,
-                             klass->get_s390_subchannels ? klass->get_s390_subchannels(self) : NULL,
-                             nm_dhcp_manager_get_config(nm_dhcp_manager_get()));
+    if (is_fake)
+        hw_address = NULL;
+    s390_subchannels = klass->get_s390_subchannels ? klass->get_s390_subchannels(self) : NULL;
+
+    if (matcher) {
+        m = nm_match_spec_device_eval(matcher,
+                                      nm_device_get_iface(self),
+                                      nm_device_get_type_description(self),
+                                      nm_device_get_driver(self),
+                                      nm_device_get_driver_version(self),
+                                      hw_address,
+                                      s390_subchannels,
+                                      nm_dhcp_manager_get_config(nm_dhcp_manager_get()));
+    } else {
+        m = nm_match_spec_device(specs,
+                                 nm_device_get_iface(self),
+                                 nm_device_get_type_description(self),
+                                 nm_device_get_driver(self),
+                                 nm_device_get_driver_version(self),
+                                 hw_address,
+                                 s390_subchannels,
+                                 nm_dhcp_manager_get_config(nm_dhcp_manager_get()));
+    }
 
     switch (m) {
     case NM_MATCH_SPEC_MATCH:
@@ -17439,6 +17695,30 @@ nm_device_spec_match_list_full(NMDevice *self, const GSList *specs, int no_match
     return no_match_value;
 }
 
+int
+nm_device_spec_match_list_full(NMDevice *self, const GSList *specs, int no_match_value)
+{
+    return _spec_match_full(self, specs, NULL, no_match_value);
+}
+
+/**
+ * nm_device_spec_match_compiled_full:
+ * @self: an #NMDevice
+ * @matcher: (allow-none): the specs, compiled by nm_match_spec_device_compile().
+ * @no_match_value: the value to return if no spec matched.
+ *
+ * Like nm_device_spec_match_list_full(), but for a pre-processed spec list.
+ */
+int
+nm_device_spec_match_compiled_full(NMDevice *               self,
+                                   const NMMatchSpecDevice *matcher,
+                                   int                      no_match_value)
+{
+    if (!matcher)
+        return no_match_value;
+    return _spec_match_full(self, NULL, matcher, no_match_value);
+}
+
 guint
 nm_device_get_supplicant_timeout(NMDevice *self)
 {
@@ -18233,7 +18513,7 @@ dispose(GObject *object)
 
     nm_clear_g_source(&priv->check_delete_unrealized_id);
 
-    nm_clear_g_source(&priv->stats.timeout_id);
+    _stats_subscribe(self, FALSE);
 
     carrier_disconnected_action_cancel(self);
 
@@ -18291,6 +18571,9 @@ finalize(GObject *object)
 
     _LOGD(LOGD_DEVICE, "finalize(): %s", G_OBJECT_TYPE_NAME(self));
 
+    nm_clear_pointer(&priv->con_defaults_cache.values, g_hash_table_unref);
+    g_clear_object(&priv->con_defaults_cache.config_data);
+
     g_free(priv->hw_addr);
     g_free(priv->hw_addr_perm);
     g_free(priv->hw_addr_initial);
@@ -576,6 +576,11 @@ gboolean nm_device_unmanage_on_quit(NMDevice *self);
 
 gboolean nm_device_spec_match_list(NMDevice *device, const GSList *specs);
 int      nm_device_spec_match_list_full(NMDevice *self, const GSList *specs, int no_match_value);
+int      nm_device_spec_match_compiled_full(NMDevice *               self,
+                                            const NMMatchSpecDevice *matcher,
+                                            int                      no_match_value);
+
+GHashTable *nm_device_get_con_defaults_cache(NMDevice *self, const NMConfigData *config_data);
 
 gboolean nm_device_is_activating(NMDevice *dev);
 gboolean nm_device_autoconnect_allowed(NMDevice *self);
@@ -40,7 +40,12 @@ typedef struct {
     guint              teamd_timeout;
     guint              teamd_read_timeout;
     guint              teamd_dbus_watch;
+    guint              port_flush_id;
+    GHashTable *       pending_port_resets;
+    GCancellable *     teamd_dbus_cancellable;
     bool               kill_in_progress : 1;
+    bool               kill_for_stage1 : 1;
+    bool               start_after_kill : 1;
     GFileMonitor *     usock_monitor;
     NMDeviceStageState stage1_state : 3;
 } NMDeviceTeamPrivate;
@@ -270,15 +275,92 @@ master_update_slave_connection(NMDevice *    self,
 
 /*****************************************************************************/
 
+/* Resetting the configuration of released ports is not urgent. Collect the
+ * ports and reset them together from an idle handler, so that releasing
+ * all ports of a team talks to teamd in one go instead of once per
+ * release_slave() call. */
+
+static void
+port_resets_flush(NMDeviceTeam *self)
+{
+    NMDeviceTeamPrivate *priv = NM_DEVICE_TEAM_GET_PRIVATE(self);
+    GHashTableIter       iter;
+    const char *         iface;
+    int                  err;
+
+    nm_clear_g_source(&priv->port_flush_id);
+
+    if (!priv->pending_port_resets || g_hash_table_size(priv->pending_port_resets) == 0)
+        return;
+
+    if (priv->tdc) {
+        _LOGD(LOGD_TEAM,
+              "resetting configuration of %u released team ports",
+              g_hash_table_size(priv->pending_port_resets));
+        g_hash_table_iter_init(&iter, priv->pending_port_resets);
+        while (g_hash_table_iter_next(&iter, (gpointer *) &iface, NULL)) {
+            err = teamdctl_port_config_update_raw(priv->tdc, iface, "{}");
+            if (err != 0)
+                _LOGD(LOGD_TEAM, "failed to reset config for port %s (err=%d)", iface, err);
+        }
+    }
+
+    g_hash_table_remove_all(priv->pending_port_resets);
+}
+
+static gboolean
+port_resets_flush_cb(gpointer user_data)
+{
+    NMDeviceTeam *       self = user_data;
+    NMDeviceTeamPrivate *priv = NM_DEVICE_TEAM_GET_PRIVATE(self);
+
+    priv->port_flush_id = 0;
+    port_resets_flush(self);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+port_resets_queue(NMDeviceTeam *self, const char *iface)
+{
+    NMDeviceTeamPrivate *priv = NM_DEVICE_TEAM_GET_PRIVATE(self);
+
+    if (!priv->pending_port_resets)
+        priv->pending_port_resets = g_hash_table_new_full(nm_str_hash, g_str_equal, g_free, NULL);
+
+    g_hash_table_add(priv->pending_port_resets, g_strdup(iface));
+
+    if (!priv->port_flush_id)
+        priv->port_flush_id = g_idle_add(port_resets_flush_cb, self);
+}
+
+static void
+port_resets_unqueue(NMDeviceTeam *self, const char *iface)
+{
+    NMDeviceTeamPrivate *priv = NM_DEVICE_TEAM_GET_PRIVATE(self);
+
+    if (priv->pending_port_resets)
+        g_hash_table_remove(priv->pending_port_resets, iface);
+}
+
+/*****************************************************************************/
+
 static void
 teamd_kill_cb(pid_t pid, gboolean success, int child_status, void *user_data)
 {
     gs_unref_object NMDeviceTeam *self = user_data;
     NMDeviceTeamPrivate *         priv = NM_DEVICE_TEAM_GET_PRIVATE(self);
+    NMDeviceState                 state;
+    gboolean                      start_after_kill;
 
+    start_after_kill       = priv->start_after_kill;
     priv->kill_in_progress = FALSE;
+    priv->kill_for_stage1  = FALSE;
+    priv->start_after_kill = FALSE;
 
-    if (nm_device_get_state(NM_DEVICE(self)) != NM_DEVICE_STATE_PREPARE) {
+    state = nm_device_get_state(NM_DEVICE(self));
+    if (state != NM_DEVICE_STATE_PREPARE
+        && !(start_after_kill && state > NM_DEVICE_STATE_PREPARE
+             && state <= NM_DEVICE_STATE_ACTIVATED)) {
         _LOGT(LOGD_TEAM, "kill terminated");
         return;
     }
@@ -313,6 +395,11 @@ teamd_cleanup(NMDeviceTeam *self, gboolean free_tdc)
     }
 
     if (priv->tdc && free_tdc) {
+        /* Without teamd there is no port configuration left to reset. */
+        nm_clear_g_source(&priv->port_flush_id);
+        if (priv->pending_port_resets)
+            g_hash_table_remove_all(priv->pending_port_resets);
+
         teamdctl_disconnect(priv->tdc);
         teamdctl_free(priv->tdc);
         priv->tdc = NULL;
@@ -412,6 +499,42 @@ teamd_gone(NMDeviceTeam *self)
     }
 }
 
+static void
+teamd_dbus_get_pid_cb(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    gs_unref_variant GVariant *ret   = NULL;
+    gs_free_error GError *     error = NULL;
+    NMDeviceTeam *             self;
+    NMDeviceTeamPrivate *      priv;
+    guint32                    pid;
+
+    ret = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error);
+    if (nm_utils_error_is_cancelled(error))
+        return;
+
+    self = user_data;
+    priv = NM_DEVICE_TEAM_GET_PRIVATE(self);
+
+    g_clear_object(&priv->teamd_dbus_cancellable);
+
+    if (!ret) {
+        /* The process that registered on the bus died. If it's
+         * the teamd instance we just started, ignore the event
+         * as we already detect the failure through the process
+         * watch. If it's a previous instance that got killed,
+         * also ignore that as our new instance will register
+         * again. */
+        _LOGD(LOGD_TEAM, "failed to determine D-Bus name owner, ignoring");
+        return;
+    }
+
+    g_variant_get(ret, "(u)", &pid);
+    if (priv->teamd_process_watch && pid != priv->teamd_pid)
+        teamd_cleanup(self, FALSE);
+
+    teamd_ready(self);
+}
+
 static void
 teamd_dbus_appeared(GDBusConnection *connection,
                     const char *     name,
@@ -425,39 +548,27 @@ teamd_dbus_appeared(GDBusConnection *connection,
 
     _LOGI(LOGD_TEAM, "teamd appeared on D-Bus");
 
+    nm_clear_g_cancellable(&priv->teamd_dbus_cancellable);
+
     /* If another teamd grabbed the bus name while our teamd was starting,
      * just ignore the death of our teamd and run with the existing one.
+     * Find out asynchronously who owns the name.
      */
     if (priv->teamd_process_watch) {
-        gs_unref_variant GVariant *ret = NULL;
-        guint32                    pid;
-
-        ret = g_dbus_connection_call_sync(connection,
-                                          DBUS_SERVICE_DBUS,
-                                          DBUS_PATH_DBUS,
-                                          DBUS_INTERFACE_DBUS,
-                                          "GetConnectionUnixProcessID",
-                                          g_variant_new("(s)", name_owner),
-                                          NULL,
-                                          G_DBUS_CALL_FLAGS_NO_AUTO_START,
-                                          2000,
-                                          NULL,
-                                          NULL);
-
-        if (ret) {
-            g_variant_get(ret, "(u)", &pid);
-            if (pid != priv->teamd_pid)
-                teamd_cleanup(self, FALSE);
-        } else {
-            /* The process that registered on the bus died. If it's
-             * the teamd instance we just started, ignore the event
-             * as we already detect the failure through the process
-             * watch. If it's a previous instance that got killed,
-             * also ignore that as our new instance will register
-             * again. */
-            _LOGD(LOGD_TEAM, "failed to determine D-Bus name owner, ignoring");
-            return;
-        }
+        priv->teamd_dbus_cancellable = g_cancellable_new();
+        g_dbus_connection_call(connection,
+                               DBUS_SERVICE_DBUS,
+                               DBUS_PATH_DBUS,
+                               DBUS_INTERFACE_DBUS,
+                               "GetConnectionUnixProcessID",
+                               g_variant_new("(s)", name_owner),
+                               G_VARIANT_TYPE("(u)"),
+                               G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                               2000,
+                               priv->teamd_dbus_cancellable,
+                               teamd_dbus_get_pid_cb,
+                               self);
+        return;
     }
 
     teamd_ready(self);
@@ -471,6 +582,8 @@ teamd_dbus_vanished(GDBusConnection *dbus_connection, const char *name, gpointer
 
     g_return_if_fail(priv->teamd_dbus_watch);
 
+    nm_clear_g_cancellable(&priv->teamd_dbus_cancellable);
+
     if (!priv->tdc) {
         /* g_bus_watch_name will always raise an initial signal, to indicate whether the
          * name exists/not exists initially. Do not take this as a failure if it hadn't
@@ -556,12 +669,140 @@ teamd_env(void)
     return env;
 }
 
+/* "teamd -k" helpers are spawned asynchronously. To not fork a storm of
+ * processes when many team devices go down at once, at most
+ * TEAMD_KILL_MAX_PARALLEL of them run at the same time and the others
+ * wait in a queue. */
+#define TEAMD_KILL_MAX_PARALLEL 4
+#define TEAMD_KILL_TIMEOUT_MSEC 5000
+
+typedef struct {
+    NMDeviceTeam *self;
+    char **       argv;
+    GPid          pid;
+    guint         watch_id;
+    guint         timeout_id;
+} TeamdKillData;
+
+static GQueue _teamd_kill_queue   = G_QUEUE_INIT;
+static guint  _teamd_kill_running = 0;
+
+static void _teamd_kill_queue_process(void);
+
+static void
+_teamd_kill_data_free(TeamdKillData *data)
+{
+    nm_assert(data->watch_id == 0);
+
+    nm_clear_g_source(&data->timeout_id);
+    g_strfreev(data->argv);
+    nm_g_slice_free(data);
+}
+
+static gboolean
+_teamd_kill_timeout_cb(gpointer user_data)
+{
+    TeamdKillData *data = user_data;
+    NMDeviceTeam * self = data->self;
+
+    data->timeout_id = 0;
+    _LOGD(LOGD_TEAM,
+          "teamd kill helper [pid %lld] did not terminate in time, killing it",
+          (long long) data->pid);
+    kill(data->pid, SIGKILL);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+_teamd_kill_spawn_failed_cb(gpointer user_data)
+{
+    TeamdKillData *      data = user_data;
+    NMDeviceTeam *       self = data->self;
+    NMDeviceTeamPrivate *priv = NM_DEVICE_TEAM_GET_PRIVATE(self);
+
+    data->timeout_id = 0;
+    _teamd_kill_data_free(data);
+
+    if (priv->kill_for_stage1
+        && nm_device_get_state(NM_DEVICE(self)) == NM_DEVICE_STATE_PREPARE) {
+        /* stage1 cannot respawn teamd with the new configuration while
+         * the old instance keeps running. */
+        priv->kill_in_progress = FALSE;
+        priv->kill_for_stage1  = FALSE;
+        priv->start_after_kill = FALSE;
+        nm_device_state_changed(NM_DEVICE(self),
+                                NM_DEVICE_STATE_FAILED,
+                                NM_DEVICE_STATE_REASON_TEAMD_CONTROL_FAILED);
+        g_object_unref(self);
+        return G_SOURCE_REMOVE;
+    }
+
+    /* teamd_kill_cb() takes over the reference to self. */
+    teamd_kill_cb(0, FALSE, 0, self);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_teamd_kill_watch_cb(GPid pid, int status, gpointer user_data)
+{
+    TeamdKillData *data = user_data;
+    NMDeviceTeam * self = data->self;
+
+    data->watch_id = 0;
+    nm_assert(_teamd_kill_running > 0);
+    _teamd_kill_running--;
+
+    _LOGD(LOGD_TEAM, "teamd kill helper [pid %lld] exited with status %d", (long long) pid, status);
+
+    /* teamd_kill_cb() takes over the reference to self. */
+    teamd_kill_cb(pid, WIFEXITED(status) && WEXITSTATUS(status) == 0, status, self);
+    _teamd_kill_data_free(data);
+
+    _teamd_kill_queue_process();
+}
+
+static void
+_teamd_kill_queue_process(void)
+{
+    while (_teamd_kill_running < TEAMD_KILL_MAX_PARALLEL) {
+        gs_free_error GError *error   = NULL;
+        gs_free const char ** envp    = NULL;
+        gs_free char *        tmp_str = NULL;
+        TeamdKillData *       data;
+        NMDeviceTeam *        self;
+
+        data = g_queue_pop_head(&_teamd_kill_queue);
+        if (!data)
+            return;
+
+        self = data->self;
+        envp = teamd_env();
+
+        _LOGD(LOGD_TEAM, "running: %s", (tmp_str = g_strjoinv(" ", data->argv)));
+        if (!g_spawn_async("/",
+                           data->argv,
+                           (char **) envp,
+                           G_SPAWN_DO_NOT_REAP_CHILD,
+                           teamd_child_setup,
+                           NULL,
+                           &data->pid,
+                           &error)) {
+            _LOGW(LOGD_TEAM, "failed to kill teamd: %s", error->message);
+            data->timeout_id = g_idle_add(_teamd_kill_spawn_failed_cb, data);
+            continue;
+        }
+
+        _teamd_kill_running++;
+        data->watch_id   = g_child_watch_add(data->pid, _teamd_kill_watch_cb, data);
+        data->timeout_id = g_timeout_add(TEAMD_KILL_TIMEOUT_MSEC, _teamd_kill_timeout_cb, data);
+    }
+}
+
 static gboolean
 teamd_kill(NMDeviceTeam *self, const char *teamd_binary, GError **error)
 {
-    gs_unref_ptrarray GPtrArray *argv    = NULL;
-    gs_free char *               tmp_str = NULL;
-    gs_free const char **        envp    = NULL;
+    NMDeviceTeamPrivate *priv = NM_DEVICE_TEAM_GET_PRIVATE(self);
+    TeamdKillData *      data;
 
     if (!teamd_binary) {
         teamd_binary = nm_utils_find_helper("teamd", NULL, error);
@@ -571,26 +812,21 @@ teamd_kill(NMDeviceTeam *self, const char *teamd_binary, GError **error)
         }
     }
 
-    argv = g_ptr_array_new();
-    g_ptr_array_add(argv, (gpointer) teamd_binary);
-    g_ptr_array_add(argv, (gpointer) "-k");
-    g_ptr_array_add(argv, (gpointer) "-t");
-    g_ptr_array_add(argv, (gpointer) nm_device_get_iface(NM_DEVICE(self)));
-    g_ptr_array_add(argv, NULL);
-
-    envp = teamd_env();
-
-    _LOGD(LOGD_TEAM, "running: %s", (tmp_str = g_strjoinv(" ", (char **) argv->pdata)));
-    return g_spawn_sync("/",
-                        (char **) argv->pdata,
-                        (char **) envp,
-                        0,
-                        teamd_child_setup,
-                        NULL,
-                        NULL,
-                        NULL,
-                        NULL,
-                        error);
+    /* The helper runs asynchronously. Like for a teamd process that we
+     * spawned ourselves, teamd_kill_cb() is invoked once it terminates. */
+    data  = g_slice_new(TeamdKillData);
+    *data = (TeamdKillData){
+        .self = g_object_ref(self),
+        .argv = g_strdupv((char **) NM_MAKE_STRV(teamd_binary,
+                                                 "-k",
+                                                 "-t",
+                                                 nm_device_get_iface(NM_DEVICE(self)))),
+    };
+    priv->kill_in_progress = TRUE;
+
+    g_queue_push_tail(&_teamd_kill_queue, data);
+    _teamd_kill_queue_process();
+    return TRUE;
 }
 
 static gboolean
@@ -625,8 +861,13 @@ teamd_start(NMDeviceTeam *self)
 
     if (priv->teamd_process_watch || priv->teamd_pid > 0 || priv->tdc) {
         g_warn_if_reached();
-        if (!priv->teamd_pid)
-            teamd_kill(self, teamd_binary, NULL);
+        if (!priv->teamd_pid && teamd_kill(self, teamd_binary, NULL)) {
+            /* The old instance must be gone before we spawn the new one.
+             * teamd_kill_cb() will call us again. */
+            teamd_cleanup(self, TRUE);
+            priv->start_after_kill = TRUE;
+            return TRUE;
+        }
         teamd_cleanup(self, TRUE);
     }
 
@@ -768,6 +1009,9 @@ act_stage1_prepare(NMDevice *device, NMDeviceStateReason *out_failure_reason)
                 NM_SET_OUT(out_failure_reason, NM_DEVICE_STATE_REASON_TEAMD_CONTROL_FAILED);
                 return NM_ACT_STAGE_RETURN_FAILURE;
             }
+
+            /* if the helper fails to spawn later, the activation fails. */
+            priv->kill_for_stage1 = TRUE;
         }
 
         _LOGD(LOGD_TEAM, "existing teamd config mismatch; respawning...");
@@ -791,7 +1035,8 @@ deactivate(NMDevice *device)
     NMDeviceTeam *       self = NM_DEVICE_TEAM(device);
     NMDeviceTeamPrivate *priv = NM_DEVICE_TEAM_GET_PRIVATE(self);
 
-    priv->stage1_state = NM_DEVICE_STAGE_STATE_INIT;
+    priv->stage1_state    = NM_DEVICE_STAGE_STATE_INIT;
+    priv->kill_for_stage1 = FALSE;
 
     if (nm_device_sys_iface_state_is_external(device))
         return;
@@ -832,6 +1077,10 @@ enslave_slave(NMDevice *device, NMDevice *slave, NMConnection *connection, gbool
                     int   err;
                     char *sanitized_config;
 
+                    /* A reset still pending from a previous release must not
+                     * overwrite the configuration we set now. */
+                    port_resets_unqueue(self, slave_iface);
+
                     sanitized_config = g_strdelimit(g_strdup(config), "\r\n", ' ');
                     err = teamdctl_port_config_update_raw(priv->tdc, slave_iface, sanitized_config);
                     g_free(sanitized_config);
@@ -912,7 +1161,7 @@ release_slave(NMDevice *device, NMDevice *slave, gboolean configure)
     if (configure && priv->tdc
         && (s_port = nm_device_get_applied_setting(slave, NM_TYPE_SETTING_TEAM_PORT))
         && (nm_setting_team_port_get_config(s_port)))
-        teamdctl_port_config_update_raw(priv->tdc, nm_device_get_ip_iface(slave), "{}");
+        port_resets_queue(self, nm_device_get_ip_iface(slave));
 }
 
 static gboolean
@@ -1028,12 +1277,15 @@ dispose(GObject *object)
         priv->teamd_dbus_watch = 0;
     }
 
+    nm_clear_g_cancellable(&priv->teamd_dbus_cancellable);
+
     if (priv->usock_monitor) {
         g_signal_handlers_disconnect_by_data(priv->usock_monitor, object);
         g_clear_object(&priv->usock_monitor);
     }
 
     teamd_cleanup(self, TRUE);
+    nm_clear_pointer(&priv->pending_port_resets, g_hash_table_unref);
     nm_clear_g_free(&priv->config);
 
     G_OBJECT_CLASS(nm_device_team_parent_class)->dispose(object);
@@ -56,6 +56,10 @@
 #define SCAN_REQUEST_SSIDS_MAX_NUM      32u
 #define SCAN_REQUEST_SSIDS_MAX_AGE_MSEC (3 * 60 * NM_UTILS_MSEC_PER_SEC)
 
+/* An AP whose BSS disappeared from the scan results stays exported for this
+ * long. If the same BSS reappears meanwhile, the AP object is reused. */
+#define AP_REMOVAL_GRACE_SEC 15
+
 #define _LOGT_scan(...) _LOGT(LOGD_WIFI_SCAN, "wifi-scan: " __VA_ARGS__)
 
 /*****************************************************************************/
@@ -81,6 +85,26 @@ typedef struct {
     CList       aps_lst_head;
     GHashTable *aps_idx_by_supplicant_path;
 
+    /* BSS paths with updates from the supplicant that are not yet applied
+     * to the AP list. While scanning, they are collected until the scan
+     * completes. */
+    GHashTable *bss_pending_hash;
+    GSource *   bss_pending_source;
+
+    /* APs whose BSS is gone, mapped to the monotonic timestamp in seconds
+     * when they get removed. */
+    GHashTable *aps_removing_hash;
+    GSource *   aps_removing_source;
+
+    struct {
+        guint64 added;
+        guint64 removed;
+        guint64 reused;
+        guint64 notified;
+    } ap_stats;
+
+    guint ap_batch_depth;
+
     CList scanning_prohibited_lst_head;
 
     GCancellable *scan_request_cancellable;
@@ -134,6 +158,8 @@ typedef struct {
     bool scan_explicit_requested : 1;
     bool ssid_found : 1;
     bool hidden_probe_scan_warn : 1;
+    bool ap_batch_changed : 1;
+    bool ap_batch_recheck_available : 1;
 
 } NMDeviceWifiPrivate;
 
@@ -176,6 +202,10 @@ static void supplicant_iface_bss_changed_cb(NMSupplicantInterface *iface,
                                             gboolean               is_present,
                                             NMDeviceWifi *         self);
 
+static void _bss_pending_flush(NMDeviceWifi *self);
+
+static void schedule_ap_list_dump(NMDeviceWifi *self);
+
 static void supplicant_iface_wps_credentials_cb(NMSupplicantInterface *iface,
                                                 GVariant *             credentials,
                                                 NMDeviceWifi *         self);
@@ -438,6 +468,12 @@ _scan_notify_is_scanning(NMDeviceWifi *self)
 
     priv->scan_is_scanning = scanning;
 
+    if (!scanning) {
+        /* the scan completed. Apply the collected BSS updates before
+         * notifying about it. */
+        _bss_pending_flush(self);
+    }
+
     if (!scanning || priv->scan_last_complete_msec == 0) {
         last_scan_changed             = TRUE;
         priv->scan_last_complete_msec = nm_utils_get_monotonic_timestamp_msec();
@@ -651,6 +687,9 @@ supplicant_interface_release(NMDeviceWifi *self)
 
     nm_clear_g_source(&priv->ap_dump_id);
 
+    nm_clear_g_source_inst(&priv->bss_pending_source);
+    nm_clear_pointer(&priv->bss_pending_hash, g_hash_table_unref);
+
     if (priv->sup_iface) {
         /* Clear supplicant interface signal handlers */
         g_signal_handlers_disconnect_by_data(priv->sup_iface, self);
@@ -804,27 +843,189 @@ ap_add_remove(NMDeviceWifi *self,
         nm_dbus_object_export(NM_DBUS_OBJECT(ap));
         _ap_dump(self, LOGL_DEBUG, ap, "added", 0);
         nm_device_wifi_emit_signal_access_point(NM_DEVICE(self), ap, TRUE);
+        priv->ap_stats.added++;
     } else {
         ap->wifi_device = NULL;
         c_list_unlink(&ap->aps_lst);
         if (!g_hash_table_remove(priv->aps_idx_by_supplicant_path,
                                  nm_wifi_ap_get_supplicant_path(ap)))
             nm_assert_not_reached();
+        if (priv->aps_removing_hash)
+            g_hash_table_remove(priv->aps_removing_hash, ap);
         _ap_dump(self, LOGL_DEBUG, ap, "removed", 0);
+        priv->ap_stats.removed++;
     }
 
-    _notify(self, PROP_ACCESS_POINTS);
+    if (priv->ap_batch_depth > 0) {
+        /* the notification and the rechecks happen once, at the end of
+         * the batch. */
+        priv->ap_batch_changed = TRUE;
+        if (recheck_available_connections)
+            priv->ap_batch_recheck_available = TRUE;
+    } else {
+        priv->ap_stats.notified++;
+        _notify(self, PROP_ACCESS_POINTS);
+    }
 
     if (!is_adding) {
         nm_device_wifi_emit_signal_access_point(NM_DEVICE(self), ap, FALSE);
         nm_dbus_object_clear_and_unexport(&ap);
     }
 
+    if (priv->ap_batch_depth > 0)
+        return;
+
+    nm_device_emit_recheck_auto_activate(NM_DEVICE(self));
+    if (recheck_available_connections)
+        nm_device_recheck_available_connections(NM_DEVICE(self));
+}
+
+static void
+_ap_batch_begin(NMDeviceWifi *self)
+{
+    NM_DEVICE_WIFI_GET_PRIVATE(self)->ap_batch_depth++;
+}
+
+static void
+_ap_batch_end(NMDeviceWifi *self)
+{
+    NMDeviceWifiPrivate *priv = NM_DEVICE_WIFI_GET_PRIVATE(self);
+    gboolean             recheck_available_connections;
+
+    nm_assert(priv->ap_batch_depth > 0);
+
+    if (--priv->ap_batch_depth > 0)
+        return;
+
+    if (!priv->ap_batch_changed)
+        return;
+
+    recheck_available_connections    = priv->ap_batch_recheck_available;
+    priv->ap_batch_changed           = FALSE;
+    priv->ap_batch_recheck_available = FALSE;
+
+    priv->ap_stats.notified++;
+    _notify(self, PROP_ACCESS_POINTS);
+
     nm_device_emit_recheck_auto_activate(NM_DEVICE(self));
     if (recheck_available_connections)
         nm_device_recheck_available_connections(NM_DEVICE(self));
 }
 
+static gboolean
+_ap_removal_timeout_cb(gpointer user_data)
+{
+    NMDeviceWifi *               self    = user_data;
+    NMDeviceWifiPrivate *        priv    = NM_DEVICE_WIFI_GET_PRIVATE(self);
+    gs_unref_ptrarray GPtrArray *expired = NULL;
+    GHashTableIter               iter;
+    NMWifiAP *                   ap;
+    gpointer                     p_expiry;
+    gint32                       now_sec;
+    gint32                       next_sec = G_MAXINT32;
+    guint                        i;
+
+    nm_clear_g_source_inst(&priv->aps_removing_source);
+
+    if (!priv->aps_removing_hash)
+        return G_SOURCE_REMOVE;
+
+    now_sec = nm_utils_get_monotonic_timestamp_sec();
+
+    g_hash_table_iter_init(&iter, priv->aps_removing_hash);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &ap, &p_expiry)) {
+        if (GPOINTER_TO_INT(p_expiry) > now_sec) {
+            next_sec = NM_MIN(next_sec, GPOINTER_TO_INT(p_expiry));
+            continue;
+        }
+        if (ap == priv->current_ap) {
+            /* the current AP gets removed when it is no longer current. */
+            g_hash_table_iter_remove(&iter);
+            continue;
+        }
+        if (!expired)
+            expired = g_ptr_array_new();
+        g_ptr_array_add(expired, ap);
+    }
+
+    if (expired) {
+        _ap_batch_begin(self);
+        for (i = 0; i < expired->len; i++)
+            ap_add_remove(self, FALSE, expired->pdata[i], TRUE);
+        _ap_batch_end(self);
+        schedule_ap_list_dump(self);
+    }
+
+    if (next_sec != G_MAXINT32) {
+        priv->aps_removing_source =
+            nm_g_source_attach(nm_g_timeout_source_new_seconds(next_sec - now_sec,
+                                                               G_PRIORITY_DEFAULT,
+                                                               _ap_removal_timeout_cb,
+                                                               self,
+                                                               NULL),
+                               NULL);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_ap_removal_schedule(NMDeviceWifi *self, NMWifiAP *ap)
+{
+    NMDeviceWifiPrivate *priv = NM_DEVICE_WIFI_GET_PRIVATE(self);
+
+    /* Set 'fake' to indicate that this AP is now unknown to the supplicant.
+     * It stays exported for a while, to avoid removing and adding it again
+     * when the BSS is at the edge of the range and comes and goes. */
+    nm_wifi_ap_set_fake(ap, TRUE);
+
+    if (!priv->aps_removing_hash)
+        priv->aps_removing_hash = g_hash_table_new(nm_direct_hash, NULL);
+
+    g_hash_table_insert(
+        priv->aps_removing_hash,
+        ap,
+        GINT_TO_POINTER(nm_utils_get_monotonic_timestamp_sec() + AP_REMOVAL_GRACE_SEC));
+
+    _ap_dump(self, LOGL_DEBUG, ap, "gone", 0);
+
+    if (!priv->aps_removing_source) {
+        priv->aps_removing_source =
+            nm_g_source_attach(nm_g_timeout_source_new_seconds(AP_REMOVAL_GRACE_SEC,
+                                                               G_PRIORITY_DEFAULT,
+                                                               _ap_removal_timeout_cb,
+                                                               self,
+                                                               NULL),
+                               NULL);
+    }
+}
+
+static NMWifiAP *
+_ap_removing_find(NMDeviceWifi *self, const NMSupplicantBssInfo *bss_info)
+{
+    NMDeviceWifiPrivate *priv = NM_DEVICE_WIFI_GET_PRIVATE(self);
+    GHashTableIter       iter;
+    NMWifiAP *           ap;
+
+    if (!priv->aps_removing_hash || !bss_info->bssid_valid)
+        return NULL;
+
+    g_hash_table_iter_init(&iter, priv->aps_removing_hash);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &ap, NULL)) {
+        if (nm_wifi_ap_get_mode(ap) != bss_info->mode)
+            continue;
+        if (!nm_gbytes_equal0(nm_wifi_ap_get_ssid(ap), bss_info->ssid))
+            continue;
+        if (!nm_utils_hwaddr_matches(nm_wifi_ap_get_address(ap),
+                                     -1,
+                                     &bss_info->bssid,
+                                     sizeof(bss_info->bssid)))
+            continue;
+        return ap;
+    }
+    return NULL;
+}
+
 static void
 remove_all_aps(NMDeviceWifi *self)
 {
@@ -836,8 +1037,10 @@ remove_all_aps(NMDeviceWifi *self)
 
     set_current_ap(self, NULL, FALSE);
 
+    _ap_batch_begin(self);
     while ((ap = c_list_first_entry(&priv->aps_lst_head, NMWifiAP, aps_lst)))
         ap_add_remove(self, FALSE, ap, FALSE);
+    _ap_batch_end(self);
 
     nm_device_recheck_available_connections(NM_DEVICE(self));
 }
@@ -1866,7 +2069,9 @@ ap_list_dump(gpointer user_data)
         char      str_buf[100];
 
         _LOGD(LOGD_WIFI_SCAN,
-              "APs: [now:%u.%03u, last:%s]",
+              "APs: [now:%u.%03u, last:%s, added:%" G_GUINT64_FORMAT ", removed:%" G_GUINT64_FORMAT
+              ", reused:%" G_GUINT64_FORMAT ", notified:%" G_GUINT64_FORMAT
+              ", strength-suppressed:%" G_GUINT64_FORMAT "]",
               (guint)(now_msec / NM_UTILS_MSEC_PER_SEC),
               (guint)(now_msec % NM_UTILS_MSEC_PER_SEC),
               priv->scan_last_complete_msec > 0
@@ -1874,7 +2079,12 @@ ap_list_dump(gpointer user_data)
                                    "%u.%03u",
                                    (guint)(priv->scan_last_complete_msec / NM_UTILS_MSEC_PER_SEC),
                                    (guint)(priv->scan_last_complete_msec % NM_UTILS_MSEC_PER_SEC))
-                  : "-1");
+                  : "-1",
+              priv->ap_stats.added,
+              priv->ap_stats.removed,
+              priv->ap_stats.reused,
+              priv->ap_stats.notified,
+              nm_wifi_ap_get_strength_suppressed_count());
         c_list_for_each_entry (ap, &priv->aps_lst_head, aps_lst)
             _ap_dump(self, LOGL_DEBUG, ap, "dump", now_msec);
     }
@@ -1921,11 +2131,8 @@ try_fill_ssid_for_hidden_ap(NMDeviceWifi *self, NMWifiAP *ap)
     }
 }
 
-static void
-supplicant_iface_bss_changed_cb(NMSupplicantInterface *iface,
-                                NMSupplicantBssInfo *  bss_info,
-                                gboolean               is_present,
-                                NMDeviceWifi *         self)
+static gboolean
+_bss_update_ap(NMDeviceWifi *self, NMSupplicantBssInfo *bss_info)
 {
     NMDeviceWifiPrivate *priv = NM_DEVICE_WIFI_GET_PRIVATE(self);
     NMWifiAP *           found_ap;
@@ -1933,28 +2140,23 @@ supplicant_iface_bss_changed_cb(NMSupplicantInterface *iface,
 
     found_ap = g_hash_table_lookup(priv->aps_idx_by_supplicant_path, bss_info->bss_path);
 
-    if (!is_present) {
-        if (!found_ap)
-            return;
-        if (found_ap == priv->current_ap) {
-            /* The current AP cannot be removed (to prevent NM indicating that
-             * it is connected, but to nothing), but it must be removed later
-             * when the current AP is changed or cleared.  Set 'fake' to
-             * indicate that this AP is now unknown to the supplicant.
-             */
-            if (nm_wifi_ap_set_fake(found_ap, TRUE))
-                _ap_dump(self, LOGL_DEBUG, found_ap, "updated", 0);
-        } else {
-            ap_add_remove(self, FALSE, found_ap, TRUE);
-            schedule_ap_list_dump(self);
-        }
-        return;
-    }
-
     if (found_ap) {
         if (!nm_wifi_ap_update_from_properties(found_ap, bss_info))
-            return;
+            return FALSE;
         _ap_dump(self, LOGL_DEBUG, found_ap, "updated", 0);
+    } else if ((found_ap = _ap_removing_find(self, bss_info))) {
+        /* The BSS reappeared with a new supplicant path. Reuse the AP. */
+        g_hash_table_remove(priv->aps_removing_hash, found_ap);
+        if (!g_hash_table_remove(priv->aps_idx_by_supplicant_path,
+                                 nm_wifi_ap_get_supplicant_path(found_ap)))
+            nm_assert_not_reached();
+        nm_wifi_ap_update_from_properties(found_ap, bss_info);
+        if (!g_hash_table_insert(priv->aps_idx_by_supplicant_path,
+                                 nm_wifi_ap_get_supplicant_path(found_ap),
+                                 found_ap))
+            nm_assert_not_reached();
+        priv->ap_stats.reused++;
+        _ap_dump(self, LOGL_DEBUG, found_ap, "reused", 0);
     } else {
         gs_unref_object NMWifiAP *ap = NULL;
 
@@ -1962,7 +2164,7 @@ supplicant_iface_bss_changed_cb(NMSupplicantInterface *iface,
             /* We failed to initialize the info about the AP. This can
              * happen due to an error in the D-Bus communication. In this case
              * we ignore the info. */
-            return;
+            return FALSE;
         }
 
         ap = nm_wifi_ap_new_from_properties(bss_info);
@@ -1991,15 +2193,117 @@ supplicant_iface_bss_changed_cb(NMSupplicantInterface *iface,
         ap_add_remove(self, TRUE, ap, TRUE);
     }
 
+    return TRUE;
+}
+
+static void
+_bss_pending_flush(NMDeviceWifi *self)
+{
+    NMDeviceWifiPrivate *          priv             = NM_DEVICE_WIFI_GET_PRIVATE(self);
+    gs_unref_hashtable GHashTable *bss_pending_hash = NULL;
+    GHashTableIter                 iter;
+    NMRefString *                  bss_path;
+    NMRefString *                  current_bss;
+    NMSupplicantBssInfo *          bss_info;
+    gboolean                       current_bss_updated = FALSE;
+    guint                          n_updated           = 0;
+
+    nm_clear_g_source_inst(&priv->bss_pending_source);
+
+    bss_pending_hash = g_steal_pointer(&priv->bss_pending_hash);
+    if (!bss_pending_hash || !priv->sup_iface)
+        return;
+
+    current_bss = nm_supplicant_interface_get_current_bss(priv->sup_iface);
+
+    _ap_batch_begin(self);
+    g_hash_table_iter_init(&iter, bss_pending_hash);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &bss_path, NULL)) {
+        bss_info = nm_supplicant_interface_get_bss_info(priv->sup_iface, bss_path);
+        if (!bss_info) {
+            /* the BSS is already gone. */
+            continue;
+        }
+        if (!_bss_update_ap(self, bss_info))
+            continue;
+        n_updated++;
+        if (bss_path == current_bss)
+            current_bss_updated = TRUE;
+    }
+    _ap_batch_end(self);
+
+    _LOGT(LOGD_WIFI_SCAN,
+          "wifi-scan: applied %u of %u pending BSS updates",
+          n_updated,
+          g_hash_table_size(bss_pending_hash));
+
+    if (n_updated == 0)
+        return;
+
     /* Update the current AP if the supplicant notified a current BSS change
      * before it sent the current BSS's scan result.
      */
-    if (nm_supplicant_interface_get_current_bss(iface) == bss_info->bss_path)
+    if (current_bss_updated)
         supplicant_iface_notify_current_bss(priv->sup_iface, NULL, self);
 
     schedule_ap_list_dump(self);
 }
 
+static gboolean
+_bss_pending_flush_cb(gpointer user_data)
+{
+    _bss_pending_flush(user_data);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+supplicant_iface_bss_changed_cb(NMSupplicantInterface *iface,
+                                NMSupplicantBssInfo *  bss_info,
+                                gboolean               is_present,
+                                NMDeviceWifi *         self)
+{
+    NMDeviceWifiPrivate *priv = NM_DEVICE_WIFI_GET_PRIVATE(self);
+    NMWifiAP *           found_ap;
+
+    if (!is_present) {
+        if (priv->bss_pending_hash)
+            g_hash_table_remove(priv->bss_pending_hash, bss_info->bss_path);
+
+        found_ap = g_hash_table_lookup(priv->aps_idx_by_supplicant_path, bss_info->bss_path);
+        if (!found_ap)
+            return;
+        if (found_ap == priv->current_ap) {
+            /* The current AP cannot be removed (to prevent NM indicating that
+             * it is connected, but to nothing), but it must be removed later
+             * when the current AP is changed or cleared.  Set 'fake' to
+             * indicate that this AP is now unknown to the supplicant.
+             */
+            if (nm_wifi_ap_set_fake(found_ap, TRUE))
+                _ap_dump(self, LOGL_DEBUG, found_ap, "updated", 0);
+        } else
+            _ap_removal_schedule(self, found_ap);
+        return;
+    }
+
+    /* During a scan, the supplicant reports each BSS separately, often
+     * several times. Collect the updates and apply them together once
+     * the scan completes (see _scan_notify_is_scanning()), or on idle
+     * when we are not scanning. */
+    if (!priv->bss_pending_hash) {
+        priv->bss_pending_hash = g_hash_table_new_full(nm_direct_hash,
+                                                       NULL,
+                                                       (GDestroyNotify) nm_ref_string_unref,
+                                                       NULL);
+    }
+    g_hash_table_add(priv->bss_pending_hash, nm_ref_string_ref(bss_info->bss_path));
+
+    if (!priv->scan_is_scanning && !priv->bss_pending_source) {
+        priv->bss_pending_source = nm_g_source_attach(
+            nm_g_idle_source_new(G_PRIORITY_DEFAULT_IDLE, _bss_pending_flush_cb, self, NULL),
+            NULL);
+    }
+}
+
 static void
 cleanup_association_attempt(NMDeviceWifi *self, gboolean disconnect)
 {
@@ -3727,6 +4031,9 @@ dispose(GObject *object)
 
     remove_all_aps(self);
 
+    nm_clear_g_source_inst(&priv->aps_removing_source);
+    nm_clear_pointer(&priv->aps_removing_hash, g_hash_table_unref);
+
     if (priv->p2p_device) {
         /* Destroy the P2P device. */
         g_object_remove_weak_pointer(G_OBJECT(priv->p2p_device), (gpointer *) &priv->p2p_device);
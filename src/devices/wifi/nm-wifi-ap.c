@@ -39,6 +39,16 @@ NM_GOBJECT_PROPERTIES_DEFINE(NMWifiAP,
                              PROP_STRENGTH,
                              PROP_LAST_SEEN, );
 
+/* Scan results report the signal strength with some jitter. Don't
+ * update the strength for changes smaller than STRENGTH_HYSTERESIS percent,
+ * and not more often than every STRENGTH_THROTTLE_MSEC, unless the strength
+ * changed by at least STRENGTH_LARGE_CHANGE percent. */
+#define STRENGTH_HYSTERESIS    5
+#define STRENGTH_LARGE_CHANGE  20
+#define STRENGTH_THROTTLE_MSEC (10 * NM_UTILS_MSEC_PER_SEC)
+
+static guint64 _strength_suppressed_count;
+
 struct _NMWifiAPPrivate {
     /* Scanned or cached values */
     GBytes *    ssid;
@@ -48,6 +58,8 @@ struct _NMWifiAPPrivate {
     guint32     freq;        /* Frequency in MHz; ie 2412 (== 2.412 GHz) */
     guint32     max_bitrate; /* Maximum bitrate of the AP in Kbit/s (ie 54000 Kb/s == 54Mbit/s) */
 
+    gint64 strength_changed_msec;
+
     gint64
         last_seen_msec; /* Timestamp when the AP was seen lastly (in nm_utils_get_monotonic_timestamp_*() scale).
                          * Note that this value might be negative! */
@@ -247,6 +259,41 @@ nm_wifi_ap_set_strength(NMWifiAP *ap, gint8 strength)
     return FALSE;
 }
 
+static gboolean
+_set_strength_throttled(NMWifiAP *ap, guint8 strength, gint64 *now_msec)
+{
+    NMWifiAPPrivate *priv = NM_WIFI_AP_GET_PRIVATE(ap);
+    int              delta;
+
+    delta = ABS(((int) strength) - ((int) priv->strength));
+    if (delta == 0)
+        return FALSE;
+
+    if (priv->strength_changed_msec != 0 && delta < STRENGTH_LARGE_CHANGE) {
+        if (delta < STRENGTH_HYSTERESIS
+            || nm_utils_get_monotonic_timestamp_msec_cached(now_msec) - priv->strength_changed_msec
+                   < STRENGTH_THROTTLE_MSEC) {
+            _strength_suppressed_count++;
+            return FALSE;
+        }
+    }
+
+    priv->strength_changed_msec = nm_utils_get_monotonic_timestamp_msec_cached(now_msec);
+    return nm_wifi_ap_set_strength(ap, strength);
+}
+
+/**
+ * nm_wifi_ap_get_strength_suppressed_count:
+ *
+ * Returns: how many strength updates from scan results were
+ *   dropped so far, by all access points.
+ */
+guint64
+nm_wifi_ap_get_strength_suppressed_count(void)
+{
+    return _strength_suppressed_count;
+}
+
 guint32
 nm_wifi_ap_get_freq(NMWifiAP *ap)
 {
@@ -363,7 +410,8 @@ gboolean
 nm_wifi_ap_update_from_properties(NMWifiAP *ap, const NMSupplicantBssInfo *bss_info)
 {
     NMWifiAPPrivate *priv;
-    gboolean         changed = FALSE;
+    gboolean         changed  = FALSE;
+    gint64           now_msec = 0;
 
     g_return_val_if_fail(NM_IS_WIFI_AP(ap), FALSE);
     g_return_val_if_fail(bss_info, FALSE);
@@ -371,18 +419,19 @@ nm_wifi_ap_update_from_properties(NMWifiAP *ap, const NMSupplicantBssInfo *bss_i
 
     priv = NM_WIFI_AP_GET_PRIVATE(ap);
 
-    nm_assert(!ap->_supplicant_path || ap->_supplicant_path == bss_info->bss_path);
-
     g_object_freeze_notify(G_OBJECT(ap));
 
-    if (!ap->_supplicant_path) {
+    if (ap->_supplicant_path != bss_info->bss_path) {
+        /* the supplicant path only changes when the AP is reused for a BSS
+         * that reappeared. The caller must update its index. */
+        nm_ref_string_unref(ap->_supplicant_path);
         ap->_supplicant_path = nm_ref_string_ref(bss_info->bss_path);
         changed              = TRUE;
     }
 
     changed |= nm_wifi_ap_set_flags(ap, bss_info->ap_flags);
     changed |= nm_wifi_ap_set_mode(ap, bss_info->mode);
-    changed |= nm_wifi_ap_set_strength(ap, bss_info->signal_percent);
+    changed |= _set_strength_throttled(ap, bss_info->signal_percent, &now_msec);
     changed |= nm_wifi_ap_set_freq(ap, bss_info->frequency);
     changed |= nm_wifi_ap_set_ssid(ap, bss_info->ssid);
 
@@ -0,0 +1,1878 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright (C) 2020 Red Hat, Inc.
+ */
+
+#include "nm-default.h"
+
+#include "nm-dns-internal.h"
+
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "nm-std-aux/unaligned.h"
+#include "nm-glib-aux/nm-random-utils.h"
+#include "nm-core-internal.h"
+#include "nm-ip4-config.h"
+#include "nm-ip6-config.h"
+#include "NetworkManagerUtils.h"
+
+/* NMDnsInternal is a small caching DNS forwarder that runs inside the
+ * daemon. It listens on 127.0.0.1:53 (UDP and TCP) and forwards each query
+ * to the upstream servers of the most specific matching DNS domain. Answers
+ * are cached in memory according to their TTL.
+ *
+ * Each query over UDP gets its own connected socket, so that the kernel
+ * picks a random ephemeral source port for it and drops datagrams that don't
+ * come from the upstream server. Together with the random ID, that makes
+ * forged answers hard to guess. Queries to the same upstream server share
+ * one TCP connection, if needed, and are told apart by the ID.
+ *
+ * A new configuration only replaces the table of upstream servers, there
+ * is nothing to restart. Queries that are already in flight finish with
+ * the servers that they started with. */
+
+/*****************************************************************************/
+
+#define DNS_PORT         53
+#define DNS_HEADER_SIZE  12
+#define DNS_UDP_SIZE_MIN 512
+#define DNS_MSG_SIZE_MAX 65535
+
+#define DNS_TYPE_OPT 41
+
+#define DNS_FLAG_QR     0x8000
+#define DNS_FLAG_TC     0x0200
+#define DNS_FLAG_RD     0x0100
+#define DNS_FLAG_RA     0x0080
+#define DNS_OPCODE_MASK 0x7800
+#define DNS_RCODE_MASK  0x000F
+
+#define DNS_RCODE_NOERROR  0
+#define DNS_RCODE_FORMERR  1
+#define DNS_RCODE_SERVFAIL 2
+#define DNS_RCODE_NXDOMAIN 3
+#define DNS_RCODE_REFUSED  5
+
+#define UPSTREAM_TIMEOUT_MSEC 2000
+#define TCP_IDLE_TIMEOUT_MSEC 10000
+#define TCP_CLIENTS_MAX       64
+#define QUERIES_MAX           1024
+#define CACHE_SIZE_MAX        1000
+#define CACHE_TTL_MAX_SEC     3600
+
+#define _NMLOG_DOMAIN LOGD_DNS
+#define _NMLOG(level, ...) \
+    __NMLOG_DEFAULT_WITH_ADDR(level, _NMLOG_DOMAIN, "dns-internal", __VA_ARGS__)
+
+/*****************************************************************************/
+
+typedef struct {
+    union {
+        struct sockaddr     sa;
+        struct sockaddr_in  in;
+        struct sockaddr_in6 in6;
+    };
+    socklen_t len;
+} SockAddr;
+
+typedef struct {
+    char *   domain;
+    SockAddr addr;
+} Server;
+
+typedef struct {
+    int ref_count;
+
+    /* Server */
+    GArray *servers;
+
+    /* domain -> GPtrArray of Server pointers into @servers. */
+    GHashTable *by_domain;
+
+    GPtrArray *wildcard;
+} ServerTable;
+
+typedef struct {
+    CList   lru_lst;
+    GBytes *key;
+    guint8 *answer;
+    gsize   answer_len;
+    gint64  stored_at_msec;
+    gint64  expires_at_msec;
+} CacheEntry;
+
+typedef struct {
+    CList          conn_lst;
+    NMDnsInternal *self;
+    GSource *      source;
+    GSource *      idle_source;
+    GByteArray *   in_buf;
+    GByteArray *   out_buf;
+    SockAddr       addr;
+    int            ref_count;
+    int            fd;
+    guint          n_pending;
+    GIOCondition   source_cond;
+    bool           is_upstream : 1;
+    bool           connecting : 1;
+    bool           closed : 1;
+} TcpConn;
+
+typedef struct {
+    NMDnsInternal *self;
+    ServerTable *  table;
+    GPtrArray *    candidates;
+    GSource *      timeout_source;
+    GBytes *       cache_key;
+
+    /* the query as we send it upstream, with our ID. */
+    guint8 *msg;
+    gsize   msg_len;
+    gsize   question_end;
+
+    /* the client TCP connection, or %NULL for UDP clients. */
+    TcpConn *client_conn;
+    SockAddr client_addr;
+
+    /* the upstream TCP connection while the query is pending on it. */
+    TcpConn *upstream_conn;
+
+    /* the connected UDP socket while the query is pending on it. */
+    GSource *udp_source;
+    int      udp_fd;
+
+    guint   candidate_idx;
+    guint16 upstream_id;
+    guint16 client_id;
+    guint16 client_udp_size;
+    bool    use_tcp : 1;
+} Query;
+
+typedef struct {
+    ServerTable *table;
+
+    /* upstream ID -> Query */
+    GHashTable *queries;
+
+    /* GBytes -> CacheEntry */
+    GHashTable *cache;
+    CList       cache_lru_lst_head;
+
+    CList tcp_conns_lst_head;
+    guint tcp_clients_n;
+
+    guint8 *recv_buf;
+
+    GSource *udp_listen_source;
+    GSource *tcp_listen_source;
+    int      udp_listen_fd;
+    int      tcp_listen_fd;
+
+    int      listen_addr_family;
+    NMIPAddr listen_address;
+    guint16  listen_port;
+} NMDnsInternalPrivate;
+
+struct _NMDnsInternal {
+    NMDnsPlugin          parent;
+    NMDnsInternalPrivate _priv;
+};
+
+struct _NMDnsInternalClass {
+    NMDnsPluginClass parent;
+};
+
+G_DEFINE_TYPE(NMDnsInternal, nm_dns_internal, NM_TYPE_DNS_PLUGIN)
+
+#define NM_DNS_INTERNAL_GET_PRIVATE(self) _NM_GET_PRIVATE(self, NMDnsInternal, NM_IS_DNS_INTERNAL)
+
+/*****************************************************************************/
+
+static void _query_start(Query *query);
+static void _query_next(Query *query);
+static void _upstream_response_received(NMDnsInternal *self,
+                                        guint8 *       msg,
+                                        gsize          len,
+                                        TcpConn *      conn,
+                                        Query *        udp_query);
+static gboolean _udp_upstream_cb(int fd, GIOCondition condition, gpointer user_data);
+static void _client_query_received(NMDnsInternal * self,
+                                   guint8 *        msg,
+                                   gsize           len,
+                                   TcpConn *       conn,
+                                   const SockAddr *from);
+
+/*****************************************************************************/
+
+static void
+_sockaddr_init(SockAddr *addr, int addr_family, gconstpointer address, guint16 port, int ifindex)
+{
+    memset(addr, 0, sizeof(*addr));
+    if (addr_family == AF_INET) {
+        addr->in.sin_family = AF_INET;
+        addr->in.sin_port   = htons(port);
+        memcpy(&addr->in.sin_addr, address, sizeof(struct in_addr));
+        addr->len = sizeof(struct sockaddr_in);
+    } else {
+        addr->in6.sin6_family = AF_INET6;
+        addr->in6.sin6_port   = htons(port);
+        memcpy(&addr->in6.sin6_addr, address, sizeof(struct in6_addr));
+        if (IN6_IS_ADDR_LINKLOCAL(&addr->in6.sin6_addr))
+            addr->in6.sin6_scope_id = ifindex;
+        addr->len = sizeof(struct sockaddr_in6);
+    }
+}
+
+static gboolean
+_sockaddr_equal(const SockAddr *a, const SockAddr *b)
+{
+    if (a->sa.sa_family != b->sa.sa_family)
+        return FALSE;
+    if (a->sa.sa_family == AF_INET) {
+        return a->in.sin_port == b->in.sin_port
+               && a->in.sin_addr.s_addr == b->in.sin_addr.s_addr;
+    }
+    return a->in6.sin6_port == b->in6.sin6_port
+           && IN6_ARE_ADDR_EQUAL(&a->in6.sin6_addr, &b->in6.sin6_addr)
+           && a->in6.sin6_scope_id == b->in6.sin6_scope_id;
+}
+
+static const char *
+_sockaddr_to_string(const SockAddr *addr, char *buf, gsize len)
+{
+    char sbuf[NM_UTILS_INET_ADDRSTRLEN];
+
+    if (addr->sa.sa_family == AF_INET) {
+        g_snprintf(buf,
+                   len,
+                   "%s:%u",
+                   _nm_utils_inet4_ntop(addr->in.sin_addr.s_addr, sbuf),
+                   (guint) ntohs(addr->in.sin_port));
+    } else {
+        g_snprintf(buf,
+                   len,
+                   "[%s]:%u",
+                   _nm_utils_inet6_ntop(&addr->in6.sin6_addr, sbuf),
+                   (guint) ntohs(addr->in6.sin6_port));
+    }
+    return buf;
+}
+
+/*****************************************************************************/
+
+static gboolean
+_dns_skip_name(const guint8 *msg, gsize len, gsize *p_offset)
+{
+    gsize offset = *p_offset;
+
+    while (TRUE) {
+        guint8 label_len;
+
+        if (offset >= len)
+            return FALSE;
+
+        label_len = msg[offset];
+        if ((label_len & 0xC0) == 0xC0) {
+            /* a compression pointer ends the name. */
+            if (offset + 2 > len)
+                return FALSE;
+            *p_offset = offset + 2;
+            return TRUE;
+        }
+        if (label_len & 0xC0)
+            return FALSE;
+
+        offset++;
+        if (label_len == 0) {
+            *p_offset = offset;
+            return TRUE;
+        }
+        offset += label_len;
+    }
+}
+
+static gboolean
+_dns_parse_qname(const guint8 *msg, gsize len, gsize *p_offset, char *out_name, gsize out_len)
+{
+    gsize offset = *p_offset;
+    gsize n      = 0;
+
+    while (TRUE) {
+        guint8 label_len;
+        guint8 i;
+
+        if (offset >= len)
+            return FALSE;
+
+        label_len = msg[offset++];
+        if (label_len == 0)
+            break;
+
+        /* queries don't use name compression. */
+        if (label_len & 0xC0)
+            return FALSE;
+        if (offset + label_len > len)
+            return FALSE;
+        if (n + label_len + 2 > out_len)
+            return FALSE;
+
+        if (n > 0)
+            out_name[n++] = '.';
+        for (i = 0; i < label_len; i++) {
+            char ch = msg[offset + i];
+
+            if (NM_IN_SET(ch, '.', '\0'))
+                return FALSE;
+            out_name[n++] = g_ascii_tolower(ch);
+        }
+        offset += label_len;
+    }
+
+    out_name[n] = '\0';
+    *p_offset   = offset;
+    return TRUE;
+}
+
+typedef struct {
+    gsize   question_end;
+    guint16 udp_size;
+    char    qname[256];
+} DnsQueryInfo;
+
+static gboolean
+_dns_parse_query(const guint8 *msg, gsize len, DnsQueryInfo *info)
+{
+    gsize   offset = DNS_HEADER_SIZE;
+    guint16 flags;
+    guint   arcount;
+    guint   i;
+
+    if (len < DNS_HEADER_SIZE)
+        return FALSE;
+
+    flags = unaligned_read_be16(&msg[2]);
+    if (flags & (DNS_FLAG_QR | DNS_OPCODE_MASK)) {
+        /* only standard queries are supported. */
+        return FALSE;
+    }
+    if (unaligned_read_be16(&msg[4]) != 1 || unaligned_read_be16(&msg[6]) != 0
+        || unaligned_read_be16(&msg[8]) != 0)
+        return FALSE;
+
+    if (!_dns_parse_qname(msg, len, &offset, info->qname, sizeof(info->qname)))
+        return FALSE;
+    if (offset + 4 > len)
+        return FALSE;
+    offset += 4;
+
+    info->question_end = offset;
+    info->udp_size     = DNS_UDP_SIZE_MIN;
+
+    arcount = unaligned_read_be16(&msg[10]);
+    for (i = 0; i < arcount; i++) {
+        guint16 type;
+        guint16 klass;
+        guint16 rdlen;
+
+        if (!_dns_skip_name(msg, len, &offset))
+            return FALSE;
+        if (offset + 10 > len)
+            return FALSE;
+
+        type  = unaligned_read_be16(&msg[offset]);
+        klass = unaligned_read_be16(&msg[offset + 2]);
+        rdlen = unaligned_read_be16(&msg[offset + 8]);
+        offset += 10;
+        if (offset + rdlen > len)
+            return FALSE;
+        offset += rdlen;
+
+        /* for the OPT pseudo-record, the class is the UDP payload size
+         * that the client accepts. */
+        if (type == DNS_TYPE_OPT)
+            info->udp_size = MAX(klass, DNS_UDP_SIZE_MIN);
+    }
+
+    return TRUE;
+}
+
+/* Walks all resource records of a response and returns the smallest TTL.
+ * If @age is positive, the TTLs are decremented by that many seconds. The OPT
+ * pseudo-record has no TTL and is skipped. If the message has no records,
+ * the returned TTL is G_MAXUINT32. */
+static gboolean
+_dns_response_ttls(guint8 *msg, gsize len, guint32 age, guint32 *out_min_ttl)
+{
+    gsize   offset  = DNS_HEADER_SIZE;
+    guint32 min_ttl = G_MAXUINT32;
+    guint   qdcount;
+    guint   n_rrs;
+    guint   i;
+
+    if (len < DNS_HEADER_SIZE)
+        return FALSE;
+
+    qdcount = unaligned_read_be16(&msg[4]);
+    n_rrs   = unaligned_read_be16(&msg[6]) + unaligned_read_be16(&msg[8])
+            + unaligned_read_be16(&msg[10]);
+
+    for (i = 0; i < qdcount; i++) {
+        if (!_dns_skip_name(msg, len, &offset))
+            return FALSE;
+        if (offset + 4 > len)
+            return FALSE;
+        offset += 4;
+    }
+
+    for (i = 0; i < n_rrs; i++) {
+        guint16 type;
+        guint16 rdlen;
+        guint32 ttl;
+
+        if (!_dns_skip_name(msg, len, &offset))
+            return FALSE;
+        if (offset + 10 > len)
+            return FALSE;
+
+        type  = unaligned_read_be16(&msg[offset]);
+        ttl   = unaligned_read_be32(&msg[offset + 4]);
+        rdlen = unaligned_read_be16(&msg[offset + 8]);
+        if (offset + 10 + rdlen > len)
+            return FALSE;
+
+        if (type != DNS_TYPE_OPT) {
+            /* RFC 2181, section 8: a TTL with the most significant bit set
+             * is treated as zero. */
+            if (ttl > G_MAXINT32)
+                ttl = 0;
+            if (age > 0) {
+                ttl = ttl > age ? ttl - age : 0;
+                unaligned_write_be32(&msg[offset + 4], ttl);
+            }
+            min_ttl = MIN(min_ttl, ttl);
+        }
+
+        offset += 10 + rdlen;
+    }
+
+    NM_SET_OUT(out_min_ttl, min_ttl);
+    return TRUE;
+}
+
+/* Turns the response in @msg into a truncated response that only contains
+ * the header and the question. Returns the new length. */
+static gsize
+_dns_truncate(guint8 *msg, gsize len)
+{
+    gsize offset = DNS_HEADER_SIZE;
+    guint qdcount;
+    guint i;
+
+    nm_assert(len >= DNS_HEADER_SIZE);
+
+    qdcount = unaligned_read_be16(&msg[4]);
+    for (i = 0; i < qdcount; i++) {
+        if (!_dns_skip_name(msg, len, &offset) || offset + 4 > len) {
+            offset = DNS_HEADER_SIZE;
+            unaligned_write_be16(&msg[4], 0);
+            break;
+        }
+        offset += 4;
+    }
+
+    unaligned_write_be16(&msg[2], unaligned_read_be16(&msg[2]) | DNS_FLAG_TC);
+    unaligned_write_be16(&msg[6], 0);
+    unaligned_write_be16(&msg[8], 0);
+    unaligned_write_be16(&msg[10], 0);
+    return offset;
+}
+
+/* Turns the query in @msg into an error response with @rcode. The
+ * question is kept, everything else is dropped. Returns the new length. */
+static gsize
+_dns_make_error(guint8 *msg, gsize len, gsize question_end, guint rcode)
+{
+    guint16 flags;
+
+    nm_assert(len >= DNS_HEADER_SIZE);
+
+    flags = unaligned_read_be16(&msg[2]);
+    flags = (flags & (DNS_OPCODE_MASK | DNS_FLAG_RD)) | DNS_FLAG_QR | DNS_FLAG_RA | rcode;
+    unaligned_write_be16(&msg[2], flags);
+    unaligned_write_be16(&msg[6], 0);
+    unaligned_write_be16(&msg[8], 0);
+    unaligned_write_be16(&msg[10], 0);
+
+    if (question_end < DNS_HEADER_SIZE || question_end > len) {
+        unaligned_write_be16(&msg[4], 0);
+        return DNS_HEADER_SIZE;
+    }
+    return question_end;
+}
+
+/*****************************************************************************/
+
+static char *
+_domain_normalize(const char *domain)
+{
+    gsize len;
+
+    while (domain[0] == '.')
+        domain++;
+    len = strlen(domain);
+    while (len > 0 && domain[len - 1] == '.')
+        len--;
+    if (len == 0)
+        return NULL;
+    return g_ascii_strdown(domain, len);
+}
+
+static ServerTable *
+_server_table_new(const NMDnsInternalServer *servers, guint n_servers)
+{
+    ServerTable *table;
+    guint        i;
+
+    table  = g_slice_new(ServerTable);
+    *table = (ServerTable){
+        .ref_count = 1,
+        .servers   = g_array_sized_new(FALSE, TRUE, sizeof(Server), n_servers),
+        .by_domain = g_hash_table_new_full(nm_str_hash,
+                                           g_str_equal,
+                                           NULL,
+                                           (GDestroyNotify) g_ptr_array_unref),
+        .wildcard  = g_ptr_array_new(),
+    };
+
+    for (i = 0; i < n_servers; i++) {
+        const NMDnsInternalServer *s = &servers[i];
+        Server                     server;
+
+        if (!NM_IN_SET(s->addr_family, AF_INET, AF_INET6))
+            continue;
+
+        server.domain = s->domain ? _domain_normalize(s->domain) : NULL;
+        _sockaddr_init(&server.addr,
+                       s->addr_family,
+                       &s->address,
+                       s->port ?: DNS_PORT,
+                       s->ifindex);
+        g_array_append_val(table->servers, server);
+    }
+
+    /* Now that the array no longer grows, index the servers by domain. */
+    for (i = 0; i < table->servers->len; i++) {
+        Server *   server = &g_array_index(table->servers, Server, i);
+        GPtrArray *arr;
+
+        if (!server->domain) {
+            g_ptr_array_add(table->wildcard, server);
+            continue;
+        }
+
+        arr = g_hash_table_lookup(table->by_domain, server->domain);
+        if (!arr) {
+            arr = g_ptr_array_new();
+            g_hash_table_insert(table->by_domain, server->domain, arr);
+        }
+        g_ptr_array_add(arr, server);
+    }
+
+    return table;
+}
+
+static ServerTable *
+_server_table_ref(ServerTable *table)
+{
+    nm_assert(table && table->ref_count > 0);
+
+    table->ref_count++;
+    return table;
+}
+
+static void
+_server_table_unref(ServerTable *table)
+{
+    guint i;
+
+    nm_assert(table && table->ref_count > 0);
+
+    if (--table->ref_count > 0)
+        return;
+
+    g_hash_table_unref(table->by_domain);
+    g_ptr_array_unref(table->wildcard);
+    for (i = 0; i < table->servers->len; i++)
+        g_free(g_array_index(table->servers, Server, i).domain);
+    g_array_unref(table->servers);
+    nm_g_slice_free(table);
+}
+
+static gboolean
+_server_table_equal(const ServerTable *a, const ServerTable *b)
+{
+    guint i;
+
+    if (!a || !b)
+        return a == b;
+
+    if (a->servers->len != b->servers->len)
+        return FALSE;
+
+    for (i = 0; i < a->servers->len; i++) {
+        const Server *server_a = &g_array_index(a->servers, Server, i);
+        const Server *server_b = &g_array_index(b->servers, Server, i);
+
+        if (!nm_streq0(server_a->domain, server_b->domain)
+            || !_sockaddr_equal(&server_a->addr, &server_b->addr))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static GPtrArray *
+_server_table_lookup(const ServerTable *table, const char *qname)
+{
+    const char *name = qname;
+
+    /* the most specific domain wins. */
+    while (name[0]) {
+        GPtrArray *arr;
+
+        arr = g_hash_table_lookup(table->by_domain, name);
+        if (arr)
+            return arr;
+
+        name = strchr(name, '.');
+        if (!name)
+            break;
+        name++;
+    }
+    return table->wildcard;
+}
+
+/*****************************************************************************/
+
+static void
+_cache_entry_free(gpointer data)
+{
+    CacheEntry *entry = data;
+
+    c_list_unlink_stale(&entry->lru_lst);
+    g_bytes_unref(entry->key);
+    g_free(entry->answer);
+    nm_g_slice_free(entry);
+}
+
+static void
+_cache_add(NMDnsInternal *self, GBytes *key, guint8 *msg, gsize len)
+{
+    NMDnsInternalPrivate *priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+    CacheEntry *          entry;
+    guint32               ttl;
+    gint64                now_msec;
+
+    if (!_dns_response_ttls(msg, len, 0, &ttl))
+        return;
+
+    /* without records (or with zero TTL) there is nothing to cache. */
+    if (ttl == G_MAXUINT32 || ttl == 0)
+        return;
+    ttl = MIN(ttl, (guint32) CACHE_TTL_MAX_SEC);
+
+    g_hash_table_remove(priv->cache, key);
+
+    while (g_hash_table_size(priv->cache) >= CACHE_SIZE_MAX) {
+        CacheEntry *oldest;
+
+        oldest = c_list_last_entry(&priv->cache_lru_lst_head, CacheEntry, lru_lst);
+        g_hash_table_remove(priv->cache, oldest->key);
+    }
+
+    now_msec = nm_utils_get_monotonic_timestamp_msec();
+
+    entry  = g_slice_new(CacheEntry);
+    *entry = (CacheEntry){
+        .key             = g_bytes_ref(key),
+        .answer          = nm_memdup(msg, len),
+        .answer_len      = len,
+        .stored_at_msec  = now_msec,
+        .expires_at_msec = now_msec + ((gint64) ttl) * 1000,
+    };
+    c_list_link_front(&priv->cache_lru_lst_head, &entry->lru_lst);
+    g_hash_table_insert(priv->cache, entry->key, entry);
+}
+
+static void
+_cache_flush(NMDnsInternal *self)
+{
+    NMDnsInternalPrivate *priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+
+    g_hash_table_remove_all(priv->cache);
+    nm_assert(c_list_is_empty(&priv->cache_lru_lst_head));
+}
+
+/*****************************************************************************/
+
+static void
+_tcp_conn_unref(TcpConn *conn)
+{
+    nm_assert(conn && conn->ref_count > 0);
+
+    if (--conn->ref_count > 0)
+        return;
+
+    nm_assert(conn->closed);
+    nm_assert(!conn->source);
+    nm_assert(!conn->idle_source);
+
+    g_byte_array_unref(conn->in_buf);
+    g_byte_array_unref(conn->out_buf);
+    nm_g_slice_free(conn);
+}
+
+static TcpConn *
+_tcp_conn_ref(TcpConn *conn)
+{
+    nm_assert(conn && conn->ref_count > 0);
+
+    conn->ref_count++;
+    return conn;
+}
+
+static void
+_tcp_conn_close(TcpConn *conn)
+{
+    NMDnsInternal *        self = conn->self;
+    NMDnsInternalPrivate * priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+    gs_unref_ptrarray GPtrArray *orphans = NULL;
+
+    if (conn->closed)
+        return;
+
+    conn->closed = TRUE;
+    nm_clear_g_source_inst(&conn->source);
+    nm_clear_g_source_inst(&conn->idle_source);
+    nm_close(conn->fd);
+    conn->fd = -1;
+    c_list_unlink(&conn->conn_lst);
+
+    if (conn->is_upstream) {
+        GHashTableIter iter;
+        Query *        query;
+
+        /* the queries that were pending on this connection move on
+         * to the next server. */
+        g_hash_table_iter_init(&iter, priv->queries);
+        while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &query)) {
+            if (query->upstream_conn == conn) {
+                if (!orphans)
+                    orphans = g_ptr_array_new();
+                g_ptr_array_add(orphans, query);
+            }
+        }
+    } else {
+        nm_assert(priv->tcp_clients_n > 0);
+        priv->tcp_clients_n--;
+    }
+
+    if (orphans) {
+        guint i;
+
+        for (i = 0; i < orphans->len; i++)
+            _query_next(orphans->pdata[i]);
+    }
+
+    _tcp_conn_unref(conn);
+}
+
+static gboolean
+_tcp_conn_idle_cb(gpointer user_data)
+{
+    TcpConn *conn = user_data;
+
+    nm_clear_g_source_inst(&conn->idle_source);
+    _tcp_conn_close(conn);
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+_tcp_conn_idle_update(TcpConn *conn)
+{
+    if (conn->closed || conn->n_pending > 0) {
+        nm_clear_g_source_inst(&conn->idle_source);
+        return;
+    }
+
+    if (!conn->idle_source) {
+        conn->idle_source = nm_g_source_attach(nm_g_timeout_source_new(TCP_IDLE_TIMEOUT_MSEC,
+                                                                       G_PRIORITY_DEFAULT,
+                                                                       _tcp_conn_idle_cb,
+                                                                       conn,
+                                                                       NULL),
+                                               NULL);
+    }
+}
+
+static gboolean _tcp_conn_io_cb(int fd, GIOCondition condition, gpointer user_data);
+
+static void
+_tcp_conn_update_source(TcpConn *conn)
+{
+    GIOCondition cond = G_IO_IN;
+
+    if (conn->closed)
+        return;
+
+    if (conn->connecting || conn->out_buf->len > 0)
+        cond |= G_IO_OUT;
+
+    if (conn->source && conn->source_cond == cond)
+        return;
+
+    nm_clear_g_source_inst(&conn->source);
+    conn->source_cond = cond;
+    conn->source      = nm_g_source_attach(
+        nm_g_unix_fd_source_new(conn->fd, cond, G_PRIORITY_DEFAULT, _tcp_conn_io_cb, conn, NULL),
+        NULL);
+}
+
+static gboolean
+_tcp_conn_flush(TcpConn *conn)
+{
+    if (conn->connecting)
+        return TRUE;
+
+    while (conn->out_buf->len > 0) {
+        ssize_t n;
+
+        n = send(conn->fd, conn->out_buf->data, conn->out_buf->len, MSG_NOSIGNAL);
+        if (n < 0) {
+            int errsv = errno;
+
+            if (errsv == EINTR)
+                continue;
+            if (NM_IN_SET(errsv, EAGAIN, EWOULDBLOCK))
+                return TRUE;
+            return FALSE;
+        }
+        g_byte_array_remove_range(conn->out_buf, 0, n);
+    }
+    return TRUE;
+}
+
+static void
+_tcp_conn_send(TcpConn *conn, const guint8 *msg, gsize len)
+{
+    guint8 len_buf[2];
+
+    nm_assert(len <= DNS_MSG_SIZE_MAX);
+
+    if (conn->closed)
+        return;
+
+    unaligned_write_be16(len_buf, len);
+    g_byte_array_append(conn->out_buf, len_buf, sizeof(len_buf));
+    g_byte_array_append(conn->out_buf, msg, len);
+
+    /* On error, the connection gets closed by _tcp_conn_io_cb(). Closing
+     * it here would fail the pending queries while the caller still uses
+     * them. */
+    _tcp_conn_flush(conn);
+    _tcp_conn_update_source(conn);
+}
+
+/* Reads from the socket and dispatches all complete messages. Returns
+ * FALSE on end of file or error. */
+static gboolean
+_tcp_conn_read(TcpConn *conn)
+{
+    NMDnsInternal *self   = conn->self;
+    gboolean       result = TRUE;
+
+    while (conn->in_buf->len < 2 * (2 + DNS_MSG_SIZE_MAX)) {
+        guint8  buf[4096];
+        ssize_t n;
+
+        n = recv(conn->fd, buf, sizeof(buf), 0);
+        if (n < 0) {
+            int errsv = errno;
+
+            if (errsv == EINTR)
+                continue;
+            if (!NM_IN_SET(errsv, EAGAIN, EWOULDBLOCK))
+                result = FALSE;
+            break;
+        }
+        if (n == 0) {
+            result = FALSE;
+            break;
+        }
+        g_byte_array_append(conn->in_buf, buf, n);
+    }
+
+    while (!conn->closed && conn->in_buf->len >= 2) {
+        gsize msg_len = unaligned_read_be16(conn->in_buf->data);
+
+        if (conn->in_buf->len < 2 + msg_len)
+            break;
+
+        if (conn->is_upstream)
+            _upstream_response_received(self, &conn->in_buf->data[2], msg_len, conn, NULL);
+        else
+            _client_query_received(self, &conn->in_buf->data[2], msg_len, conn, NULL);
+
+        if (!conn->closed)
+            g_byte_array_remove_range(conn->in_buf, 0, 2 + msg_len);
+    }
+
+    return result;
+}
+
+static gboolean
+_tcp_conn_io_cb(int fd, GIOCondition condition, gpointer user_data)
+{
+    TcpConn *conn = _tcp_conn_ref(user_data);
+
+    if (conn->connecting) {
+        int       errsv   = 0;
+        socklen_t errsv_l = sizeof(errsv);
+
+        if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &errsv, &errsv_l) < 0 || errsv != 0) {
+            _tcp_conn_close(conn);
+            goto out;
+        }
+        conn->connecting = FALSE;
+    }
+
+    if (NM_FLAGS_ANY(condition, G_IO_IN | G_IO_HUP | G_IO_ERR)) {
+        if (!_tcp_conn_read(conn)) {
+            _tcp_conn_close(conn);
+            goto out;
+        }
+        if (conn->closed)
+            goto out;
+    }
+
+    if (!_tcp_conn_flush(conn)) {
+        _tcp_conn_close(conn);
+        goto out;
+    }
+
+    _tcp_conn_update_source(conn);
+
+out:
+    _tcp_conn_unref(conn);
+    return G_SOURCE_CONTINUE;
+}
+
+static TcpConn *
+_tcp_conn_new(NMDnsInternal *self, int fd, gboolean is_upstream, gboolean connecting)
+{
+    NMDnsInternalPrivate *priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+    TcpConn *             conn;
+
+    conn  = g_slice_new(TcpConn);
+    *conn = (TcpConn){
+        .self        = self,
+        .fd          = fd,
+        .ref_count   = 1,
+        .in_buf      = g_byte_array_new(),
+        .out_buf     = g_byte_array_new(),
+        .is_upstream = is_upstream,
+        .connecting  = connecting,
+    };
+    c_list_link_tail(&priv->tcp_conns_lst_head, &conn->conn_lst);
+    if (!is_upstream)
+        priv->tcp_clients_n++;
+
+    _tcp_conn_update_source(conn);
+    _tcp_conn_idle_update(conn);
+    return conn;
+}
+
+static TcpConn *
+_tcp_upstream_get(NMDnsInternal *self, const SockAddr *addr)
+{
+    NMDnsInternalPrivate *priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+    TcpConn *             conn;
+    int                   fd;
+
+    c_list_for_each_entry (conn, &priv->tcp_conns_lst_head, conn_lst) {
+        if (conn->is_upstream && _sockaddr_equal(&conn->addr, addr))
+            return conn;
+    }
+
+    fd = socket(addr->sa.sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return NULL;
+
+    if (connect(fd, &addr->sa, addr->len) < 0 && errno != EINPROGRESS) {
+        nm_close(fd);
+        return NULL;
+    }
+
+    conn       = _tcp_conn_new(self, fd, TRUE, TRUE);
+    conn->addr = *addr;
+    return conn;
+}
+
+static void
+_tcp_conn_pending_inc(TcpConn *conn)
+{
+    conn->n_pending++;
+    _tcp_conn_idle_update(conn);
+}
+
+static void
+_tcp_conn_pending_dec(TcpConn *conn)
+{
+    nm_assert(conn->n_pending > 0);
+
+    conn->n_pending--;
+    _tcp_conn_idle_update(conn);
+}
+
+/*****************************************************************************/
+
+static void
+_client_reply(NMDnsInternal * self,
+              TcpConn *       client_conn,
+              const SockAddr *client_addr,
+              guint16         client_udp_size,
+              guint8 *        msg,
+              gsize           len)
+{
+    NMDnsInternalPrivate *priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+
+    if (client_conn) {
+        _tcp_conn_send(client_conn, msg, len);
+        return;
+    }
+
+    if (priv->udp_listen_fd < 0)
+        return;
+
+    if (len > client_udp_size)
+        len = _dns_truncate(msg, len);
+
+    if (sendto(priv->udp_listen_fd,
+               msg,
+               len,
+               MSG_DONTWAIT | MSG_NOSIGNAL,
+               &client_addr->sa,
+               client_addr->len)
+        < 0) {
+        int errsv = errno;
+
+        _LOGT("failed to send reply: %s", nm_strerror_native(errsv));
+    }
+}
+
+static void
+_query_udp_close(Query *query)
+{
+    nm_clear_g_source_inst(&query->udp_source);
+    nm_close(query->udp_fd);
+    query->udp_fd = -1;
+}
+
+static void
+_query_free(Query *query)
+{
+    NMDnsInternal *       self = query->self;
+    NMDnsInternalPrivate *priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+
+    g_hash_table_remove(priv->queries, GUINT_TO_POINTER(query->upstream_id));
+
+    nm_clear_g_source_inst(&query->timeout_source);
+    _query_udp_close(query);
+
+    if (query->upstream_conn) {
+        _tcp_conn_pending_dec(query->upstream_conn);
+        _tcp_conn_unref(query->upstream_conn);
+    }
+    if (query->client_conn) {
+        _tcp_conn_pending_dec(query->client_conn);
+        _tcp_conn_unref(query->client_conn);
+    }
+
+    _server_table_unref(query->table);
+    g_bytes_unref(query->cache_key);
+    g_free(query->msg);
+    nm_g_slice_free(query);
+}
+
+static void
+_query_complete(Query *query, guint8 *msg, gsize len)
+{
+    unaligned_write_be16(msg, query->client_id);
+    _client_reply(query->self,
+                  query->client_conn,
+                  &query->client_addr,
+                  query->client_udp_size,
+                  msg,
+                  len);
+    _query_free(query);
+}
+
+static void
+_query_complete_error(Query *query, guint rcode)
+{
+    gsize len;
+
+    len = _dns_make_error(query->msg, query->msg_len, query->question_end, rcode);
+    _query_complete(query, query->msg, len);
+}
+
+static gboolean
+_query_timeout_cb(gpointer user_data)
+{
+    Query *query = user_data;
+
+    nm_clear_g_source_inst(&query->timeout_source);
+    _query_next(query);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+_query_send(Query *query, const Server *server)
+{
+    NMDnsInternal *self = query->self;
+
+    if (query->use_tcp) {
+        TcpConn *conn;
+
+        conn = _tcp_upstream_get(self, &server->addr);
+        if (!conn)
+            return FALSE;
+
+        query->upstream_conn = _tcp_conn_ref(conn);
+        _tcp_conn_pending_inc(conn);
+        _tcp_conn_send(conn, query->msg, query->msg_len);
+        return TRUE;
+    } else {
+        nm_auto_close int fd = -1;
+
+        /* a fresh socket for each query gets a new, random source port from
+         * the kernel. Connecting it also makes the kernel drop datagrams that
+         * don't come from @server. */
+        fd = socket(server->addr.sa.sa_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return FALSE;
+
+        if (connect(fd, &server->addr.sa, server->addr.len) < 0)
+            return FALSE;
+
+        if (send(fd, query->msg, query->msg_len, MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+            return FALSE;
+
+        query->udp_fd     = nm_steal_fd(&fd);
+        query->udp_source = nm_g_source_attach(nm_g_unix_fd_source_new(query->udp_fd,
+                                                                       G_IO_IN,
+                                                                       G_PRIORITY_DEFAULT,
+                                                                       _udp_upstream_cb,
+                                                                       query,
+                                                                       NULL),
+                                               NULL);
+        return TRUE;
+    }
+}
+
+static void
+_query_start(Query *query)
+{
+    NMDnsInternal *self = query->self;
+
+    nm_clear_g_source_inst(&query->timeout_source);
+
+    while (query->candidate_idx < query->candidates->len) {
+        const Server *server = query->candidates->pdata[query->candidate_idx];
+
+        _query_udp_close(query);
+
+        if (query->upstream_conn) {
+            TcpConn *conn = g_steal_pointer(&query->upstream_conn);
+
+            _tcp_conn_pending_dec(conn);
+            _tcp_conn_unref(conn);
+        }
+
+        if (_query_send(query, server)) {
+            query->timeout_source =
+                nm_g_source_attach(nm_g_timeout_source_new(UPSTREAM_TIMEOUT_MSEC,
+                                                           G_PRIORITY_DEFAULT,
+                                                           _query_timeout_cb,
+                                                           query,
+                                                           NULL),
+                                   NULL);
+            return;
+        }
+
+        if (_LOGT_ENABLED()) {
+            char sbuf[100];
+
+            _LOGT("failed to send query to %s",
+                  _sockaddr_to_string(&server->addr, sbuf, sizeof(sbuf)));
+        }
+
+        query->candidate_idx++;
+        query->use_tcp = !!query->client_conn;
+    }
+
+    _query_complete_error(query, DNS_RCODE_SERVFAIL);
+}
+
+static void
+_query_next(Query *query)
+{
+    query->candidate_idx++;
+    query->use_tcp = !!query->client_conn;
+    _query_start(query);
+}
+
+static guint16
+_query_alloc_id(NMDnsInternal *self)
+{
+    NMDnsInternalPrivate *priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+    guint16               id;
+
+    nm_assert(g_hash_table_size(priv->queries) < QUERIES_MAX);
+
+    do {
+        nm_utils_random_bytes(&id, sizeof(id));
+    } while (g_hash_table_contains(priv->queries, GUINT_TO_POINTER(id)));
+    return id;
+}
+
+/*****************************************************************************/
+
+static void
+_upstream_response_received(NMDnsInternal *self,
+                            guint8 *       msg,
+                            gsize          len,
+                            TcpConn *      conn,
+                            Query *        udp_query)
+{
+    NMDnsInternalPrivate *priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+    Query *               query;
+    guint16               flags;
+    guint                 rcode;
+
+    nm_assert(!conn != !udp_query);
+
+    if (len < DNS_HEADER_SIZE)
+        return;
+
+    if (conn) {
+        query = g_hash_table_lookup(priv->queries, GUINT_TO_POINTER(unaligned_read_be16(msg)));
+        if (!query || query->upstream_conn != conn)
+            return;
+    } else {
+        /* a UDP response is only accepted on the socket of its query. */
+        query = udp_query;
+        if (query->use_tcp || unaligned_read_be16(msg) != query->upstream_id)
+            return;
+    }
+
+    /* the response must be for the question that we asked. */
+    if (len < query->question_end || memcmp(&msg[4], &query->msg[4], 2) != 0
+        || memcmp(&msg[DNS_HEADER_SIZE],
+                  &query->msg[DNS_HEADER_SIZE],
+                  query->question_end - DNS_HEADER_SIZE)
+               != 0)
+        return;
+
+    flags = unaligned_read_be16(&msg[2]);
+    if (!(flags & DNS_FLAG_QR))
+        return;
+
+    if ((flags & DNS_FLAG_TC) && !conn) {
+        /* retry the same server over TCP. */
+        query->use_tcp = TRUE;
+        _query_start(query);
+        return;
+    }
+
+    rcode = flags & DNS_RCODE_MASK;
+
+    if (NM_IN_SET(rcode, DNS_RCODE_SERVFAIL, DNS_RCODE_REFUSED)
+        && query->candidate_idx + 1 < query->candidates->len) {
+        _query_next(query);
+        return;
+    }
+
+    if (NM_IN_SET(rcode, DNS_RCODE_NOERROR, DNS_RCODE_NXDOMAIN) && !(flags & DNS_FLAG_TC))
+        _cache_add(self, query->cache_key, msg, len);
+
+    _query_complete(query, msg, len);
+}
+
+static gboolean
+_udp_upstream_cb(int fd, GIOCondition condition, gpointer user_data)
+{
+    Query *               query = user_data;
+    NMDnsInternal *       self  = query->self;
+    NMDnsInternalPrivate *priv  = NM_DNS_INTERNAL_GET_PRIVATE(self);
+    const Server *        server;
+    guint                 i;
+
+    nm_assert(query->udp_fd == fd);
+
+    server = query->candidates->pdata[query->candidate_idx];
+
+    /* don't starve the main loop. */
+    for (i = 0; i < 100; i++) {
+        SockAddr from;
+        ssize_t  n;
+
+        from.len = sizeof(struct sockaddr_in6);
+        n =
+            recvfrom(fd, priv->recv_buf, DNS_MSG_SIZE_MAX, MSG_DONTWAIT, &from.sa, &from.len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        /* the socket is connected, so the kernel already filters by source.
+         * Check anyway. */
+        if (!_sockaddr_equal(&from, &server->addr))
+            continue;
+
+        /* the query might be completed and freed by the response,
+         * together with this source. Don't touch it afterwards. */
+        _upstream_response_received(self, priv->recv_buf, n, NULL, query);
+        break;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/*****************************************************************************/
+
+static void
+_client_reply_error(NMDnsInternal * self,
+                    TcpConn *       conn,
+                    const SockAddr *from,
+                    guint8 *        msg,
+                    gsize           len,
+                    gsize           question_end,
+                    guint           rcode)
+{
+    if (len < DNS_HEADER_SIZE)
+        return;
+
+    len = _dns_make_error(msg, len, question_end, rcode);
+    _client_reply(self, conn, from, DNS_UDP_SIZE_MIN, msg, len);
+}
+
+static gboolean
+_client_reply_from_cache(NMDnsInternal * self,
+                         TcpConn *       conn,
+                         const SockAddr *from,
+                         guint16         client_id,
+                         guint16         client_udp_size,
+                         GBytes *        key)
+{
+    NMDnsInternalPrivate *priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+    gs_free guint8 *answer     = NULL;
+    CacheEntry *    entry;
+    gint64          now_msec;
+
+    entry = g_hash_table_lookup(priv->cache, key);
+    if (!entry)
+        return FALSE;
+
+    now_msec = nm_utils_get_monotonic_timestamp_msec();
+    if (now_msec >= entry->expires_at_msec) {
+        g_hash_table_remove(priv->cache, key);
+        return FALSE;
+    }
+
+    c_list_unlink_stale(&entry->lru_lst);
+    c_list_link_front(&priv->cache_lru_lst_head, &entry->lru_lst);
+
+    answer = nm_memdup(entry->answer, entry->answer_len);
+    _dns_response_ttls(answer,
+                       entry->answer_len,
+                       (now_msec - entry->stored_at_msec) / 1000,
+                       NULL);
+    unaligned_write_be16(answer, client_id);
+    _client_reply(self, conn, from, client_udp_size, answer, entry->answer_len);
+    return TRUE;
+}
+
+static void
+_client_query_received(NMDnsInternal * self,
+                       guint8 *        msg,
+                       gsize           len,
+                       TcpConn *       conn,
+                       const SockAddr *from)
+{
+    NMDnsInternalPrivate *priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+    gs_unref_bytes GBytes *key = NULL;
+    DnsQueryInfo           info;
+    GPtrArray *            candidates;
+    Query *                query;
+    guint16                client_id;
+
+    if (!_dns_parse_query(msg, len, &info)) {
+        _client_reply_error(self, conn, from, msg, len, 0, DNS_RCODE_FORMERR);
+        return;
+    }
+
+    client_id = unaligned_read_be16(msg);
+    if (conn)
+        info.udp_size = DNS_MSG_SIZE_MAX;
+
+    /* the cache key is the query without the ID. */
+    key = g_bytes_new(&msg[2], len - 2);
+
+    if (_client_reply_from_cache(self, conn, from, client_id, info.udp_size, key)) {
+        _LOGT("query for \"%s\" answered from cache", info.qname);
+        return;
+    }
+
+    candidates = priv->table ? _server_table_lookup(priv->table, info.qname) : NULL;
+    if (!candidates || candidates->len == 0) {
+        _client_reply_error(self, conn, from, msg, len, info.question_end, DNS_RCODE_REFUSED);
+        return;
+    }
+
+    if (g_hash_table_size(priv->queries) >= QUERIES_MAX) {
+        _client_reply_error(self, conn, from, msg, len, info.question_end, DNS_RCODE_SERVFAIL);
+        return;
+    }
+
+    query  = g_slice_new(Query);
+    *query = (Query){
+        .self            = self,
+        .table           = _server_table_ref(priv->table),
+        .candidates      = candidates,
+        .cache_key       = g_steal_pointer(&key),
+        .msg             = nm_memdup(msg, len),
+        .msg_len         = len,
+        .question_end    = info.question_end,
+        .upstream_id     = _query_alloc_id(self),
+        .client_id       = client_id,
+        .client_udp_size = info.udp_size,
+        .udp_fd          = -1,
+        .use_tcp         = !!conn,
+    };
+    if (conn) {
+        query->client_conn = _tcp_conn_ref(conn);
+        _tcp_conn_pending_inc(conn);
+    } else
+        query->client_addr = *from;
+
+    unaligned_write_be16(query->msg, query->upstream_id);
+    g_hash_table_insert(priv->queries, GUINT_TO_POINTER(query->upstream_id), query);
+
+    _LOGT("forwarding query for \"%s\"", info.qname);
+    _query_start(query);
+}
+
+static gboolean
+_udp_listen_cb(int fd, GIOCondition condition, gpointer user_data)
+{
+    NMDnsInternal *       self = user_data;
+    NMDnsInternalPrivate *priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+    guint                 i;
+
+    /* don't starve the main loop. */
+    for (i = 0; i < 100; i++) {
+        SockAddr from;
+        ssize_t  n;
+
+        from.len = sizeof(struct sockaddr_in6);
+        n =
+            recvfrom(fd, priv->recv_buf, DNS_MSG_SIZE_MAX, MSG_DONTWAIT, &from.sa, &from.len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        _client_query_received(self, priv->recv_buf, n, NULL, &from);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+_tcp_listen_cb(int fd, GIOCondition condition, gpointer user_data)
+{
+    NMDnsInternal *       self = user_data;
+    NMDnsInternalPrivate *priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+
+    while (TRUE) {
+        int conn_fd;
+
+        conn_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (conn_fd < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        if (priv->tcp_clients_n >= TCP_CLIENTS_MAX) {
+            nm_close(conn_fd);
+            continue;
+        }
+
+        /* the connection is owned by the list of connections. */
+        _tcp_conn_new(self, conn_fd, FALSE, FALSE);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/*****************************************************************************/
+
+static int
+_listen_socket(NMDnsInternal *self, int type, SockAddr *addr, GError **error)
+{
+    nm_auto_close int fd = -1;
+    int               errsv;
+
+    fd = socket(addr->sa.sa_family, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        errsv = errno;
+        nm_utils_error_set_errno(error, errsv, "failed to create socket: %s");
+        return -1;
+    }
+
+    if (type == SOCK_STREAM) {
+        int on = 1;
+
+        (void) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+
+    if (bind(fd, &addr->sa, addr->len) < 0) {
+        errsv = errno;
+        nm_utils_error_set_errno(error, errsv, "failed to bind socket: %s");
+        return -1;
+    }
+
+    if (type == SOCK_STREAM && listen(fd, 64) < 0) {
+        errsv = errno;
+        nm_utils_error_set_errno(error, errsv, "failed to listen on socket: %s");
+        return -1;
+    }
+
+    return nm_steal_fd(&fd);
+}
+
+gboolean
+nm_dns_internal_start(NMDnsInternal *self, GError **error)
+{
+    NMDnsInternalPrivate *priv;
+    SockAddr              addr;
+    int                   udp_fd;
+    int                   tcp_fd;
+
+    g_return_val_if_fail(NM_IS_DNS_INTERNAL(self), FALSE);
+
+    priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+
+    if (priv->udp_listen_fd >= 0)
+        return TRUE;
+
+    _sockaddr_init(&addr, priv->listen_addr_family, &priv->listen_address, priv->listen_port, 0);
+
+    udp_fd = _listen_socket(self, SOCK_DGRAM, &addr, error);
+    if (udp_fd < 0)
+        return FALSE;
+
+    if (priv->listen_port == 0) {
+        /* bind TCP to the same port that the kernel picked for UDP. */
+        addr.len = sizeof(struct sockaddr_in6);
+        if (getsockname(udp_fd, &addr.sa, &addr.len) < 0) {
+            int errsv = errno;
+
+            nm_close(udp_fd);
+            nm_utils_error_set_errno(error, errsv, "failed to get socket name: %s");
+            return FALSE;
+        }
+    }
+
+    tcp_fd = _listen_socket(self, SOCK_STREAM, &addr, error);
+    if (tcp_fd < 0) {
+        nm_close(udp_fd);
+        return FALSE;
+    }
+
+    priv->listen_port =
+        ntohs(addr.sa.sa_family == AF_INET ? addr.in.sin_port : addr.in6.sin6_port);
+    priv->udp_listen_fd = udp_fd;
+    priv->tcp_listen_fd = tcp_fd;
+    priv->udp_listen_source =
+        nm_g_source_attach(nm_g_unix_fd_source_new(udp_fd,
+                                                   G_IO_IN,
+                                                   G_PRIORITY_DEFAULT,
+                                                   _udp_listen_cb,
+                                                   self,
+                                                   NULL),
+                           NULL);
+    priv->tcp_listen_source =
+        nm_g_source_attach(nm_g_unix_fd_source_new(tcp_fd,
+                                                   G_IO_IN,
+                                                   G_PRIORITY_DEFAULT,
+                                                   _tcp_listen_cb,
+                                                   self,
+                                                   NULL),
+                           NULL);
+
+    _LOGD("listening on port %u", (guint) priv->listen_port);
+    return TRUE;
+}
+
+guint16
+nm_dns_internal_get_listen_port(NMDnsInternal *self)
+{
+    g_return_val_if_fail(NM_IS_DNS_INTERNAL(self), 0);
+
+    return NM_DNS_INTERNAL_GET_PRIVATE(self)->listen_port;
+}
+
+void
+nm_dns_internal_set_servers(NMDnsInternal *            self,
+                            const NMDnsInternalServer *servers,
+                            guint                      n_servers)
+{
+    NMDnsInternalPrivate *priv;
+    ServerTable *         table;
+
+    g_return_if_fail(NM_IS_DNS_INTERNAL(self));
+
+    priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+
+    table = _server_table_new(servers, n_servers);
+    if (_server_table_equal(priv->table, table)) {
+        _server_table_unref(table);
+        return;
+    }
+
+    _LOGD("using %u upstream servers", table->servers->len);
+
+    /* In-flight queries keep their reference to the old table. The
+     * cached answers might be wrong for the new servers. */
+    if (priv->table)
+        _server_table_unref(priv->table);
+    priv->table = table;
+    _cache_flush(self);
+}
+
+/*****************************************************************************/
+
+static void
+_servers_add(GArray *     servers,
+             const char * domain,
+             int          addr_family,
+             gconstpointer address,
+             int          ifindex)
+{
+    NMDnsInternalServer *s;
+
+    g_array_set_size(servers, servers->len + 1);
+    s  = &g_array_index(servers, NMDnsInternalServer, servers->len - 1);
+    *s = (NMDnsInternalServer){
+        .domain      = domain,
+        .addr_family = addr_family,
+        .ifindex     = ifindex,
+    };
+    nm_ip_addr_set(addr_family, &s->address, address);
+}
+
+static void
+add_global_config(GArray *servers, const NMGlobalDnsConfig *config)
+{
+    guint i, j;
+
+    for (i = 0; i < nm_global_dns_config_get_num_domains(config); i++) {
+        NMGlobalDnsDomain *domain      = nm_global_dns_config_get_domain(config, i);
+        const char *const *nameservers = nm_global_dns_domain_get_servers(domain);
+        const char *       name        = nm_global_dns_domain_get_name(domain);
+
+        for (j = 0; nameservers && nameservers[j]; j++) {
+            NMIPAddr addr;
+            int      addr_family;
+
+            if (!nm_utils_parse_inaddr_bin(AF_UNSPEC, nameservers[j], &addr_family, &addr))
+                continue;
+            _servers_add(servers, nm_streq0(name, "*") ? NULL : name, addr_family, &addr, 0);
+        }
+    }
+}
+
+static void
+add_ip_config(GArray *servers, const NMDnsConfigIPData *ip_data)
+{
+    NMIPConfig *ip_config   = ip_data->ip_config;
+    int         addr_family = nm_ip_config_get_addr_family(ip_config);
+    int         ifindex     = ip_data->data->ifindex;
+    guint       i, j, num;
+
+    num = nm_ip_config_get_num_nameservers(ip_config);
+    for (i = 0; i < num; i++) {
+        gconstpointer addr = nm_ip_config_get_nameserver(ip_config, i);
+
+        if (!ip_data->domains.has_default_route_explicit && ip_data->domains.has_default_route)
+            _servers_add(servers, NULL, addr_family, addr, ifindex);
+        if (ip_data->domains.search) {
+            for (j = 0; ip_data->domains.search[j]; j++) {
+                const char *domain;
+
+                domain = nm_utils_parse_dns_domain(ip_data->domains.search[j], NULL);
+                _servers_add(servers, domain[0] ? domain : NULL, addr_family, addr, ifindex);
+            }
+        }
+        if (ip_data->domains.reverse) {
+            for (j = 0; ip_data->domains.reverse[j]; j++)
+                _servers_add(servers, ip_data->domains.reverse[j], addr_family, addr, ifindex);
+        }
+    }
+}
+
+static gboolean
+update(NMDnsPlugin *            plugin,
+       const NMGlobalDnsConfig *global_config,
+       const CList *            ip_config_lst_head,
+       const char *             hostname,
+       GError **                error)
+{
+    NMDnsInternal *          self    = NM_DNS_INTERNAL(plugin);
+    gs_unref_array GArray *  servers = NULL;
+    const NMDnsConfigIPData *ip_data;
+
+    if (!nm_dns_internal_start(self, error))
+        return FALSE;
+
+    servers = g_array_new(FALSE, FALSE, sizeof(NMDnsInternalServer));
+    if (global_config)
+        add_global_config(servers, global_config);
+    else {
+        c_list_for_each_entry (ip_data, ip_config_lst_head, ip_config_lst)
+            add_ip_config(servers, ip_data);
+    }
+
+    nm_dns_internal_set_servers(self,
+                                (const NMDnsInternalServer *) servers->data,
+                                servers->len);
+    return TRUE;
+}
+
+static void
+_cleanup(NMDnsInternal *self)
+{
+    NMDnsInternalPrivate *priv    = NM_DNS_INTERNAL_GET_PRIVATE(self);
+    gs_free gpointer *    queries = NULL;
+    TcpConn *             conn;
+    guint                 n_queries;
+    guint                 i;
+
+    nm_clear_g_source_inst(&priv->udp_listen_source);
+    nm_clear_g_source_inst(&priv->tcp_listen_source);
+    nm_close(priv->udp_listen_fd);
+    nm_close(priv->tcp_listen_fd);
+    priv->udp_listen_fd = -1;
+    priv->tcp_listen_fd = -1;
+
+    /* drop the in-flight queries without replying. Their clients
+     * will retry. */
+    queries = nm_utils_hash_values_to_array(priv->queries, NULL, NULL, &n_queries);
+    for (i = 0; i < n_queries; i++)
+        _query_free(queries[i]);
+
+    while ((conn = c_list_first_entry(&priv->tcp_conns_lst_head, TcpConn, conn_lst)))
+        _tcp_conn_close(conn);
+
+    _cache_flush(self);
+}
+
+static void
+stop(NMDnsPlugin *plugin)
+{
+    _cleanup(NM_DNS_INTERNAL(plugin));
+}
+
+/*****************************************************************************/
+
+static void
+nm_dns_internal_init(NMDnsInternal *self)
+{
+    NMDnsInternalPrivate *priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+
+    priv->queries = g_hash_table_new(nm_direct_hash, NULL);
+    priv->cache   = g_hash_table_new_full(g_bytes_hash, g_bytes_equal, NULL, _cache_entry_free);
+    c_list_init(&priv->cache_lru_lst_head);
+    c_list_init(&priv->tcp_conns_lst_head);
+    priv->recv_buf             = g_malloc(DNS_MSG_SIZE_MAX);
+    priv->udp_listen_fd        = -1;
+    priv->tcp_listen_fd        = -1;
+    priv->listen_addr_family   = AF_INET;
+    priv->listen_address.addr4 = htonl(INADDR_LOOPBACK);
+    priv->listen_port          = DNS_PORT;
+}
+
+NMDnsPlugin *
+nm_dns_internal_new(void)
+{
+    return g_object_new(NM_TYPE_DNS_INTERNAL, NULL);
+}
+
+NMDnsPlugin *
+nm_dns_internal_new_full(int addr_family, gconstpointer listen_address, guint16 listen_port)
+{
+    NMDnsInternal *       self;
+    NMDnsInternalPrivate *priv;
+
+    g_return_val_if_fail(NM_IN_SET(addr_family, AF_INET, AF_INET6), NULL);
+    g_return_val_if_fail(listen_address, NULL);
+
+    self = g_object_new(NM_TYPE_DNS_INTERNAL, NULL);
+    priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+
+    priv->listen_addr_family = addr_family;
+    nm_ip_addr_set(addr_family, &priv->listen_address, listen_address);
+    priv->listen_port = listen_port;
+    return NM_DNS_PLUGIN(self);
+}
+
+static void
+dispose(GObject *object)
+{
+    _cleanup(NM_DNS_INTERNAL(object));
+
+    G_OBJECT_CLASS(nm_dns_internal_parent_class)->dispose(object);
+}
+
+static void
+finalize(GObject *object)
+{
+    NMDnsInternal *       self = NM_DNS_INTERNAL(object);
+    NMDnsInternalPrivate *priv = NM_DNS_INTERNAL_GET_PRIVATE(self);
+
+    if (priv->table)
+        _server_table_unref(priv->table);
+    g_hash_table_unref(priv->queries);
+    g_hash_table_unref(priv->cache);
+    g_free(priv->recv_buf);
+
+    G_OBJECT_CLASS(nm_dns_internal_parent_class)->finalize(object);
+}
+
+static void
+nm_dns_internal_class_init(NMDnsInternalClass *klass)
+{
+    NMDnsPluginClass *plugin_class = NM_DNS_PLUGIN_CLASS(klass);
+    GObjectClass *    object_class = G_OBJECT_CLASS(klass);
+
+    object_class->dispose  = dispose;
+    object_class->finalize = finalize;
+
+    plugin_class->plugin_name = "internal";
+    plugin_class->is_caching  = TRUE;
+    plugin_class->stop        = stop;
+    plugin_class->update      = update;
+}
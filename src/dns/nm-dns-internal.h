@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright (C) 2020 Red Hat, Inc.
+ */
+
+#ifndef __NETWORKMANAGER_DNS_INTERNAL_H__
+#define __NETWORKMANAGER_DNS_INTERNAL_H__
+
+#include "nm-dns-plugin.h"
+
+#define NM_TYPE_DNS_INTERNAL (nm_dns_internal_get_type())
+#define NM_DNS_INTERNAL(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST((obj), NM_TYPE_DNS_INTERNAL, NMDnsInternal))
+#define NM_DNS_INTERNAL_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_CAST((klass), NM_TYPE_DNS_INTERNAL, NMDnsInternalClass))
+#define NM_IS_DNS_INTERNAL(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), NM_TYPE_DNS_INTERNAL))
+#define NM_IS_DNS_INTERNAL_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), NM_TYPE_DNS_INTERNAL))
+#define NM_DNS_INTERNAL_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS((obj), NM_TYPE_DNS_INTERNAL, NMDnsInternalClass))
+
+typedef struct _NMDnsInternal      NMDnsInternal;
+typedef struct _NMDnsInternalClass NMDnsInternalClass;
+
+GType nm_dns_internal_get_type(void);
+
+NMDnsPlugin *nm_dns_internal_new(void);
+
+NMDnsPlugin *
+nm_dns_internal_new_full(int addr_family, gconstpointer listen_address, guint16 listen_port);
+
+/*****************************************************************************/
+
+typedef struct {
+    /* the DNS domain that should be resolved by this server, or %NULL
+     * for the wildcard domain. */
+    const char *domain;
+    int         addr_family;
+    NMIPAddr    address;
+
+    /* in host byte order. Zero means the default DNS port 53. */
+    guint16 port;
+
+    /* only relevant for IPv6 link-local addresses. */
+    int ifindex;
+} NMDnsInternalServer;
+
+gboolean nm_dns_internal_start(NMDnsInternal *self, GError **error);
+
+guint16 nm_dns_internal_get_listen_port(NMDnsInternal *self);
+
+void nm_dns_internal_set_servers(NMDnsInternal *            self,
+                                 const NMDnsInternalServer *servers,
+                                 guint                      n_servers);
+
+#endif /* __NETWORKMANAGER_DNS_INTERNAL_H__ */
@@ -35,6 +35,7 @@
 
 #include "nm-dns-plugin.h"
 #include "nm-dns-dnsmasq.h"
+#include "nm-dns-internal.h"
 #include "nm-dns-systemd-resolved.h"
 #include "nm-dns-unbound.h"
 
@@ -2263,6 +2264,12 @@ again:
             priv->plugin   = nm_dns_unbound_new();
             plugin_changed = TRUE;
         }
+    } else if (nm_streq0(mode, "internal")) {
+        if (force_reload_plugin || !NM_IS_DNS_INTERNAL(priv->plugin)) {
+            _clear_plugin(self);
+            priv->plugin   = nm_dns_internal_new();
+            plugin_changed = TRUE;
+        }
     } else {
         if (!NM_IN_STRSET(mode, "none", "default")) {
             if (mode)
@@ -0,0 +1,463 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright (C) 2020 Red Hat, Inc.
+ */
+
+#include "nm-default.h"
+
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#include "nm-std-aux/unaligned.h"
+#include "dns/nm-dns-internal.h"
+
+#include "nm-test-utils-core.h"
+
+/*****************************************************************************/
+
+/* A minimal upstream DNS server. It answers every query for type A with
+ * a single record that contains @answer. */
+typedef struct {
+    int        udp_fd;
+    int        tcp_fd;
+    GSource *  udp_source;
+    GSource *  tcp_source;
+    GPtrArray *conn_sources;
+    guint16    port;
+    in_addr_t  answer;
+    guint32    ttl;
+    guint      n_udp_queries;
+    guint      n_tcp_queries;
+    guint16    udp_src_ports[8];
+    bool       truncate_udp;
+} Stub;
+
+static gsize
+_stub_build_reply(Stub *stub, const guint8 *query, gsize len, gboolean truncate, guint8 *out)
+{
+    gsize n;
+
+    g_assert_cmpint(len, >=, 12);
+    g_assert_cmpint(len + 16, <=, 512);
+
+    memcpy(out, query, len);
+    unaligned_write_be16(&out[2], 0x8180 | (truncate ? 0x0200 : 0));
+    if (truncate)
+        return len;
+
+    unaligned_write_be16(&out[6], 1);
+    n = len;
+    unaligned_write_be16(&out[n], 0xC00C);
+    unaligned_write_be16(&out[n + 2], 1);
+    unaligned_write_be16(&out[n + 4], 1);
+    unaligned_write_be32(&out[n + 6], stub->ttl);
+    unaligned_write_be16(&out[n + 10], 4);
+    memcpy(&out[n + 12], &stub->answer, 4);
+    return n + 16;
+}
+
+static gboolean
+_stub_udp_cb(int fd, GIOCondition condition, gpointer user_data)
+{
+    Stub *                  stub = user_data;
+    guint8                  buf[512];
+    guint8                  reply[512];
+    struct sockaddr_storage from;
+    socklen_t               from_len = sizeof(from);
+    gssize                  n;
+    gsize                   reply_len;
+
+    n = recvfrom(fd, buf, sizeof(buf) - 16, MSG_DONTWAIT, (struct sockaddr *) &from, &from_len);
+    if (n < 12)
+        return G_SOURCE_CONTINUE;
+
+    if (stub->n_udp_queries < G_N_ELEMENTS(stub->udp_src_ports))
+        stub->udp_src_ports[stub->n_udp_queries] = ntohs(((struct sockaddr_in *) &from)->sin_port);
+    stub->n_udp_queries++;
+    reply_len = _stub_build_reply(stub, buf, n, stub->truncate_udp, reply);
+    g_assert_cmpint(sendto(fd, reply, reply_len, 0, (struct sockaddr *) &from, from_len),
+                    ==,
+                    reply_len);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+_stub_tcp_conn_cb(int fd, GIOCondition condition, gpointer user_data)
+{
+    Stub * stub = user_data;
+    guint8 buf[512];
+    guint8 reply[2 + 512];
+    gsize  len;
+    gsize  reply_len;
+
+    if (recv(fd, buf, 2, MSG_WAITALL) != 2)
+        return G_SOURCE_REMOVE;
+
+    len = unaligned_read_be16(buf);
+    g_assert_cmpint(len, >=, 12);
+    g_assert_cmpint(len, <=, sizeof(buf) - 16);
+    g_assert_cmpint(recv(fd, buf, len, MSG_WAITALL), ==, len);
+
+    stub->n_tcp_queries++;
+    reply_len = _stub_build_reply(stub, buf, len, FALSE, &reply[2]);
+    unaligned_write_be16(reply, reply_len);
+    g_assert_cmpint(send(fd, reply, reply_len + 2, MSG_NOSIGNAL), ==, reply_len + 2);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+_stub_tcp_cb(int fd, GIOCondition condition, gpointer user_data)
+{
+    Stub *stub = user_data;
+    int   conn_fd;
+
+    conn_fd = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+    if (conn_fd < 0)
+        return G_SOURCE_CONTINUE;
+
+    g_ptr_array_add(stub->conn_sources,
+                    nm_g_source_attach(nm_g_unix_fd_source_new(conn_fd,
+                                                               G_IO_IN,
+                                                               G_PRIORITY_DEFAULT,
+                                                               _stub_tcp_conn_cb,
+                                                               stub,
+                                                               NULL),
+                                       NULL));
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+_stub_conn_source_free(gpointer data)
+{
+    GSource *source = data;
+
+    nm_close(g_unix_fd_source_get_fd(source));
+    g_source_destroy(source);
+    g_source_unref(source);
+}
+
+static Stub *
+_stub_new(const char *answer)
+{
+    Stub *             stub;
+    struct sockaddr_in addr;
+    socklen_t          addr_len = sizeof(addr);
+
+    stub  = g_slice_new(Stub);
+    *stub = (Stub){
+        .answer       = nmtst_inet4_from_string(answer),
+        .ttl          = 300,
+        .conn_sources = g_ptr_array_new_with_free_func(_stub_conn_source_free),
+    };
+
+    addr = (struct sockaddr_in){
+        .sin_family      = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+
+    stub->udp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    g_assert(stub->udp_fd >= 0);
+    g_assert_cmpint(bind(stub->udp_fd, (struct sockaddr *) &addr, sizeof(addr)), ==, 0);
+    g_assert_cmpint(getsockname(stub->udp_fd, (struct sockaddr *) &addr, &addr_len), ==, 0);
+
+    stub->tcp_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    g_assert(stub->tcp_fd >= 0);
+    g_assert_cmpint(bind(stub->tcp_fd, (struct sockaddr *) &addr, sizeof(addr)), ==, 0);
+    g_assert_cmpint(listen(stub->tcp_fd, 5), ==, 0);
+
+    stub->port = ntohs(addr.sin_port);
+
+    stub->udp_source = nm_g_source_attach(nm_g_unix_fd_source_new(stub->udp_fd,
+                                                                  G_IO_IN,
+                                                                  G_PRIORITY_DEFAULT,
+                                                                  _stub_udp_cb,
+                                                                  stub,
+                                                                  NULL),
+                                          NULL);
+    stub->tcp_source = nm_g_source_attach(nm_g_unix_fd_source_new(stub->tcp_fd,
+                                                                  G_IO_IN,
+                                                                  G_PRIORITY_DEFAULT,
+                                                                  _stub_tcp_cb,
+                                                                  stub,
+                                                                  NULL),
+                                          NULL);
+    return stub;
+}
+
+static void
+_stub_free(Stub *stub)
+{
+    nm_clear_g_source_inst(&stub->udp_source);
+    nm_clear_g_source_inst(&stub->tcp_source);
+    g_ptr_array_unref(stub->conn_sources);
+    nm_close(stub->udp_fd);
+    nm_close(stub->tcp_fd);
+    nm_g_slice_free(stub);
+}
+
+static NMDnsInternalServer
+_stub_server(Stub *stub, const char *domain)
+{
+    return (NMDnsInternalServer){
+        .domain        = domain,
+        .addr_family   = AF_INET,
+        .address.addr4 = htonl(INADDR_LOOPBACK),
+        .port          = stub->port,
+    };
+}
+
+/*****************************************************************************/
+
+static gsize
+_build_query(guint8 *buf, guint16 id, const char *name)
+{
+    gsize n = 12;
+
+    memset(buf, 0, 12);
+    unaligned_write_be16(&buf[0], id);
+    unaligned_write_be16(&buf[2], 0x0100);
+    unaligned_write_be16(&buf[4], 1);
+
+    while (*name) {
+        const char *dot = strchr(name, '.');
+        gsize       l   = dot ? (gsize)(dot - name) : strlen(name);
+
+        buf[n++] = l;
+        memcpy(&buf[n], name, l);
+        n += l;
+        name += l;
+        if (*name == '.')
+            name++;
+    }
+    buf[n++] = 0;
+    unaligned_write_be16(&buf[n], 1);
+    unaligned_write_be16(&buf[n + 2], 1);
+    return n + 4;
+}
+
+static gboolean
+_recv_ready(int fd, gboolean tcp)
+{
+    guint8 buf[2];
+    int    avail;
+    gssize n;
+
+    n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT | MSG_PEEK);
+    if (n <= 0)
+        return FALSE;
+    if (!tcp)
+        return TRUE;
+    if (n < 2)
+        return FALSE;
+    g_assert_cmpint(ioctl(fd, FIONREAD, &avail), ==, 0);
+    return avail >= 2 + unaligned_read_be16(buf);
+}
+
+/* sends the query to the plugin and returns the address of the answer
+ * record. Asserts that the reply carries the same ID. */
+static in_addr_t
+_resolve(NMDnsInternal *plugin, const char *name, guint16 id, gboolean tcp)
+{
+    nm_auto_close int  fd = -1;
+    struct sockaddr_in addr;
+    guint8             query[2 + 512];
+    guint8             reply[512];
+    gsize              query_len;
+    gssize             n;
+    in_addr_t          a;
+
+    addr = (struct sockaddr_in){
+        .sin_family      = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        .sin_port        = htons(nm_dns_internal_get_listen_port(plugin)),
+    };
+
+    fd = socket(AF_INET, (tcp ? SOCK_STREAM : SOCK_DGRAM) | SOCK_CLOEXEC, 0);
+    g_assert(fd >= 0);
+    g_assert_cmpint(connect(fd, (struct sockaddr *) &addr, sizeof(addr)), ==, 0);
+
+    query_len = _build_query(&query[2], id, name);
+    if (tcp) {
+        unaligned_write_be16(query, query_len);
+        g_assert_cmpint(send(fd, query, query_len + 2, MSG_NOSIGNAL), ==, query_len + 2);
+    } else
+        g_assert_cmpint(send(fd, &query[2], query_len, 0), ==, query_len);
+
+    nmtst_main_context_iterate_until_assert(NULL, 5000, _recv_ready(fd, tcp));
+
+    if (tcp) {
+        g_assert_cmpint(recv(fd, reply, 2, MSG_WAITALL), ==, 2);
+        n = unaligned_read_be16(reply);
+        g_assert_cmpint(n, <=, sizeof(reply));
+        g_assert_cmpint(recv(fd, reply, n, MSG_WAITALL), ==, n);
+    } else
+        n = recv(fd, reply, sizeof(reply), 0);
+
+    g_assert_cmpint(n, ==, query_len + 16);
+    g_assert_cmpint(unaligned_read_be16(&reply[0]), ==, id);
+    g_assert_cmpint(unaligned_read_be16(&reply[2]) & 0x820F, ==, 0x8000);
+    g_assert_cmpint(unaligned_read_be16(&reply[6]), ==, 1);
+    memcpy(&a, &reply[n - 4], 4);
+    return a;
+}
+
+static NMDnsInternal *
+_plugin_new(void)
+{
+    gs_free_error GError *error    = NULL;
+    in_addr_t             loopback = htonl(INADDR_LOOPBACK);
+    NMDnsInternal *       plugin;
+
+    plugin = NM_DNS_INTERNAL(nm_dns_internal_new_full(AF_INET, &loopback, 0));
+    if (!nm_dns_internal_start(plugin, &error))
+        g_error("failed to start internal DNS: %s", error->message);
+    g_assert_cmpint(nm_dns_internal_get_listen_port(plugin), !=, 0);
+    return plugin;
+}
+
+/*****************************************************************************/
+
+static void
+test_routing_and_cache(void)
+{
+    gs_unref_object NMDnsInternal *plugin = _plugin_new();
+    Stub *                         stub1  = _stub_new("192.0.2.1");
+    Stub *                         stub2  = _stub_new("192.0.2.2");
+    NMDnsInternalServer            servers[2];
+
+    servers[0] = _stub_server(stub1, NULL);
+    servers[1] = _stub_server(stub2, "corp.example");
+    nm_dns_internal_set_servers(plugin, servers, G_N_ELEMENTS(servers));
+
+    g_assert_cmpint(_resolve(plugin, "www.example.com", 0x1234, FALSE),
+                    ==,
+                    nmtst_inet4_from_string("192.0.2.1"));
+    g_assert_cmpint(_resolve(plugin, "host.corp.example", 0x1235, FALSE),
+                    ==,
+                    nmtst_inet4_from_string("192.0.2.2"));
+    g_assert_cmpint(stub1->n_udp_queries, ==, 1);
+    g_assert_cmpint(stub2->n_udp_queries, ==, 1);
+
+    /* answered from the cache, with the ID of the new query. */
+    g_assert_cmpint(_resolve(plugin, "www.example.com", 0x4321, FALSE),
+                    ==,
+                    nmtst_inet4_from_string("192.0.2.1"));
+    g_assert_cmpint(stub1->n_udp_queries, ==, 1);
+
+    /* setting the same servers again keeps the cache. */
+    nm_dns_internal_set_servers(plugin, servers, G_N_ELEMENTS(servers));
+    g_assert_cmpint(_resolve(plugin, "www.example.com", 0x4322, TRUE),
+                    ==,
+                    nmtst_inet4_from_string("192.0.2.1"));
+    g_assert_cmpint(stub1->n_udp_queries, ==, 1);
+
+    /* new servers flush the cache. */
+    servers[0] = _stub_server(stub2, NULL);
+    nm_dns_internal_set_servers(plugin, servers, 1);
+    g_assert_cmpint(_resolve(plugin, "www.example.com", 0x4323, FALSE),
+                    ==,
+                    nmtst_inet4_from_string("192.0.2.2"));
+    g_assert_cmpint(stub1->n_udp_queries, ==, 1);
+    g_assert_cmpint(stub2->n_udp_queries, ==, 2);
+
+    g_clear_object(&plugin);
+    _stub_free(stub1);
+    _stub_free(stub2);
+}
+
+static void
+test_no_cache_ttl0(void)
+{
+    gs_unref_object NMDnsInternal *plugin = _plugin_new();
+    Stub *                         stub   = _stub_new("192.0.2.3");
+    NMDnsInternalServer            server;
+
+    stub->ttl = 0;
+    server    = _stub_server(stub, NULL);
+    nm_dns_internal_set_servers(plugin, &server, 1);
+
+    _resolve(plugin, "www.example.com", 1, FALSE);
+    _resolve(plugin, "www.example.com", 2, FALSE);
+    g_assert_cmpint(stub->n_udp_queries, ==, 2);
+
+    g_clear_object(&plugin);
+    _stub_free(stub);
+}
+
+static void
+test_tcp(void)
+{
+    gs_unref_object NMDnsInternal *plugin = _plugin_new();
+    Stub *                         stub   = _stub_new("192.0.2.4");
+    NMDnsInternalServer            server;
+
+    server = _stub_server(stub, NULL);
+    nm_dns_internal_set_servers(plugin, &server, 1);
+
+    /* a TCP client query is forwarded over TCP. */
+    g_assert_cmpint(_resolve(plugin, "a.example.com", 1, TRUE),
+                    ==,
+                    nmtst_inet4_from_string("192.0.2.4"));
+    g_assert_cmpint(stub->n_udp_queries, ==, 0);
+    g_assert_cmpint(stub->n_tcp_queries, ==, 1);
+
+    /* a truncated UDP answer is retried over TCP. */
+    stub->truncate_udp = TRUE;
+    g_assert_cmpint(_resolve(plugin, "b.example.com", 2, FALSE),
+                    ==,
+                    nmtst_inet4_from_string("192.0.2.4"));
+    g_assert_cmpint(stub->n_udp_queries, ==, 1);
+    g_assert_cmpint(stub->n_tcp_queries, ==, 2);
+
+    g_clear_object(&plugin);
+    _stub_free(stub);
+}
+
+static void
+test_udp_source_port(void)
+{
+    gs_unref_object NMDnsInternal *plugin = _plugin_new();
+    Stub *                         stub   = _stub_new("192.0.2.5");
+    NMDnsInternalServer            server;
+    guint                          n_distinct;
+    guint                          i;
+
+    stub->ttl = 0;
+    server    = _stub_server(stub, NULL);
+    nm_dns_internal_set_servers(plugin, &server, 1);
+
+    for (i = 0; i < G_N_ELEMENTS(stub->udp_src_ports); i++)
+        _resolve(plugin, "www.example.com", i + 1, FALSE);
+    g_assert_cmpint(stub->n_udp_queries, ==, G_N_ELEMENTS(stub->udp_src_ports));
+
+    /* each query is sent from a new socket with a kernel-chosen port. Two
+     * random ports might collide, eight equal ones won't. */
+    n_distinct = 1;
+    for (i = 1; i < G_N_ELEMENTS(stub->udp_src_ports); i++) {
+        g_assert_cmpint(stub->udp_src_ports[i], !=, 0);
+        if (stub->udp_src_ports[i] != stub->udp_src_ports[0])
+            n_distinct++;
+    }
+    g_assert_cmpint(n_distinct, >, 1);
+
+    g_clear_object(&plugin);
+    _stub_free(stub);
+}
+
+/*****************************************************************************/
+
+NMTST_DEFINE();
+
+int
+main(int argc, char **argv)
+{
+    nmtst_init_assert_logging(&argc, &argv, "INFO", "DEFAULT");
+
+    g_test_add_func("/dns/internal/routing-and-cache", test_routing_and_cache);
+    g_test_add_func("/dns/internal/no-cache-ttl0", test_no_cache_ttl0);
+    g_test_add_func("/dns/internal/tcp", test_tcp);
+    g_test_add_func("/dns/internal/udp-source-port", test_udp_source_port);
+
+    return g_test_run();
+}
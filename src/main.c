@@ -35,6 +35,8 @@
 #include "dns/nm-dns-manager.h"
 #include "systemd/nm-sd.h"
 #include "nm-netns.h"
+#include "nm-main-loop-profiler.h"
+#include "nm-startup-trace.h"
 
 #if !defined(NM_DIST_VERSION)
     #define NM_DIST_VERSION VERSION
@@ -56,6 +58,7 @@ static struct {
     char *   opt_log_level;
     char *   opt_log_domains;
     char *   pidfile;
+    char *   startup_trace;
 } global_opt = {
     .become_daemon = TRUE,
 };
@@ -129,6 +132,9 @@ nm_main_config_reload(int signal)
         g_return_if_reached();
     }
 
+    if (signal == SIGUSR2)
+        nm_main_loop_profiler_log_stats();
+
     nm_log_info(LOGD_CORE, "reload configuration (signal %s)...", strsignal(signal));
 
     /* The signal handler thread is only installed after
@@ -238,6 +244,13 @@ do_early_setup(int *argc, char **argv[], NMConfigCmdLineOptions *config_cli)
                                &global_opt.print_config,
                                N_("Print NetworkManager configuration and exit"),
                                NULL},
+                              {"startup-trace",
+                               0,
+                               0,
+                               G_OPTION_ARG_FILENAME,
+                               &global_opt.startup_trace,
+                               N_("Write a trace of the startup to a file"),
+                               N_("filename")},
                               {NULL}};
 
     if (!nm_main_utils_early_setup(
@@ -302,6 +315,8 @@ main(int argc, char *argv[])
     GError *                error_invalid_logging_config = NULL;
     const char *const *     warnings;
     int                     errsv;
+    gint64                  startup_nsec;
+    gint64                  config_load_nsec;
 
     /* Known to cause a possible deadlock upon GDBus initialization:
      * https://bugzilla.gnome.org/show_bug.cgi?id=674885 */
@@ -311,6 +326,8 @@ main(int argc, char *argv[])
 
     _nm_utils_is_manager_process = TRUE;
 
+    startup_nsec = nm_utils_get_monotonic_timestamp_nsec();
+
     main_loop = g_main_loop_new(NULL, FALSE);
 
     /* we determine a first-start (contrary to a restart during the same boot)
@@ -376,7 +393,11 @@ main(int argc, char *argv[])
         exit(1);
     }
 
+    if (global_opt.startup_trace)
+        nm_startup_trace_setup(global_opt.startup_trace, startup_nsec);
+
     /* Read the config file and CLI overrides */
+    config_load_nsec = nm_utils_get_monotonic_timestamp_nsec();
     config = nm_config_setup(config_cli, CONFIG_ATOMIC_SECTION_PREFIXES, &error);
     nm_config_cmd_line_options_free(config_cli);
     config_cli = NULL;
@@ -387,6 +408,23 @@ main(int argc, char *argv[])
 
     _init_nm_debug(config);
 
+    if (!global_opt.startup_trace) {
+        gs_free char *v = NULL;
+
+        /* the option can only be read after loading the configuration,
+         * so the span for loading it is added afterwards. */
+        v = nm_config_data_get_value(NM_CONFIG_GET_DATA_ORIG,
+                                     NM_CONFIG_KEYFILE_GROUP_MAIN,
+                                     NM_CONFIG_KEYFILE_KEY_MAIN_STARTUP_TRACE,
+                                     NM_CONFIG_GET_VALUE_STRIP | NM_CONFIG_GET_VALUE_NO_EMPTY);
+        if (v)
+            nm_startup_trace_setup(v, startup_nsec);
+    }
+    nm_startup_trace_span_add("config-load",
+                              NULL,
+                              config_load_nsec,
+                              nm_utils_get_monotonic_timestamp_nsec());
+
     /* Initialize logging from config file *only* if not explicitly
      * specified by commandline.
      */
@@ -463,6 +501,30 @@ main(int argc, char *argv[])
     /* the first access to State causes the file to be read (and possibly print a warning) */
     nm_config_state_get(config);
 
+    {
+        gint64 stall_threshold;
+
+        stall_threshold =
+            nm_config_data_get_value_int64(NM_CONFIG_GET_DATA_ORIG,
+                                           NM_CONFIG_KEYFILE_GROUP_MAIN,
+                                           NM_CONFIG_KEYFILE_KEY_MAIN_MAIN_LOOP_STALL_THRESHOLD,
+                                           10,
+                                           0,
+                                           G_MAXINT32,
+                                           -1);
+        if (stall_threshold >= 0)
+            nm_main_loop_profiler_setup(g_main_context_default(), stall_threshold);
+    }
+
+    nm_utils_ip_routes_set_export_max(
+        nm_config_data_get_value_int64(NM_CONFIG_GET_DATA_ORIG,
+                                       NM_CONFIG_KEYFILE_GROUP_MAIN,
+                                       NM_CONFIG_KEYFILE_KEY_MAIN_ROUTE_DATA_EXPORT_MAX,
+                                       10,
+                                       0,
+                                       G_MAXUINT32,
+                                       -1));
+
     nm_log_dbg(LOGD_CORE,
                "WEXT support is %s",
 #if HAVE_WEXT
@@ -475,7 +537,11 @@ main(int argc, char *argv[])
     if (!_dbus_manager_init(config))
         goto done_no_manager;
 
-    nm_linux_platform_setup();
+    {
+        NM_STARTUP_TRACE_SCOPE("platform-setup", NULL);
+
+        nm_linux_platform_setup();
+    }
 
     NM_UTILS_KEEP_ALIVE(config, nm_netns_get(), "NMConfig-depends-on-NMNetns");
 
@@ -535,6 +601,9 @@ done:
     nm_settings_kf_db_write(NM_SETTINGS_GET);
 
 done_no_manager:
+    /* if startup never completed, still write what was traced so far. */
+    nm_startup_trace_finish();
+
     if (global_opt.pidfile && wrote_pidfile)
         unlink(global_opt.pidfile);
 
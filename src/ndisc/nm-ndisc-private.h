@@ -17,6 +17,23 @@ struct _NMNDiscDataInternal {
     GArray *routes;
     GArray *dns_servers;
     GArray *dns_domains;
+
+    /* Gateways and routes are tracked in hash tables, indexed by their
+     * address and by network/plen respectively. The GArrays above are
+     * only the sorted view of them, regenerated on demand by
+     * _data_complete(). */
+    GHashTable *gateways_idx;
+    GHashTable *routes_idx;
+    guint64     idx_seq;
+
+    /* Lower bounds for the next expiry of any gateway or route. As long as
+     * the current time is before it, nothing can have expired and the
+     * entries don't need to be checked. */
+    gint64 gateways_expiry;
+    gint64 routes_expiry;
+
+    bool gateways_dirty : 1;
+    bool routes_dirty : 1;
 };
 
 typedef struct _NMNDiscDataInternal NMNDiscDataInternal;
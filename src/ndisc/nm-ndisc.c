@@ -347,6 +347,128 @@ nm_ndisc_get_node_type(NMNDisc *self)
 
 /*****************************************************************************/
 
+typedef struct {
+    NMNDiscGateway data;
+    guint64        seq;
+} GatewayEntry;
+
+typedef struct {
+    NMNDiscRoute data;
+    guint64      seq;
+} RouteEntry;
+
+static guint
+_gateway_entry_hash(gconstpointer ptr)
+{
+    const GatewayEntry *entry = ptr;
+
+    return nm_hash_mem(1581738913u, &entry->data.address, sizeof(entry->data.address));
+}
+
+static gboolean
+_gateway_entry_equal(gconstpointer a, gconstpointer b)
+{
+    const GatewayEntry *entry_a = a;
+    const GatewayEntry *entry_b = b;
+
+    return IN6_ARE_ADDR_EQUAL(&entry_a->data.address, &entry_b->data.address);
+}
+
+static int
+_gateway_entry_cmp(gconstpointer pa, gconstpointer pb, gpointer user_data)
+{
+    const GatewayEntry *a = *((const GatewayEntry *const *) pa);
+    const GatewayEntry *b = *((const GatewayEntry *const *) pb);
+
+    /* More preferable gateways first. For the same preference, the
+     * gateway that we know the longest comes first. */
+    NM_CMP_DIRECT(_preference_to_priority(b->data.preference),
+                  _preference_to_priority(a->data.preference));
+    NM_CMP_FIELD(a, b, seq);
+    return 0;
+}
+
+static guint
+_route_entry_hash(gconstpointer ptr)
+{
+    const RouteEntry *entry = ptr;
+    NMHashState       h;
+
+    nm_hash_init(&h, 3287102923u);
+    nm_hash_update_valp(&h, &entry->data.network);
+    nm_hash_update_val(&h, entry->data.plen);
+    return nm_hash_complete(&h);
+}
+
+static gboolean
+_route_entry_equal(gconstpointer a, gconstpointer b)
+{
+    const RouteEntry *entry_a = a;
+    const RouteEntry *entry_b = b;
+
+    return entry_a->data.plen == entry_b->data.plen
+           && IN6_ARE_ADDR_EQUAL(&entry_a->data.network, &entry_b->data.network);
+}
+
+static int
+_route_entry_cmp(gconstpointer pa, gconstpointer pb, gpointer user_data)
+{
+    const RouteEntry *a = *((const RouteEntry *const *) pa);
+    const RouteEntry *b = *((const RouteEntry *const *) pb);
+
+    /* More preferable routes first. For the same preference, the
+     * most recently added route comes first. */
+    NM_CMP_DIRECT(_preference_to_priority(b->data.preference),
+                  _preference_to_priority(a->data.preference));
+    NM_CMP_FIELD(b, a, seq);
+    return 0;
+}
+
+static void
+_expiry_bound_update(gint64 *bound, gint64 expiry)
+{
+    if (*bound > expiry)
+        *bound = expiry;
+}
+
+static void
+_data_sync_gateways(NMNDiscDataInternal *data)
+{
+    gs_free gpointer *entries = NULL;
+    guint             i, len;
+
+    if (!data->gateways_dirty)
+        return;
+
+    data->gateways_dirty = FALSE;
+
+    entries = nm_utils_hash_keys_to_array(data->gateways_idx, _gateway_entry_cmp, NULL, &len);
+    g_array_set_size(data->gateways, len);
+    for (i = 0; i < len; i++) {
+        g_array_index(data->gateways, NMNDiscGateway, i) =
+            ((const GatewayEntry *) entries[i])->data;
+    }
+}
+
+static void
+_data_sync_routes(NMNDiscDataInternal *data)
+{
+    gs_free gpointer *entries = NULL;
+    guint             i, len;
+
+    if (!data->routes_dirty)
+        return;
+
+    data->routes_dirty = FALSE;
+
+    entries = nm_utils_hash_keys_to_array(data->routes_idx, _route_entry_cmp, NULL, &len);
+    g_array_set_size(data->routes, len);
+    for (i = 0; i < len; i++)
+        g_array_index(data->routes, NMNDiscRoute, i) = ((const RouteEntry *) entries[i])->data;
+}
+
+/*****************************************************************************/
+
 static void
 _ASSERT_data_gateways(const NMNDiscDataInternal *data)
 {
@@ -383,6 +505,9 @@ _ASSERT_data_gateways(const NMNDiscDataInternal *data)
 static const NMNDiscData *
 _data_complete(NMNDiscDataInternal *data)
 {
+    _data_sync_gateways(data);
+    _data_sync_routes(data);
+
     _ASSERT_data_gateways(data);
 
 #define _SET(data, field)                                      \
@@ -406,12 +531,11 @@ _data_complete(NMNDiscDataInternal *data)
 void
 nm_ndisc_emit_config_change(NMNDisc *self, NMNDiscConfigMap changed)
 {
+    const NMNDiscData *rdata;
+
+    rdata = _data_complete(&NM_NDISC_GET_PRIVATE(self)->rdata);
     _config_changed_log(self, changed);
-    g_signal_emit(self,
-                  signals[CONFIG_RECEIVED],
-                  0,
-                  _data_complete(&NM_NDISC_GET_PRIVATE(self)->rdata),
-                  (guint) changed);
+    g_signal_emit(self, signals[CONFIG_RECEIVED], 0, rdata, (guint) changed);
 }
 
 /*****************************************************************************/
@@ -419,48 +543,41 @@ nm_ndisc_emit_config_change(NMNDisc *self, NMNDiscConfigMap changed)
 gboolean
 nm_ndisc_add_gateway(NMNDisc *ndisc, const NMNDiscGateway *new)
 {
-    NMNDiscDataInternal *rdata = &NM_NDISC_GET_PRIVATE(ndisc)->rdata;
-    guint                i;
-    guint                insert_idx = G_MAXUINT;
-
-    for (i = 0; i < rdata->gateways->len;) {
-        NMNDiscGateway *item = &g_array_index(rdata->gateways, NMNDiscGateway, i);
-
-        if (IN6_ARE_ADDR_EQUAL(&item->address, &new->address)) {
-            if (new->lifetime == 0) {
-                g_array_remove_index(rdata->gateways, i);
-                _ASSERT_data_gateways(rdata);
-                return TRUE;
-            }
+    NMNDiscDataInternal *rdata  = &NM_NDISC_GET_PRIVATE(ndisc)->rdata;
+    const GatewayEntry   needle = {.data = *new};
+    GatewayEntry *       entry;
 
-            if (item->preference != new->preference) {
-                g_array_remove_index(rdata->gateways, i);
-                continue;
-            }
-
-            if (get_expiry(item) == get_expiry(new))
-                return FALSE;
-
-            *item = *new;
-            _ASSERT_data_gateways(rdata);
+    entry = g_hash_table_lookup(rdata->gateways_idx, &needle);
+    if (entry) {
+        if (new->lifetime == 0) {
+            g_hash_table_remove(rdata->gateways_idx, entry);
+            rdata->gateways_dirty = TRUE;
             return TRUE;
         }
 
-        /* Put before less preferable gateways. */
-        if (_preference_to_priority(item->preference) < _preference_to_priority(new->preference)
-            && insert_idx == G_MAXUINT)
-            insert_idx = i;
+        if (entry->data.preference != new->preference) {
+            /* the gateway moves behind the other gateways of its new
+             * preference, like a newly added one. */
+            entry->seq = ++rdata->idx_seq;
+        } else if (get_expiry(&entry->data) == get_expiry(new))
+            return FALSE;
 
-        i++;
-    }
+        entry->data = *new;
+    } else {
+        if (new->lifetime == 0)
+            return FALSE;
 
-    if (new->lifetime) {
-        g_array_insert_val(rdata->gateways,
-                           insert_idx == G_MAXUINT ? rdata->gateways->len : insert_idx,
-                           *new);
+        entry  = g_new(GatewayEntry, 1);
+        *entry = (GatewayEntry){
+            .data = *new,
+            .seq  = ++rdata->idx_seq,
+        };
+        g_hash_table_add(rdata->gateways_idx, entry);
     }
-    _ASSERT_data_gateways(rdata);
-    return !!new->lifetime;
+
+    rdata->gateways_dirty = TRUE;
+    _expiry_bound_update(&rdata->gateways_expiry, get_expiry(new));
+    return TRUE;
 }
 
 /**
@@ -647,10 +764,9 @@ nm_ndisc_complete_and_add_address(NMNDisc *ndisc, const NMNDiscAddress *new, gin
 gboolean
 nm_ndisc_add_route(NMNDisc *ndisc, const NMNDiscRoute *new)
 {
-    NMNDiscPrivate *     priv;
     NMNDiscDataInternal *rdata;
-    guint                i;
-    guint                insert_idx = G_MAXUINT;
+    const RouteEntry     needle = {.data = *new};
+    RouteEntry *         entry;
 
     if (new->plen == 0 || new->plen > 128) {
         /* Only expect non-default routes.  The router has no idea what the
@@ -663,43 +779,40 @@ nm_ndisc_add_route(NMNDisc *ndisc, const NMNDiscRoute *new)
         g_return_val_if_reached(FALSE);
     }
 
-    priv  = NM_NDISC_GET_PRIVATE(ndisc);
-    rdata = &priv->rdata;
-
-    for (i = 0; i < rdata->routes->len;) {
-        NMNDiscRoute *item = &g_array_index(rdata->routes, NMNDiscRoute, i);
-
-        if (IN6_ARE_ADDR_EQUAL(&item->network, &new->network) && item->plen == new->plen) {
-            if (new->lifetime == 0) {
-                g_array_remove_index(rdata->routes, i);
-                return TRUE;
-            }
-
-            if (item->preference != new->preference) {
-                g_array_remove_index(rdata->routes, i);
-                continue;
-            }
-
-            if (get_expiry(item) == get_expiry(new)
-                && IN6_ARE_ADDR_EQUAL(&item->gateway, &new->gateway))
-                return FALSE;
+    rdata = &NM_NDISC_GET_PRIVATE(ndisc)->rdata;
 
-            *item = *new;
+    entry = g_hash_table_lookup(rdata->routes_idx, &needle);
+    if (entry) {
+        if (new->lifetime == 0) {
+            g_hash_table_remove(rdata->routes_idx, entry);
+            rdata->routes_dirty = TRUE;
             return TRUE;
         }
 
-        /* Put before less preferable routes. */
-        if (_preference_to_priority(item->preference) < _preference_to_priority(new->preference)
-            && insert_idx == G_MAXUINT)
-            insert_idx = i;
+        if (entry->data.preference != new->preference) {
+            /* the route moves in front of the other routes of its new
+             * preference, like a newly added one. */
+            entry->seq = ++rdata->idx_seq;
+        } else if (get_expiry(&entry->data) == get_expiry(new)
+                   && IN6_ARE_ADDR_EQUAL(&entry->data.gateway, &new->gateway))
+            return FALSE;
 
-        i++;
-    }
+        entry->data = *new;
+    } else {
+        if (new->lifetime == 0)
+            return FALSE;
 
-    if (new->lifetime) {
-        g_array_insert_val(rdata->routes, insert_idx == G_MAXUINT ? 0u : insert_idx, *new);
+        entry  = g_new(RouteEntry, 1);
+        *entry = (RouteEntry){
+            .data = *new,
+            .seq  = ++rdata->idx_seq,
+        };
+        g_hash_table_add(rdata->routes_idx, entry);
     }
-    return !!new->lifetime;
+
+    rdata->routes_dirty = TRUE;
+    _expiry_bound_update(&rdata->routes_expiry, get_expiry(new));
+    return TRUE;
 }
 
 gboolean
@@ -1097,6 +1210,12 @@ nm_ndisc_stop(NMNDisc *ndisc)
     g_array_set_size(rdata->routes, 0);
     g_array_set_size(rdata->dns_servers, 0);
     g_array_set_size(rdata->dns_domains, 0);
+    g_hash_table_remove_all(rdata->gateways_idx);
+    g_hash_table_remove_all(rdata->routes_idx);
+    rdata->gateways_dirty  = FALSE;
+    rdata->routes_dirty    = FALSE;
+    rdata->gateways_expiry = _EXPIRY_INFINITY;
+    rdata->routes_expiry   = _EXPIRY_INFINITY;
     priv->rdata.public.hop_limit = 64;
 
     /* Start at very low number so that last_rs - router_solicitation_interval
@@ -1257,23 +1376,31 @@ static void
 clean_gateways(NMNDisc *ndisc, gint32 now, NMNDiscConfigMap *changed, gint32 *nextevent)
 {
     NMNDiscDataInternal *rdata;
-    guint                i;
+    GHashTableIter       iter;
+    GatewayEntry *       entry;
+    gint64               bound = _EXPIRY_INFINITY;
 
     rdata = &NM_NDISC_GET_PRIVATE(ndisc)->rdata;
 
-    for (i = 0; i < rdata->gateways->len;) {
-        NMNDiscGateway *item = &g_array_index(rdata->gateways, NMNDiscGateway, i);
+    if (expiry_next(now, rdata->gateways_expiry, nextevent)) {
+        /* nothing expired yet. */
+        return;
+    }
 
-        if (!expiry_next(now, get_expiry(item), nextevent)) {
-            g_array_remove_index(rdata->gateways, i);
+    g_hash_table_iter_init(&iter, rdata->gateways_idx);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &entry, NULL)) {
+        gint64 expiry = get_expiry(&entry->data);
+
+        if (!expiry_next(now, expiry, nextevent)) {
+            g_hash_table_iter_remove(&iter);
+            rdata->gateways_dirty = TRUE;
             *changed |= NM_NDISC_CONFIG_GATEWAYS;
             continue;
         }
 
-        i++;
+        _expiry_bound_update(&bound, expiry);
     }
-
-    _ASSERT_data_gateways(rdata);
+    rdata->gateways_expiry = bound;
 }
 
 static void
@@ -1301,21 +1428,31 @@ static void
 clean_routes(NMNDisc *ndisc, gint32 now, NMNDiscConfigMap *changed, gint32 *nextevent)
 {
     NMNDiscDataInternal *rdata;
-    guint                i;
+    GHashTableIter       iter;
+    RouteEntry *         entry;
+    gint64               bound = _EXPIRY_INFINITY;
 
     rdata = &NM_NDISC_GET_PRIVATE(ndisc)->rdata;
 
-    for (i = 0; i < rdata->routes->len;) {
-        NMNDiscRoute *item = &g_array_index(rdata->routes, NMNDiscRoute, i);
+    if (expiry_next(now, rdata->routes_expiry, nextevent)) {
+        /* nothing expired yet. */
+        return;
+    }
 
-        if (!expiry_next(now, get_expiry(item), nextevent)) {
-            g_array_remove_index(rdata->routes, i);
+    g_hash_table_iter_init(&iter, rdata->routes_idx);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &entry, NULL)) {
+        gint64 expiry = get_expiry(&entry->data);
+
+        if (!expiry_next(now, expiry, nextevent)) {
+            g_hash_table_iter_remove(&iter);
+            rdata->routes_dirty = TRUE;
             *changed |= NM_NDISC_CONFIG_ROUTES;
             continue;
         }
 
-        i++;
+        _expiry_bound_update(&bound, expiry);
     }
+    rdata->routes_expiry = bound;
 }
 
 static void
@@ -1531,6 +1668,11 @@ nm_ndisc_init(NMNDisc *ndisc)
     rdata->dns_servers = g_array_new(FALSE, FALSE, sizeof(NMNDiscDNSServer));
     rdata->dns_domains = g_array_new(FALSE, FALSE, sizeof(NMNDiscDNSDomain));
     g_array_set_clear_func(rdata->dns_domains, dns_domain_free);
+    rdata->gateways_idx =
+        g_hash_table_new_full(_gateway_entry_hash, _gateway_entry_equal, g_free, NULL);
+    rdata->routes_idx = g_hash_table_new_full(_route_entry_hash, _route_entry_equal, g_free, NULL);
+    rdata->gateways_expiry       = _EXPIRY_INFINITY;
+    rdata->routes_expiry         = _EXPIRY_INFINITY;
     priv->rdata.public.hop_limit = 64;
 
     /* Start at very low number so that last_rs - router_solicitation_interval
@@ -1570,6 +1712,8 @@ finalize(GObject *object)
     g_array_unref(rdata->routes);
     g_array_unref(rdata->dns_servers);
     g_array_unref(rdata->dns_domains);
+    g_hash_table_unref(rdata->gateways_idx);
+    g_hash_table_unref(rdata->routes_idx);
 
     g_clear_object(&priv->netns);
     g_clear_object(&priv->platform);
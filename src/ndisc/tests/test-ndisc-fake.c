@@ -428,6 +428,139 @@ test_preference_changed(void)
     g_main_loop_unref(data.loop);
 }
 
+#define LARGE_RA_N_ROUTES 600
+
+static guint8
+_large_ra_priority(NMIcmpv6RouterPref pref)
+{
+    switch (pref) {
+    case NM_ICMPV6_ROUTER_PREF_LOW:
+        return 1;
+    case NM_ICMPV6_ROUTER_PREF_MEDIUM:
+        return 2;
+    case NM_ICMPV6_ROUTER_PREF_HIGH:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+static NMIcmpv6RouterPref
+_large_ra_preference(guint i)
+{
+    static const NMIcmpv6RouterPref prefs[] = {
+        NM_ICMPV6_ROUTER_PREF_LOW,
+        NM_ICMPV6_ROUTER_PREF_MEDIUM,
+        NM_ICMPV6_ROUTER_PREF_HIGH,
+    };
+
+    return prefs[i % G_N_ELEMENTS(prefs)];
+}
+
+static void
+test_large_ra_cb(NMNDisc *ndisc, const NMNDiscData *rdata, guint changed_int, TestData *data)
+{
+    NMNDiscConfigMap changed = changed_int;
+    guint            i;
+
+    g_assert(NM_FLAGS_HAS(changed, NM_NDISC_CONFIG_ROUTES));
+
+    if (data->counter == 0)
+        g_assert_cmpint(rdata->routes_n, ==, LARGE_RA_N_ROUTES);
+    else if (data->counter == 1) {
+        /* the second RA withdrew all the even routes. */
+        g_assert_cmpint(rdata->routes_n, ==, LARGE_RA_N_ROUTES / 2);
+    } else
+        g_assert_not_reached();
+
+    g_assert_cmpint(rdata->gateways_n, ==, 1);
+    match_gateway(rdata, 0, "fe80::1", data->timestamp1, 600, NM_ICMPV6_ROUTER_PREF_MEDIUM);
+
+    for (i = 0; i < rdata->routes_n; i++) {
+        const NMNDiscRoute *route = &rdata->routes[i];
+        guint               idx;
+
+        idx = (((guint) route->network.s6_addr[4]) << 8) | route->network.s6_addr[5];
+
+        g_assert_cmpint(route->plen, ==, 56);
+        g_assert_cmpint(idx, <, LARGE_RA_N_ROUTES);
+        g_assert_cmpint(route->preference, ==, _large_ra_preference(idx));
+        g_assert_cmpint(route->lifetime, ==, 600);
+        if (data->counter == 1)
+            g_assert_cmpint(idx % 2, ==, 1);
+        if (i > 0) {
+            g_assert_cmpint(_large_ra_priority(rdata->routes[i - 1].preference),
+                            >=,
+                            _large_ra_priority(route->preference));
+        }
+    }
+
+    if (data->counter == 1) {
+        g_assert(nm_fake_ndisc_done(NM_FAKE_NDISC(ndisc)));
+        g_main_loop_quit(data->loop);
+    }
+
+    data->counter++;
+}
+
+static void
+test_large_ra(void)
+{
+    NMFakeNDisc *ndisc = ndisc_new();
+    guint32      now   = nm_utils_get_monotonic_timestamp_sec();
+    TestData     data  = {g_main_loop_new(NULL, FALSE), 0, 0, now};
+    guint        id;
+    guint        i;
+
+    /* Many Route Information Options in one RA, followed by a second RA
+     * that refreshes half of them and withdraws the other half. */
+
+    id = nm_fake_ndisc_add_ra(ndisc, 1, NM_NDISC_DHCP_LEVEL_NONE, 4, 1500);
+    g_assert(id);
+    nm_fake_ndisc_add_gateway(ndisc, id, "fe80::1", now, 600, NM_ICMPV6_ROUTER_PREF_MEDIUM);
+    for (i = 0; i < LARGE_RA_N_ROUTES; i++) {
+        char network[100];
+
+        nm_sprintf_buf(network, "2001:db8:%x::", i);
+        nm_fake_ndisc_add_prefix(ndisc,
+                                 id,
+                                 network,
+                                 56,
+                                 "fe80::1",
+                                 now,
+                                 600,
+                                 600,
+                                 _large_ra_preference(i));
+    }
+
+    id = nm_fake_ndisc_add_ra(ndisc, 1, NM_NDISC_DHCP_LEVEL_NONE, 4, 1500);
+    g_assert(id);
+    nm_fake_ndisc_add_gateway(ndisc, id, "fe80::1", now, 600, NM_ICMPV6_ROUTER_PREF_MEDIUM);
+    for (i = 0; i < LARGE_RA_N_ROUTES; i++) {
+        char network[100];
+
+        nm_sprintf_buf(network, "2001:db8:%x::", i);
+        nm_fake_ndisc_add_prefix(ndisc,
+                                 id,
+                                 network,
+                                 56,
+                                 "fe80::1",
+                                 now,
+                                 (i % 2) ? 600 : 0,
+                                 (i % 2) ? 600 : 0,
+                                 _large_ra_preference(i));
+    }
+
+    g_signal_connect(ndisc, NM_NDISC_CONFIG_RECEIVED, G_CALLBACK(test_large_ra_cb), &data);
+
+    nm_ndisc_start(NM_NDISC(ndisc));
+    g_main_loop_run(data.loop);
+    g_assert_cmpint(data.counter, ==, 2);
+
+    g_object_unref(ndisc);
+    g_main_loop_unref(data.loop);
+}
+
 static void
 test_dns_solicit_loop_changed(NMNDisc *          ndisc,
                               const NMNDiscData *rdata,
@@ -533,6 +666,7 @@ main(int argc, char **argv)
     g_test_add_func("/ndisc/preference-order", test_preference_order);
     g_test_add_func("/ndisc/preference-changed", test_preference_changed);
     g_test_add_func("/ndisc/dns-solicit-loop", test_dns_solicit_loop);
+    g_test_add_func("/ndisc/large-ra", test_large_ra);
 
     return g_test_run();
 }
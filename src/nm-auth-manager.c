@@ -21,6 +21,14 @@
 #define CANCELLATION_ID_PREFIX  "cancellation-id-"
 #define CANCELLATION_TIMEOUT_MS 5000
 
+/* Polkit results are cached for a short time, because clients tend to
+ * ask for the same permissions over and over. The cache is flushed when
+ * polkit announces a change. Only the results of checks without user
+ * interaction are cached. */
+#define AUTH_CACHE_MAX_SIZE     256
+#define AUTH_CACHE_TTL_YES_MSEC 5000
+#define AUTH_CACHE_TTL_NO_MSEC  10000
+
 /*****************************************************************************/
 
 NM_GOBJECT_PROPERTIES_DEFINE_BASE(PROP_POLKIT_ENABLED, );
@@ -40,6 +48,17 @@ typedef struct {
     guint64          call_numid_counter;
     guint            changed_id;
     guint            name_owner_changed_id;
+
+    struct {
+        GHashTable *idx;
+        CList       lst_head;
+        guint64     generation;
+        guint64     hits;
+        guint64     misses;
+        gint64      polkit_msec_total;
+        guint64     polkit_calls;
+    } cache;
+
     bool             disposing : 1;
     bool             shutting_down : 1;
     bool             got_name_owner : 1;
@@ -144,9 +163,173 @@ struct _NMAuthManagerCallId {
     gpointer                                user_data;
     guint64                                 call_numid;
     guint                                   idle_id;
+    char *                                  cache_key;
+    guint64                                 cache_generation;
+    gint64                                  start_msec;
     bool                                    idle_is_authorized : 1;
+    bool                                    allow_user_interaction : 1;
 };
 
+typedef struct {
+    CList  cache_lst;
+    char * key;
+    gint64 expiry_msec;
+    bool   is_authorized : 1;
+} AuthCacheEntry;
+
+static void
+_cache_entry_free(gpointer data)
+{
+    AuthCacheEntry *entry = data;
+
+    c_list_unlink_stale(&entry->cache_lst);
+    g_free(entry->key);
+    nm_g_slice_free(entry);
+}
+
+static char *
+_cache_key(NMAuthSubject *subject, const char *action_id)
+{
+    const char *dbus_sender;
+
+    /* unique D-Bus names are never reused. Together with the PID, they
+     * identify the process for as long as it stays connected. */
+    dbus_sender = nm_auth_subject_get_unix_process_dbus_sender(subject);
+    if (!dbus_sender)
+        return NULL;
+
+    return g_strdup_printf("%lu:%lu:%s:%s",
+                           nm_auth_subject_get_unix_process_uid(subject),
+                           nm_auth_subject_get_unix_process_pid(subject),
+                           dbus_sender,
+                           action_id);
+}
+
+static void
+_cache_clear(NMAuthManager *self, const char *reason)
+{
+    NMAuthManagerPrivate *priv = NM_AUTH_MANAGER_GET_PRIVATE(self);
+
+    /* results of pending calls must not be cached either. */
+    priv->cache.generation++;
+
+    if (g_hash_table_size(priv->cache.idx) == 0)
+        return;
+
+    _LOGT("cache: flush %u entries (%s)", g_hash_table_size(priv->cache.idx), reason);
+    g_hash_table_remove_all(priv->cache.idx);
+    nm_assert(c_list_is_empty(&priv->cache.lst_head));
+}
+
+static gboolean
+_cache_lookup(NMAuthManager *self,
+              const char *   key,
+              gboolean       allow_user_interaction,
+              gboolean *     out_is_authorized)
+{
+    NMAuthManagerPrivate *priv = NM_AUTH_MANAGER_GET_PRIVATE(self);
+    AuthCacheEntry *      entry;
+
+    entry = g_hash_table_lookup(priv->cache.idx, key);
+    if (entry && entry->expiry_msec <= nm_utils_get_monotonic_timestamp_msec()) {
+        g_hash_table_remove(priv->cache.idx, key);
+        entry = NULL;
+    }
+
+    /* the cache only has results of checks without user interaction. A "yes"
+     * also holds with interaction, but after a "no" the user might still be
+     * able to authenticate. */
+    if (!entry || (allow_user_interaction && !entry->is_authorized)) {
+        priv->cache.misses++;
+        return FALSE;
+    }
+
+    priv->cache.hits++;
+    *out_is_authorized = entry->is_authorized;
+    return TRUE;
+}
+
+static void
+_cache_add(NMAuthManager *self,
+           const char *   key,
+           gboolean       allow_user_interaction,
+           gboolean       is_authorized,
+           gboolean       is_challenge)
+{
+    NMAuthManagerPrivate *priv = NM_AUTH_MANAGER_GET_PRIVATE(self);
+    AuthCacheEntry *      entry;
+
+    /* the result of an interactive check depends on the user's answer,
+     * like a challenge. Don't cache either. */
+    if (allow_user_interaction || is_challenge) {
+        /* but after the user authenticated, a cached "no" is outdated. */
+        if (is_authorized)
+            g_hash_table_remove(priv->cache.idx, key);
+        return;
+    }
+
+    if (g_hash_table_size(priv->cache.idx) >= AUTH_CACHE_MAX_SIZE
+        && !g_hash_table_contains(priv->cache.idx, key)) {
+        /* evict the oldest entry. */
+        entry = c_list_first_entry(&priv->cache.lst_head, AuthCacheEntry, cache_lst);
+        g_hash_table_remove(priv->cache.idx, entry->key);
+    }
+
+    entry  = g_slice_new(AuthCacheEntry);
+    *entry = (AuthCacheEntry){
+        .key           = g_strdup(key),
+        .is_authorized = is_authorized,
+        .expiry_msec   = nm_utils_get_monotonic_timestamp_msec()
+                       + (is_authorized ? AUTH_CACHE_TTL_YES_MSEC : AUTH_CACHE_TTL_NO_MSEC),
+    };
+    c_list_link_tail(&priv->cache.lst_head, &entry->cache_lst);
+    g_hash_table_replace(priv->cache.idx, entry->key, entry);
+}
+
+gboolean
+_nm_auth_manager_cache_lookup(NMAuthManager *self,
+                              NMAuthSubject *subject,
+                              const char *   action_id,
+                              gboolean       allow_user_interaction,
+                              gboolean *     out_is_authorized)
+{
+    gs_free char *key = NULL;
+
+    g_return_val_if_fail(NM_IS_AUTH_MANAGER(self), FALSE);
+
+    key = _cache_key(subject, action_id);
+    return key && _cache_lookup(self, key, allow_user_interaction, out_is_authorized);
+}
+
+void
+_nm_auth_manager_cache_add(NMAuthManager *self,
+                           NMAuthSubject *subject,
+                           const char *   action_id,
+                           gboolean       allow_user_interaction,
+                           gboolean       is_authorized,
+                           gboolean       is_challenge)
+{
+    gs_free char *key = NULL;
+
+    g_return_if_fail(NM_IS_AUTH_MANAGER(self));
+
+    key = _cache_key(subject, action_id);
+    if (key)
+        _cache_add(self, key, allow_user_interaction, is_authorized, is_challenge);
+}
+
+static gint64
+_cache_saved_msec(NMAuthManagerPrivate *priv)
+{
+    if (priv->cache.polkit_calls == 0)
+        return 0;
+
+    /* estimate the time saved by cache hits with the average duration
+     * of a CheckAuthorization call. */
+    return (priv->cache.polkit_msec_total / (gint64) priv->cache.polkit_calls)
+           * (gint64) priv->cache.hits;
+}
+
 #define cancellation_id_to_str_a(call_numid)                     \
     nm_sprintf_bufa(NM_STRLEN(CANCELLATION_ID_PREFIX) + 60,      \
                     CANCELLATION_ID_PREFIX "%" G_GUINT64_FORMAT, \
@@ -165,6 +348,7 @@ _call_id_free(NMAuthManagerCallId *call_id)
         return;
     }
 
+    g_free(call_id->cache_key);
     g_object_unref(call_id->self);
     g_slice_free(NMAuthManagerCallId, call_id);
 }
@@ -260,6 +444,18 @@ _call_check_authorize_cb(GObject *proxy, GAsyncResult *res, gpointer user_data)
     if (!error) {
         g_variant_get(value, "((bb@a{ss}))", &is_authorized, &is_challenge, NULL);
         _LOG2T(call_id, "completed: authorized=%d, challenge=%d", is_authorized, is_challenge);
+
+        priv->cache.polkit_msec_total +=
+            nm_utils_get_monotonic_timestamp_msec() - call_id->start_msec;
+        priv->cache.polkit_calls++;
+
+        if (call_id->cache_key && call_id->cache_generation == priv->cache.generation) {
+            _cache_add(self,
+                       call_id->cache_key,
+                       call_id->allow_user_interaction,
+                       is_authorized,
+                       is_challenge);
+        }
     } else
         _LOG2T(call_id, "completed: failed: %s", error->message);
 
@@ -310,6 +506,7 @@ nm_auth_manager_check_authorization(NMAuthManager *                         self
     PolkitCheckAuthorizationFlags flags;
     char                          subject_buf[64];
     NMAuthManagerCallId *         call_id;
+    gboolean                      is_authorized;
 
     g_return_val_if_fail(NM_IS_AUTH_MANAGER(self), NULL);
     g_return_val_if_fail(NM_IN_SET(nm_auth_subject_get_subject_type(subject),
@@ -328,11 +525,12 @@ nm_auth_manager_check_authorization(NMAuthManager *                         self
 
     call_id  = g_slice_new(NMAuthManagerCallId);
     *call_id = (NMAuthManagerCallId){
-        .self               = g_object_ref(self),
-        .callback           = callback,
-        .user_data          = user_data,
-        .call_numid         = ++priv->call_numid_counter,
-        .idle_is_authorized = TRUE,
+        .self                   = g_object_ref(self),
+        .callback               = callback,
+        .user_data              = user_data,
+        .call_numid             = ++priv->call_numid_counter,
+        .idle_is_authorized     = TRUE,
+        .allow_user_interaction = allow_user_interaction,
     };
     c_list_link_tail(&priv->calls_lst_head, &call_id->calls_lst);
 
@@ -357,6 +555,22 @@ nm_auth_manager_check_authorization(NMAuthManager *                         self
                priv->auth_polkit_mode == NM_AUTH_POLKIT_MODE_ALLOW_ALL ? "grant" : "deny");
         call_id->idle_is_authorized = (priv->auth_polkit_mode == NM_AUTH_POLKIT_MODE_ALLOW_ALL);
         call_id->idle_id            = g_idle_add(_call_on_idle, call_id);
+    } else if ((call_id->cache_key = _cache_key(subject, action_id))
+               && _cache_lookup(self,
+                                call_id->cache_key,
+                                allow_user_interaction,
+                                &is_authorized)) {
+        _LOG2T(call_id,
+               "CheckAuthorization(%s), subject=%s (cached %s, %" G_GUINT64_FORMAT
+               " hits, %" G_GUINT64_FORMAT " misses, ~%" G_GINT64_FORMAT " msec saved)",
+               action_id,
+               nm_auth_subject_to_string(subject, subject_buf, sizeof(subject_buf)),
+               is_authorized ? "yes" : "no",
+               priv->cache.hits,
+               priv->cache.misses,
+               _cache_saved_msec(priv));
+        call_id->idle_is_authorized = is_authorized;
+        call_id->idle_id            = g_idle_add(_call_on_idle, call_id);
     } else {
         GVariant *      parameters;
         GVariantBuilder builder;
@@ -383,6 +597,8 @@ nm_auth_manager_check_authorization(NMAuthManager *                         self
                nm_auth_subject_to_string(subject, subject_buf, sizeof(subject_buf)));
 
         call_id->dbus_cancellable = g_cancellable_new();
+        call_id->cache_generation = priv->cache.generation;
+        call_id->start_msec       = nm_utils_get_monotonic_timestamp_msec();
 
         nm_assert(priv->main_cancellable);
 
@@ -445,8 +661,10 @@ changed_signal_cb(GDBusConnection *connection,
 
     _LOGD("dbus-signal: \"Changed\" notification%s", valid_sender ? "" : " (ignore)");
 
-    if (valid_sender)
+    if (valid_sender) {
+        _cache_clear(self, "polkit changed");
         _emit_changed_signal(self);
+    }
 }
 
 static void
@@ -469,6 +687,7 @@ _name_owner_changed(NMAuthManager *self, const char *name_owner, gboolean is_ini
     if (is_changed) {
         old_name_owner   = g_steal_pointer(&priv->name_owner);
         priv->name_owner = g_strdup(name_owner);
+        _cache_clear(self, "polkit name owner changed");
     } else {
         if (!is_initial)
             return;
@@ -601,6 +820,8 @@ nm_auth_manager_init(NMAuthManager *self)
     NMAuthManagerPrivate *priv = NM_AUTH_MANAGER_GET_PRIVATE(self);
 
     c_list_init(&priv->calls_lst_head);
+    c_list_init(&priv->cache.lst_head);
+    priv->cache.idx = g_hash_table_new_full(nm_str_hash, g_str_equal, NULL, _cache_entry_free);
     priv->auth_polkit_mode = NM_AUTH_POLKIT_MODE_ROOT_ONLY;
 }
 
@@ -704,6 +925,15 @@ dispose(GObject *object)
 
     nm_assert(c_list_is_empty(&priv->calls_lst_head));
 
+    if (priv->cache.hits + priv->cache.misses > 0) {
+        _LOGD("cache: %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT
+              " misses, ~%" G_GINT64_FORMAT " msec saved",
+              priv->cache.hits,
+              priv->cache.misses,
+              _cache_saved_msec(priv));
+    }
+    nm_clear_pointer(&priv->cache.idx, g_hash_table_destroy);
+
     priv->disposing = TRUE;
 
     nm_clear_g_cancellable(&priv->main_cancellable);
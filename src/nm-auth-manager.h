@@ -85,4 +85,19 @@ nm_auth_manager_check_authorization(NMAuthManager *                         self
 
 void nm_auth_manager_check_authorization_cancel(NMAuthManagerCallId *call_id);
 
+/*****************************************************************************/
+
+/* exposed for tests. */
+gboolean _nm_auth_manager_cache_lookup(NMAuthManager *self,
+                                       NMAuthSubject *subject,
+                                       const char *   action_id,
+                                       gboolean       allow_user_interaction,
+                                       gboolean *     out_is_authorized);
+void     _nm_auth_manager_cache_add(NMAuthManager *self,
+                                    NMAuthSubject *subject,
+                                    const char *   action_id,
+                                    gboolean       allow_user_interaction,
+                                    gboolean       is_authorized,
+                                    gboolean       is_challenge);
+
 #endif /* NM_AUTH_MANAGER_H */
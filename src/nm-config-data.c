@@ -20,12 +20,15 @@ typedef struct {
     char *   group_name;
     gboolean stop_match;
     struct {
-        /* have a separate boolean field @has, because a @spec with
+        /* have a separate boolean field @has, because a @matcher with
          * value %NULL does not necessarily mean, that the property
          * "match-device" was unspecified. */
-        gboolean has;
-        GSList * spec;
+        gboolean           has;
+        NMMatchSpecDevice *matcher;
     } match_device;
+
+    /* the string values of the section, as returned by g_key_file_get_string(). */
+    GHashTable *values;
 } MatchSectionInfo;
 
 struct _NMGlobalDnsDomain {
@@ -1376,7 +1379,6 @@ global_dns_equal(NMGlobalDnsConfig *old, NMGlobalDnsConfig *new)
 
 static const MatchSectionInfo *
 _match_section_infos_lookup(const MatchSectionInfo *match_section_infos,
-                            GKeyFile *              keyfile,
                             const char *            property,
                             NMDevice *              device,
                             const NMPlatformLink *  pllink,
@@ -1391,39 +1393,34 @@ _match_section_infos_lookup(const MatchSectionInfo *match_section_infos,
     match_dhcp_plugin = nm_dhcp_manager_get_config(nm_dhcp_manager_get());
 
     for (; match_section_infos->group_name; match_section_infos++) {
-        char *   value = NULL;
-        gboolean match;
-
-        /* FIXME: Here we use g_key_file_get_string(). This should be in sync with what keyfile-reader
-         * does.
-         *
-         * Unfortunately that is currently not possible because keyfile-reader does the two steps
-         * string_to_value(keyfile_to_string(keyfile)) in one. Optimally, keyfile library would
-         * expose both functions, and we would return here keyfile_to_string(keyfile).
-         * The caller then could convert the string to the proper value via string_to_value(value). */
-        value = g_key_file_get_string(keyfile, match_section_infos->group_name, property, NULL);
+        const char *value = NULL;
+        gboolean    match;
+
+        if (match_section_infos->values)
+            value = g_hash_table_lookup(match_section_infos->values, property);
         if (!value && !match_section_infos->stop_match)
             continue;
 
         if (match_section_infos->match_device.has) {
+            const NMMatchSpecDevice *matcher = match_section_infos->match_device.matcher;
+
             if (device)
-                match = nm_device_spec_match_list(device, match_section_infos->match_device.spec);
+                match = nm_device_spec_match_compiled_full(device, matcher, FALSE);
             else if (pllink)
-                match = nm_match_spec_device_by_pllink(pllink,
-                                                       match_device_type,
-                                                       match_dhcp_plugin,
-                                                       match_section_infos->match_device.spec,
-                                                       FALSE);
+                match = nm_match_spec_device_compiled_by_pllink(pllink,
+                                                                match_device_type,
+                                                                match_dhcp_plugin,
+                                                                matcher,
+                                                                FALSE);
             else
                 match = FALSE;
         } else
             match = TRUE;
 
         if (match) {
-            *out_value = value;
+            *out_value = g_strdup(value);
             return match_section_infos;
         }
-        g_free(value);
     }
     return NULL;
 }
@@ -1446,7 +1443,6 @@ nm_config_data_get_device_config(const NMConfigData *self,
     priv = NM_CONFIG_DATA_GET_PRIVATE(self);
 
     connection_info = _match_section_infos_lookup(&priv->device_infos[0],
-                                                  priv->keyfile,
                                                   property,
                                                   device,
                                                   NULL,
@@ -1473,7 +1469,6 @@ nm_config_data_get_device_config_by_pllink(const NMConfigData *  self,
     priv = NM_CONFIG_DATA_GET_PRIVATE(self);
 
     connection_info = _match_section_infos_lookup(&priv->device_infos[0],
-                                                  priv->keyfile,
                                                   property,
                                                   NULL,
                                                   pllink,
@@ -1505,6 +1500,8 @@ nm_config_data_get_connection_default(const NMConfigData *self,
                                       NMDevice *          device)
 {
     const NMConfigDataPrivate *priv;
+    GHashTable *               cache = NULL;
+    const char *               cached;
     char *                     value = NULL;
 
     g_return_val_if_fail(self, NULL);
@@ -1526,13 +1523,22 @@ nm_config_data_get_connection_default(const NMConfigData *self,
     }
 #endif
 
+    if (device) {
+        /* the lookup only depends on the configuration and on the device. Memoize
+         * the result on the device. */
+        cache = nm_device_get_con_defaults_cache(device, self);
+        if (g_hash_table_lookup_extended(cache, property, NULL, (gpointer *) &cached))
+            return g_strdup(cached);
+    }
+
     _match_section_infos_lookup(&priv->connection_infos[0],
-                                priv->keyfile,
                                 property,
                                 device,
                                 NULL,
                                 NULL,
                                 &value);
+    if (cache)
+        g_hash_table_insert(cache, g_strdup(property), g_strdup(value));
     return value;
 }
 
@@ -1553,16 +1559,43 @@ nm_config_data_get_connection_default_int64(const NMConfigData *self,
 static void
 _get_connection_info_init(MatchSectionInfo *connection_info, GKeyFile *keyfile, char *group)
 {
+    gs_strfreev char **keys = NULL;
+    GSList *           spec;
+    gsize              i;
+
     /* pass ownership of @group on... */
     connection_info->group_name = group;
 
-    connection_info->match_device.spec =
-        nm_config_get_match_spec(keyfile,
-                                 group,
-                                 NM_CONFIG_KEYFILE_KEY_MATCH_DEVICE,
-                                 &connection_info->match_device.has);
+    spec = nm_config_get_match_spec(keyfile,
+                                    group,
+                                    NM_CONFIG_KEYFILE_KEY_MATCH_DEVICE,
+                                    &connection_info->match_device.has);
+    connection_info->match_device.matcher = nm_match_spec_device_compile(spec);
+    g_slist_free_full(spec, g_free);
+
     connection_info->stop_match =
         nm_config_keyfile_get_boolean(keyfile, group, NM_CONFIG_KEYFILE_KEY_STOP_MATCH, FALSE);
+
+    /* FIXME: Here we use g_key_file_get_string(). This should be in sync with what keyfile-reader
+     * does.
+     *
+     * Unfortunately that is currently not possible because keyfile-reader does the two steps
+     * string_to_value(keyfile_to_string(keyfile)) in one. Optimally, keyfile library would
+     * expose both functions, and we would return here keyfile_to_string(keyfile).
+     * The caller then could convert the string to the proper value via string_to_value(value). */
+    keys = g_key_file_get_keys(keyfile, group, NULL, NULL);
+    for (i = 0; keys && keys[i]; i++) {
+        char *value;
+
+        value = g_key_file_get_string(keyfile, group, keys[i], NULL);
+        if (!value)
+            continue;
+        if (!connection_info->values) {
+            connection_info->values =
+                g_hash_table_new_full(nm_str_hash, g_str_equal, g_free, g_free);
+        }
+        g_hash_table_insert(connection_info->values, g_strdup(keys[i]), value);
+    }
 }
 
 static void
@@ -1574,7 +1607,8 @@ _match_section_infos_free(MatchSectionInfo *match_section_infos)
         return;
     for (i = 0; match_section_infos[i].group_name; i++) {
         g_free(match_section_infos[i].group_name);
-        g_slist_free_full(match_section_infos[i].match_device.spec, g_free);
+        nm_match_spec_device_free(match_section_infos[i].match_device.matcher);
+        nm_clear_pointer(&match_section_infos[i].values, g_hash_table_unref);
     }
     g_free(match_section_infos);
 }
@@ -17,6 +17,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <libudev.h>
 #include <linux/if.h>
 #include <linux/if_infiniband.h>
 #include <net/if_arp.h>
@@ -27,6 +28,7 @@
 #include "nm-glib-aux/nm-io-utils.h"
 #include "nm-glib-aux/nm-secret-utils.h"
 #include "nm-glib-aux/nm-time-utils.h"
+#include "nm-udev-aux/nm-udev-utils.h"
 #include "nm-utils.h"
 #include "nm-core-internal.h"
 #include "nm-setting-connection.h"
@@ -315,9 +317,262 @@ _trunk_first_line(char *str)
     return str;
 }
 
+/*****************************************************************************/
+
+/* The result of loading a module is remembered for the lifetime of the
+ * process, so that we don't spawn modprobe over and over for a module
+ * that is either already loaded or cannot be loaded. A uevent of the
+ * "module" subsystem drops the cached result for that module. */
+
+typedef struct {
+    NMUtilsModprobeCallback callback;
+    gpointer                user_data;
+} ModprobeWaiter;
+
+typedef struct {
+    char *  module;
+    GArray *waiters;
+    int     result;
+    bool    pending : 1;
+    bool    has_result : 1;
+} ModprobeEntry;
+
+static struct {
+    GHashTable *  entries;
+    NMUdevClient *udev_client;
+} _modprobe;
+
+static char *
+_modprobe_module_normalize(const char *module)
+{
+    /* modprobe treats '-' and '_' the same, and /sys/module uses '_'. */
+    return g_strdelimit(g_strdup(module), "-", '_');
+}
+
+static gboolean
+_modprobe_module_is_loaded(const char *module_normalized)
+{
+    gs_free char *path = NULL;
+
+    path = g_strdup_printf("/sys/module/%s", module_normalized);
+    return access(path, F_OK) == 0;
+}
+
+static void
+_modprobe_entry_free(gpointer data)
+{
+    ModprobeEntry *entry = data;
+
+    nm_assert(!entry->pending);
+
+    if (entry->waiters)
+        g_array_unref(entry->waiters);
+    g_free(entry->module);
+    nm_g_slice_free(entry);
+}
+
+static void
+_modprobe_udev_event(NMUdevClient *udev_client, struct udev_device *udevice, gpointer user_data)
+{
+    const char *   name;
+    ModprobeEntry *entry;
+
+    name = udev_device_get_sysname(udevice);
+    if (!name || !_modprobe.entries)
+        return;
+
+    entry = g_hash_table_lookup(_modprobe.entries, &name);
+    if (!entry || entry->pending)
+        return;
+
+    nm_log_dbg(LOGD_CORE,
+               "modprobe: module '%s' %s, drop cached result",
+               name,
+               udev_device_get_action(udevice) ?: "changed");
+    g_hash_table_remove(_modprobe.entries, &name);
+}
+
+static ModprobeEntry *
+_modprobe_entry_get(const char *module_normalized, gboolean create)
+{
+    ModprobeEntry *entry;
+
+    if (!_modprobe.entries) {
+        if (!create)
+            return NULL;
+        _modprobe.entries =
+            g_hash_table_new_full(nm_pstr_hash, nm_pstr_equal, NULL, _modprobe_entry_free);
+        _modprobe.udev_client =
+            nm_udev_client_new(NM_MAKE_STRV("module"), _modprobe_udev_event, NULL);
+    }
+
+    entry = g_hash_table_lookup(_modprobe.entries, &module_normalized);
+    if (!entry && create) {
+        entry  = g_slice_new(ModprobeEntry);
+        *entry = (ModprobeEntry){
+            .module = g_strdup(module_normalized),
+        };
+        g_hash_table_add(_modprobe.entries, entry);
+    }
+    return entry;
+}
+
+static void
+_modprobe_cache_result(const char *module_normalized, int result)
+{
+    ModprobeEntry *entry;
+
+    entry             = _modprobe_entry_get(module_normalized, TRUE);
+    entry->result     = result;
+    entry->has_result = TRUE;
+}
+
+static int
+_modprobe_exit_status(int status)
+{
+    if (WIFEXITED(status))
+        return WEXITSTATUS(status);
+    return -1;
+}
+
+static void
+_modprobe_complete(ModprobeEntry *entry, int result)
+{
+    gs_unref_array GArray *waiters = NULL;
+    gs_free char *         module  = NULL;
+    guint                  i;
+
+    entry->pending    = FALSE;
+    entry->result     = result;
+    entry->has_result = TRUE;
+    waiters           = g_steal_pointer(&entry->waiters);
+
+    if (!waiters)
+        return;
+
+    /* The callbacks may start another modprobe or trigger a udev event
+     * that drops @entry. Don't touch it anymore. */
+    module = g_strdup(entry->module);
+    for (i = 0; i < waiters->len; i++) {
+        const ModprobeWaiter *w = &g_array_index(waiters, ModprobeWaiter, i);
+
+        w->callback(module, result, w->user_data);
+    }
+}
+
+static void
+_modprobe_watch_cb(GPid pid, int status, gpointer user_data)
+{
+    gs_free char * module = user_data;
+    ModprobeEntry *entry;
+    int            result;
+
+    result = _modprobe_exit_status(status);
+    if (result != 0) {
+        nm_log_dbg(LOGD_CORE,
+                   "modprobe: '%s' [pid %lld] exited with error %d",
+                   module,
+                   (long long) pid,
+                   result);
+    } else
+        nm_log_dbg(LOGD_CORE, "modprobe: '%s' [pid %lld] succeeded", module, (long long) pid);
+
+    entry = _modprobe_entry_get(module, FALSE);
+    if (entry && entry->pending)
+        _modprobe_complete(entry, result);
+}
+
+static gboolean
+_modprobe_cached_cb(gpointer user_data)
+{
+    gs_free char * module = user_data;
+    ModprobeEntry *entry;
+
+    entry = _modprobe_entry_get(module, FALSE);
+    if (entry && entry->pending)
+        _modprobe_complete(entry, entry->result);
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * nm_utils_modprobe_async:
+ * @module: the name of the kernel module to load.
+ * @callback: (allow-none): called with the exit status of modprobe
+ *   (or -1 if spawning failed) once the module is loaded.
+ * @user_data: user data for @callback.
+ *
+ * Loads @module without blocking. Concurrent requests for the same
+ * module share one modprobe process. If the module is already loaded,
+ * or if a previous attempt already has a result, no process is spawned
+ * at all. @callback is always invoked asynchronously.
+ */
+void
+nm_utils_modprobe_async(const char *module, NMUtilsModprobeCallback callback, gpointer user_data)
+{
+    gs_free char *        module_normalized = NULL;
+    gs_free_error GError *error             = NULL;
+    ModprobeEntry *       entry;
+    GPid                  pid;
+    const char *const *   argv;
+
+    g_return_if_fail(module);
+
+    module_normalized = _modprobe_module_normalize(module);
+
+    entry = _modprobe_entry_get(module_normalized, TRUE);
+
+    if (callback) {
+        if (!entry->waiters)
+            entry->waiters = g_array_new(FALSE, FALSE, sizeof(ModprobeWaiter));
+        g_array_append_val(entry->waiters,
+                           ((ModprobeWaiter){
+                               .callback  = callback,
+                               .user_data = user_data,
+                           }));
+    }
+
+    if (entry->pending)
+        return;
+
+    if (!entry->has_result && _modprobe_module_is_loaded(module_normalized)) {
+        nm_log_dbg(LOGD_CORE, "modprobe: module '%s' is already loaded", module_normalized);
+        entry->result     = 0;
+        entry->has_result = TRUE;
+    }
+
+    entry->pending = TRUE;
+
+    if (entry->has_result) {
+        g_idle_add(_modprobe_cached_cb, g_steal_pointer(&module_normalized));
+        return;
+    }
+
+    argv = NM_MAKE_STRV("/sbin/modprobe", "--use-blacklist", module_normalized);
+    nm_log_dbg(LOGD_CORE, "modprobe: '%s' (async)", module_normalized);
+    if (!g_spawn_async(NULL,
+                       (char **) argv,
+                       NULL,
+                       G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDOUT_TO_DEV_NULL
+                           | G_SPAWN_STDERR_TO_DEV_NULL,
+                       NULL,
+                       NULL,
+                       &pid,
+                       &error)) {
+        nm_log_dbg(LOGD_CORE, "modprobe: '%s' failed: %s", module_normalized, error->message);
+        entry->result     = -1;
+        entry->has_result = TRUE;
+        g_idle_add(_modprobe_cached_cb, g_steal_pointer(&module_normalized));
+        return;
+    }
+
+    g_child_watch_add(pid, _modprobe_watch_cb, g_steal_pointer(&module_normalized));
+}
+
 int
 nm_utils_modprobe(GError **error, gboolean suppress_error_logging, const char *arg1, ...)
 {
+    gs_free char *               module_normalized = NULL;
+    ModprobeEntry *              entry;
     gs_unref_ptrarray GPtrArray *argv = NULL;
     int                          exit_status;
     gs_free char *               _log_str = NULL;
@@ -331,6 +586,29 @@ nm_utils_modprobe(GError **error, gboolean suppress_error_logging, const char *a
     g_return_val_if_fail(!error || !*error, -1);
     g_return_val_if_fail(arg1, -1);
 
+    module_normalized = _modprobe_module_normalize(arg1);
+
+    if (_modprobe_module_is_loaded(module_normalized)) {
+        nm_log_dbg(LOGD_CORE, "modprobe: module '%s' is already loaded", module_normalized);
+        return 0;
+    }
+
+    entry = _modprobe_entry_get(module_normalized, FALSE);
+    if (entry && entry->has_result) {
+        nm_log_dbg(LOGD_CORE,
+                   "modprobe: module '%s' was already tried (result %d)",
+                   module_normalized,
+                   entry->result);
+        if (entry->result == -1) {
+            g_set_error(error,
+                        NM_UTILS_ERROR,
+                        NM_UTILS_ERROR_UNKNOWN,
+                        "modprobe of '%s' failed before",
+                        module_normalized);
+        }
+        return entry->result;
+    }
+
     /* construct the argument list */
     argv = g_ptr_array_sized_new(4);
     g_ptr_array_add(argv, "/sbin/modprobe");
@@ -363,6 +641,7 @@ nm_utils_modprobe(GError **error, gboolean suppress_error_logging, const char *a
                ARGV_TO_STR(argv),
                local->message);
         g_propagate_error(error, local);
+        _modprobe_cache_result(module_normalized, -1);
         return -1;
     } else if (exit_status != 0) {
         nm_log(llevel,
@@ -380,6 +659,7 @@ nm_utils_modprobe(GError **error, gboolean suppress_error_logging, const char *a
                std_err && *std_err ? ")" : "");
     }
 
+    _modprobe_cache_result(module_normalized, exit_status);
     return exit_status;
 }
 
@@ -1590,6 +1870,375 @@ nm_match_spec_device(const GSList *specs,
     return _match_result(has_except, has_not_except, has_match, has_match_except);
 }
 
+/*****************************************************************************/
+
+typedef struct {
+    char *        driver;
+    gsize         driver_len;
+    GPatternSpec *driver_version;
+} MatchSpecDriverVersion;
+
+typedef struct {
+    guint32 a;
+    guint32 b;
+    guint32 c;
+} MatchSpecS390Subchannels;
+
+typedef struct {
+    /* The compiled form of either the positive or the "except:" specs. The
+     * containers are only allocated when there is a spec of that kind. */
+    GHashTable *interface_names;
+    GPtrArray * interface_patterns;
+    GHashTable *hwaddrs;
+    GHashTable *device_types;
+    GHashTable *drivers;
+    GArray *    driver_versions;
+    GArray *    s390_subchannels;
+    GHashTable *dhcp_plugins;
+    bool        match_all;
+} MatchSpecDeviceSet;
+
+struct _NMMatchSpecDevice {
+    MatchSpecDeviceSet match;
+    MatchSpecDeviceSet match_except;
+    bool               has_except;
+    bool               has_not_except;
+};
+
+static GBytes *
+_match_spec_hwaddr_to_key(const guint8 *bin, gsize len)
+{
+    guint8 buf[NM_UTILS_HWADDR_LEN_MAX];
+
+    nm_assert(len > 0 && len <= sizeof(buf));
+
+    /* nm_utils_hwaddr_matches() only considers the last 8 bytes of
+     * an infiniband address. Mask the rest. */
+    memcpy(buf, bin, len);
+    if (len == INFINIBAND_ALEN)
+        memset(buf, 0, INFINIBAND_ALEN - 8);
+    return g_bytes_new(buf, len);
+}
+
+static void
+_match_spec_set_add_str(GHashTable **p_set, const char *str)
+{
+    if (!*p_set)
+        *p_set = g_hash_table_new_full(nm_str_hash, g_str_equal, g_free, NULL);
+    g_hash_table_add(*p_set, g_strdup(str));
+}
+
+static void
+_match_spec_set_add_hwaddr(MatchSpecDeviceSet *set, const char *spec_str)
+{
+    guint8 bin[NM_UTILS_HWADDR_LEN_MAX];
+    gsize  len;
+
+    if (!_nm_utils_hwaddr_aton(spec_str, bin, sizeof(bin), &len) || len == 0)
+        return;
+    if (!set->hwaddrs) {
+        set->hwaddrs = g_hash_table_new_full(g_bytes_hash,
+                                             g_bytes_equal,
+                                             (GDestroyNotify) g_bytes_unref,
+                                             NULL);
+    }
+    g_hash_table_add(set->hwaddrs, _match_spec_hwaddr_to_key(bin, len));
+}
+
+static void
+_match_spec_set_add_interface_pattern(MatchSpecDeviceSet *set, const char *pattern)
+{
+    if (!set->interface_patterns)
+        set->interface_patterns =
+            g_ptr_array_new_with_free_func((GDestroyNotify) g_pattern_spec_free);
+    g_ptr_array_add(set->interface_patterns, g_pattern_spec_new(pattern));
+}
+
+static void
+_match_spec_set_compile(MatchSpecDeviceSet *set, const char *spec_str, gboolean allow_fuzzy)
+{
+    /* This must be kept in sync with match_device_eval(). */
+
+    if (spec_str[0] == '*' && spec_str[1] == '\0') {
+        set->match_all = TRUE;
+        return;
+    }
+
+    if (_MATCH_CHECK(spec_str, DEVICE_TYPE_TAG)) {
+        _match_spec_set_add_str(&set->device_types, spec_str);
+        return;
+    }
+
+    if (_MATCH_CHECK(spec_str, NM_MATCH_SPEC_MAC_TAG)) {
+        _match_spec_set_add_hwaddr(set, spec_str);
+        return;
+    }
+
+    if (_MATCH_CHECK(spec_str, NM_MATCH_SPEC_INTERFACE_NAME_TAG)) {
+        gboolean use_pattern = FALSE;
+
+        if (spec_str[0] == '=')
+            spec_str += 1;
+        else {
+            if (spec_str[0] == '~')
+                spec_str += 1;
+            use_pattern = TRUE;
+        }
+
+        /* a pattern without wildcards only matches literally. */
+        if (use_pattern && strpbrk(spec_str, "*?"))
+            _match_spec_set_add_interface_pattern(set, spec_str);
+        else
+            _match_spec_set_add_str(&set->interface_names, spec_str);
+        return;
+    }
+
+    if (_MATCH_CHECK(spec_str, DRIVER_TAG)) {
+        MatchSpecDriverVersion *d;
+        const char *            t;
+
+        t = strrchr(spec_str, '/');
+        if (!t) {
+            _match_spec_set_add_str(&set->drivers, spec_str);
+            return;
+        }
+
+        if (!set->driver_versions)
+            set->driver_versions = g_array_new(FALSE, FALSE, sizeof(MatchSpecDriverVersion));
+        g_array_set_size(set->driver_versions, set->driver_versions->len + 1);
+        d  = &g_array_index(set->driver_versions,
+                           MatchSpecDriverVersion,
+                           set->driver_versions->len - 1);
+        *d = (MatchSpecDriverVersion){
+            .driver         = g_strndup(spec_str, t - spec_str),
+            .driver_len     = t - spec_str,
+            .driver_version = g_pattern_spec_new(&t[1]),
+        };
+        return;
+    }
+
+    if (_MATCH_CHECK(spec_str, NM_MATCH_SPEC_S390_SUBCHANNELS_TAG)) {
+        MatchSpecS390Subchannels s;
+
+        if (!match_device_s390_subchannels_parse(spec_str, &s.a, &s.b, &s.c))
+            return;
+        if (!set->s390_subchannels)
+            set->s390_subchannels = g_array_new(FALSE, FALSE, sizeof(MatchSpecS390Subchannels));
+        g_array_append_val(set->s390_subchannels, s);
+        return;
+    }
+
+    if (_MATCH_CHECK(spec_str, DHCP_PLUGIN_TAG)) {
+        _match_spec_set_add_str(&set->dhcp_plugins, spec_str);
+        return;
+    }
+
+    if (allow_fuzzy) {
+        _match_spec_set_add_hwaddr(set, spec_str);
+        _match_spec_set_add_str(&set->interface_names, spec_str);
+    }
+}
+
+static void
+_match_spec_set_clear(MatchSpecDeviceSet *set)
+{
+    guint i;
+
+    nm_clear_pointer(&set->interface_names, g_hash_table_unref);
+    nm_clear_pointer(&set->interface_patterns, g_ptr_array_unref);
+    nm_clear_pointer(&set->hwaddrs, g_hash_table_unref);
+    nm_clear_pointer(&set->device_types, g_hash_table_unref);
+    nm_clear_pointer(&set->drivers, g_hash_table_unref);
+    if (set->driver_versions) {
+        for (i = 0; i < set->driver_versions->len; i++) {
+            MatchSpecDriverVersion *d =
+                &g_array_index(set->driver_versions, MatchSpecDriverVersion, i);
+
+            g_free(d->driver);
+            g_pattern_spec_free(d->driver_version);
+        }
+        nm_clear_pointer(&set->driver_versions, g_array_unref);
+    }
+    nm_clear_pointer(&set->s390_subchannels, g_array_unref);
+    nm_clear_pointer(&set->dhcp_plugins, g_hash_table_unref);
+}
+
+/**
+ * nm_match_spec_device_compile:
+ * @specs: the list of device specs.
+ *
+ * Pre-processes @specs for repeated evaluation with nm_match_spec_device_eval().
+ * The result is the same as with nm_match_spec_device(), but the specs
+ * are only parsed once and names and MAC addresses are looked up in
+ * hash tables.
+ *
+ * Returns: the compiled matcher, or %NULL if @specs contains no specs.
+ *   A %NULL matcher never matches.
+ */
+NMMatchSpecDevice *
+nm_match_spec_device_compile(const GSList *specs)
+{
+    NMMatchSpecDevice *matcher = NULL;
+    const GSList *     iter;
+
+    for (iter = specs; iter; iter = iter->next) {
+        const char *spec_str = iter->data;
+        gboolean    except;
+
+        if (!spec_str || !*spec_str)
+            continue;
+
+        if (!matcher)
+            matcher = g_slice_new0(NMMatchSpecDevice);
+
+        spec_str = match_except(spec_str, &except);
+        if (except) {
+            matcher->has_except = TRUE;
+            _match_spec_set_compile(&matcher->match_except, spec_str, FALSE);
+        } else {
+            matcher->has_not_except = TRUE;
+            _match_spec_set_compile(&matcher->match, spec_str, TRUE);
+        }
+    }
+
+    return matcher;
+}
+
+void
+nm_match_spec_device_free(NMMatchSpecDevice *matcher)
+{
+    if (!matcher)
+        return;
+    _match_spec_set_clear(&matcher->match);
+    _match_spec_set_clear(&matcher->match_except);
+    nm_g_slice_free(matcher);
+}
+
+static gboolean
+_match_spec_set_eval(const MatchSpecDeviceSet *set, MatchDeviceData *match_data)
+{
+    guint i;
+
+    if (set->match_all)
+        return TRUE;
+
+    if (match_data->interface_name) {
+        if (set->interface_names
+            && g_hash_table_contains(set->interface_names, match_data->interface_name))
+            return TRUE;
+        if (set->interface_patterns) {
+            for (i = 0; i < set->interface_patterns->len; i++) {
+                if (g_pattern_match_string(set->interface_patterns->pdata[i],
+                                           match_data->interface_name))
+                    return TRUE;
+            }
+        }
+    }
+
+    if (set->hwaddrs && match_data->hwaddr.value) {
+        gs_unref_bytes GBytes *key = NULL;
+
+        if (!match_data->hwaddr.is_parsed) {
+            gsize l;
+
+            match_data->hwaddr.is_parsed = TRUE;
+            if (_nm_utils_hwaddr_aton(match_data->hwaddr.value,
+                                      match_data->hwaddr.bin,
+                                      sizeof(match_data->hwaddr.bin),
+                                      &l))
+                match_data->hwaddr.len = l;
+        }
+        if (match_data->hwaddr.len > 0) {
+            key = _match_spec_hwaddr_to_key(match_data->hwaddr.bin, match_data->hwaddr.len);
+            if (g_hash_table_contains(set->hwaddrs, key))
+                return TRUE;
+        }
+    }
+
+    if (set->device_types && match_data->device_type
+        && g_hash_table_contains(set->device_types, match_data->device_type))
+        return TRUE;
+
+    if (match_data->driver) {
+        if (set->drivers && g_hash_table_contains(set->drivers, match_data->driver))
+            return TRUE;
+        if (set->driver_versions) {
+            for (i = 0; i < set->driver_versions->len; i++) {
+                const MatchSpecDriverVersion *d =
+                    &g_array_index(set->driver_versions, MatchSpecDriverVersion, i);
+
+                if (strncmp(d->driver, match_data->driver, d->driver_len) == 0
+                    && g_pattern_match_string(d->driver_version,
+                                              match_data->driver_version ?: ""))
+                    return TRUE;
+            }
+        }
+    }
+
+    if (set->s390_subchannels && match_data->s390_subchannels.value) {
+        if (!match_data->s390_subchannels.is_parsed) {
+            match_data->s390_subchannels.is_parsed = TRUE;
+            if (!match_device_s390_subchannels_parse(match_data->s390_subchannels.value,
+                                                     &match_data->s390_subchannels.a,
+                                                     &match_data->s390_subchannels.b,
+                                                     &match_data->s390_subchannels.c))
+                match_data->s390_subchannels.value = NULL;
+        }
+        for (i = 0; match_data->s390_subchannels.value && i < set->s390_subchannels->len; i++) {
+            const MatchSpecS390Subchannels *s =
+                &g_array_index(set->s390_subchannels, MatchSpecS390Subchannels, i);
+
+            if (s->a == match_data->s390_subchannels.a && s->b == match_data->s390_subchannels.b
+                && s->c == match_data->s390_subchannels.c)
+                return TRUE;
+        }
+    }
+
+    if (set->dhcp_plugins && match_data->dhcp_plugin
+        && g_hash_table_contains(set->dhcp_plugins, match_data->dhcp_plugin))
+        return TRUE;
+
+    return FALSE;
+}
+
+NMMatchSpecMatchType
+nm_match_spec_device_eval(const NMMatchSpecDevice *matcher,
+                          const char *             interface_name,
+                          const char *             device_type,
+                          const char *             driver,
+                          const char *             driver_version,
+                          const char *             hwaddr,
+                          const char *             s390_subchannels,
+                          const char *             dhcp_plugin)
+{
+    MatchDeviceData match_data = {
+        .interface_name = interface_name,
+        .device_type    = nm_str_not_empty(device_type),
+        .driver         = nm_str_not_empty(driver),
+        .driver_version = nm_str_not_empty(driver_version),
+        .dhcp_plugin    = nm_str_not_empty(dhcp_plugin),
+        .hwaddr =
+            {
+                .value = hwaddr,
+            },
+        .s390_subchannels =
+            {
+                .value = s390_subchannels,
+            },
+    };
+
+    nm_assert(!hwaddr || nm_utils_hwaddr_valid(hwaddr, -1));
+
+    if (!matcher)
+        return NM_MATCH_SPEC_NO_MATCH;
+
+    return _match_result(
+        matcher->has_except,
+        matcher->has_not_except,
+        matcher->has_not_except && _match_spec_set_eval(&matcher->match, &match_data),
+        matcher->has_except && _match_spec_set_eval(&matcher->match_except, &match_data));
+}
+
 static gboolean
 match_config_eval(const char *str, const char *tag, guint cur_nm_version)
 {
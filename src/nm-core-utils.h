@@ -224,6 +224,11 @@ nm_utils_ip_route_metric_penalize(guint32 metric, guint32 penalty)
 int nm_utils_modprobe(GError **error, gboolean suppress_error_loggin, const char *arg1, ...)
     G_GNUC_NULL_TERMINATED;
 
+typedef void (*NMUtilsModprobeCallback)(const char *module, int exit_status, gpointer user_data);
+
+void
+nm_utils_modprobe_async(const char *module, NMUtilsModprobeCallback callback, gpointer user_data);
+
 void nm_utils_kill_process_sync(pid_t       pid,
                                 guint64     start_time,
                                 int         sig,
@@ -274,6 +279,19 @@ NMMatchSpecMatchType nm_match_spec_device(const GSList *specs,
                                           const char *  hwaddr,
                                           const char *  s390_subchannels,
                                           const char *  dhcp_plugin);
+typedef struct _NMMatchSpecDevice NMMatchSpecDevice;
+
+NMMatchSpecDevice *  nm_match_spec_device_compile(const GSList *specs);
+void                 nm_match_spec_device_free(NMMatchSpecDevice *matcher);
+NMMatchSpecMatchType nm_match_spec_device_eval(const NMMatchSpecDevice *matcher,
+                                               const char *             interface_name,
+                                               const char *             device_type,
+                                               const char *             driver,
+                                               const char *             driver_version,
+                                               const char *             hwaddr,
+                                               const char *             s390_subchannels,
+                                               const char *             dhcp_plugin);
+
 NMMatchSpecMatchType nm_match_spec_config(const GSList *specs, guint nm_version, const char *env);
 GSList *             nm_match_spec_split(const char *value);
 char *               nm_match_spec_join(GSList *specs);
@@ -20,6 +20,7 @@
 #include "nm-dbus-object.h"
 #include "NetworkManagerUtils.h"
 #include "nm-libnm-core-intern/nm-auth-subject.h"
+#include "nm-main-loop-profiler.h"
 
 /* The base path for our GDBusObjectManagerServers.  They do not contain
  * "NetworkManager" because GDBusObjectManagerServer requires that all
@@ -762,6 +763,19 @@ _reg_data_get_interface_info(RegistrationData *reg_data)
 
 /*****************************************************************************/
 
+static const char *
+_method_profile_name(const NMDBusInterfaceInfoExtended *interface_info,
+                     const NMDBusMethodInfoExtended *   method_info)
+{
+    gs_free char *name = NULL;
+
+    if (!_nm_main_loop_profiler_enabled)
+        return NULL;
+
+    name = g_strdup_printf("D-Bus %s.%s()", interface_info->parent.name, method_info->parent.name);
+    return g_intern_string(name);
+}
+
 static void
 dbus_vtable_method_call(GDBusConnection *      connection,
                         const char *           sender,
@@ -850,13 +864,17 @@ dbus_vtable_method_call(GDBusConnection *      connection,
         return;
     }
 
-    method_info->handle(reg_data->obj,
-                        interface_info,
-                        method_info,
-                        connection,
-                        sender,
-                        invocation,
-                        parameters);
+    {
+        NM_MAIN_LOOP_PROFILE_SCOPE(_method_profile_name(interface_info, method_info));
+
+        method_info->handle(reg_data->obj,
+                            interface_info,
+                            method_info,
+                            connection,
+                            sender,
+                            invocation,
+                            parameters);
+    }
 }
 
 static GVariant *
@@ -15,6 +15,7 @@
 
 #define FIREWALL_DBUS_SERVICE        "org.fedoraproject.FirewallD1"
 #define FIREWALL_DBUS_PATH           "/org/fedoraproject/FirewallD1"
+#define FIREWALL_DBUS_INTERFACE      "org.fedoraproject.FirewallD1"
 #define FIREWALL_DBUS_INTERFACE_ZONE "org.fedoraproject.FirewallD1.zone"
 
 /*****************************************************************************/
@@ -30,7 +31,12 @@ typedef struct {
 
     CList pending_calls;
 
+    /* Per-interface request queues (IfaceData). */
+    GHashTable *ifaces;
+
     guint name_owner_changed_id;
+    guint zone_changed_id;
+    guint reloaded_id;
 
     bool dbus_inited : 1;
     bool running : 1;
@@ -62,12 +68,37 @@ typedef enum {
     OPS_TYPE_REMOVE,
 } OpsType;
 
+/* Requests for the same interface are sent to firewalld one at a time, in
+ * order. A queued request is superseded by a newer one for the same
+ * interface only if it has the same type and is last in the queue, so
+ * requests are never reordered. Requests for different interfaces are
+ * independent and run in parallel. */
+typedef struct {
+    /* must be the first field, the hash uses nm_pstr_hash(). */
+    char *iface;
+
+    CList calls_lst_head;
+
+    NMFirewallManagerCallId *call_in_flight;
+
+    /* The zone firewalld has for the interface according to our last
+     * successful request, "" for the default zone. Only valid if
+     * zone_known is set. */
+    char *zone;
+
+    bool zone_known : 1;
+} IfaceData;
+
 struct _NMFirewallManagerCallId {
     CList lst;
 
     NMFirewallManager *self;
 
     char *iface;
+    char *zone;
+
+    IfaceData *iface_data;
+    CList      iface_lst;
 
     NMFirewallManagerAddRemoveCallback callback;
     gpointer                           user_data;
@@ -154,7 +185,7 @@ _get_running(NMFirewallManagerPrivate *priv)
      * service is indeed running. That is the time when we queue the
      * requests, and they will be started once the get-name-owner call
      * returns. */
-    return priv->running || (priv->dbus_connection && !priv->dbus_inited);
+    return priv->running || !priv->dbus_inited;
 }
 
 gboolean
@@ -167,6 +198,59 @@ nm_firewall_manager_get_running(NMFirewallManager *self)
 
 /*****************************************************************************/
 
+static void
+_iface_data_free(gpointer data)
+{
+    IfaceData *iface_data = data;
+
+    nm_assert(c_list_is_empty(&iface_data->calls_lst_head));
+    nm_assert(!iface_data->call_in_flight);
+
+    g_free(iface_data->iface);
+    g_free(iface_data->zone);
+    nm_g_slice_free(iface_data);
+}
+
+static IfaceData *
+_iface_data_get(NMFirewallManager *self, const char *iface, gboolean create)
+{
+    NMFirewallManagerPrivate *priv = NM_FIREWALL_MANAGER_GET_PRIVATE(self);
+    IfaceData *               iface_data;
+
+    iface_data = g_hash_table_lookup(priv->ifaces, &iface);
+    if (!iface_data && create) {
+        iface_data  = g_slice_new(IfaceData);
+        *iface_data = (IfaceData){
+            .iface          = g_strdup(iface),
+            .calls_lst_head = C_LIST_INIT(iface_data->calls_lst_head),
+        };
+        g_hash_table_add(priv->ifaces, iface_data);
+    }
+    return iface_data;
+}
+
+static void
+_iface_data_set_zone(IfaceData *iface_data, gboolean zone_known, const char *zone)
+{
+    iface_data->zone_known = zone_known;
+    if (zone_known)
+        nm_utils_strdup_reset(&iface_data->zone, zone ?: "");
+    else
+        nm_clear_g_free(&iface_data->zone);
+}
+
+static void
+_iface_data_maybe_free(NMFirewallManager *self, IfaceData *iface_data)
+{
+    NMFirewallManagerPrivate *priv = NM_FIREWALL_MANAGER_GET_PRIVATE(self);
+
+    /* Once idle, we only need to remember interfaces that are in a zone,
+     * for the fast path in _iface_dispatch(). */
+    if (c_list_is_empty(&iface_data->calls_lst_head) && !iface_data->call_in_flight
+        && !iface_data->zone_known)
+        g_hash_table_remove(priv->ifaces, iface_data);
+}
+
 static NMFirewallManagerCallId *
 _cb_info_create(NMFirewallManager *                self,
                 OpsType                            ops_type,
@@ -183,8 +267,10 @@ _cb_info_create(NMFirewallManager *                self,
     call_id->self      = g_object_ref(self);
     call_id->ops_type  = ops_type;
     call_id->iface     = g_strdup(iface);
+    call_id->zone      = g_strdup(zone);
     call_id->callback  = callback;
     call_id->user_data = user_data;
+    c_list_init(&call_id->iface_lst);
 
     if (_get_running(priv)) {
         call_id->is_idle  = FALSE;
@@ -197,11 +283,27 @@ _cb_info_create(NMFirewallManager *                self,
     return call_id;
 }
 
+static void _iface_dispatch(NMFirewallManager *self, IfaceData *iface_data);
+
 static void
 _cb_info_complete(NMFirewallManagerCallId *call_id, GError *error)
 {
+    IfaceData *iface_data;
+
     c_list_unlink(&call_id->lst);
 
+    iface_data = g_steal_pointer(&call_id->iface_data);
+    if (iface_data) {
+        if (iface_data->call_in_flight == call_id)
+            iface_data->call_in_flight = NULL;
+        else
+            c_list_unlink(&call_id->iface_lst);
+
+        /* Start the next request before invoking the callback. The callback
+         * may schedule or cancel requests, which can free @iface_data. */
+        _iface_dispatch(call_id->self, iface_data);
+    }
+
     if (call_id->callback)
         call_id->callback(call_id->self, call_id, error, call_id->user_data);
 
@@ -212,6 +314,7 @@ _cb_info_complete(NMFirewallManagerCallId *call_id, GError *error)
         nm_clear_g_cancellable(&call_id->dbus.cancellable);
     }
     g_free(call_id->iface);
+    g_free(call_id->zone);
     g_object_unref(call_id->self);
     nm_g_slice_free(call_id);
 }
@@ -302,6 +405,12 @@ _handle_dbus_cb(GObject *source, GAsyncResult *result, gpointer user_data)
     } else
         _LOGD(call_id, "complete: success");
 
+    if (call_id->iface_data) {
+        _iface_data_set_zone(call_id->iface_data,
+                             !error && call_id->ops_type != OPS_TYPE_REMOVE,
+                             call_id->zone);
+    }
+
     g_clear_object(&call_id->dbus.cancellable);
 
     _cb_info_complete(call_id, error);
@@ -354,6 +463,63 @@ _handle_dbus_start(NMFirewallManager *self, NMFirewallManagerCallId *call_id)
                            call_id);
 }
 
+static void
+_iface_call_to_idle(NMFirewallManager *self, NMFirewallManagerCallId *call_id)
+{
+    nm_assert(!call_id->is_idle);
+    nm_assert(!call_id->dbus.cancellable);
+    nm_assert(call_id->iface_data);
+    nm_assert(call_id->iface_data->call_in_flight != call_id);
+
+    c_list_unlink(&call_id->iface_lst);
+    call_id->iface_data = NULL;
+
+    nm_clear_pointer(&call_id->dbus.arg, g_variant_unref);
+    call_id->is_idle = TRUE;
+    _handle_idle_start(self, call_id);
+}
+
+static void
+_iface_dispatch(NMFirewallManager *self, IfaceData *iface_data)
+{
+    NMFirewallManagerPrivate *priv = NM_FIREWALL_MANAGER_GET_PRIVATE(self);
+    NMFirewallManagerCallId * call_id;
+
+    while (!iface_data->call_in_flight) {
+        call_id = c_list_first_entry(&iface_data->calls_lst_head,
+                                     NMFirewallManagerCallId,
+                                     iface_lst);
+        if (!call_id)
+            break;
+
+        if (!priv->running) {
+            if (!priv->dbus_inited) {
+                /* wait for the get-name-owner call. */
+                return;
+            }
+            _LOGD(call_id, "firewall not running, fake success on idle");
+            _iface_call_to_idle(self, call_id);
+            continue;
+        }
+
+        if (call_id->ops_type != OPS_TYPE_REMOVE && iface_data->zone_known
+            && nm_streq(iface_data->zone, call_id->zone ?: "")) {
+            _LOGD(call_id, "interface is already in the zone, fake success on idle");
+            _iface_call_to_idle(self, call_id);
+            continue;
+        }
+
+        /* until the request completes, we don't know the zone. */
+        _iface_data_set_zone(iface_data, FALSE, NULL);
+
+        c_list_unlink(&call_id->iface_lst);
+        iface_data->call_in_flight = call_id;
+        _handle_dbus_start(self, call_id);
+    }
+
+    _iface_data_maybe_free(self, iface_data);
+}
+
 static NMFirewallManagerCallId *
 _start_request(NMFirewallManager *                self,
                OpsType                            ops_type,
@@ -381,10 +547,30 @@ _start_request(NMFirewallManager *                self,
                            : (!priv->running ? " (waiting to initialize)" : ""));
 
     if (!call_id->is_idle) {
-        if (priv->running)
-            _handle_dbus_start(self, call_id);
-        if (!call_id->callback) {
+        IfaceData *              iface_data;
+        NMFirewallManagerCallId *call_id_old;
+
+        iface_data = _iface_data_get(self, iface, TRUE);
+
+        /* Only the last queued request can be superseded, and only by a
+         * request of the same type. Anything before it must still reach
+         * firewalld, for example a remove that is queued ahead of an add
+         * to a different zone. */
+        call_id_old = c_list_last_entry(&iface_data->calls_lst_head,
+                                        NMFirewallManagerCallId,
+                                        iface_lst);
+        if (call_id_old && call_id_old->ops_type == ops_type) {
+            _LOGD(call_id_old, "superseded by a newer request, fake success on idle");
+            _iface_call_to_idle(self, call_id_old);
+        }
+
+        call_id->iface_data = iface_data;
+        c_list_link_tail(&iface_data->calls_lst_head, &call_id->iface_lst);
+        _iface_dispatch(self, iface_data);
+
+        if (!callback) {
             /* if the user did not provide a callback, the call_id is useless.
+             * It might even be completed and freed already.
              * Especially, the user cannot use the call-id to cancel the request,
              * because he cannot know whether the request is still pending.
              *
@@ -453,6 +639,110 @@ nm_firewall_manager_cancel_call(NMFirewallManagerCallId *call_id)
     _cb_info_complete(call_id, error);
 }
 
+NMFirewallManager *
+_nm_firewall_manager_new_paused(void)
+{
+    NMFirewallManager *       self = g_object_new(NM_TYPE_FIREWALL_MANAGER, NULL);
+    NMFirewallManagerPrivate *priv = NM_FIREWALL_MANAGER_GET_PRIVATE(self);
+
+    nm_assert(!priv->dbus_connection);
+
+    /* like while waiting for the initial get-name-owner call, requests
+     * get queued until _nm_firewall_manager_unpause(). */
+    priv->dbus_inited = FALSE;
+    return self;
+}
+
+/*****************************************************************************/
+
+static void
+_ifaces_forget_zones(NMFirewallManager *self, const char *iface)
+{
+    NMFirewallManagerPrivate *priv = NM_FIREWALL_MANAGER_GET_PRIVATE(self);
+    gs_free IfaceData **      arr  = NULL;
+    IfaceData *               iface_data;
+    guint                     i, len;
+
+    if (iface) {
+        iface_data = _iface_data_get(self, iface, FALSE);
+        if (iface_data && iface_data->zone_known) {
+            _LOGT(NULL, "forget zone of interface \"%s\"", iface);
+            _iface_data_set_zone(iface_data, FALSE, NULL);
+            _iface_data_maybe_free(self, iface_data);
+        }
+        return;
+    }
+
+    arr = (IfaceData **) nm_utils_hash_values_to_array(priv->ifaces, NULL, NULL, &len);
+    for (i = 0; i < len; i++) {
+        _iface_data_set_zone(arr[i], FALSE, NULL);
+        _iface_data_maybe_free(self, arr[i]);
+    }
+}
+
+static void
+_ifaces_dispatch_all(NMFirewallManager *self)
+{
+    NMFirewallManagerPrivate *priv = NM_FIREWALL_MANAGER_GET_PRIVATE(self);
+    gs_free IfaceData **      arr  = NULL;
+    guint                     i, len;
+
+    /* _iface_dispatch() may only free the IfaceData that it is called for. */
+    arr = (IfaceData **) nm_utils_hash_values_to_array(priv->ifaces, NULL, NULL, &len);
+    for (i = 0; i < len; i++)
+        _iface_dispatch(self, arr[i]);
+}
+
+static void
+zone_changed_cb(GDBusConnection *connection,
+                const char *     sender_name,
+                const char *     object_path,
+                const char *     interface_name,
+                const char *     signal_name,
+                GVariant *       parameters,
+                gpointer         user_data)
+{
+    NMFirewallManager *self = user_data;
+    IfaceData *        iface_data;
+    const char *       iface;
+
+    if (!NM_IN_STRSET(signal_name,
+                      "InterfaceAdded",
+                      "InterfaceRemoved",
+                      "ZoneChanged",
+                      "ZoneOfInterfaceChanged"))
+        return;
+
+    if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(ss)")))
+        return;
+
+    g_variant_get(parameters, "(&s&s)", NULL, &iface);
+
+    iface_data = _iface_data_get(self, iface, FALSE);
+    if (iface_data && iface_data->call_in_flight) {
+        /* most likely the result of our own request. */
+        return;
+    }
+
+    /* somebody else changed the zone of the interface. */
+    _ifaces_forget_zones(self, iface);
+}
+
+static void
+reloaded_cb(GDBusConnection *connection,
+            const char *     sender_name,
+            const char *     object_path,
+            const char *     interface_name,
+            const char *     signal_name,
+            GVariant *       parameters,
+            gpointer         user_data)
+{
+    NMFirewallManager *self = user_data;
+
+    _LOGT(NULL, "firewalld reloaded");
+    _ifaces_forget_zones(self, NULL);
+}
+
 /*****************************************************************************/
 
 static void
@@ -479,10 +769,10 @@ name_owner_changed(NMFirewallManager *self, const char *owner)
 
     now_running = _get_running(priv);
 
-    if (just_initied) {
-        NMFirewallManagerCallId *call_id_safe;
-        NMFirewallManagerCallId *call_id;
+    /* a (re)started firewalld has none of our runtime configuration. */
+    _ifaces_forget_zones(self, NULL);
 
+    if (just_initied) {
         /* We kick of the requests that we have pending. Note that this is
          * entirely asynchronous and also we don't invoke any callbacks for
          * the user.
@@ -490,25 +780,11 @@ name_owner_changed(NMFirewallManager *self, const char *owner)
          * because we don't want to callback to the user before emitting the
          * DISCONNECTED signal below. Also, emitting callbacks means the user
          * can call back to modify the list of pending-calls and we'd have
-         * to handle reentrancy. */
-        c_list_for_each_entry_safe (call_id, call_id_safe, &priv->pending_calls, lst) {
-            nm_assert(!call_id->is_idle);
-            nm_assert(call_id->dbus.arg);
-
-            if (priv->running) {
-                _LOGD(call_id, "initalizing: make D-Bus call");
-                _handle_dbus_start(self, call_id);
-            } else {
-                /* we don't want to invoke callbacks to the user right away. That is because
-                 * the user might schedule/cancel more calls, which messes up the order.
-                 *
-                 * Instead, convert the pending calls to idle requests... */
-                nm_clear_pointer(&call_id->dbus.arg, g_variant_unref);
-                call_id->is_idle = TRUE;
-                _LOGD(call_id, "initializing: fake success on idle");
-                _handle_idle_start(self, call_id);
-            }
-        }
+         * to handle reentrancy.
+         *
+         * If firewalld is not running, _iface_dispatch() converts the queued
+         * requests to idle requests. */
+        _ifaces_dispatch_all(self);
     }
 
     if (was_running != now_running)
@@ -552,6 +828,15 @@ get_name_owner_cb(const char *name_owner, GError *error, gpointer user_data)
     name_owner_changed(self, name_owner);
 }
 
+void
+_nm_firewall_manager_unpause(NMFirewallManager *self)
+{
+    g_return_if_fail(NM_IS_FIREWALL_MANAGER(self));
+    g_return_if_fail(!NM_FIREWALL_MANAGER_GET_PRIVATE(self)->dbus_inited);
+
+    name_owner_changed(self, NULL);
+}
+
 /*****************************************************************************/
 
 static void
@@ -561,10 +846,13 @@ nm_firewall_manager_init(NMFirewallManager *self)
 
     c_list_init(&priv->pending_calls);
 
+    priv->ifaces = g_hash_table_new_full(nm_pstr_hash, nm_pstr_equal, NULL, _iface_data_free);
+
     priv->dbus_connection = nm_g_object_ref(NM_MAIN_DBUS_CONNECTION_GET);
 
     if (!priv->dbus_connection) {
         _LOGD(NULL, "no D-Bus connection");
+        priv->dbus_inited = TRUE;
         return;
     }
 
@@ -575,6 +863,28 @@ nm_firewall_manager_init(NMFirewallManager *self)
                                                                self,
                                                                NULL);
 
+    priv->zone_changed_id = g_dbus_connection_signal_subscribe(priv->dbus_connection,
+                                                               FIREWALL_DBUS_SERVICE,
+                                                               FIREWALL_DBUS_INTERFACE_ZONE,
+                                                               NULL,
+                                                               FIREWALL_DBUS_PATH,
+                                                               NULL,
+                                                               G_DBUS_SIGNAL_FLAGS_NONE,
+                                                               zone_changed_cb,
+                                                               self,
+                                                               NULL);
+
+    priv->reloaded_id = g_dbus_connection_signal_subscribe(priv->dbus_connection,
+                                                           FIREWALL_DBUS_SERVICE,
+                                                           FIREWALL_DBUS_INTERFACE,
+                                                           "Reloaded",
+                                                           FIREWALL_DBUS_PATH,
+                                                           NULL,
+                                                           G_DBUS_SIGNAL_FLAGS_NONE,
+                                                           reloaded_cb,
+                                                           self,
+                                                           NULL);
+
     priv->get_name_owner_cancellable = g_cancellable_new();
     nm_dbus_connection_call_get_name_owner(priv->dbus_connection,
                                            FIREWALL_DBUS_SERVICE,
@@ -595,9 +905,13 @@ dispose(GObject *object)
     nm_assert(c_list_is_empty(&priv->pending_calls));
 
     nm_clear_g_dbus_connection_signal(priv->dbus_connection, &priv->name_owner_changed_id);
+    nm_clear_g_dbus_connection_signal(priv->dbus_connection, &priv->zone_changed_id);
+    nm_clear_g_dbus_connection_signal(priv->dbus_connection, &priv->reloaded_id);
 
     nm_clear_g_cancellable(&priv->get_name_owner_cancellable);
 
+    nm_clear_pointer(&priv->ifaces, g_hash_table_unref);
+
     G_OBJECT_CLASS(nm_firewall_manager_parent_class)->dispose(object);
 
     g_clear_object(&priv->dbus_connection);
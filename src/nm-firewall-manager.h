@@ -51,4 +51,8 @@ nm_firewall_manager_remove_from_zone(NMFirewallManager *                mgr,
 
 void nm_firewall_manager_cancel_call(NMFirewallManagerCallId *call_id);
 
+/* exposed for tests. */
+NMFirewallManager *_nm_firewall_manager_new_paused(void);
+void               _nm_firewall_manager_unpause(NMFirewallManager *self);
+
 #endif /* __NETWORKMANAGER_FIREWALL_MANAGER_H__ */
@@ -271,6 +271,7 @@ NM_GOBJECT_PROPERTIES_DEFINE(NMIP4Config,
                              PROP_ADDRESSES,
                              PROP_ROUTE_DATA,
                              PROP_ROUTES,
+                             PROP_ROUTES_GENERATION,
                              PROP_GATEWAY,
                              PROP_NAMESERVER_DATA,
                              PROP_NAMESERVERS,
@@ -301,6 +302,9 @@ typedef struct {
     GVariant *               addresses_variant;
     GVariant *               route_data_variant;
     GVariant *               routes_variant;
+    GHashTable *             routes_exported;
+    GSource *                routes_changed_source;
+    guint64                  routes_generation;
     NMDedupMultiIndex *      multi_idx;
     const NMPObject *        best_default_route;
     union {
@@ -492,6 +496,8 @@ _notify_addresses(NMIP4Config *self)
     nm_gobject_notify_together(self, PROP_ADDRESS_DATA, PROP_ADDRESSES);
 }
 
+static gboolean _routes_changed_cb(gpointer user_data);
+
 static void
 _notify_routes(NMIP4Config *self)
 {
@@ -500,7 +506,21 @@ _notify_routes(NMIP4Config *self)
     nm_assert(priv->best_default_route == _nm_ip4_config_best_default_route_find(self));
     nm_clear_g_variant(&priv->route_data_variant);
     nm_clear_g_variant(&priv->routes_variant);
-    nm_gobject_notify_together(self, PROP_ROUTE_DATA, PROP_ROUTES);
+
+    if (nm_utils_ip_routes_get_export_max() >= 0
+        && nm_dbus_object_is_exported(NM_DBUS_OBJECT(self))) {
+        /* announce the changes together on idle, see _routes_changed_cb(). */
+        if (!priv->routes_changed_source) {
+            priv->routes_changed_source = nm_g_source_attach(
+                nm_g_idle_source_new(G_PRIORITY_DEFAULT, _routes_changed_cb, self, NULL),
+                NULL);
+        }
+        return;
+    }
+
+    nm_clear_pointer(&priv->routes_exported, g_hash_table_unref);
+    priv->routes_generation++;
+    nm_gobject_notify_together(self, PROP_ROUTE_DATA, PROP_ROUTES, PROP_ROUTES_GENERATION);
 }
 
 /*****************************************************************************/
@@ -3002,6 +3022,9 @@ get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
                             prop_id == PROP_ROUTE_DATA ? priv->route_data_variant
                                                        : priv->routes_variant);
         break;
+    case PROP_ROUTES_GENERATION:
+        g_value_set_uint64(value, priv->routes_generation);
+        break;
     case PROP_GATEWAY:
         if (priv->best_default_route) {
             g_value_take_string(value,
@@ -3143,6 +3166,8 @@ finalize(GObject *object)
     nm_clear_g_variant(&priv->addresses_variant);
     nm_clear_g_variant(&priv->route_data_variant);
     nm_clear_g_variant(&priv->routes_variant);
+    nm_clear_g_source_inst(&priv->routes_changed_source);
+    nm_clear_pointer(&priv->routes_exported, g_hash_table_unref);
 
     g_array_unref(priv->nameservers);
     g_ptr_array_unref(priv->domains);
@@ -3157,10 +3182,81 @@ finalize(GObject *object)
     nm_dedup_multi_index_unref(priv->multi_idx);
 }
 
+static const GDBusSignalInfo signal_info_routes_changed = NM_DEFINE_GDBUS_SIGNAL_INFO_INIT(
+    "RoutesChanged",
+    .args = NM_DEFINE_GDBUS_ARG_INFOS(NM_DEFINE_GDBUS_ARG_INFO("generation", "t"),
+                                      NM_DEFINE_GDBUS_ARG_INFO("added", "aa{sv}"),
+                                      NM_DEFINE_GDBUS_ARG_INFO("removed", "aa{sv}"), ), );
+
+static const NMDBusInterfaceInfoExtended interface_info_ip4_config;
+
+static gboolean
+_routes_changed_cb(gpointer user_data)
+{
+    NMIP4Config *              self    = user_data;
+    NMIP4ConfigPrivate *       priv    = NM_IP4_CONFIG_GET_PRIVATE(self);
+    gs_unref_variant GVariant *added   = NULL;
+    gs_unref_variant GVariant *removed = NULL;
+    gboolean                   first;
+    gboolean                   over_max;
+
+    nm_clear_g_source_inst(&priv->routes_changed_source);
+
+    if (!nm_dbus_object_is_exported(NM_DBUS_OBJECT(self))) {
+        nm_clear_pointer(&priv->routes_exported, g_hash_table_unref);
+        priv->routes_generation++;
+        nm_gobject_notify_together(self, PROP_ROUTE_DATA, PROP_ROUTES, PROP_ROUTES_GENERATION);
+        return G_SOURCE_REMOVE;
+    }
+
+    first = !priv->routes_exported;
+
+    if (!nm_utils_ip_routes_to_dbus_delta(AF_INET,
+                                          nm_ip4_config_lookup_routes(self),
+                                          &priv->routes_exported,
+                                          nm_utils_ip_routes_get_export_max(),
+                                          &over_max,
+                                          first ? NULL : &added,
+                                          first ? NULL : &removed)) {
+        /* nothing changed in what is exported on D-Bus. */
+        return G_SOURCE_REMOVE;
+    }
+
+    /* RoutesGeneration always matches the last announced routes. */
+    priv->routes_generation++;
+
+    if (first) {
+        /* The first change after exporting the object. Clients only know the
+         * routes from reading the properties, announce them in full. */
+        nm_gobject_notify_together(self, PROP_ROUTE_DATA, PROP_ROUTES, PROP_ROUTES_GENERATION);
+        return G_SOURCE_REMOVE;
+    }
+
+    g_variant_ref_sink(added);
+    g_variant_ref_sink(removed);
+    nm_dbus_object_emit_signal(NM_DBUS_OBJECT(self),
+                               &interface_info_ip4_config,
+                               &signal_info_routes_changed,
+                               "(t@aa{sv}@aa{sv})",
+                               priv->routes_generation,
+                               added,
+                               removed);
+
+    /* Above the limit, don't serialize all routes for PropertiesChanged. They
+     * are only serialized when somebody reads the properties. */
+    if (over_max)
+        _notify(self, PROP_ROUTES_GENERATION);
+    else
+        nm_gobject_notify_together(self, PROP_ROUTE_DATA, PROP_ROUTES, PROP_ROUTES_GENERATION);
+
+    return G_SOURCE_REMOVE;
+}
+
 static const NMDBusInterfaceInfoExtended interface_info_ip4_config = {
     .parent = NM_DEFINE_GDBUS_INTERFACE_INFO_INIT(
         NM_DBUS_INTERFACE_IP4_CONFIG,
-        .signals    = NM_DEFINE_GDBUS_SIGNAL_INFOS(&nm_signal_info_property_changed_legacy, ),
+        .signals    = NM_DEFINE_GDBUS_SIGNAL_INFOS(&nm_signal_info_property_changed_legacy,
+                                                &signal_info_routes_changed, ),
         .properties = NM_DEFINE_GDBUS_PROPERTY_INFOS(
             NM_DEFINE_DBUS_PROPERTY_INFO_EXTENDED_READABLE_L("Addresses",
                                                              "aau",
@@ -3173,6 +3269,9 @@ static const NMDBusInterfaceInfoExtended interface_info_ip4_config = {
             NM_DEFINE_DBUS_PROPERTY_INFO_EXTENDED_READABLE_L("RouteData",
                                                              "aa{sv}",
                                                              NM_IP4_CONFIG_ROUTE_DATA),
+            NM_DEFINE_DBUS_PROPERTY_INFO_EXTENDED_READABLE("RoutesGeneration",
+                                                           "t",
+                                                           NM_IP4_CONFIG_ROUTES_GENERATION),
             NM_DEFINE_DBUS_PROPERTY_INFO_EXTENDED_READABLE("NameserverData",
                                                            "aa{sv}",
                                                            NM_IP4_CONFIG_NAMESERVER_DATA),
@@ -3306,6 +3405,14 @@ nm_ip4_config_class_init(NMIP4ConfigClass *klass)
                              G_VARIANT_TYPE("as"),
                              NULL,
                              G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+    obj_properties[PROP_ROUTES_GENERATION] =
+        g_param_spec_uint64(NM_IP4_CONFIG_ROUTES_GENERATION,
+                            "",
+                            "",
+                            0,
+                            G_MAXUINT64,
+                            0,
+                            G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
     obj_properties[PROP_WINS_SERVERS] =
         g_param_spec_variant(NM_IP4_CONFIG_WINS_SERVERS,
                              "",
@@ -45,14 +45,15 @@ typedef struct _NMIP6ConfigClass NMIP6ConfigClass;
 #define NM_IP6_CONFIG_IFINDEX   "ifindex"
 
 /* public */
-#define NM_IP6_CONFIG_ADDRESS_DATA "address-data"
-#define NM_IP6_CONFIG_ROUTE_DATA   "route-data"
-#define NM_IP6_CONFIG_GATEWAY      "gateway"
-#define NM_IP6_CONFIG_NAMESERVERS  "nameservers"
-#define NM_IP6_CONFIG_DOMAINS      "domains"
-#define NM_IP6_CONFIG_SEARCHES     "searches"
-#define NM_IP6_CONFIG_DNS_OPTIONS  "dns-options"
-#define NM_IP6_CONFIG_DNS_PRIORITY "dns-priority"
+#define NM_IP6_CONFIG_ADDRESS_DATA      "address-data"
+#define NM_IP6_CONFIG_ROUTE_DATA        "route-data"
+#define NM_IP6_CONFIG_ROUTES_GENERATION "routes-generation"
+#define NM_IP6_CONFIG_GATEWAY           "gateway"
+#define NM_IP6_CONFIG_NAMESERVERS       "nameservers"
+#define NM_IP6_CONFIG_DOMAINS           "domains"
+#define NM_IP6_CONFIG_SEARCHES          "searches"
+#define NM_IP6_CONFIG_DNS_OPTIONS       "dns-options"
+#define NM_IP6_CONFIG_DNS_PRIORITY      "dns-priority"
 
 /* deprecated */
 #define NM_IP6_CONFIG_ADDRESSES "addresses"
@@ -14,6 +14,7 @@
 #include "nm-netns.h"
 #include "n-acd/src/n-acd.h"
 #include "nm-l3-ipv4ll.h"
+#include "nm-main-loop-profiler.h"
 
 /*****************************************************************************/
 
@@ -2542,6 +2543,8 @@ _l3_commit_on_idle_cb(gpointer user_data)
 {
     NML3Cfg *self = user_data;
 
+    NM_MAIN_LOOP_PROFILE_SCOPE("l3cfg commit on idle");
+
     nm_clear_g_source_inst(&self->priv.p->commit_on_idle_source);
 
     _LOGT("commit on idle");
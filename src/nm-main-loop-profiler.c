@@ -0,0 +1,341 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright (C) 2020 Red Hat, Inc.
+ */
+
+#include "nm-default.h"
+
+#include "nm-main-loop-profiler.h"
+
+#include "nm-glib-aux/nm-time-utils.h"
+
+/*****************************************************************************/
+
+/* Bucket 0 counts durations below 1 msec, bucket i durations in
+ * [2^(i-1), 2^i) msec. The last bucket also takes everything longer. */
+#define N_BUCKETS 12
+
+#define N_SLOWEST 10
+
+#define ITERATION_NAME "main-loop-iteration"
+
+typedef struct {
+    /* must be the first field, the hash uses nm_pstr_hash(). */
+    const char *name;
+    guint64     count;
+    gint64      total_nsec;
+    gint64      max_nsec;
+    guint64     buckets[N_BUCKETS];
+} SectionStats;
+
+typedef struct {
+    const char *name;
+    gint64      duration_nsec;
+    gint64      timestamp_msec;
+} SlowEntry;
+
+gboolean _nm_main_loop_profiler_enabled = FALSE;
+
+static struct {
+    GPollFunc    poll_orig;
+    GHashTable * sections;
+    SectionStats iteration;
+    SlowEntry    slowest[N_SLOWEST];
+    gint64       stall_threshold_nsec;
+    guint64      stalls;
+    gint64       poll_returned_nsec;
+    const char * iter_slowest_name;
+    gint64       iter_slowest_nsec;
+} _profiler;
+
+/*****************************************************************************/
+
+static void
+_stats_add(SectionStats *stats, gint64 duration_nsec)
+{
+    guint64 msec = duration_nsec / NM_UTILS_NSEC_PER_MSEC;
+
+    stats->count++;
+    stats->total_nsec += duration_nsec;
+    stats->max_nsec = NM_MAX(stats->max_nsec, duration_nsec);
+    stats->buckets[NM_MIN(msec == 0 ? 0u : g_bit_storage(msec), N_BUCKETS - 1u)]++;
+}
+
+static void
+_slowest_add(const char *name, gint64 duration_nsec)
+{
+    guint i;
+
+    if (duration_nsec <= _profiler.slowest[N_SLOWEST - 1].duration_nsec)
+        return;
+
+    for (i = N_SLOWEST - 1; i > 0; i--) {
+        if (_profiler.slowest[i - 1].duration_nsec >= duration_nsec)
+            break;
+        _profiler.slowest[i] = _profiler.slowest[i - 1];
+    }
+    _profiler.slowest[i] = (SlowEntry){
+        .name           = name,
+        .duration_nsec  = duration_nsec,
+        .timestamp_msec = nm_utils_get_monotonic_timestamp_msec(),
+    };
+}
+
+gint64
+_nm_main_loop_profiler_section_begin(void)
+{
+    return nm_utils_get_monotonic_timestamp_nsec();
+}
+
+void
+_nm_main_loop_profiler_section_end(const char *name, gint64 start_nsec)
+{
+    SectionStats *stats;
+    gint64        duration_nsec;
+
+    nm_assert(name);
+    nm_assert(_profiler.sections);
+
+    duration_nsec = nm_utils_get_monotonic_timestamp_nsec() - start_nsec;
+
+    stats = g_hash_table_lookup(_profiler.sections, &name);
+    if (!stats) {
+        stats  = g_slice_new(SectionStats);
+        *stats = (SectionStats){
+            .name = name,
+        };
+        g_hash_table_add(_profiler.sections, stats);
+    }
+    _stats_add(stats, duration_nsec);
+    _slowest_add(name, duration_nsec);
+
+    if (duration_nsec > _profiler.iter_slowest_nsec) {
+        _profiler.iter_slowest_name = name;
+        _profiler.iter_slowest_nsec = duration_nsec;
+    }
+}
+
+/*****************************************************************************/
+
+static int
+_poll_func(GPollFD *ufds, guint nfsd, int timeout)
+{
+    gint64 busy_nsec;
+    int    r;
+
+    if (_profiler.poll_returned_nsec != 0) {
+        /* everything since the last poll() returned was check, dispatch
+         * and prepare of one iteration. */
+        busy_nsec = nm_utils_get_monotonic_timestamp_nsec() - _profiler.poll_returned_nsec;
+        _stats_add(&_profiler.iteration, busy_nsec);
+
+        if (_profiler.stall_threshold_nsec > 0 && busy_nsec >= _profiler.stall_threshold_nsec) {
+            _profiler.stalls++;
+            if (_profiler.iter_slowest_name) {
+                nm_log_warn(LOGD_CORE,
+                            "main-loop: iteration was busy for %" G_GINT64_FORMAT
+                            " msec (slowest section: %s, %" G_GINT64_FORMAT " msec)",
+                            busy_nsec / NM_UTILS_NSEC_PER_MSEC,
+                            _profiler.iter_slowest_name,
+                            _profiler.iter_slowest_nsec / NM_UTILS_NSEC_PER_MSEC);
+            } else {
+                nm_log_warn(LOGD_CORE,
+                            "main-loop: iteration was busy for %" G_GINT64_FORMAT " msec",
+                            busy_nsec / NM_UTILS_NSEC_PER_MSEC);
+            }
+        }
+    }
+
+    _profiler.iter_slowest_name = NULL;
+    _profiler.iter_slowest_nsec = 0;
+
+    r = _profiler.poll_orig(ufds, nfsd, timeout);
+
+    _profiler.poll_returned_nsec = nm_utils_get_monotonic_timestamp_nsec();
+    return r;
+}
+
+/**
+ * nm_main_loop_profiler_setup:
+ * @context: the #GMainContext to profile.
+ * @stall_threshold_msec: log a warning for each main loop iteration that
+ *   is busy for at least this long. 0 means to collect statistics only.
+ *
+ * Enables the profiler. This can only be called once.
+ */
+void
+nm_main_loop_profiler_setup(GMainContext *context, guint stall_threshold_msec)
+{
+    g_return_if_fail(context);
+    g_return_if_fail(!_nm_main_loop_profiler_enabled);
+
+    /* the statistics live as long as the process, they are never freed. */
+    _profiler.sections             = g_hash_table_new(nm_pstr_hash, nm_pstr_equal);
+    _profiler.iteration.name       = ITERATION_NAME;
+    _profiler.stall_threshold_nsec = stall_threshold_msec * NM_UTILS_NSEC_PER_MSEC;
+    _profiler.poll_orig            = g_main_context_get_poll_func(context);
+    g_main_context_set_poll_func(context, _poll_func);
+
+    _nm_main_loop_profiler_enabled = TRUE;
+
+    nm_log_dbg(LOGD_CORE,
+               "main-loop: profiler enabled (stall threshold %u msec)",
+               stall_threshold_msec);
+}
+
+/*****************************************************************************/
+
+static int
+_stats_cmp(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    const SectionStats *s_a = *((const SectionStats *const *) a);
+    const SectionStats *s_b = *((const SectionStats *const *) b);
+
+    NM_CMP_FIELD(s_b, s_a, total_nsec);
+    return strcmp(s_a->name, s_b->name);
+}
+
+static void
+_stats_log(const SectionStats *stats)
+{
+    char  buf[N_BUCKETS * 24];
+    char *b = buf;
+    gsize l = sizeof(buf);
+    guint i;
+
+    buf[0] = '\0';
+    for (i = 0; i < N_BUCKETS; i++) {
+        if (stats->buckets[i] == 0)
+            continue;
+        if (i == 0)
+            nm_utils_strbuf_append(&b, &l, " <1ms:%" G_GUINT64_FORMAT, stats->buckets[i]);
+        else if (i == N_BUCKETS - 1) {
+            nm_utils_strbuf_append(&b,
+                                   &l,
+                                   " >=%ums:%" G_GUINT64_FORMAT,
+                                   1u << (i - 1),
+                                   stats->buckets[i]);
+        } else
+            nm_utils_strbuf_append(&b, &l, " <%ums:%" G_GUINT64_FORMAT, 1u << i, stats->buckets[i]);
+    }
+
+    nm_log_info(LOGD_CORE,
+                "main-loop: %s: count %" G_GUINT64_FORMAT ", total %" G_GINT64_FORMAT
+                " msec, avg %" G_GINT64_FORMAT " usec, max %" G_GINT64_FORMAT " msec,%s",
+                stats->name,
+                stats->count,
+                stats->total_nsec / NM_UTILS_NSEC_PER_MSEC,
+                stats->count > 0 ? (stats->total_nsec / (gint64) stats->count) / 1000 : (gint64) 0,
+                stats->max_nsec / NM_UTILS_NSEC_PER_MSEC,
+                buf);
+}
+
+/**
+ * nm_main_loop_profiler_log_stats:
+ *
+ * Logs the collected histograms and the slowest sections.
+ */
+void
+nm_main_loop_profiler_log_stats(void)
+{
+    gs_free SectionStats **arr = NULL;
+    gint64                 now_msec;
+    guint                  i, len;
+
+    if (!_nm_main_loop_profiler_enabled) {
+        nm_log_info(LOGD_CORE, "main-loop: profiler is disabled");
+        return;
+    }
+
+    _stats_log(&_profiler.iteration);
+
+    arr = (SectionStats **) nm_utils_hash_keys_to_array(_profiler.sections, _stats_cmp, NULL, &len);
+    for (i = 0; i < len; i++)
+        _stats_log(arr[i]);
+
+    now_msec = nm_utils_get_monotonic_timestamp_msec();
+    for (i = 0; i < N_SLOWEST; i++) {
+        const SlowEntry *e = &_profiler.slowest[i];
+
+        if (!e->name)
+            break;
+        nm_log_info(LOGD_CORE,
+                    "main-loop: slowest #%u: %s took %" G_GINT64_FORMAT " msec, %" G_GINT64_FORMAT
+                    " sec ago",
+                    i + 1,
+                    e->name,
+                    e->duration_nsec / NM_UTILS_NSEC_PER_MSEC,
+                    (now_msec - e->timestamp_msec) / 1000);
+    }
+}
+
+static GVariant *
+_stats_to_variant(const SectionStats *stats)
+{
+    return g_variant_new(
+        "(sttt@at)",
+        stats->name,
+        stats->count,
+        (guint64) (stats->total_nsec / 1000),
+        (guint64) (stats->max_nsec / 1000),
+        g_variant_new_fixed_array(G_VARIANT_TYPE_UINT64, stats->buckets, N_BUCKETS, sizeof(guint64)));
+}
+
+/**
+ * nm_main_loop_profiler_get_stats:
+ *
+ * Returns: (transfer floating): the collected statistics as "a{sv}". Durations
+ *   are in microseconds. Each section is "(stttat)" with the name, count,
+ *   total duration, maximum duration and the histogram buckets. The slowest
+ *   sections are "(stt)" with the name, duration and the milliseconds since
+ *   they ran.
+ */
+GVariant *
+nm_main_loop_profiler_get_stats(void)
+{
+    gs_free SectionStats **arr = NULL;
+    GVariantBuilder        builder;
+    GVariantBuilder        array_builder;
+    gint64                 now_msec;
+    guint                  i, len;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&builder,
+                          "{sv}",
+                          "enabled",
+                          g_variant_new_boolean(_nm_main_loop_profiler_enabled));
+
+    if (!_nm_main_loop_profiler_enabled)
+        return g_variant_builder_end(&builder);
+
+    g_variant_builder_add(
+        &builder,
+        "{sv}",
+        "stall-threshold",
+        g_variant_new_uint32(_profiler.stall_threshold_nsec / NM_UTILS_NSEC_PER_MSEC));
+    g_variant_builder_add(&builder, "{sv}", "stalls", g_variant_new_uint64(_profiler.stalls));
+    g_variant_builder_add(&builder, "{sv}", "iteration", _stats_to_variant(&_profiler.iteration));
+
+    g_variant_builder_init(&array_builder, G_VARIANT_TYPE("a(stttat)"));
+    arr = (SectionStats **) nm_utils_hash_keys_to_array(_profiler.sections, _stats_cmp, NULL, &len);
+    for (i = 0; i < len; i++)
+        g_variant_builder_add_value(&array_builder, _stats_to_variant(arr[i]));
+    g_variant_builder_add(&builder, "{sv}", "sections", g_variant_builder_end(&array_builder));
+
+    now_msec = nm_utils_get_monotonic_timestamp_msec();
+    g_variant_builder_init(&array_builder, G_VARIANT_TYPE("a(stt)"));
+    for (i = 0; i < N_SLOWEST; i++) {
+        const SlowEntry *e = &_profiler.slowest[i];
+
+        if (!e->name)
+            break;
+        g_variant_builder_add(&array_builder,
+                              "(stt)",
+                              e->name,
+                              (guint64) (e->duration_nsec / 1000),
+                              (guint64) (now_msec - e->timestamp_msec));
+    }
+    g_variant_builder_add(&builder, "{sv}", "slowest", g_variant_builder_end(&array_builder));
+
+    return g_variant_builder_end(&builder);
+}
@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright (C) 2020 Red Hat, Inc.
+ */
+
+#ifndef __NM_MAIN_LOOP_PROFILER_H__
+#define __NM_MAIN_LOOP_PROFILER_H__
+
+/*****************************************************************************/
+
+/* The main loop profiler measures how long each iteration of the main loop
+ * is busy (that is, not waiting in poll()). An iteration that takes longer than
+ * the configured threshold is logged together with the slowest profiled section
+ * that ran during it. Profiled sections are hot callbacks that are wrapped with
+ * NM_MAIN_LOOP_PROFILE_SCOPE(); their durations are collected in histograms. */
+
+extern gboolean _nm_main_loop_profiler_enabled;
+
+void nm_main_loop_profiler_setup(GMainContext *context, guint stall_threshold_msec);
+
+gint64 _nm_main_loop_profiler_section_begin(void);
+void   _nm_main_loop_profiler_section_end(const char *name, gint64 start_nsec);
+
+void nm_main_loop_profiler_log_stats(void);
+
+GVariant *nm_main_loop_profiler_get_stats(void);
+
+typedef struct {
+    const char *name;
+    gint64      start_nsec;
+} NMMainLoopProfilerScope;
+
+static inline NMMainLoopProfilerScope
+_nm_main_loop_profiler_scope_begin(const char *name)
+{
+    return (NMMainLoopProfilerScope){
+        .name       = name,
+        .start_nsec =
+            (_nm_main_loop_profiler_enabled && name) ? _nm_main_loop_profiler_section_begin() : 0,
+    };
+}
+
+static inline void
+_nm_main_loop_profiler_scope_end(NMMainLoopProfilerScope *scope)
+{
+    if (scope->start_nsec != 0)
+        _nm_main_loop_profiler_section_end(scope->name, scope->start_nsec);
+}
+
+/* Profile the remainder of the current C scope. @name must stay valid for
+ * the lifetime of the process, like a string literal or an interned string.
+ * If @name is %NULL, nothing is profiled. */
+#define NM_MAIN_LOOP_PROFILE_SCOPE(name)                                           \
+    _nm_unused nm_auto(_nm_main_loop_profiler_scope_end) NMMainLoopProfilerScope \
+        NM_UNIQ_T(_profile_scope, NM_UNIQ) = _nm_main_loop_profiler_scope_begin(name)
+
+#endif /* __NM_MAIN_LOOP_PROFILER_H__ */
@@ -49,6 +49,8 @@
 #include "nm-dbus-object.h"
 #include "nm-dispatcher.h"
 #include "NetworkManagerUtils.h"
+#include "nm-startup-trace.h"
+#include "nm-main-loop-profiler.h"
 
 #define DEVICE_STATE_PRUNE_RATELIMIT_MAX 100u
 
@@ -1619,10 +1621,13 @@ check_if_startup_complete(NMManager *self)
     g_signal_handlers_unblock_by_func(priv->settings, settings_startup_complete_changed, self);
     if (reason) {
         _LOGD(LOGD_CORE, "startup complete is waiting for connection (%s)", reason);
+        nm_startup_trace_async_begin(priv->settings, "settings-wait-device", reason);
         return;
     }
+    nm_startup_trace_async_end(priv->settings, "settings-wait-device");
 
     _LOGI(LOGD_CORE, "startup complete");
+    nm_startup_trace_finish();
 
     priv->startup = FALSE;
 
@@ -2834,6 +2839,8 @@ recheck_assume_connection(NMManager *self, NMDevice *device)
     NMDeviceState         state;
     gboolean              activation_type_assume;
 
+    NM_STARTUP_TRACE_SCOPE("device-assume", nm_device_get_iface(device));
+
     g_return_val_if_fail(NM_IS_MANAGER(self), FALSE);
     g_return_val_if_fail(NM_IS_DEVICE(device), FALSE);
 
@@ -3590,6 +3597,8 @@ platform_query_devices(NMManager *self)
     gboolean                     guess_assume;
     gs_free char *               order = NULL;
 
+    NM_STARTUP_TRACE_SCOPE("platform-query-devices", NULL);
+
     guess_assume = nm_config_get_first_start(nm_config_get());
     order        = nm_config_data_get_value(NM_CONFIG_GET_DATA,
                                      NM_CONFIG_KEYFILE_GROUP_MAIN,
@@ -3602,6 +3611,8 @@ platform_query_devices(NMManager *self)
         const NMPlatformLink *         link = NMP_OBJECT_CAST_LINK(links->pdata[i]);
         const NMConfigDeviceStateData *dev_state;
 
+        NM_STARTUP_TRACE_SCOPE("device-realize", link->name);
+
         dev_state = nm_config_device_state_get(priv->config, link->ifindex);
         platform_link_added(self,
                             link->ifindex,
@@ -6616,6 +6627,20 @@ impl_manager_get_logging(NMDBusObject *                     obj,
         g_variant_new("(ss)", nm_logging_level_to_string(), nm_logging_domains_to_string()));
 }
 
+static void
+impl_manager_get_main_loop_stats(NMDBusObject *                     obj,
+                                 const NMDBusInterfaceInfoExtended *interface_info,
+                                 const NMDBusMethodInfoExtended *   method_info,
+                                 GDBusConnection *                  connection,
+                                 const char *                       sender,
+                                 GDBusMethodInvocation *            invocation,
+                                 GVariant *                         parameters)
+{
+    g_dbus_method_invocation_return_value(invocation,
+                                          g_variant_new("(@a{sv})",
+                                                        nm_main_loop_profiler_get_stats()));
+}
+
 typedef struct {
     NMManager *            self;
     GDBusMethodInvocation *context;
@@ -6862,9 +6887,13 @@ nm_manager_start(NMManager *self, GError **error)
     gs_free NMSettingsConnection **connections = NULL;
     guint                          i;
 
-    nm_device_factory_manager_load_factories(_register_device_factory, self);
+    {
+        NM_STARTUP_TRACE_SCOPE("device-factories-load", NULL);
+
+        nm_device_factory_manager_load_factories(_register_device_factory, self);
 
-    nm_device_factory_manager_for_each_factory(start_factory, NULL);
+        nm_device_factory_manager_for_each_factory(start_factory, NULL);
+    }
 
     /* Set initial radio enabled/disabled state */
     for (i = 0; i < RFKILL_TYPE_MAX; i++) {
@@ -6897,7 +6926,11 @@ nm_manager_start(NMManager *self, GError **error)
     if (!nm_settings_start(priv->settings, error))
         return FALSE;
 
-    nm_platform_process_events(priv->platform);
+    {
+        NM_STARTUP_TRACE_SCOPE("platform-process-events", NULL);
+
+        nm_platform_process_events(priv->platform);
+    }
 
     g_signal_connect(priv->platform,
                      NM_PLATFORM_SIGNAL_LINK_CHANGED,
@@ -8240,6 +8273,12 @@ static const NMDBusInterfaceInfoExtended interface_info_manager = {
                                                      NM_DEFINE_GDBUS_ARG_INFO("level", "s"),
                                                      NM_DEFINE_GDBUS_ARG_INFO("domains", "s"), ), ),
                 .handle = impl_manager_get_logging, ),
+            NM_DEFINE_DBUS_METHOD_INFO_EXTENDED(
+                NM_DEFINE_GDBUS_METHOD_INFO_INIT(
+                    "GetMainLoopStats",
+                    .out_args = NM_DEFINE_GDBUS_ARG_INFOS(
+                        NM_DEFINE_GDBUS_ARG_INFO("stats", "a{sv}"), ), ),
+                .handle = impl_manager_get_main_loop_stats, ),
             NM_DEFINE_DBUS_METHOD_INFO_EXTENDED(
                 NM_DEFINE_GDBUS_METHOD_INFO_INIT(
                     "CheckConnectivity",
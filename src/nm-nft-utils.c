@@ -0,0 +1,731 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright (C) 2020 Red Hat, Inc.
+ */
+
+#include "nm-default.h"
+
+#include "nm-nft-utils.h"
+
+#include <arpa/inet.h>
+#include <linux/icmp.h>
+#include <linux/if.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+#include <linux/netfilter/nf_conntrack_common.h>
+
+#include "platform/nm-netlink.h"
+
+/*****************************************************************************/
+
+#define NFT_PRIO_FILTER  0
+#define NFT_PRIO_NAT_SRC 100
+
+#define _nft_type(cmd) ((NFNL_SUBSYS_NFTABLES << 8) | (cmd))
+
+typedef enum {
+    NFT_VERDICT_ACCEPT,
+    NFT_VERDICT_REJECT,
+    NFT_VERDICT_MASQUERADE,
+} NftVerdict;
+
+typedef struct {
+    const char *name;
+    const char *type;
+    const char *hook;
+    guint32     hooknum;
+    gint32      priority;
+} NftChain;
+
+/* The rules are the same as the iptables rules of nm_utils_share_rules_add_all_rules().
+ * Each field selects a match on the shared interface or network. */
+typedef struct {
+    const char *chain;
+    guint16     dport;
+    guint8      l4proto;
+    NftVerdict  verdict : 3;
+    bool        iifname : 1;
+    bool        oifname : 1;
+    bool        saddr : 1;
+    bool        daddr : 1;
+    bool        daddr_not : 1;
+    bool        ct_established : 1;
+} NftRule;
+
+static const NftChain shared_chains[] = {
+    {"postrouting", "nat", "postrouting", NF_INET_POST_ROUTING, NFT_PRIO_NAT_SRC},
+    {"forward", "filter", "forward", NF_INET_FORWARD, NFT_PRIO_FILTER},
+    {"input", "filter", "input", NF_INET_LOCAL_IN, NFT_PRIO_FILTER},
+};
+
+static const NftRule shared_rules[] = {
+    {
+        .chain     = "postrouting",
+        .saddr     = TRUE,
+        .daddr     = TRUE,
+        .daddr_not = TRUE,
+        .verdict   = NFT_VERDICT_MASQUERADE,
+    },
+    {
+        .chain          = "forward",
+        .daddr          = TRUE,
+        .oifname        = TRUE,
+        .ct_established = TRUE,
+        .verdict        = NFT_VERDICT_ACCEPT,
+    },
+    {
+        .chain   = "forward",
+        .saddr   = TRUE,
+        .iifname = TRUE,
+        .verdict = NFT_VERDICT_ACCEPT,
+    },
+    {
+        .chain   = "forward",
+        .iifname = TRUE,
+        .oifname = TRUE,
+        .verdict = NFT_VERDICT_ACCEPT,
+    },
+    {
+        .chain   = "forward",
+        .oifname = TRUE,
+        .verdict = NFT_VERDICT_REJECT,
+    },
+    {
+        .chain   = "forward",
+        .iifname = TRUE,
+        .verdict = NFT_VERDICT_REJECT,
+    },
+    {
+        .chain   = "input",
+        .iifname = TRUE,
+        .l4proto = IPPROTO_UDP,
+        .dport   = 67,
+        .verdict = NFT_VERDICT_ACCEPT,
+    },
+    {
+        .chain   = "input",
+        .iifname = TRUE,
+        .l4proto = IPPROTO_TCP,
+        .dport   = 67,
+        .verdict = NFT_VERDICT_ACCEPT,
+    },
+    {
+        .chain   = "input",
+        .iifname = TRUE,
+        .l4proto = IPPROTO_UDP,
+        .dport   = 53,
+        .verdict = NFT_VERDICT_ACCEPT,
+    },
+    {
+        .chain   = "input",
+        .iifname = TRUE,
+        .l4proto = IPPROTO_TCP,
+        .dport   = 53,
+        .verdict = NFT_VERDICT_ACCEPT,
+    },
+};
+
+/*****************************************************************************/
+
+static struct nl_msg *
+_batch_msg_new(GPtrArray *batch, int type, int flags)
+{
+    struct nl_msg *       msg;
+    const gboolean        is_batch = NM_IN_SET(type, NFNL_MSG_BATCH_BEGIN, NFNL_MSG_BATCH_END);
+    const struct nfgenmsg nfmsg    = {
+        .nfgen_family = is_batch ? AF_UNSPEC : NFPROTO_IPV4,
+        .version      = NFNETLINK_V0,
+        .res_id       = htons(is_batch ? NFNL_SUBSYS_NFTABLES : 0),
+    };
+
+    msg = nlmsg_alloc_simple(type, NLM_F_REQUEST | flags);
+
+    /* The sequence number is the position in the batch (starting with 1),
+     * so that we can tell which message an error refers to. */
+    nlmsg_hdr(msg)->nlmsg_seq = batch->len + 1;
+
+    if (nlmsg_append_struct(msg, &nfmsg) < 0)
+        nm_assert_not_reached();
+
+    g_ptr_array_add(batch, msg);
+    return msg;
+}
+
+static GPtrArray *
+_batch_new(void)
+{
+    GPtrArray *batch;
+
+    batch = g_ptr_array_new_with_free_func((GDestroyNotify) nlmsg_free);
+    _batch_msg_new(batch, NFNL_MSG_BATCH_BEGIN, 0);
+    return batch;
+}
+
+static gboolean
+_batch_add_table(GPtrArray *batch, int cmd, int flags, const char *table)
+{
+    struct nl_msg *msg;
+
+    msg = _batch_msg_new(batch, _nft_type(cmd), NLM_F_ACK | flags);
+    NLA_PUT_STRING(msg, NFTA_TABLE_NAME, table);
+    return TRUE;
+
+nla_put_failure:
+    g_return_val_if_reached(FALSE);
+}
+
+static gboolean
+_batch_add_chain(GPtrArray *batch, const char *table, const NftChain *chain)
+{
+    struct nl_msg *msg;
+    struct nlattr *hook;
+
+    msg = _batch_msg_new(batch, _nft_type(NFT_MSG_NEWCHAIN), NLM_F_ACK | NLM_F_CREATE);
+    NLA_PUT_STRING(msg, NFTA_CHAIN_TABLE, table);
+    NLA_PUT_STRING(msg, NFTA_CHAIN_NAME, chain->name);
+    NLA_PUT_STRING(msg, NFTA_CHAIN_TYPE, chain->type);
+
+    if (!(hook = nla_nest_start(msg, NFTA_CHAIN_HOOK)))
+        goto nla_put_failure;
+    NLA_PUT_U32(msg, NFTA_HOOK_HOOKNUM, htonl(chain->hooknum));
+    NLA_PUT_U32(msg, NFTA_HOOK_PRIORITY, htonl((guint32) chain->priority));
+    nla_nest_end(msg, hook);
+
+    NLA_PUT_U32(msg, NFTA_CHAIN_POLICY, htonl(NF_ACCEPT));
+    return TRUE;
+
+nla_put_failure:
+    g_return_val_if_reached(FALSE);
+}
+
+static void
+_batch_end(GPtrArray *batch)
+{
+    _batch_msg_new(batch, NFNL_MSG_BATCH_END, 0);
+}
+
+/*****************************************************************************/
+
+static struct nlattr *
+_expr_start(struct nl_msg *msg, const char *name, struct nlattr **out_elem)
+{
+    if (!(*out_elem = nla_nest_start(msg, NFTA_LIST_ELEM)))
+        return NULL;
+    if (nla_put_string(msg, NFTA_EXPR_NAME, name) < 0)
+        return NULL;
+    return nla_nest_start(msg, NFTA_EXPR_DATA);
+}
+
+static void
+_expr_end(struct nl_msg *msg, struct nlattr *elem, struct nlattr *data)
+{
+    /* an expression without attributes (like "masq") drops the empty
+     * data attribute again. */
+    nla_nest_end(msg, data);
+    nla_nest_end(msg, elem);
+}
+
+static gboolean
+_put_data(struct nl_msg *msg, int attrtype, gconstpointer data, gsize len)
+{
+    struct nlattr *nest;
+
+    if (!(nest = nla_nest_start(msg, attrtype)))
+        return FALSE;
+    if (nla_put(msg, NFTA_DATA_VALUE, len, data) < 0)
+        return FALSE;
+    nla_nest_end(msg, nest);
+    return TRUE;
+}
+
+static gboolean
+_expr_meta(struct nl_msg *msg, guint32 key)
+{
+    struct nlattr *elem;
+    struct nlattr *data;
+
+    if (!(data = _expr_start(msg, "meta", &elem)))
+        goto nla_put_failure;
+    NLA_PUT_U32(msg, NFTA_META_KEY, htonl(key));
+    NLA_PUT_U32(msg, NFTA_META_DREG, htonl(NFT_REG_1));
+    _expr_end(msg, elem, data);
+    return TRUE;
+
+nla_put_failure:
+    return FALSE;
+}
+
+static gboolean
+_expr_ct(struct nl_msg *msg, guint32 key)
+{
+    struct nlattr *elem;
+    struct nlattr *data;
+
+    if (!(data = _expr_start(msg, "ct", &elem)))
+        goto nla_put_failure;
+    NLA_PUT_U32(msg, NFTA_CT_KEY, htonl(key));
+    NLA_PUT_U32(msg, NFTA_CT_DREG, htonl(NFT_REG_1));
+    _expr_end(msg, elem, data);
+    return TRUE;
+
+nla_put_failure:
+    return FALSE;
+}
+
+static gboolean
+_expr_payload(struct nl_msg *msg, guint32 base, guint32 offset, guint32 len)
+{
+    struct nlattr *elem;
+    struct nlattr *data;
+
+    if (!(data = _expr_start(msg, "payload", &elem)))
+        goto nla_put_failure;
+    NLA_PUT_U32(msg, NFTA_PAYLOAD_DREG, htonl(NFT_REG_1));
+    NLA_PUT_U32(msg, NFTA_PAYLOAD_BASE, htonl(base));
+    NLA_PUT_U32(msg, NFTA_PAYLOAD_OFFSET, htonl(offset));
+    NLA_PUT_U32(msg, NFTA_PAYLOAD_LEN, htonl(len));
+    _expr_end(msg, elem, data);
+    return TRUE;
+
+nla_put_failure:
+    return FALSE;
+}
+
+static gboolean
+_expr_bitwise(struct nl_msg *msg, gconstpointer mask, gsize len)
+{
+    const guint8   xor[16] = {0};
+    struct nlattr *elem;
+    struct nlattr *data;
+
+    nm_assert(len <= sizeof(xor));
+
+    if (!(data = _expr_start(msg, "bitwise", &elem)))
+        goto nla_put_failure;
+    NLA_PUT_U32(msg, NFTA_BITWISE_SREG, htonl(NFT_REG_1));
+    NLA_PUT_U32(msg, NFTA_BITWISE_DREG, htonl(NFT_REG_1));
+    NLA_PUT_U32(msg, NFTA_BITWISE_LEN, htonl(len));
+    if (!_put_data(msg, NFTA_BITWISE_MASK, mask, len))
+        goto nla_put_failure;
+    if (!_put_data(msg, NFTA_BITWISE_XOR, xor, len))
+        goto nla_put_failure;
+    _expr_end(msg, elem, data);
+    return TRUE;
+
+nla_put_failure:
+    return FALSE;
+}
+
+static gboolean
+_expr_cmp(struct nl_msg *msg, guint32 op, gconstpointer value, gsize len)
+{
+    struct nlattr *elem;
+    struct nlattr *data;
+
+    if (!(data = _expr_start(msg, "cmp", &elem)))
+        goto nla_put_failure;
+    NLA_PUT_U32(msg, NFTA_CMP_SREG, htonl(NFT_REG_1));
+    NLA_PUT_U32(msg, NFTA_CMP_OP, htonl(op));
+    if (!_put_data(msg, NFTA_CMP_DATA, value, len))
+        goto nla_put_failure;
+    _expr_end(msg, elem, data);
+    return TRUE;
+
+nla_put_failure:
+    return FALSE;
+}
+
+static gboolean
+_expr_verdict(struct nl_msg *msg, NftVerdict verdict)
+{
+    struct nlattr *elem;
+    struct nlattr *data;
+    struct nlattr *imm_data;
+    struct nlattr *imm_verdict;
+
+    switch (verdict) {
+    case NFT_VERDICT_ACCEPT:
+        if (!(data = _expr_start(msg, "immediate", &elem)))
+            goto nla_put_failure;
+        NLA_PUT_U32(msg, NFTA_IMMEDIATE_DREG, htonl(NFT_REG_VERDICT));
+        if (!(imm_data = nla_nest_start(msg, NFTA_IMMEDIATE_DATA)))
+            goto nla_put_failure;
+        if (!(imm_verdict = nla_nest_start(msg, NFTA_DATA_VERDICT)))
+            goto nla_put_failure;
+        NLA_PUT_U32(msg, NFTA_VERDICT_CODE, htonl(NF_ACCEPT));
+        nla_nest_end(msg, imm_verdict);
+        nla_nest_end(msg, imm_data);
+        break;
+    case NFT_VERDICT_REJECT:
+        /* like the default of iptables' REJECT target. */
+        if (!(data = _expr_start(msg, "reject", &elem)))
+            goto nla_put_failure;
+        NLA_PUT_U32(msg, NFTA_REJECT_TYPE, htonl(NFT_REJECT_ICMP_UNREACH));
+        NLA_PUT_U8(msg, NFTA_REJECT_ICMP_CODE, ICMP_PORT_UNREACH);
+        break;
+    case NFT_VERDICT_MASQUERADE:
+        if (!(data = _expr_start(msg, "masq", &elem)))
+            goto nla_put_failure;
+        break;
+    default:
+        nm_assert_not_reached();
+        return FALSE;
+    }
+
+    _expr_end(msg, elem, data);
+    return TRUE;
+
+nla_put_failure:
+    return FALSE;
+}
+
+static gboolean
+_expr_ifname(struct nl_msg *msg, guint32 key, const char *ifname)
+{
+    char buf[IFNAMSIZ] = {0};
+
+    g_strlcpy(buf, ifname, sizeof(buf));
+    return _expr_meta(msg, key) && _expr_cmp(msg, NFT_CMP_EQ, buf, sizeof(buf));
+}
+
+static gboolean
+_expr_ip4(struct nl_msg *msg, guint32 offset, in_addr_t network, in_addr_t netmask, guint32 op)
+{
+    return _expr_payload(msg, NFT_PAYLOAD_NETWORK_HEADER, offset, sizeof(in_addr_t))
+           && _expr_bitwise(msg, &netmask, sizeof(netmask))
+           && _expr_cmp(msg, op, &network, sizeof(network));
+}
+
+static gboolean
+_batch_add_rule(GPtrArray *    batch,
+                const char *   table,
+                const NftRule *rule,
+                const char *   ip_iface,
+                in_addr_t      network,
+                in_addr_t      netmask)
+{
+    struct nl_msg *msg;
+    struct nlattr *exprs;
+
+    msg = _batch_msg_new(batch,
+                         _nft_type(NFT_MSG_NEWRULE),
+                         NLM_F_ACK | NLM_F_CREATE | NLM_F_APPEND);
+    NLA_PUT_STRING(msg, NFTA_RULE_TABLE, table);
+    NLA_PUT_STRING(msg, NFTA_RULE_CHAIN, rule->chain);
+
+    if (!(exprs = nla_nest_start(msg, NFTA_RULE_EXPRESSIONS)))
+        goto nla_put_failure;
+
+    if (rule->iifname && !_expr_ifname(msg, NFT_META_IIFNAME, ip_iface))
+        goto nla_put_failure;
+    if (rule->oifname && !_expr_ifname(msg, NFT_META_OIFNAME, ip_iface))
+        goto nla_put_failure;
+
+    /* source and destination address at offset 12 and 16 of the IPv4 header. */
+    if (rule->saddr && !_expr_ip4(msg, 12, network, netmask, NFT_CMP_EQ))
+        goto nla_put_failure;
+    if (rule->daddr
+        && !_expr_ip4(msg, 16, network, netmask, rule->daddr_not ? NFT_CMP_NEQ : NFT_CMP_EQ))
+        goto nla_put_failure;
+
+    if (rule->ct_established) {
+        const guint32 mask = NF_CT_STATE_BIT(IP_CT_ESTABLISHED) | NF_CT_STATE_BIT(IP_CT_RELATED);
+        const guint32 zero = 0;
+
+        /* the conntrack state is in host byte order. */
+        if (!_expr_ct(msg, NFT_CT_STATE) || !_expr_bitwise(msg, &mask, sizeof(mask))
+            || !_expr_cmp(msg, NFT_CMP_NEQ, &zero, sizeof(zero)))
+            goto nla_put_failure;
+    }
+
+    if (rule->l4proto) {
+        const guint16 dport = htons(rule->dport);
+
+        /* the destination port is at offset 2 of both the UDP and TCP header. */
+        if (!_expr_meta(msg, NFT_META_L4PROTO)
+            || !_expr_cmp(msg, NFT_CMP_EQ, &rule->l4proto, sizeof(rule->l4proto))
+            || !_expr_payload(msg, NFT_PAYLOAD_TRANSPORT_HEADER, 2, sizeof(dport))
+            || !_expr_cmp(msg, NFT_CMP_EQ, &dport, sizeof(dport)))
+            goto nla_put_failure;
+    }
+
+    if (!_expr_verdict(msg, rule->verdict))
+        goto nla_put_failure;
+
+    nla_nest_end(msg, exprs);
+    return TRUE;
+
+nla_put_failure:
+    g_return_val_if_reached(FALSE);
+}
+
+/*****************************************************************************/
+
+static int
+_batch_commit(GPtrArray *batch)
+{
+    struct nl_sock *      sk = NULL;
+    gs_free struct iovec *iov = NULL;
+    guint                 n_pending;
+    guint                 i;
+    int                   r;
+
+    nm_assert(batch->len >= 3);
+
+    sk = nl_socket_alloc();
+    r  = nl_connect(sk, NETLINK_NETFILTER);
+    if (r < 0)
+        goto out;
+
+    /* nfnetlink processes the whole batch while we send it. All replies
+     * are queued on the socket when sendmsg() returns, so a non-blocking
+     * socket is enough and we never wait for the kernel. */
+    r = nl_socket_set_nonblocking(sk);
+    if (r < 0)
+        goto out;
+
+    iov = g_new(struct iovec, batch->len);
+    for (i = 0; i < batch->len; i++) {
+        struct nlmsghdr *nlh = nlmsg_hdr(batch->pdata[i]);
+
+        iov[i] = (struct iovec){
+            .iov_base = nlh,
+            .iov_len  = nlh->nlmsg_len,
+        };
+    }
+
+    r = nl_send_iovec(sk, batch->pdata[0], iov, batch->len);
+    if (r < 0)
+        goto out;
+
+    /* every message between the begin and end marker requested an ACK. */
+    n_pending = batch->len - 2;
+    r         = 0;
+
+    while (n_pending > 0) {
+        gs_free unsigned char *buf = NULL;
+        struct sockaddr_nl     nla = {0};
+        struct nlmsghdr *      hdr;
+        int                    n;
+
+        n = nl_recv(sk, &nla, &buf, NULL, NULL);
+        if (n <= 0) {
+            /* -EAGAIN means that the kernel did not reply to every message. */
+            if (r == 0)
+                r = n < 0 ? n : -NME_UNSPEC;
+            goto out;
+        }
+
+        for (hdr = (struct nlmsghdr *) buf; nlmsg_ok(hdr, n); hdr = nlmsg_next(hdr, &n)) {
+            const struct nlmsgerr *e;
+
+            if (hdr->nlmsg_type != NLMSG_ERROR)
+                continue;
+
+            if (hdr->nlmsg_len < nlmsg_size(sizeof(*e))) {
+                r = -NME_NL_MSG_TRUNC;
+                goto out;
+            }
+
+            e = nlmsg_data(hdr);
+            if (e->error && r == 0)
+                r = -nm_errno_from_native(e->error);
+
+            if (hdr->nlmsg_seq == 1) {
+                /* an error about the batch itself, for example because
+                 * nf_tables is not available. Nothing else follows. */
+                goto out;
+            }
+            if (n_pending > 0)
+                n_pending--;
+        }
+    }
+
+out:
+    nl_socket_free(sk);
+    return r;
+}
+
+/*****************************************************************************/
+
+#define _table_name(buf, ip_iface) nm_sprintf_buf(buf, NM_NFT_SHARED_TABLE_PREFIX "%s", ip_iface)
+
+static void
+_rule_to_string(GString *      gstr,
+                const NftRule *rule,
+                const char *   ip_iface,
+                const char *   str_network,
+                guint8         plen)
+{
+    const gsize start = gstr->len;
+
+    /* the order of the matches is the same as in _batch_add_rule(). */
+    if (rule->iifname)
+        g_string_append_printf(gstr, " iifname \"%s\"", ip_iface);
+    if (rule->oifname)
+        g_string_append_printf(gstr, " oifname \"%s\"", ip_iface);
+    if (rule->saddr)
+        g_string_append_printf(gstr, " ip saddr %s/%u", str_network, plen);
+    if (rule->daddr) {
+        g_string_append_printf(gstr,
+                               " ip daddr %s%s/%u",
+                               rule->daddr_not ? "!= " : "",
+                               str_network,
+                               plen);
+    }
+    if (rule->ct_established)
+        g_string_append(gstr, " ct state established,related");
+    if (rule->l4proto) {
+        g_string_append_printf(gstr,
+                               " meta l4proto %s th dport %u",
+                               rule->l4proto == IPPROTO_TCP ? "tcp" : "udp",
+                               rule->dport);
+    }
+
+    switch (rule->verdict) {
+    case NFT_VERDICT_ACCEPT:
+        g_string_append(gstr, " accept");
+        break;
+    case NFT_VERDICT_REJECT:
+        g_string_append(gstr, " reject with icmp type port-unreachable");
+        break;
+    case NFT_VERDICT_MASQUERADE:
+        g_string_append(gstr, " masquerade");
+        break;
+    }
+
+    /* drop the separator before the first word. */
+    g_string_erase(gstr, start, 1);
+}
+
+/**
+ * nm_nft_shared_table_to_string:
+ * @ip_iface: the interface that is shared
+ * @addr: the IPv4 address on @ip_iface
+ * @plen: the prefix length of @addr
+ *
+ * Renders the table that nm_nft_shared_table_add() creates in the syntax
+ * of the nft tool. The result is for logging and testing, the daemon
+ * itself does not need the nft tool.
+ *
+ * Returns: (transfer full): the ruleset.
+ */
+char *
+nm_nft_shared_table_to_string(const char *ip_iface, in_addr_t addr, guint8 plen)
+{
+    GString * gstr;
+    char      str_network[NM_UTILS_INET_ADDRSTRLEN];
+    in_addr_t netmask;
+    guint     i;
+    guint     j;
+
+    g_return_val_if_fail(ip_iface, NULL);
+
+    netmask = _nm_utils_ip4_prefix_to_netmask(plen);
+    _nm_utils_inet4_ntop(addr & netmask, str_network);
+
+    gstr = g_string_sized_new(1024);
+    g_string_append_printf(gstr, "table ip " NM_NFT_SHARED_TABLE_PREFIX "%s {\n", ip_iface);
+    for (i = 0; i < G_N_ELEMENTS(shared_chains); i++) {
+        const NftChain *chain = &shared_chains[i];
+
+        g_string_append_printf(gstr,
+                               "\tchain %s {\n"
+                               "\t\ttype %s hook %s priority %d; policy accept;\n",
+                               chain->name,
+                               chain->type,
+                               chain->hook,
+                               (int) chain->priority);
+        for (j = 0; j < G_N_ELEMENTS(shared_rules); j++) {
+            if (!nm_streq(shared_rules[j].chain, chain->name))
+                continue;
+            g_string_append(gstr, "\t\t");
+            _rule_to_string(gstr, &shared_rules[j], ip_iface, str_network, plen);
+            g_string_append_c(gstr, '\n');
+        }
+        g_string_append(gstr, "\t}\n");
+    }
+    g_string_append(gstr, "}\n");
+
+    return g_string_free(gstr, FALSE);
+}
+
+/**
+ * nm_nft_shared_table_add:
+ * @ip_iface: the interface that is shared
+ * @addr: the IPv4 address on @ip_iface
+ * @plen: the prefix length of @addr
+ *
+ * Creates (or replaces) the nftables table with the NAT and filter rules
+ * for sharing @ip_iface. All rules are committed in a single netlink batch,
+ * which the kernel applies atomically.
+ *
+ * Returns: 0 on success or a negative nm-errno.
+ */
+int
+nm_nft_shared_table_add(const char *ip_iface, in_addr_t addr, guint8 plen)
+{
+    gs_unref_ptrarray GPtrArray *batch = NULL;
+    char                         table[sizeof(NM_NFT_SHARED_TABLE_PREFIX) + IFNAMSIZ];
+    in_addr_t                    netmask;
+    in_addr_t                    network;
+    guint                        i;
+
+    g_return_val_if_fail(ip_iface, -NME_BUG);
+
+    _table_name(table, ip_iface);
+
+    netmask = _nm_utils_ip4_prefix_to_netmask(plen);
+    network = addr & netmask;
+
+    batch = _batch_new();
+
+    /* Creating the table first lets the delete succeed if it does not exist
+     * yet. Re-creating it afterwards replaces left-over rules in the same
+     * transaction. */
+    if (!_batch_add_table(batch, NFT_MSG_NEWTABLE, NLM_F_CREATE, table)
+        || !_batch_add_table(batch, NFT_MSG_DELTABLE, 0, table)
+        || !_batch_add_table(batch, NFT_MSG_NEWTABLE, NLM_F_CREATE, table))
+        return -NME_BUG;
+
+    for (i = 0; i < G_N_ELEMENTS(shared_chains); i++) {
+        if (!_batch_add_chain(batch, table, &shared_chains[i]))
+            return -NME_BUG;
+    }
+
+    for (i = 0; i < G_N_ELEMENTS(shared_rules); i++) {
+        if (!_batch_add_rule(batch, table, &shared_rules[i], ip_iface, network, netmask))
+            return -NME_BUG;
+    }
+
+    _batch_end(batch);
+    return _batch_commit(batch);
+}
+
+/**
+ * nm_nft_shared_table_delete:
+ * @ip_iface: the interface that was shared
+ *
+ * Deletes the table created by nm_nft_shared_table_add() with all its
+ * chains and rules.
+ *
+ * Returns: 0 on success or a negative nm-errno. -ENOENT means that
+ *   the table did not exist.
+ */
+int
+nm_nft_shared_table_delete(const char *ip_iface)
+{
+    gs_unref_ptrarray GPtrArray *batch = NULL;
+    char                         table[sizeof(NM_NFT_SHARED_TABLE_PREFIX) + IFNAMSIZ];
+
+    g_return_val_if_fail(ip_iface, -NME_BUG);
+
+    _table_name(table, ip_iface);
+
+    batch = _batch_new();
+    if (!_batch_add_table(batch, NFT_MSG_DELTABLE, 0, table))
+        return -NME_BUG;
+    _batch_end(batch);
+    return _batch_commit(batch);
+}
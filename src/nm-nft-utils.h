@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright (C) 2020 Red Hat, Inc.
+ */
+
+#ifndef __NM_NFT_UTILS_H__
+#define __NM_NFT_UTILS_H__
+
+/*****************************************************************************/
+
+/* The rules for a shared connection are kept in a per-interface nftables
+ * table named "nm-shared-$IFACE". The table is created and deleted as a
+ * whole in one netlink batch, so the kernel either sees all rules or none. */
+
+#define NM_NFT_SHARED_TABLE_PREFIX "nm-shared-"
+
+int nm_nft_shared_table_add(const char *ip_iface, in_addr_t addr, guint8 plen);
+
+int nm_nft_shared_table_delete(const char *ip_iface);
+
+char *nm_nft_shared_table_to_string(const char *ip_iface, in_addr_t addr, guint8 plen);
+
+#endif /* __NM_NFT_UTILS_H__ */
@@ -0,0 +1,306 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright (C) 2020 Red Hat, Inc.
+ */
+
+#include "nm-default.h"
+
+#include "nm-startup-trace.h"
+
+#include "nm-glib-aux/nm-io-utils.h"
+#include "nm-glib-aux/nm-json-aux.h"
+#include "nm-glib-aux/nm-time-utils.h"
+
+/*****************************************************************************/
+
+#define CATEGORY "startup"
+
+typedef struct {
+    const char *name;
+    char *      detail;
+    gint64      start_nsec;
+    gint64      end_nsec;
+
+    /* for asynchronous spans, the unique id of the span. Otherwise zero. */
+    guint64 async_id;
+} Span;
+
+typedef struct {
+    /* the first two fields are the key of the hash. */
+    gconstpointer owner;
+    char *        name;
+    char *        detail;
+    gint64        start_nsec;
+} AsyncSpan;
+
+gboolean _nm_startup_trace_enabled = FALSE;
+
+static struct {
+    char *      filename;
+    GArray *    spans;
+    GHashTable *async_spans;
+    gint64      start_nsec;
+    guint64     async_id_counter;
+} _trace;
+
+/*****************************************************************************/
+
+static guint
+_async_span_hash(gconstpointer ptr)
+{
+    const AsyncSpan *s = ptr;
+    NMHashState      h;
+
+    nm_hash_init(&h, 1845079311u);
+    nm_hash_update_val(&h, s->owner);
+    nm_hash_update_str(&h, s->name);
+    return nm_hash_complete(&h);
+}
+
+static gboolean
+_async_span_equal(gconstpointer a, gconstpointer b)
+{
+    const AsyncSpan *s_a = a;
+    const AsyncSpan *s_b = b;
+
+    return s_a->owner == s_b->owner && nm_streq(s_a->name, s_b->name);
+}
+
+static void
+_async_span_free(gpointer ptr)
+{
+    AsyncSpan *s = ptr;
+
+    g_free(s->name);
+    g_free(s->detail);
+    nm_g_slice_free(s);
+}
+
+static void
+_span_clear(gpointer ptr)
+{
+    Span *span = ptr;
+
+    g_free(span->detail);
+}
+
+/*****************************************************************************/
+
+/**
+ * nm_startup_trace_setup:
+ * @filename: the file to write the trace to.
+ * @start_nsec: the monotonic timestamp when the startup began. Spans
+ *   that happened before the setup can be added with
+ *   nm_startup_trace_span_add().
+ *
+ * Enables the startup trace. This can only be called once.
+ */
+void
+nm_startup_trace_setup(const char *filename, gint64 start_nsec)
+{
+    g_return_if_fail(filename && filename[0]);
+    g_return_if_fail(!_nm_startup_trace_enabled);
+    g_return_if_fail(!_trace.filename);
+
+    _trace.filename   = g_strdup(filename);
+    _trace.start_nsec = start_nsec;
+    _trace.spans      = g_array_new(FALSE, FALSE, sizeof(Span));
+    g_array_set_clear_func(_trace.spans, _span_clear);
+    _trace.async_spans =
+        g_hash_table_new_full(_async_span_hash, _async_span_equal, _async_span_free, NULL);
+
+    _nm_startup_trace_enabled = TRUE;
+}
+
+void
+_nm_startup_trace_span_add(const char *name,
+                           const char *detail,
+                           gint64      start_nsec,
+                           gint64      end_nsec)
+{
+    Span *span;
+
+    nm_assert(_nm_startup_trace_enabled);
+    nm_assert(name);
+
+    span  = nm_g_array_append_new(_trace.spans, Span);
+    *span = (Span){
+        .name       = name,
+        .detail     = g_strdup(detail),
+        .start_nsec = start_nsec,
+        .end_nsec   = end_nsec,
+    };
+}
+
+void
+_nm_startup_trace_async_begin(gconstpointer owner, const char *name, const char *detail)
+{
+    AsyncSpan  needle = {
+        .owner = owner,
+        .name  = (char *) name,
+    };
+    AsyncSpan *s;
+
+    nm_assert(_nm_startup_trace_enabled);
+    nm_assert(name);
+
+    if (g_hash_table_contains(_trace.async_spans, &needle))
+        return;
+
+    s  = g_slice_new(AsyncSpan);
+    *s = (AsyncSpan){
+        .owner      = owner,
+        .name       = g_strdup(name),
+        .detail     = g_strdup(detail),
+        .start_nsec = nm_utils_get_monotonic_timestamp_nsec(),
+    };
+    g_hash_table_add(_trace.async_spans, s);
+}
+
+static void
+_async_span_complete(GArray *spans, AsyncSpan *s, gint64 end_nsec)
+{
+    Span *span;
+
+    span  = nm_g_array_append_new(spans, Span);
+    *span = (Span){
+        .name       = g_intern_string(s->name),
+        .detail     = g_steal_pointer(&s->detail),
+        .start_nsec = s->start_nsec,
+        .end_nsec   = end_nsec,
+        .async_id   = ++_trace.async_id_counter,
+    };
+}
+
+void
+_nm_startup_trace_async_end(gconstpointer owner, const char *name)
+{
+    AsyncSpan  needle = {
+        .owner = owner,
+        .name  = (char *) name,
+    };
+    AsyncSpan *s;
+
+    nm_assert(_nm_startup_trace_enabled);
+    nm_assert(name);
+
+    s = g_hash_table_lookup(_trace.async_spans, &needle);
+    if (!s)
+        return;
+
+    _async_span_complete(_trace.spans, s, nm_utils_get_monotonic_timestamp_nsec());
+    g_hash_table_remove(_trace.async_spans, s);
+}
+
+/*****************************************************************************/
+
+static void
+_event_append(GString *   gstr,
+              const Span *span,
+              char        phase,
+              gint64      ts_nsec,
+              gboolean    with_duration,
+              pid_t       pid)
+{
+    g_string_append(gstr, "{ ");
+    nm_json_gstr_append_obj_name(gstr, "name", '\0');
+    nm_json_gstr_append_string(gstr, span->name);
+    nm_json_gstr_append_delimiter(gstr);
+    nm_json_gstr_append_obj_name(gstr, "cat", '\0');
+    nm_json_gstr_append_string(gstr, CATEGORY);
+    g_string_append_printf(gstr, ", \"ph\": \"%c\"", phase);
+    if (span->async_id != 0)
+        g_string_append_printf(gstr, ", \"id\": %" G_GUINT64_FORMAT, span->async_id);
+    g_string_append_printf(gstr,
+                           ", \"ts\": %" G_GINT64_FORMAT,
+                           (ts_nsec - _trace.start_nsec) / 1000);
+    if (with_duration) {
+        g_string_append_printf(gstr,
+                               ", \"dur\": %" G_GINT64_FORMAT,
+                               (span->end_nsec - span->start_nsec) / 1000);
+    }
+    g_string_append_printf(gstr, ", \"pid\": %d, \"tid\": %d", (int) pid, (int) pid);
+    if (span->detail && phase != 'e') {
+        nm_json_gstr_append_delimiter(gstr);
+        nm_json_gstr_append_obj_name(gstr, "args", '{');
+        nm_json_gstr_append_obj_name(gstr, "detail", '\0');
+        nm_json_gstr_append_string(gstr, span->detail);
+        g_string_append(gstr, " }");
+    }
+    g_string_append(gstr, " }");
+}
+
+/**
+ * nm_startup_trace_finish:
+ *
+ * Writes the recorded spans to the file and disables the trace. Asynchronous
+ * spans that are still pending are ended now. Does nothing if the trace is
+ * not enabled.
+ */
+void
+nm_startup_trace_finish(void)
+{
+    nm_auto_free_gstring GString *gstr     = NULL;
+    gs_free_error GError *error            = NULL;
+    gs_free char *        filename         = NULL;
+    gs_unref_array GArray *spans           = NULL;
+    gs_unref_hashtable GHashTable *pending = NULL;
+    GHashTableIter                 iter;
+    AsyncSpan *                    s;
+    Span                           startup;
+    const pid_t                    pid = getpid();
+    gint64                         now_nsec;
+    guint                          i;
+
+    if (!_nm_startup_trace_enabled)
+        return;
+
+    _nm_startup_trace_enabled = FALSE;
+
+    filename = g_steal_pointer(&_trace.filename);
+    spans    = g_steal_pointer(&_trace.spans);
+    pending  = g_steal_pointer(&_trace.async_spans);
+
+    now_nsec = nm_utils_get_monotonic_timestamp_nsec();
+
+    g_hash_table_iter_init(&iter, pending);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &s, NULL))
+        _async_span_complete(spans, s, now_nsec);
+
+    startup = (Span){
+        .name       = "startup",
+        .start_nsec = _trace.start_nsec,
+        .end_nsec   = now_nsec,
+    };
+
+    gstr = g_string_sized_new(100 + spans->len * 150u);
+    g_string_append(gstr, "{ \"traceEvents\": [\n");
+    _event_append(gstr, &startup, 'X', startup.start_nsec, TRUE, pid);
+    for (i = 0; i < spans->len; i++) {
+        const Span *span = &g_array_index(spans, Span, i);
+
+        g_string_append(gstr, ",\n");
+        if (span->async_id == 0)
+            _event_append(gstr, span, 'X', span->start_nsec, TRUE, pid);
+        else {
+            _event_append(gstr, span, 'b', span->start_nsec, FALSE, pid);
+            g_string_append(gstr, ",\n");
+            _event_append(gstr, span, 'e', span->end_nsec, FALSE, pid);
+        }
+    }
+    g_string_append(gstr, "\n], \"displayTimeUnit\": \"ms\" }\n");
+
+    if (!nm_utils_file_set_contents(filename, gstr->str, gstr->len, 0644, NULL, &error)) {
+        nm_log_warn(LOGD_CORE,
+                    "startup-trace: failure to write \"%s\": %s",
+                    filename,
+                    error->message);
+        return;
+    }
+
+    nm_log_info(LOGD_CORE,
+                "startup-trace: wrote %u spans after %" G_GINT64_FORMAT " msec to \"%s\"",
+                spans->len,
+                (now_nsec - _trace.start_nsec) / NM_UTILS_NSEC_PER_MSEC,
+                filename);
+}
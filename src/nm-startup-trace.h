@@ -0,0 +1,100 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright (C) 2020 Red Hat, Inc.
+ */
+
+#ifndef __NM_STARTUP_TRACE_H__
+#define __NM_STARTUP_TRACE_H__
+
+#include "nm-glib-aux/nm-time-utils.h"
+
+/*****************************************************************************/
+
+/* The startup trace records spans for the phases of the startup until
+ * "startup complete". When startup completes, the spans are written to a file
+ * in the Chrome trace event format, and the trace is disabled for the
+ * remaining lifetime of the process.
+ *
+ * Synchronous spans are recorded with NM_STARTUP_TRACE_SCOPE(). Spans that
+ * begin and end in different callbacks, like pending actions of a device,
+ * are recorded with nm_startup_trace_async_begin()/nm_startup_trace_async_end(),
+ * where the @owner and @name pair identifies the span. */
+
+extern gboolean _nm_startup_trace_enabled;
+
+void nm_startup_trace_setup(const char *filename, gint64 start_nsec);
+
+void nm_startup_trace_finish(void);
+
+void _nm_startup_trace_span_add(const char *name,
+                                const char *detail,
+                                gint64      start_nsec,
+                                gint64      end_nsec);
+
+void _nm_startup_trace_async_begin(gconstpointer owner, const char *name, const char *detail);
+void _nm_startup_trace_async_end(gconstpointer owner, const char *name);
+
+static inline void
+nm_startup_trace_span_add(const char *name,
+                          const char *detail,
+                          gint64      start_nsec,
+                          gint64      end_nsec)
+{
+    if (_nm_startup_trace_enabled)
+        _nm_startup_trace_span_add(name, detail, start_nsec, end_nsec);
+}
+
+static inline void
+nm_startup_trace_async_begin(gconstpointer owner, const char *name, const char *detail)
+{
+    if (_nm_startup_trace_enabled)
+        _nm_startup_trace_async_begin(owner, name, detail);
+}
+
+static inline void
+nm_startup_trace_async_end(gconstpointer owner, const char *name)
+{
+    if (_nm_startup_trace_enabled)
+        _nm_startup_trace_async_end(owner, name);
+}
+
+typedef struct {
+    const char *name;
+    char *      detail;
+    gint64      start_nsec;
+} NMStartupTraceScope;
+
+static inline NMStartupTraceScope
+_nm_startup_trace_scope_begin(const char *name, const char *detail)
+{
+    if (!_nm_startup_trace_enabled)
+        return (NMStartupTraceScope){};
+
+    return (NMStartupTraceScope){
+        .name       = name,
+        .detail     = g_strdup(detail),
+        .start_nsec = nm_utils_get_monotonic_timestamp_nsec(),
+    };
+}
+
+static inline void
+_nm_startup_trace_scope_end(NMStartupTraceScope *scope)
+{
+    if (scope->start_nsec != 0) {
+        nm_startup_trace_span_add(scope->name,
+                                  scope->detail,
+                                  scope->start_nsec,
+                                  nm_utils_get_monotonic_timestamp_nsec());
+        g_free(scope->detail);
+    }
+}
+
+/* Trace the remainder of the current C scope. @name must stay valid for
+ * the lifetime of the process, like a string literal. @detail is optional
+ * and gets copied. It is only evaluated while the trace is enabled. */
+#define NM_STARTUP_TRACE_SCOPE(name, detail)                            \
+    _nm_unused nm_auto(_nm_startup_trace_scope_end) NMStartupTraceScope \
+        NM_UNIQ_T(_trace_scope, NM_UNIQ) =                              \
+            _nm_startup_trace_scope_begin((name), _nm_startup_trace_enabled ? (detail) : NULL)
+
+#endif /* __NM_STARTUP_TRACE_H__ */
@@ -22,6 +22,7 @@
 #include <linux/if_tunnel.h>
 #include <linux/if_vlan.h>
 #include <linux/ip6_tunnel.h>
+#include <linux/netconf.h>
 #include <linux/tc_act/tc_mirred.h>
 #include <netinet/icmp6.h>
 #include <netinet/in.h>
@@ -51,6 +52,8 @@
 #include "wpan/nm-wpan-utils.h"
 #include "nm-glib-aux/nm-io-utils.h"
 #include "nm-udev-aux/nm-udev-utils.h"
+#include "nm-main-loop-profiler.h"
+#include "nm-startup-trace.h"
 
 /*****************************************************************************/
 
@@ -73,6 +76,38 @@ enum { TCA_DEF_UNSPEC, TCA_DEF_TM, TCA_DEF_PARMS, TCA_DEF_DATA, TCA_DEF_PAD, __T
 #define TCA_FQ_CODEL_CE_THRESHOLD 7
 #define TCA_FQ_CODEL_MEMORY_LIMIT 9
 
+/* Bridge VLAN notifications were added in kernel 5.8. */
+#ifndef RTM_NEWVLAN
+    #define RTM_NEWVLAN 112
+    #define RTM_DELVLAN 113
+
+struct br_vlan_msg {
+    __u8  family;
+    __u8  reserved1;
+    __u16 reserved2;
+    __u32 ifindex;
+};
+
+enum {
+    BRIDGE_VLANDB_UNSPEC,
+    BRIDGE_VLANDB_ENTRY,
+};
+
+enum {
+    BRIDGE_VLANDB_ENTRY_UNSPEC,
+    BRIDGE_VLANDB_ENTRY_INFO,
+    BRIDGE_VLANDB_ENTRY_RANGE,
+};
+#endif
+
+#ifndef RTNLGRP_BRVLAN
+    #define RTNLGRP_BRVLAN 33
+#endif
+
+#ifndef RTEXT_FILTER_BRVLAN_COMPRESSED
+    #define RTEXT_FILTER_BRVLAN_COMPRESSED (1 << 2)
+#endif
+
 /*****************************************************************************/
 
 #define VLAN_FLAG_MVRP 0x8
@@ -436,6 +471,18 @@ typedef struct {
 
     NMUdevClient *udev_client;
 
+    /* The bridge VLANs by ifindex (BridgeVlansEntry). They are filled by
+     * dumping the AF_BRIDGE links and updated by notifications. */
+    GHashTable *bridge_vlans;
+
+    /* whether @bridge_vlans contains all bridges and bridge ports. */
+    bool bridge_vlans_valid : 1;
+
+    /* whether we receive RTM_NEWVLAN/RTM_DELVLAN notifications. Without them,
+     * we don't see changes of the "default_pvid" option and must dump the
+     * VLANs every time before using the cache. */
+    bool bridge_vlans_notify : 1;
+
     struct {
         /* which delayed actions are scheduled, as marked in @flags.
          * Some types have additional arguments in the fields below. */
@@ -1228,6 +1275,63 @@ _nl_addattr_l(struct nlmsghdr *n, int maxlen, int type, const void *data, int al
 
 /*****************************************************************************/
 
+/* The position of the NMPlatformDevconf values in IFLA_INET_CONF and IFLA_INET6_CONF.
+ * Note that IFLA_INET_CONF is indexed by IPV4_DEVCONF_* minus one, while
+ * IFLA_INET6_CONF is indexed by DEVCONF_* from <linux/ipv6.h>. */
+static const struct {
+    int    addr_family;
+    guint8 kernel_id;
+} _devconf_infos[] = {
+    [NM_PLATFORM_DEVCONF_IP4_FORWARDING] = {AF_INET, IPV4_DEVCONF_FORWARDING},
+    [NM_PLATFORM_DEVCONF_IP4_RP_FILTER]  = {AF_INET, IPV4_DEVCONF_RP_FILTER},
+    [NM_PLATFORM_DEVCONF_IP6_FORWARDING] = {AF_INET6, 0 /* DEVCONF_FORWARDING */},
+};
+
+G_STATIC_ASSERT(G_N_ELEMENTS(_devconf_infos) == _NM_PLATFORM_DEVCONF_NUM);
+
+static void
+_parse_devconf(struct nlattr *attr, int addr_family, gint32 *devconf, guint8 *devconf_valid)
+{
+    const guint8 *data = nla_data(attr);
+    gsize         len  = nla_len(attr);
+    guint         i;
+
+    for (i = 0; i < _NM_PLATFORM_DEVCONF_NUM; i++) {
+        gsize idx;
+
+        if (_devconf_infos[i].addr_family != addr_family)
+            continue;
+
+        idx = _devconf_infos[i].kernel_id;
+        if (addr_family == AF_INET)
+            idx--;
+
+        if ((idx + 1u) * 4u > len)
+            continue;
+
+        devconf[i] = (gint32) unaligned_read_ne32(&data[idx * 4u]);
+        *devconf_valid |= (1u << i);
+    }
+}
+
+static gboolean
+_parse_af_inet(struct nlattr *attr, gint32 *devconf, guint8 *devconf_valid)
+{
+    static const struct nla_policy policy[] = {
+        [IFLA_INET_CONF] = {.minlen = 4},
+    };
+    struct nlattr *tb[G_N_ELEMENTS(policy)];
+
+    if (nla_parse_nested_arr(tb, attr, policy) < 0)
+        return FALSE;
+
+    if (!tb[IFLA_INET_CONF] || nla_len(tb[IFLA_INET_CONF]) % 4)
+        return FALSE;
+
+    _parse_devconf(tb[IFLA_INET_CONF], AF_INET, devconf, devconf_valid);
+    return TRUE;
+}
+
 /* Copied and heavily modified from libnl3's inet6_parse_protinfo(). */
 static gboolean
 _parse_af_inet6(NMPlatform *        platform,
@@ -1235,7 +1339,9 @@ _parse_af_inet6(NMPlatform *        platform,
                 NMUtilsIPv6IfaceId *out_token,
                 gboolean *          out_token_valid,
                 guint8 *            out_addr_gen_mode_inv,
-                gboolean *          out_addr_gen_mode_valid)
+                gboolean *          out_addr_gen_mode_valid,
+                gint32 *            devconf,
+                guint8 *            devconf_valid)
 {
     static const struct nla_policy policy[] = {
         [IFLA_INET6_FLAGS]      = {.type = NLA_U32},
@@ -1286,6 +1392,9 @@ _parse_af_inet6(NMPlatform *        platform,
         addr_gen_mode_valid = TRUE;
     }
 
+    if (tb[IFLA_INET6_CONF])
+        _parse_devconf(tb[IFLA_INET6_CONF], AF_INET6, devconf, devconf_valid);
+
     if (token_valid) {
         *out_token_valid = token_valid;
         nm_utils_ipv6_interface_identifier_get_from_addr(out_token, &i6_token);
@@ -3054,13 +3163,18 @@ _new_from_nl_link(NMPlatform *     platform,
 
         nla_for_each_nested (af_attr, tb[IFLA_AF_SPEC], remaining) {
             switch (nla_type(af_attr)) {
+            case AF_INET:
+                _parse_af_inet(af_attr, obj->link.devconf, &obj->link.devconf_valid);
+                break;
             case AF_INET6:
                 _parse_af_inet6(platform,
                                 af_attr,
                                 &obj->link.inet6_token,
                                 &af_inet6_token_valid,
                                 &obj->link.inet6_addr_gen_mode_inv,
-                                &af_inet6_addr_gen_mode_valid);
+                                &af_inet6_addr_gen_mode_valid,
+                                obj->link.devconf,
+                                &obj->link.devconf_valid);
                 break;
             }
         }
@@ -3126,7 +3240,7 @@ _new_from_nl_link(NMPlatform *     platform,
     if (completed_from_cache
         && (lnk_data_complete_from_cache || need_ext_data || address_complete_from_cache
             || broadcast_complete_from_cache || !af_inet6_token_valid
-            || !af_inet6_addr_gen_mode_valid || !tb[IFLA_STATS64])) {
+            || !af_inet6_addr_gen_mode_valid || !tb[IFLA_AF_SPEC] || !tb[IFLA_STATS64])) {
         _lookup_cached_link(cache, obj->link.ifindex, completed_from_cache, &link_cached);
         if (link_cached && link_cached->_link.netlink.is_in_netlink) {
             if (lnk_data_complete_from_cache && link_cached->link.type == obj->link.type
@@ -3156,6 +3270,12 @@ _new_from_nl_link(NMPlatform *     platform,
                 obj->link.inet6_token = link_cached->link.inet6_token;
             if (!af_inet6_addr_gen_mode_valid)
                 obj->link.inet6_addr_gen_mode_inv = link_cached->link.inet6_addr_gen_mode_inv;
+            if (!tb[IFLA_AF_SPEC]) {
+                /* If IFLA_AF_SPEC is present, it contains all address families. Only
+                 * if it is missing entirely, keep the previous devconf values. */
+                obj->link.devconf_valid = link_cached->link.devconf_valid;
+                memcpy(obj->link.devconf, link_cached->link.devconf, sizeof(obj->link.devconf));
+            }
             if (!tb[IFLA_STATS64]) {
                 obj->link.rx_packets = link_cached->link.rx_packets;
                 obj->link.rx_bytes   = link_cached->link.rx_bytes;
@@ -6847,6 +6967,296 @@ event_seq_check(NMPlatform *            platform,
 #endif
 }
 
+/*****************************************************************************/
+
+typedef struct {
+    int     ifindex;
+    bool    is_bridge;
+    GArray *vlans;
+} BridgeVlansEntry;
+
+static void
+_bridge_vlans_entry_free(gpointer data)
+{
+    BridgeVlansEntry *entry = data;
+
+    g_array_unref(entry->vlans);
+    nm_g_slice_free(entry);
+}
+
+static void
+_bridge_vlans_handle_link_msg(NMPlatform *platform, struct nlmsghdr *msghdr)
+{
+    static const struct nla_policy policy[] = {
+        [IFLA_MASTER]  = {.type = NLA_U32},
+        [IFLA_AF_SPEC] = {.type = NLA_NESTED},
+    };
+    NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE(platform);
+    struct nlattr *         tb[G_N_ELEMENTS(policy)];
+    const struct ifinfomsg *ifi;
+    BridgeVlansEntry *      entry;
+    struct nlattr *         attr;
+    guint16                 range_start = 0;
+    guint16                 range_flags = 0;
+    int                     rem;
+
+    if (!nlmsg_valid_hdr(msghdr, sizeof(*ifi)))
+        return;
+
+    ifi = nlmsg_data(msghdr);
+    if (ifi->ifi_index <= 0)
+        return;
+
+    if (msghdr->nlmsg_type == RTM_DELLINK) {
+        /* the port was removed from the bridge. */
+        g_hash_table_remove(priv->bridge_vlans, &ifi->ifi_index);
+        return;
+    }
+
+    if (nlmsg_parse_arr(msghdr, sizeof(*ifi), tb, policy) < 0)
+        return;
+
+    /* the messages of the bridge driver always have a master. For the
+     * bridge itself, the master is the bridge. */
+    if (!tb[IFLA_MASTER])
+        return;
+
+    entry  = g_slice_new(BridgeVlansEntry);
+    *entry = (BridgeVlansEntry){
+        .ifindex   = ifi->ifi_index,
+        .is_bridge = (nla_get_u32(tb[IFLA_MASTER]) == (guint32) ifi->ifi_index),
+        .vlans     = g_array_new(FALSE, FALSE, sizeof(NMPlatformBridgeVlan)),
+    };
+
+    if (tb[IFLA_AF_SPEC]) {
+        nla_for_each_nested (attr, tb[IFLA_AF_SPEC], rem) {
+            const struct bridge_vlan_info *vinfo;
+            guint16                        vid_start;
+
+            if (nla_type(attr) != IFLA_BRIDGE_VLAN_INFO || nla_len(attr) < (int) sizeof(*vinfo))
+                continue;
+
+            vinfo = nla_data(attr);
+
+            if (NM_FLAGS_HAS(vinfo->flags, BRIDGE_VLAN_INFO_RANGE_BEGIN)) {
+                range_start = vinfo->vid;
+                range_flags = vinfo->flags;
+                continue;
+            }
+
+            if (NM_FLAGS_HAS(vinfo->flags, BRIDGE_VLAN_INFO_RANGE_END)) {
+                if (!range_start)
+                    continue;
+                vid_start   = range_start;
+                range_start = 0;
+            } else {
+                vid_start   = vinfo->vid;
+                range_flags = vinfo->flags;
+            }
+
+            g_array_append_val(
+                entry->vlans,
+                ((NMPlatformBridgeVlan){
+                    .vid_start = vid_start,
+                    .vid_end   = vinfo->vid,
+                    .untagged  = NM_FLAGS_HAS(range_flags, BRIDGE_VLAN_INFO_UNTAGGED),
+                    .pvid      = NM_FLAGS_HAS(range_flags, BRIDGE_VLAN_INFO_PVID),
+                }));
+        }
+    }
+
+    g_hash_table_add(priv->bridge_vlans, entry);
+}
+
+static void
+_bridge_vlans_handle_vlan_msg(NMPlatform *platform, struct nlmsghdr *msghdr)
+{
+    static const struct nla_policy policy[] = {
+        [BRIDGE_VLANDB_ENTRY_INFO]  = {.minlen = sizeof(struct bridge_vlan_info)},
+        [BRIDGE_VLANDB_ENTRY_RANGE] = {.type = NLA_U16},
+    };
+    NMLinuxPlatformPrivate *  priv = NM_LINUX_PLATFORM_GET_PRIVATE(platform);
+    guint8                    flags[NM_PLATFORM_BRIDGE_VLAN_FLAGS_LEN];
+    const struct br_vlan_msg *bvm;
+    BridgeVlansEntry *        entry;
+    struct nlattr *           attr;
+    gboolean                  changed = FALSE;
+    int                       ifindex;
+    int                       rem;
+
+    if (!nlmsg_valid_hdr(msghdr, sizeof(*bvm)))
+        return;
+
+    bvm     = nlmsg_data(msghdr);
+    ifindex = bvm->ifindex;
+
+    /* we only update VLANs that we know. Others are fetched with
+     * the next dump. */
+    entry = g_hash_table_lookup(priv->bridge_vlans, &ifindex);
+    if (!entry)
+        return;
+
+    nm_platform_bridge_vlans_to_flags((const NMPlatformBridgeVlan *) entry->vlans->data,
+                                      entry->vlans->len,
+                                      flags);
+
+    nla_for_each_attr (attr,
+                       nlmsg_attrdata(msghdr, sizeof(*bvm)),
+                       nlmsg_attrlen(msghdr, sizeof(*bvm)),
+                       rem) {
+        struct nlattr *                tb[G_N_ELEMENTS(policy)];
+        const struct bridge_vlan_info *vinfo;
+        guint                          vid;
+        guint                          vid_end;
+        guint8                         f = 0;
+
+        if (nla_type(attr) != BRIDGE_VLANDB_ENTRY)
+            continue;
+        if (nla_parse_nested_arr(tb, attr, policy) < 0 || !tb[BRIDGE_VLANDB_ENTRY_INFO])
+            continue;
+
+        vinfo   = nla_data(tb[BRIDGE_VLANDB_ENTRY_INFO]);
+        vid_end = tb[BRIDGE_VLANDB_ENTRY_RANGE] ? nla_get_u16(tb[BRIDGE_VLANDB_ENTRY_RANGE])
+                                                : vinfo->vid;
+
+        /* on the bridge itself, a VLAN without BRENTRY flag is only a
+         * global VLAN context and not configured on the bridge. */
+        if (msghdr->nlmsg_type == RTM_NEWVLAN
+            && (!entry->is_bridge || NM_FLAGS_HAS(vinfo->flags, BRIDGE_VLAN_INFO_BRENTRY))) {
+            f = NM_PLATFORM_BRIDGE_VLAN_FLAG_PRESENT;
+            if (NM_FLAGS_HAS(vinfo->flags, BRIDGE_VLAN_INFO_UNTAGGED))
+                f |= NM_PLATFORM_BRIDGE_VLAN_FLAG_UNTAGGED;
+            if (NM_FLAGS_HAS(vinfo->flags, BRIDGE_VLAN_INFO_PVID)) {
+                /* there is only one PVID. */
+                for (vid = 1; vid <= NM_PLATFORM_BRIDGE_VLAN_VID_MAX; vid++)
+                    flags[vid] &= ~NM_PLATFORM_BRIDGE_VLAN_FLAG_PVID;
+                f |= NM_PLATFORM_BRIDGE_VLAN_FLAG_PVID;
+            }
+        }
+
+        vid_end = MIN(vid_end, (guint) NM_PLATFORM_BRIDGE_VLAN_VID_MAX);
+        for (vid = MAX(vinfo->vid, 1u); vid <= vid_end; vid++)
+            flags[vid] = f;
+        changed = TRUE;
+    }
+
+    if (changed) {
+        g_array_unref(entry->vlans);
+        entry->vlans = nm_platform_bridge_vlans_from_flags(flags);
+    }
+}
+
+static gboolean
+_bridge_vlans_handle_msg(NMPlatform *platform, struct nlmsghdr *msghdr)
+{
+    NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE(platform);
+
+    switch (msghdr->nlmsg_type) {
+    case RTM_NEWLINK:
+    case RTM_DELLINK:
+        if (!nlmsg_valid_hdr(msghdr, sizeof(struct ifinfomsg)))
+            return FALSE;
+        if (((struct ifinfomsg *) nlmsg_data(msghdr))->ifi_family != AF_BRIDGE) {
+            if (msghdr->nlmsg_type == RTM_DELLINK) {
+                /* the link is gone. Let the regular handling continue. */
+                g_hash_table_remove(priv->bridge_vlans,
+                                    &((struct ifinfomsg *) nlmsg_data(msghdr))->ifi_index);
+            }
+            return FALSE;
+        }
+        _bridge_vlans_handle_link_msg(platform, msghdr);
+        return TRUE;
+    case RTM_NEWVLAN:
+    case RTM_DELVLAN:
+        _bridge_vlans_handle_vlan_msg(platform, msghdr);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* RTM_NEWNETCONF announces changes of some of the ip_conf sysctls, also
+ * those by other processes. Update the devconf values of the cached link. */
+static gboolean
+_netconf_handle_msg(NMPlatform *platform, struct nlmsghdr *msghdr)
+{
+    static const struct nla_policy policy[] = {
+        [NETCONFA_IFINDEX]    = {.type = NLA_S32},
+        [NETCONFA_FORWARDING] = {.type = NLA_S32},
+        [NETCONFA_RP_FILTER]  = {.type = NLA_S32},
+    };
+    struct nlattr *                 tb[G_N_ELEMENTS(policy)];
+    nm_auto_nmpobj NMPObject *      obj     = NULL;
+    nm_auto_nmpobj const NMPObject *obj_old = NULL;
+    nm_auto_nmpobj const NMPObject *obj_new = NULL;
+    NMPCache *                      cache   = nm_platform_get_cache(platform);
+    const struct netconfmsg *       ncm;
+    const NMPObject *               obj_cached;
+    NMPCacheOpsType                 cache_op;
+    gint32                          devconf[_NM_PLATFORM_DEVCONF_NUM];
+    guint8                          devconf_valid;
+    int                             ifindex;
+
+    if (msghdr->nlmsg_type != RTM_NEWNETCONF)
+        return FALSE;
+
+    if (nlmsg_parse_arr(msghdr, sizeof(*ncm), tb, policy) < 0 || !tb[NETCONFA_IFINDEX])
+        return TRUE;
+
+    /* changes of "all" and "default" are followed by a message for each
+     * affected link. */
+    ifindex = nla_get_s32(tb[NETCONFA_IFINDEX]);
+    if (ifindex <= 0)
+        return TRUE;
+
+    obj_cached = nmp_cache_lookup_link(cache, ifindex);
+    if (!obj_cached || !obj_cached->_link.netlink.is_in_netlink)
+        return TRUE;
+
+    memcpy(devconf, obj_cached->link.devconf, sizeof(devconf));
+    devconf_valid = obj_cached->link.devconf_valid;
+
+    ncm = nlmsg_data(msghdr);
+    switch (ncm->ncm_family) {
+    case AF_INET:
+        if (tb[NETCONFA_FORWARDING]) {
+            devconf[NM_PLATFORM_DEVCONF_IP4_FORWARDING] = nla_get_s32(tb[NETCONFA_FORWARDING]);
+            devconf_valid |= (1u << NM_PLATFORM_DEVCONF_IP4_FORWARDING);
+        }
+        if (tb[NETCONFA_RP_FILTER]) {
+            devconf[NM_PLATFORM_DEVCONF_IP4_RP_FILTER] = nla_get_s32(tb[NETCONFA_RP_FILTER]);
+            devconf_valid |= (1u << NM_PLATFORM_DEVCONF_IP4_RP_FILTER);
+        }
+        break;
+    case AF_INET6:
+        if (tb[NETCONFA_FORWARDING]) {
+            devconf[NM_PLATFORM_DEVCONF_IP6_FORWARDING] = nla_get_s32(tb[NETCONFA_FORWARDING]);
+            devconf_valid |= (1u << NM_PLATFORM_DEVCONF_IP6_FORWARDING);
+        }
+        break;
+    default:
+        return TRUE;
+    }
+
+    if (devconf_valid == obj_cached->link.devconf_valid
+        && memcmp(devconf, obj_cached->link.devconf, sizeof(devconf)) == 0)
+        return TRUE;
+
+    /* like for WireGuard, re-inject a modified clone into the cache. */
+    obj                     = nmp_object_clone(obj_cached, FALSE);
+    obj->link.devconf_valid = devconf_valid;
+    memcpy(obj->link.devconf, devconf, sizeof(devconf));
+    obj->link.driver = NULL;
+    nm_clear_pointer(&obj->_link.udev.device, udev_device_unref);
+
+    cache_op = nmp_cache_update_netlink(cache, obj, FALSE, &obj_old, &obj_new);
+    if (cache_op != NMP_CACHE_OPS_UNCHANGED) {
+        cache_on_change(platform, cache_op, obj_old, obj_new);
+        nm_platform_cache_update_emit_signal(platform, cache_op, obj_old, obj_new);
+    }
+    return TRUE;
+}
+
 static void
 event_valid_msg(NMPlatform *platform, struct nl_msg *msg, gboolean handle_events)
 {
@@ -6885,6 +7295,18 @@ event_valid_msg(NMPlatform *platform, struct nl_msg *msg, gboolean handle_events
     if (!handle_events)
         return;
 
+    if (_bridge_vlans_handle_msg(platform, msghdr)) {
+        _LOGT("event-notification: %s: bridge VLANs",
+              nl_nlmsghdr_to_str(msghdr, buf_nlmsghdr, sizeof(buf_nlmsghdr)));
+        return;
+    }
+
+    if (_netconf_handle_msg(platform, msghdr)) {
+        _LOGT("event-notification: %s: netconf",
+              nl_nlmsghdr_to_str(msghdr, buf_nlmsghdr, sizeof(buf_nlmsghdr)));
+        return;
+    }
+
     if (NM_IN_SET(msghdr->nlmsg_type,
                   RTM_DELLINK,
                   RTM_DELADDR,
@@ -7407,6 +7829,26 @@ link_refresh(NMPlatform *platform, int ifindex)
     return !!nm_platform_link_get_obj(platform, ifindex, TRUE);
 }
 
+static void
+refresh_all(NMPlatform *platform, NMPObjectType obj_type)
+{
+    NMPObject obj_needle;
+
+    /* routing rules are refreshed per address family, which a needle
+     * without address cannot express. */
+    g_return_if_fail(NM_IN_SET(obj_type,
+                               NMP_OBJECT_TYPE_LINK,
+                               NMP_OBJECT_TYPE_IP4_ADDRESS,
+                               NMP_OBJECT_TYPE_IP6_ADDRESS,
+                               NMP_OBJECT_TYPE_IP4_ROUTE,
+                               NMP_OBJECT_TYPE_IP6_ROUTE,
+                               NMP_OBJECT_TYPE_QDISC,
+                               NMP_OBJECT_TYPE_TFILTER));
+
+    do_request_one_type_by_needle_object(platform,
+                                         nmp_object_stackinit(&obj_needle, obj_type, NULL));
+}
+
 static gboolean
 link_set_netns(NMPlatform *platform, int ifindex, int netns_fd)
 {
@@ -7509,6 +7951,45 @@ link_set_token(NMPlatform *platform, int ifindex, NMUtilsIPv6IfaceId iid)
     return (do_change_link(platform, CHANGE_LINK_TYPE_UNSPEC, ifindex, nlmsg, NULL) >= 0);
 }
 
+static int
+link_set_devconf(NMPlatform *platform, int ifindex, NMPlatformDevconf devconf, gint32 value)
+{
+    nm_auto_nlmsg struct nl_msg *nlmsg = NULL;
+    struct nlattr *              af_spec;
+    struct nlattr *              af_attr;
+    struct nlattr *              conf;
+
+    nm_assert(devconf < _NM_PLATFORM_DEVCONF_NUM);
+
+    /* The kernel only accepts IFLA_INET_CONF. IFLA_INET6_CONF is read-only. */
+    if (_devconf_infos[devconf].addr_family != AF_INET)
+        return -NME_PL_OPNOTSUPP;
+
+    _LOGD("link: change %d: devconf: set IPv4 devconf #%u to %d",
+          ifindex,
+          (guint) _devconf_infos[devconf].kernel_id,
+          (int) value);
+
+    nlmsg = _nl_msg_new_link(RTM_NEWLINK, 0, ifindex, NULL);
+    if (!nlmsg)
+        g_return_val_if_reached(-NME_BUG);
+
+    if (!(af_spec = nla_nest_start(nlmsg, IFLA_AF_SPEC)))
+        goto nla_put_failure;
+    if (!(af_attr = nla_nest_start(nlmsg, AF_INET)))
+        goto nla_put_failure;
+    if (!(conf = nla_nest_start(nlmsg, IFLA_INET_CONF)))
+        goto nla_put_failure;
+    NLA_PUT_U32(nlmsg, _devconf_infos[devconf].kernel_id, value);
+    nla_nest_end(nlmsg, conf);
+    nla_nest_end(nlmsg, af_attr);
+    nla_nest_end(nlmsg, af_spec);
+
+    return do_change_link(platform, CHANGE_LINK_TYPE_UNSPEC, ifindex, nlmsg, NULL);
+nla_put_failure:
+    g_return_val_if_reached(-NME_BUG);
+}
+
 static gboolean
 link_supports_carrier_detect(NMPlatform *platform, int ifindex)
 {
@@ -7861,6 +8342,33 @@ nla_put_failure:
     g_return_val_if_reached(FALSE);
 }
 
+static gboolean
+_nl_put_bridge_vlan(struct nl_msg *nlmsg, const NMPlatformBridgeVlan *vlan)
+{
+    struct bridge_vlan_info vinfo    = {};
+    gboolean                is_range = vlan->vid_start != vlan->vid_end;
+
+    vinfo.vid   = vlan->vid_start;
+    vinfo.flags = is_range ? BRIDGE_VLAN_INFO_RANGE_BEGIN : 0;
+
+    if (vlan->untagged)
+        vinfo.flags |= BRIDGE_VLAN_INFO_UNTAGGED;
+    if (vlan->pvid)
+        vinfo.flags |= BRIDGE_VLAN_INFO_PVID;
+
+    NLA_PUT(nlmsg, IFLA_BRIDGE_VLAN_INFO, sizeof(vinfo), &vinfo);
+
+    if (is_range) {
+        vinfo.vid   = vlan->vid_end;
+        vinfo.flags = BRIDGE_VLAN_INFO_RANGE_END;
+        NLA_PUT(nlmsg, IFLA_BRIDGE_VLAN_INFO, sizeof(vinfo), &vinfo);
+    }
+
+    return TRUE;
+nla_put_failure:
+    return FALSE;
+}
+
 static gboolean
 link_set_bridge_vlans(NMPlatform *                       platform,
                       int                                ifindex,
@@ -7869,7 +8377,6 @@ link_set_bridge_vlans(NMPlatform *                       platform,
 {
     nm_auto_nlmsg struct nl_msg *nlmsg = NULL;
     struct nlattr *              list;
-    struct bridge_vlan_info      vinfo = {};
     guint                        i;
 
     nlmsg =
@@ -7885,34 +8392,89 @@ link_set_bridge_vlans(NMPlatform *                       platform,
     if (vlans) {
         /* Add VLANs */
         for (i = 0; vlans[i]; i++) {
-            const NMPlatformBridgeVlan *vlan     = vlans[i];
-            gboolean                    is_range = vlan->vid_start != vlan->vid_end;
+            if (!_nl_put_bridge_vlan(nlmsg, vlans[i]))
+                goto nla_put_failure;
+        }
+    } else {
+        /* Flush existing VLANs */
+        if (!_nl_put_bridge_vlan(nlmsg,
+                                 &((const NMPlatformBridgeVlan){
+                                     .vid_start = 1,
+                                     .vid_end   = NM_PLATFORM_BRIDGE_VLAN_VID_MAX,
+                                 })))
+            goto nla_put_failure;
+    }
 
-            vinfo.vid   = vlan->vid_start;
-            vinfo.flags = is_range ? BRIDGE_VLAN_INFO_RANGE_BEGIN : 0;
+    nla_nest_end(nlmsg, list);
 
-            if (vlan->untagged)
-                vinfo.flags |= BRIDGE_VLAN_INFO_UNTAGGED;
-            if (vlan->pvid)
-                vinfo.flags |= BRIDGE_VLAN_INFO_PVID;
+    return (do_change_link(platform, CHANGE_LINK_TYPE_UNSPEC, ifindex, nlmsg, NULL) >= 0);
+nla_put_failure:
+    g_return_val_if_reached(FALSE);
+}
 
-            NLA_PUT(nlmsg, IFLA_BRIDGE_VLAN_INFO, sizeof(vinfo), &vinfo);
+static gboolean
+_bridge_vlans_request_all(NMPlatform *platform)
+{
+    NMLinuxPlatformPrivate *     priv       = NM_LINUX_PLATFORM_GET_PRIVATE(platform);
+    nm_auto_nlmsg struct nl_msg *nlmsg      = NULL;
+    WaitForNlResponseResult      seq_result = WAIT_FOR_NL_RESPONSE_RESULT_UNKNOWN;
+    char                         s_buf[256];
 
-            if (is_range) {
-                vinfo.vid   = vlan->vid_end;
-                vinfo.flags = BRIDGE_VLAN_INFO_RANGE_END;
-                NLA_PUT(nlmsg, IFLA_BRIDGE_VLAN_INFO, sizeof(vinfo), &vinfo);
-            }
-        }
-    } else {
-        /* Flush existing VLANs */
-        vinfo.vid   = 1;
-        vinfo.flags = BRIDGE_VLAN_INFO_RANGE_BEGIN;
-        NLA_PUT(nlmsg, IFLA_BRIDGE_VLAN_INFO, sizeof(vinfo), &vinfo);
+    nlmsg = _nl_msg_new_link_full(RTM_GETLINK, NLM_F_DUMP, 0, NULL, AF_BRIDGE, 0, 0);
+    if (!nlmsg)
+        g_return_val_if_reached(FALSE);
 
-        vinfo.vid   = 4094;
-        vinfo.flags = BRIDGE_VLAN_INFO_RANGE_END;
-        NLA_PUT(nlmsg, IFLA_BRIDGE_VLAN_INFO, sizeof(vinfo), &vinfo);
+    NLA_PUT_U32(nlmsg, IFLA_EXT_MASK, RTEXT_FILTER_BRVLAN_COMPRESSED);
+
+    g_hash_table_remove_all(priv->bridge_vlans);
+    priv->bridge_vlans_valid = FALSE;
+
+    if (_nl_send_nlmsg(platform, nlmsg, &seq_result, NULL, DELAYED_ACTION_RESPONSE_TYPE_VOID, NULL)
+        < 0)
+        return FALSE;
+
+    delayed_action_handle_all(platform, FALSE);
+
+    if (seq_result != WAIT_FOR_NL_RESPONSE_RESULT_RESPONSE_OK) {
+        _LOGD("bridge-vlans: failure to dump bridge VLANs: %s",
+              wait_for_nl_response_to_string(seq_result, NULL, s_buf, sizeof(s_buf)));
+        return FALSE;
+    }
+
+    /* without notifications about VLAN changes (before kernel 5.8), the
+     * cache is only good for the current request. */
+    priv->bridge_vlans_valid = priv->bridge_vlans_notify;
+    return TRUE;
+nla_put_failure:
+    g_return_val_if_reached(FALSE);
+}
+
+static gboolean
+_bridge_vlans_send(NMPlatform *platform,
+                   int         ifindex,
+                   gboolean    on_master,
+                   int         nlmsg_type,
+                   GArray *    vlans)
+{
+    nm_auto_nlmsg struct nl_msg *nlmsg = NULL;
+    struct nlattr *              list;
+    guint                        i;
+
+    if (vlans->len == 0)
+        return TRUE;
+
+    nlmsg = _nl_msg_new_link_full(nlmsg_type, 0, ifindex, NULL, AF_BRIDGE, 0, 0);
+    if (!nlmsg)
+        g_return_val_if_reached(FALSE);
+
+    if (!(list = nla_nest_start(nlmsg, IFLA_AF_SPEC)))
+        goto nla_put_failure;
+
+    NLA_PUT_U16(nlmsg, IFLA_BRIDGE_FLAGS, on_master ? BRIDGE_FLAGS_MASTER : BRIDGE_FLAGS_SELF);
+
+    for (i = 0; i < vlans->len; i++) {
+        if (!_nl_put_bridge_vlan(nlmsg, &g_array_index(vlans, NMPlatformBridgeVlan, i)))
+            goto nla_put_failure;
     }
 
     nla_nest_end(nlmsg, list);
@@ -7922,6 +8484,68 @@ nla_put_failure:
     g_return_val_if_reached(FALSE);
 }
 
+static gboolean
+link_sync_bridge_vlans(NMPlatform *                       platform,
+                       int                                ifindex,
+                       gboolean                           on_master,
+                       const NMPlatformBridgeVlan *const *vlans)
+{
+    NMLinuxPlatformPrivate *priv      = NM_LINUX_PLATFORM_GET_PRIVATE(platform);
+    gs_unref_array GArray * vlans_del = NULL;
+    gs_unref_array GArray * vlans_add = NULL;
+    BridgeVlansEntry *      entry;
+
+    /* process pending notifications, so that the cache is up to date. */
+    event_handler_read_netlink(platform, FALSE);
+
+    if (!priv->bridge_vlans_valid)
+        _bridge_vlans_request_all(platform);
+
+    entry = g_hash_table_lookup(priv->bridge_vlans, &ifindex);
+    if (!entry || entry->is_bridge == on_master) {
+        /* We don't know the current VLANs of the interface. Fall back to
+         * flushing all VLANs and adding the requested ones. */
+        _LOGD("bridge-vlans: %d: current VLANs unknown, replace all", ifindex);
+        if (!link_set_bridge_vlans(platform, ifindex, on_master, NULL))
+            return FALSE;
+        return !vlans || link_set_bridge_vlans(platform, ifindex, on_master, vlans);
+    }
+
+    nm_platform_bridge_vlans_diff((const NMPlatformBridgeVlan *) entry->vlans->data,
+                                  entry->vlans->len,
+                                  vlans,
+                                  &vlans_del,
+                                  &vlans_add);
+
+    _LOGD("bridge-vlans: %d: remove %u and add %u VLAN ranges",
+          ifindex,
+          vlans_del->len,
+          vlans_add->len);
+
+    /* @entry might be gone after the first request. */
+    entry = NULL;
+
+    if (!_bridge_vlans_send(platform, ifindex, on_master, RTM_DELLINK, vlans_del))
+        return FALSE;
+    return _bridge_vlans_send(platform, ifindex, on_master, RTM_SETLINK, vlans_add);
+}
+
+static GArray *
+link_get_bridge_vlans(NMPlatform *platform, int ifindex, gboolean on_master)
+{
+    NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE(platform);
+    BridgeVlansEntry *      entry;
+    GArray *                vlans;
+
+    entry = g_hash_table_lookup(priv->bridge_vlans, &ifindex);
+    if (!entry || entry->is_bridge == on_master)
+        return NULL;
+
+    vlans = g_array_sized_new(FALSE, FALSE, sizeof(NMPlatformBridgeVlan), entry->vlans->len);
+    g_array_append_vals(vlans, entry->vlans->data, entry->vlans->len);
+    return vlans;
+}
+
 static char *
 link_get_physical_port_id(NMPlatform *platform, int ifindex)
 {
@@ -8902,9 +9526,129 @@ tfilter_add(NMPlatform *platform, NMPNlmFlags flags, const NMPlatformTfilter *tf
 
 /*****************************************************************************/
 
+static int
+tc_batch(NMPlatform *platform, int ifindex, NMPlatformTcOp *ops, guint n_ops)
+{
+    NMLinuxPlatformPrivate *         priv        = NM_LINUX_PLATFORM_GET_PRIVATE(platform);
+    gs_unref_ptrarray GPtrArray *    msgs        = NULL;
+    gs_free struct iovec *           iov         = NULL;
+    gs_free WaitForNlResponseResult *seq_results = NULL;
+    gs_free char **                  errmsgs     = NULL;
+    char                             s_buf[256];
+    guint                            i;
+    int                              nle;
+
+    nm_assert(n_ops > 0);
+
+    msgs        = g_ptr_array_new_full(n_ops, (GDestroyNotify) nlmsg_free);
+    iov         = g_new(struct iovec, n_ops);
+    seq_results = g_new0(WaitForNlResponseResult, n_ops);
+    errmsgs     = g_new0(char *, n_ops);
+
+    for (i = 0; i < n_ops; i++) {
+        const NMPlatformTcOp *op = &ops[i];
+        struct nl_msg *       msg;
+        struct nlmsghdr *     nlhdr;
+        int                   nlmsg_type;
+        int                   nlmsg_flags;
+
+        switch (op->op_type) {
+        case NM_PLATFORM_TC_OP_TYPE_DELETE:
+            nlmsg_flags = 0;
+            break;
+        case NM_PLATFORM_TC_OP_TYPE_ADD:
+            nlmsg_flags = NMP_NLM_FLAG_ADD;
+            break;
+        case NM_PLATFORM_TC_OP_TYPE_REPLACE:
+        default:
+            nlmsg_flags = NMP_NLM_FLAG_REPLACE;
+            break;
+        }
+
+        if (op->obj_type == NMP_OBJECT_TYPE_QDISC) {
+            nlmsg_type =
+                (op->op_type == NM_PLATFORM_TC_OP_TYPE_DELETE) ? RTM_DELQDISC : RTM_NEWQDISC;
+            msg = _nl_msg_new_qdisc(nlmsg_type, nlmsg_flags, op->qdisc);
+        } else {
+            nlmsg_type =
+                (op->op_type == NM_PLATFORM_TC_OP_TYPE_DELETE) ? RTM_DELTFILTER : RTM_NEWTFILTER;
+            msg = _nl_msg_new_tfilter(nlmsg_type, nlmsg_flags, op->tfilter);
+        }
+        if (!msg)
+            g_return_val_if_reached(-NME_BUG);
+        g_ptr_array_add(msgs, msg);
+
+        nlhdr            = nlmsg_hdr(msg);
+        nlhdr->nlmsg_seq = _nlh_seq_next_get(priv);
+        nl_complete_msg(priv->nlh, msg);
+
+        /* the kernel expects the messages at aligned offsets. */
+        nm_assert(NLMSG_ALIGN(nlhdr->nlmsg_len) == nlhdr->nlmsg_len);
+
+        iov[i] = (struct iovec){
+            .iov_base = nlhdr,
+            .iov_len  = nlhdr->nlmsg_len,
+        };
+    }
+
+    event_handler_read_netlink(platform, FALSE);
+
+    /* the kernel handles all messages in one buffer in order and
+     * acknowledges each of them. */
+    nle = nl_send_iovec(priv->nlh, msgs->pdata[0], iov, n_ops);
+    if (nle < 0) {
+        _LOGE("do-tc-batch: failed sending netlink request \"%s\" (%d)", nm_strerror(nle), -nle);
+        for (i = 0; i < n_ops; i++)
+            ops[i].result = -NME_PL_NETLINK;
+        return -NME_PL_NETLINK;
+    }
+
+    for (i = 0; i < n_ops; i++) {
+        delayed_action_schedule_WAIT_FOR_NL_RESPONSE(platform,
+                                                     nlmsg_hdr(msgs->pdata[i])->nlmsg_seq,
+                                                     &seq_results[i],
+                                                     &errmsgs[i],
+                                                     DELAYED_ACTION_RESPONSE_TYPE_VOID,
+                                                     NULL);
+    }
+
+    delayed_action_handle_all(platform, FALSE);
+
+    for (i = 0; i < n_ops; i++) {
+        NMPlatformTcOp *op = &ops[i];
+
+        nm_assert(seq_results[i]);
+
+        if (op->op_type == NM_PLATFORM_TC_OP_TYPE_DELETE
+            && NM_IN_SET(-((int) seq_results[i]), ESRCH, ENOENT)) {
+            /* the object was already removed, for example together with its parent. */
+            seq_results[i] = WAIT_FOR_NL_RESPONSE_RESULT_RESPONSE_OK;
+        }
+
+        _NMLOG(seq_results[i] == WAIT_FOR_NL_RESPONSE_RESULT_RESPONSE_OK ? LOGL_DEBUG : LOGL_WARN,
+               "do-tc-batch: %s %s: %s",
+               op->op_type == NM_PLATFORM_TC_OP_TYPE_DELETE
+                   ? "delete"
+                   : (op->op_type == NM_PLATFORM_TC_OP_TYPE_ADD ? "add" : "replace"),
+               op->obj_type == NMP_OBJECT_TYPE_QDISC
+                   ? nm_platform_qdisc_to_string(op->qdisc, NULL, 0)
+                   : nm_platform_tfilter_to_string(op->tfilter, NULL, 0),
+               wait_for_nl_response_to_string(seq_results[i], errmsgs[i], s_buf, sizeof(s_buf)));
+
+        op->result = wait_for_nl_response_to_nmerr(seq_results[i]);
+        nm_clear_g_free(&errmsgs[i]);
+    }
+
+    return 0;
+}
+
+/*****************************************************************************/
+
 static gboolean
 event_handler(int fd, GIOCondition io_condition, gpointer user_data)
 {
+    NM_MAIN_LOOP_PROFILE_SCOPE("platform netlink events");
+
     delayed_action_handle_all(NM_PLATFORM(user_data), TRUE);
     return TRUE;
 }
@@ -9169,6 +9913,7 @@ event_handler_read_netlink(NMPlatform *platform, gboolean wait_for_acks)
                         platform,
                         WAIT_FOR_NL_RESPONSE_RESULT_FAILED_RESYNC);
 
+                    priv->bridge_vlans_valid = FALSE;
                     delayed_action_schedule(platform,
                                             DELAYED_ACTION_TYPE_REFRESH_ALL_LINKS
                                                 | DELAYED_ACTION_TYPE_REFRESH_ALL_IP4_ADDRESSES
@@ -9384,6 +10129,8 @@ nm_linux_platform_init(NMLinuxPlatform *self)
     priv->delayed_action.list_refresh_link     = g_ptr_array_new();
     priv->delayed_action.list_wait_for_nl_response =
         g_array_new(FALSE, TRUE, sizeof(DelayedActionWaitForNlResponseData));
+    priv->bridge_vlans =
+        g_hash_table_new_full(nm_pint_hash, nm_pint_equals, _bridge_vlans_entry_free, NULL);
 }
 
 static void
@@ -9461,6 +10208,16 @@ constructed(GObject *_object)
                                     0);
     g_assert(!nle);
 
+    /* bridge VLAN notifications are only supported since kernel 5.8. */
+    nle = nl_socket_add_memberships(priv->nlh, RTNLGRP_BRVLAN, 0);
+    if (nle)
+        _LOGD("could not subscribe to bridge VLAN notifications: %s", nm_strerror(nle));
+    priv->bridge_vlans_notify = !nle;
+
+    nle = nl_socket_add_memberships(priv->nlh, RTNLGRP_IPV4_NETCONF, RTNLGRP_IPV6_NETCONF, 0);
+    if (nle)
+        _LOGD("could not subscribe to netconf notifications: %s", nm_strerror(nle));
+
     fd = nl_socket_get_fd(priv->nlh);
 
     _LOGD("Netlink socket for events established: port=%u, fd=%d",
@@ -9480,17 +10237,21 @@ constructed(GObject *_object)
     G_OBJECT_CLASS(nm_linux_platform_parent_class)->constructed(_object);
 
     _LOGD("populate platform cache");
-    delayed_action_schedule(
-        platform,
-        DELAYED_ACTION_TYPE_REFRESH_ALL_LINKS | DELAYED_ACTION_TYPE_REFRESH_ALL_IP4_ADDRESSES
-            | DELAYED_ACTION_TYPE_REFRESH_ALL_IP6_ADDRESSES
-            | DELAYED_ACTION_TYPE_REFRESH_ALL_IP4_ROUTES
-            | DELAYED_ACTION_TYPE_REFRESH_ALL_IP6_ROUTES
-            | DELAYED_ACTION_TYPE_REFRESH_ALL_ROUTING_RULES_ALL
-            | DELAYED_ACTION_TYPE_REFRESH_ALL_QDISCS | DELAYED_ACTION_TYPE_REFRESH_ALL_TFILTERS,
-        NULL);
+    {
+        NM_STARTUP_TRACE_SCOPE("platform-netlink-dump", NULL);
+
+        delayed_action_schedule(
+            platform,
+            DELAYED_ACTION_TYPE_REFRESH_ALL_LINKS | DELAYED_ACTION_TYPE_REFRESH_ALL_IP4_ADDRESSES
+                | DELAYED_ACTION_TYPE_REFRESH_ALL_IP6_ADDRESSES
+                | DELAYED_ACTION_TYPE_REFRESH_ALL_IP4_ROUTES
+                | DELAYED_ACTION_TYPE_REFRESH_ALL_IP6_ROUTES
+                | DELAYED_ACTION_TYPE_REFRESH_ALL_ROUTING_RULES_ALL
+                | DELAYED_ACTION_TYPE_REFRESH_ALL_QDISCS | DELAYED_ACTION_TYPE_REFRESH_ALL_TFILTERS,
+            NULL);
 
-    delayed_action_handle_all(platform, FALSE);
+        delayed_action_handle_all(platform, FALSE);
+    }
 
     /* Set up udev monitoring */
     if (priv->udev_client) {
@@ -9587,6 +10348,7 @@ finalize(GObject *object)
     g_ptr_array_unref(priv->delayed_action.list_master_connected);
     g_ptr_array_unref(priv->delayed_action.list_refresh_link);
     g_array_unref(priv->delayed_action.list_wait_for_nl_response);
+    g_hash_table_destroy(priv->bridge_vlans);
 
     nl_socket_free(priv->genl);
 
@@ -9622,6 +10384,7 @@ nm_linux_platform_class_init(NMLinuxPlatformClass *klass)
     platform_class->link_delete = link_delete;
 
     platform_class->link_refresh = link_refresh;
+    platform_class->refresh_all  = refresh_all;
 
     platform_class->link_set_netns = link_set_netns;
 
@@ -9632,6 +10395,7 @@ nm_linux_platform_class_init(NMLinuxPlatformClass *klass)
 
     platform_class->link_set_user_ipv6ll_enabled = link_set_user_ipv6ll_enabled;
     platform_class->link_set_token               = link_set_token;
+    platform_class->link_set_devconf             = link_set_devconf;
 
     platform_class->link_set_address            = link_set_address;
     platform_class->link_get_permanent_address  = link_get_permanent_address;
@@ -9640,6 +10404,8 @@ nm_linux_platform_class_init(NMLinuxPlatformClass *klass)
     platform_class->link_set_sriov_params_async = link_set_sriov_params_async;
     platform_class->link_set_sriov_vfs          = link_set_sriov_vfs;
     platform_class->link_set_bridge_vlans       = link_set_bridge_vlans;
+    platform_class->link_sync_bridge_vlans      = link_sync_bridge_vlans;
+    platform_class->link_get_bridge_vlans       = link_get_bridge_vlans;
 
     platform_class->link_get_physical_port_id = link_get_physical_port_id;
     platform_class->link_get_dev_id           = link_get_dev_id;
@@ -9697,6 +10463,7 @@ nm_linux_platform_class_init(NMLinuxPlatformClass *klass)
 
     platform_class->qdisc_add   = qdisc_add;
     platform_class->tfilter_add = tfilter_add;
+    platform_class->tc_batch    = tc_batch;
 
     platform_class->process_events = process_events;
 }
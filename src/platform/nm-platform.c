@@ -179,6 +179,11 @@ typedef struct _NMPlatformPrivate {
     bool use_udev : 1;
     bool log_with_ptr : 1;
 
+    /* whether we wrote an ip_conf sysctl via the file system. The kernel
+     * announces the change with RTM_NEWNETCONF, but the cached devconf
+     * values are outdated until we process that event. */
+    bool devconf_dirty : 1;
+
     guint              ip4_dev_route_blacklist_check_id;
     guint              ip4_dev_route_blacklist_gc_timeout_id;
     GHashTable *       ip4_dev_route_blacklist_hash;
@@ -462,6 +467,23 @@ nm_platform_process_events(NMPlatform *self)
         klass->process_events(self);
 }
 
+/**
+ * nm_platform_refresh_all:
+ * @self: platform instance
+ * @obj_type: the type of the objects to refresh
+ *
+ * Reload the cache for all objects of @obj_type synchronously,
+ * with one dump request.
+ */
+void
+nm_platform_refresh_all(NMPlatform *self, NMPObjectType obj_type)
+{
+    _CHECK_SELF_VOID(self, klass);
+
+    if (klass->refresh_all)
+        klass->refresh_all(self, obj_type);
+}
+
 const NMPlatformLink *
 nm_platform_process_events_ensure_link(NMPlatform *self, int ifindex, const char *ifname)
 {
@@ -558,6 +580,11 @@ nm_platform_sysctl_set(NMPlatform *self,
     g_return_val_if_fail(path, FALSE);
     g_return_val_if_fail(value, FALSE);
 
+    if (dirfd < 0
+        && (g_str_has_prefix(path, "/proc/sys/net/ipv4/conf/")
+            || g_str_has_prefix(path, "/proc/sys/net/ipv6/conf/")))
+        NM_PLATFORM_GET_PRIVATE(self)->devconf_dirty = TRUE;
+
     return klass->sysctl_set(self, pathid, dirfd, path, value);
 }
 
@@ -598,9 +625,7 @@ nm_platform_sysctl_set_async(NMPlatform *            self,
 gboolean
 nm_platform_sysctl_ip_conf_set_ipv6_hop_limit_safe(NMPlatform *self, const char *iface, int value)
 {
-    const char *path;
-    gint64      cur;
-    char        buf[NM_UTILS_SYSCTL_IP_CONF_PATH_BUFSIZE];
+    gint64 cur;
 
     _CHECK_SELF(self, klass, FALSE);
 
@@ -612,25 +637,22 @@ nm_platform_sysctl_ip_conf_set_ipv6_hop_limit_safe(NMPlatform *self, const char
     if (value < 10)
         return FALSE;
 
-    path = nm_utils_sysctl_ip_conf_path(AF_INET6, buf, iface, "hop_limit");
-    cur  = nm_platform_sysctl_get_int_checked(self,
-                                             NMP_SYSCTL_PATHID_ABSOLUTE(path),
-                                             10,
-                                             1,
-                                             G_MAXINT32,
-                                             -1);
+    cur = nm_platform_sysctl_ip_conf_get_int_checked(self,
+                                                     AF_INET6,
+                                                     iface,
+                                                     "hop_limit",
+                                                     10,
+                                                     1,
+                                                     G_MAXINT32,
+                                                     -1);
 
     /* only allow increasing the hop-limit to avoid DOS by an attacker
      * setting a low hop-limit (CVE-2015-2924, rh#1209902) */
 
     if (value < cur)
         return FALSE;
-    if (value != cur) {
-        char svalue[20];
-
-        sprintf(svalue, "%d", value);
-        nm_platform_sysctl_set(self, NMP_SYSCTL_PATHID_ABSOLUTE(path), svalue);
-    }
+    if (value != cur)
+        nm_platform_sysctl_ip_conf_set_int64(self, AF_INET6, iface, "hop_limit", value);
 
     return TRUE;
 }
@@ -798,13 +820,117 @@ nm_platform_sysctl_get_int_checked(NMPlatform *self,
 
 /*****************************************************************************/
 
+static const struct {
+    const char *property;
+    int         addr_family;
+
+    /* whether the value can be set via RTM_SETLINK. The kernel sets IFLA_INET_CONF
+     * values without the side effects of the sysctl handler, so this is only
+     * suitable for plain values. */
+    bool setlink : 1;
+} _devconf_infos[] = {
+    [NM_PLATFORM_DEVCONF_IP4_FORWARDING] = {"forwarding", AF_INET},
+    [NM_PLATFORM_DEVCONF_IP4_RP_FILTER]  = {"rp_filter", AF_INET, .setlink = TRUE},
+    [NM_PLATFORM_DEVCONF_IP6_FORWARDING] = {"forwarding", AF_INET6},
+};
+
+G_STATIC_ASSERT(G_N_ELEMENTS(_devconf_infos) == _NM_PLATFORM_DEVCONF_NUM);
+G_STATIC_ASSERT(_NM_PLATFORM_DEVCONF_NUM <= 8 * sizeof(((NMPlatformLink *) NULL)->devconf_valid));
+
+static NMPlatformDevconf
+_devconf_from_property(int addr_family, const char *property)
+{
+    NMPlatformDevconf i;
+
+    for (i = 0; i < _NM_PLATFORM_DEVCONF_NUM; i++) {
+        if (_devconf_infos[i].addr_family == addr_family
+            && nm_streq(_devconf_infos[i].property, property))
+            return i;
+    }
+    return _NM_PLATFORM_DEVCONF_NUM;
+}
+
+static gboolean
+_sysctl_ip_conf_get_cached(NMPlatform *self,
+                           int         addr_family,
+                           const char *ifname,
+                           const char *property,
+                           gint32 *    out_value)
+{
+    NMPlatformPrivate *   priv = NM_PLATFORM_GET_PRIVATE(self);
+    const NMPlatformLink *pllink;
+    NMPlatformDevconf     devconf;
+
+    devconf = _devconf_from_property(addr_family, property);
+    if (devconf == _NM_PLATFORM_DEVCONF_NUM)
+        return FALSE;
+
+    if (priv->devconf_dirty) {
+        /* The kernel queued RTM_NEWNETCONF for our writes before the write
+         * returned. Process them once, which covers all writes in the meantime,
+         * including those to "all" and "default". */
+        priv->devconf_dirty = FALSE;
+        nm_platform_process_events(self);
+    }
+
+    pllink = nm_platform_link_get_by_ifname(self, ifname);
+    if (!pllink)
+        return FALSE;
+
+    if (!NM_FLAGS_ANY(pllink->devconf_valid, (1u << devconf)))
+        return FALSE;
+
+    *out_value = pllink->devconf[devconf];
+    return TRUE;
+}
+
+static gboolean
+_sysctl_ip_conf_set(NMPlatform *self,
+                    int         addr_family,
+                    const char *ifname,
+                    const char *property,
+                    const char *value)
+{
+    NMPlatformClass *     klass = NM_PLATFORM_GET_CLASS(self);
+    const NMPlatformLink *pllink;
+    NMPlatformDevconf     devconf;
+    char                  buf[NM_UTILS_SYSCTL_IP_CONF_PATH_BUFSIZE];
+
+    pllink = nm_platform_link_get_by_ifname(self, ifname);
+    if (pllink) {
+        devconf = _devconf_from_property(addr_family, property);
+        if (devconf != _NM_PLATFORM_DEVCONF_NUM && _devconf_infos[devconf].setlink
+            && klass->link_set_devconf) {
+            gint64 v;
+
+            v = _nm_utils_ascii_str_to_int64(value, 10, G_MININT32, G_MAXINT32, G_MININT64);
+            if (v != G_MININT64
+                && klass->link_set_devconf(self, pllink->ifindex, devconf, v) >= 0) {
+                /* the kernel notifies about the change with RTM_NEWLINK, so the
+                 * cache is up to date. */
+                return TRUE;
+            }
+        }
+    }
+
+    return nm_platform_sysctl_set(
+        self,
+        NMP_SYSCTL_PATHID_ABSOLUTE(
+            nm_utils_sysctl_ip_conf_path(addr_family, buf, ifname, property)),
+        value);
+}
+
 char *
 nm_platform_sysctl_ip_conf_get(NMPlatform *self,
                                int         addr_family,
                                const char *ifname,
                                const char *property)
 {
-    char buf[NM_UTILS_SYSCTL_IP_CONF_PATH_BUFSIZE];
+    char   buf[NM_UTILS_SYSCTL_IP_CONF_PATH_BUFSIZE];
+    gint32 v;
+
+    if (_sysctl_ip_conf_get_cached(self, addr_family, ifname, property, &v))
+        return g_strdup_printf("%d", (int) v);
 
     return nm_platform_sysctl_get(
         self,
@@ -822,7 +948,17 @@ nm_platform_sysctl_ip_conf_get_int_checked(NMPlatform *self,
                                            gint64      max,
                                            gint64      fallback)
 {
-    char buf[NM_UTILS_SYSCTL_IP_CONF_PATH_BUFSIZE];
+    char   buf[NM_UTILS_SYSCTL_IP_CONF_PATH_BUFSIZE];
+    gint32 v;
+
+    if (_sysctl_ip_conf_get_cached(self, addr_family, ifname, property, &v)) {
+        if (v < min || v > max) {
+            errno = ERANGE;
+            return fallback;
+        }
+        errno = 0;
+        return v;
+    }
 
     return nm_platform_sysctl_get_int_checked(
         self,
@@ -841,13 +977,7 @@ nm_platform_sysctl_ip_conf_set(NMPlatform *self,
                                const char *property,
                                const char *value)
 {
-    char buf[NM_UTILS_SYSCTL_IP_CONF_PATH_BUFSIZE];
-
-    return nm_platform_sysctl_set(
-        self,
-        NMP_SYSCTL_PATHID_ABSOLUTE(
-            nm_utils_sysctl_ip_conf_path(addr_family, buf, ifname, property)),
-        value);
+    return _sysctl_ip_conf_set(self, addr_family, ifname, property, value);
 }
 
 gboolean
@@ -857,14 +987,13 @@ nm_platform_sysctl_ip_conf_set_int64(NMPlatform *self,
                                      const char *property,
                                      gint64      value)
 {
-    char buf[NM_UTILS_SYSCTL_IP_CONF_PATH_BUFSIZE];
     char s[64];
 
-    return nm_platform_sysctl_set(
-        self,
-        NMP_SYSCTL_PATHID_ABSOLUTE(
-            nm_utils_sysctl_ip_conf_path(addr_family, buf, ifname, property)),
-        nm_sprintf_buf(s, "%" G_GINT64_FORMAT, value));
+    return _sysctl_ip_conf_set(self,
+                               addr_family,
+                               ifname,
+                               property,
+                               nm_sprintf_buf(s, "%" G_GINT64_FORMAT, value));
 }
 
 int
@@ -1917,6 +2046,69 @@ nm_platform_link_set_bridge_vlans(NMPlatform *                       self,
     return klass->link_set_bridge_vlans(self, ifindex, on_master, vlans);
 }
 
+/**
+ * nm_platform_link_sync_bridge_vlans:
+ * @self: platform instance
+ * @ifindex: the bridge or bridge port
+ * @on_master: whether to configure the VLANs of the port on the bridge (master)
+ *   or the VLANs of the interface itself (self).
+ * @vlans: (allow-none): the %NULL terminated list of VLANs that the
+ *   interface should have.
+ *
+ * Like nm_platform_link_set_bridge_vlans(), but the result are exactly
+ * the VLANs in @vlans. Contrary to flushing all VLANs and adding them again,
+ * only the VLANs that differ from the current configuration are removed
+ * or added. VLANs that are already configured the same way are not touched.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+nm_platform_link_sync_bridge_vlans(NMPlatform *                       self,
+                                   int                                ifindex,
+                                   gboolean                           on_master,
+                                   const NMPlatformBridgeVlan *const *vlans)
+{
+    guint i;
+    _CHECK_SELF(self, klass, FALSE);
+
+    g_return_val_if_fail(ifindex > 0, FALSE);
+
+    _LOG3D("link: syncing bridge VLANs on %s", on_master ? "master" : "self");
+    if (vlans) {
+        for (i = 0; vlans[i]; i++)
+            _LOG3D("link:   bridge VLAN %s", nm_platform_bridge_vlan_to_string(vlans[i], NULL, 0));
+    }
+
+    return klass->link_sync_bridge_vlans(self, ifindex, on_master, vlans);
+}
+
+/**
+ * nm_platform_link_get_bridge_vlans:
+ * @self: platform instance
+ * @ifindex: the bridge or bridge port
+ * @on_master: whether to get the VLANs of the port on the bridge (master)
+ *   or the VLANs of the interface itself (self).
+ *
+ * Returns the VLANs that nm_platform_link_sync_bridge_vlans() would diff
+ * against. The cache is not refreshed, so pending events should be
+ * processed first.
+ *
+ * Returns: (transfer full): a #GArray of #NMPlatformBridgeVlan or %NULL
+ *   if the VLANs of @ifindex are not known.
+ */
+GArray *
+nm_platform_link_get_bridge_vlans(NMPlatform *self, int ifindex, gboolean on_master)
+{
+    _CHECK_SELF(self, klass, NULL);
+
+    g_return_val_if_fail(ifindex > 0, NULL);
+
+    if (!klass->link_get_bridge_vlans)
+        return NULL;
+
+    return klass->link_get_bridge_vlans(self, ifindex, on_master);
+}
+
 /**
  * nm_platform_link_set_up:
  * @self: platform instance
@@ -5210,12 +5402,84 @@ nm_platform_qdisc_add(NMPlatform *self, NMPNlmFlags flags, const NMPlatformQdisc
     return klass->qdisc_add(self, flags, qdisc);
 }
 
+static gboolean
+_tc_batch(NMPlatform *self, int ifindex, GArray *ops, GPtrArray *ops_plat)
+{
+    gboolean success = TRUE;
+    guint    i;
+    _CHECK_SELF(self, klass, FALSE);
+
+    nm_assert(ops->len == ops_plat->len);
+
+    if (ops->len == 0)
+        return TRUE;
+
+    _LOG3D("tc: sending %u changes", ops->len);
+    klass->tc_batch(self, ifindex, (NMPlatformTcOp *) ops->data, ops->len);
+
+    for (i = 0; i < ops->len; i++) {
+        const NMPlatformTcOp *op   = &g_array_index(ops, NMPlatformTcOp, i);
+        const NMPObject *     plat = ops_plat->pdata[i];
+        int                   r;
+
+        if (op->result >= 0)
+            continue;
+
+        if (op->op_type != NM_PLATFORM_TC_OP_TYPE_REPLACE || !plat) {
+            success = FALSE;
+            continue;
+        }
+
+        /* Not all kinds support changing their parameters. Fall back
+         * to delete and add. */
+        _LOG3D("tc: cannot replace %s, delete and add it again",
+               nmp_object_to_string(plat, NMP_OBJECT_TO_STRING_ID, NULL, 0));
+        nm_platform_object_delete(self, plat);
+        if (op->obj_type == NMP_OBJECT_TYPE_QDISC)
+            r = nm_platform_qdisc_add(self, NMP_NLM_FLAG_ADD, op->qdisc);
+        else
+            r = nm_platform_tfilter_add(self, NMP_NLM_FLAG_ADD, op->tfilter);
+        if (r < 0)
+            success = FALSE;
+    }
+
+    return success;
+}
+
+static void
+_tc_op_append(GArray *           ops,
+              GPtrArray *        ops_plat,
+              NMPObjectType      obj_type,
+              NMPlatformTcOpType op_type,
+              gconstpointer      obj,
+              const NMPObject *  plat)
+{
+    NMPlatformTcOp *op;
+
+    g_array_set_size(ops, ops->len + 1);
+    op  = &g_array_index(ops, NMPlatformTcOp, ops->len - 1);
+    *op = (NMPlatformTcOp){
+        .obj_type = obj_type,
+        .op_type  = op_type,
+    };
+    if (obj_type == NMP_OBJECT_TYPE_QDISC)
+        op->qdisc = obj;
+    else
+        op->tfilter = obj;
+    g_ptr_array_add(ops_plat, (gpointer) plat);
+}
+
 /**
  * nm_platform_qdisc_sync:
  * @self: the #NMPlatform instance
  * @ifindex: the ifindex where to configure the qdiscs.
  * @known_qdiscs: the list of qdiscs (#NMPObject).
  *
+ * The qdiscs are matched with the existing ones by their parent.
+ * Qdiscs that are already configured are left alone, qdiscs that
+ * differ are replaced in place and the remaining ones are deleted.
+ * All changes are sent to the kernel together.
+ *
  * The function promises not to take any reference to the qdisc
  * instances from @known_qdiscs, nor to keep them around after
  * the function returns. This is important, because it allows the
@@ -5228,74 +5492,131 @@ gboolean
 nm_platform_qdisc_sync(NMPlatform *self, int ifindex, GPtrArray *known_qdiscs)
 {
     gs_unref_ptrarray GPtrArray *plat_qdiscs = NULL;
+    gs_unref_ptrarray GPtrArray *ops_plat    = NULL;
+    gs_unref_array GArray *      ops         = NULL;
+    gs_free const NMPObject **   matched     = NULL;
     NMPLookup                    lookup;
     guint                        i;
-    gboolean                     success            = TRUE;
-    gs_unref_hashtable GHashTable *known_qdiscs_idx = NULL;
+    gs_unref_hashtable GHashTable *plat_qdiscs_idx = NULL;
+    gs_unref_hashtable GHashTable *grafted         = NULL;
 
     nm_assert(NM_IS_PLATFORM(self));
     nm_assert(ifindex > 0);
 
-    known_qdiscs_idx =
+    plat_qdiscs_idx =
         g_hash_table_new((GHashFunc) nmp_object_id_hash, (GEqualFunc) nmp_object_id_equal);
+    grafted  = g_hash_table_new(nm_direct_hash, NULL);
+    ops      = g_array_new(FALSE, FALSE, sizeof(NMPlatformTcOp));
+    ops_plat = g_ptr_array_new();
+
+    plat_qdiscs =
+        nm_platform_lookup_clone(self,
+                                 nmp_lookup_init_object(&lookup, NMP_OBJECT_TYPE_QDISC, ifindex),
+                                 NULL,
+                                 NULL);
+    if (plat_qdiscs) {
+        for (i = 0; i < plat_qdiscs->len; i++)
+            g_hash_table_add(plat_qdiscs_idx, plat_qdiscs->pdata[i]);
+    }
+
     if (known_qdiscs) {
+        gs_unref_hashtable GHashTable *known_qdiscs_idx = NULL;
+
+        known_qdiscs_idx =
+            g_hash_table_new((GHashFunc) nmp_object_id_hash, (GEqualFunc) nmp_object_id_equal);
+        matched = g_new0(const NMPObject *, known_qdiscs->len);
+
         for (i = 0; i < known_qdiscs->len; i++) {
             const NMPObject *q = g_ptr_array_index(known_qdiscs, i);
 
-            if (!g_hash_table_insert(known_qdiscs_idx, (gpointer) q, (gpointer) q)) {
+            if (!g_hash_table_add(known_qdiscs_idx, (gpointer) q)) {
                 _LOGW("duplicate qdisc %s", nm_platform_qdisc_to_string(&q->qdisc, NULL, 0));
                 return FALSE;
             }
+
+            /* look up the platform qdisc with same parent */
+            matched[i] = g_hash_table_lookup(plat_qdiscs_idx, q);
+            if (matched[i])
+                g_hash_table_remove(plat_qdiscs_idx, matched[i]);
         }
     }
 
-    plat_qdiscs =
-        nm_platform_lookup_clone(self,
-                                 nmp_lookup_init_object(&lookup, NMP_OBJECT_TYPE_QDISC, ifindex),
-                                 NULL,
-                                 NULL);
+    /* first delete the qdiscs that are no longer needed. */
     if (plat_qdiscs) {
         for (i = 0; i < plat_qdiscs->len; i++) {
             const NMPObject *p = g_ptr_array_index(plat_qdiscs, i);
-            const NMPObject *k;
-
-            /* look up known qdisc with same parent */
-            k = g_hash_table_lookup(known_qdiscs_idx, p);
 
-            if (k) {
-                const NMPlatformQdisc *qdisc_k = NMP_OBJECT_CAST_QDISC(k);
-                const NMPlatformQdisc *qdisc_p = NMP_OBJECT_CAST_QDISC(p);
-
-                /* check other fields */
-                if (nm_platform_qdisc_cmp_full(qdisc_k, qdisc_p, FALSE) != 0
-                    || (qdisc_k->handle != qdisc_p->handle && qdisc_k != 0)) {
-                    k = NULL;
-                }
-            }
-
-            if (k) {
-                g_hash_table_remove(known_qdiscs_idx, k);
-            } else {
-                /* can't delete qdisc with zero handle */
-                if (TC_H_MAJ(p->qdisc.handle) != 0) {
-                    success &= nm_platform_object_delete(self, p);
-                }
+            /* can't delete qdisc with zero handle */
+            if (g_hash_table_contains(plat_qdiscs_idx, p) && TC_H_MAJ(p->qdisc.handle) != 0) {
+                g_hash_table_add(grafted, GUINT_TO_POINTER(TC_H_MAJ(p->qdisc.handle)));
+                _tc_op_append(ops,
+                              ops_plat,
+                              NMP_OBJECT_TYPE_QDISC,
+                              NM_PLATFORM_TC_OP_TYPE_DELETE,
+                              &p->qdisc,
+                              p);
             }
         }
     }
 
     if (known_qdiscs) {
         for (i = 0; i < known_qdiscs->len; i++) {
-            const NMPObject *q = g_ptr_array_index(known_qdiscs, i);
+            const NMPlatformQdisc *qdisc_k = NMP_OBJECT_CAST_QDISC(known_qdiscs->pdata[i]);
+            const NMPObject *      p       = matched[i];
+            const NMPlatformQdisc *qdisc_p;
+            NMPlatformQdisc        qdisc_cmp;
+
+            if (p && g_hash_table_contains(grafted, GUINT_TO_POINTER(TC_H_MAJ(qdisc_k->parent)))) {
+                /* the parent is replaced by a new qdisc, and this one goes away
+                 * together with it. */
+                if (TC_H_MAJ(p->qdisc.handle) != 0)
+                    g_hash_table_add(grafted, GUINT_TO_POINTER(TC_H_MAJ(p->qdisc.handle)));
+                p = NULL;
+            }
+
+            if (!p) {
+                _tc_op_append(ops,
+                              ops_plat,
+                              NMP_OBJECT_TYPE_QDISC,
+                              NM_PLATFORM_TC_OP_TYPE_ADD,
+                              qdisc_k,
+                              NULL);
+                continue;
+            }
+
+            qdisc_p = NMP_OBJECT_CAST_QDISC(p);
+
+            /* for qdiscs, the kernel reports its reference count as info. That
+             * is not something we configure. */
+            qdisc_cmp      = *qdisc_k;
+            qdisc_cmp.info = qdisc_p->info;
+            if (qdisc_cmp.handle == 0)
+                qdisc_cmp.handle = qdisc_p->handle;
 
-            if (g_hash_table_contains(known_qdiscs_idx, q)) {
-                success &=
-                    (nm_platform_qdisc_add(self, NMP_NLM_FLAG_ADD, NMP_OBJECT_CAST_QDISC(q)) >= 0);
+            if (nm_platform_qdisc_cmp(&qdisc_cmp, qdisc_p) == 0) {
+                /* already configured. */
+                continue;
+            }
+
+            /* the kernel changes the qdisc in place if the kind and the handle
+             * stay the same. Otherwise, the new qdisc replaces the old one
+             * together with its children. */
+            if (!nm_streq0(qdisc_k->kind, qdisc_p->kind)
+                || (qdisc_k->handle != 0 && qdisc_k->handle != qdisc_p->handle)) {
+                if (TC_H_MAJ(qdisc_p->handle) != 0)
+                    g_hash_table_add(grafted, GUINT_TO_POINTER(TC_H_MAJ(qdisc_p->handle)));
             }
+
+            _tc_op_append(ops,
+                          ops_plat,
+                          NMP_OBJECT_TYPE_QDISC,
+                          NM_PLATFORM_TC_OP_TYPE_REPLACE,
+                          qdisc_k,
+                          p);
         }
     }
 
-    return success;
+    return _tc_batch(self, ifindex, ops, ops_plat);
 }
 
 /*****************************************************************************/
@@ -5313,12 +5634,45 @@ nm_platform_tfilter_add(NMPlatform *self, NMPNlmFlags flags, const NMPlatformTfi
     return klass->tfilter_add(self, flags, tfilter);
 }
 
+static const NMPObject *
+_tfilter_find_match(GPtrArray *plat_tfilters, gboolean *used, const NMPlatformTfilter *tfilter)
+{
+    guint i;
+
+    if (!plat_tfilters)
+        return NULL;
+
+    for (i = 0; i < plat_tfilters->len; i++) {
+        const NMPlatformTfilter *p = NMP_OBJECT_CAST_TFILTER(plat_tfilters->pdata[i]);
+
+        if (used[i] || p->parent != tfilter->parent)
+            continue;
+
+        /* without handle, the kernel chooses one. Match any filter with the
+         * same protocol and kind instead. The same applies to the priority. */
+        if (tfilter->handle != 0
+                ? (p->handle == tfilter->handle)
+                : (TC_H_MIN(p->info) == TC_H_MIN(tfilter->info)
+                   && NM_IN_SET(TC_H_MAJ(tfilter->info), 0, TC_H_MAJ(p->info))
+                   && nm_streq0(p->kind, tfilter->kind))) {
+            used[i] = TRUE;
+            return plat_tfilters->pdata[i];
+        }
+    }
+
+    return NULL;
+}
+
 /**
- * nm_platform_qdisc_sync:
+ * nm_platform_tfilter_sync:
  * @self: the #NMPlatform instance
- * @ifindex: the ifindex where to configure the qdiscs.
+ * @ifindex: the ifindex where to configure the tfilters.
  * @known_tfilters: the list of tfilters (#NMPObject).
  *
+ * The tfilters are matched with the existing ones by their parent and
+ * handle. Like for nm_platform_qdisc_sync(), filters that differ are
+ * replaced in place and all changes are sent to the kernel together.
+ *
  * The function promises not to take any reference to the tfilter
  * instances from @known_tfilters, nor to keep them around after
  * the function returns. This is important, because it allows the
@@ -5331,50 +5685,108 @@ gboolean
 nm_platform_tfilter_sync(NMPlatform *self, int ifindex, GPtrArray *known_tfilters)
 {
     gs_unref_ptrarray GPtrArray *plat_tfilters = NULL;
+    gs_unref_ptrarray GPtrArray *ops_plat      = NULL;
+    gs_unref_array GArray *      ops           = NULL;
+    gs_free const NMPObject **   matched       = NULL;
+    gs_free NMPlatformTfilter *  tfilters      = NULL;
+    gs_free gboolean *           used          = NULL;
     NMPLookup                    lookup;
     guint                        i;
-    gboolean                     success              = TRUE;
-    gs_unref_hashtable GHashTable *known_tfilters_idx = NULL;
 
     nm_assert(NM_IS_PLATFORM(self));
     nm_assert(ifindex > 0);
 
-    known_tfilters_idx =
-        g_hash_table_new((GHashFunc) nmp_object_id_hash, (GEqualFunc) nmp_object_id_equal);
-
-    if (known_tfilters) {
-        for (i = 0; i < known_tfilters->len; i++) {
-            const NMPObject *q = g_ptr_array_index(known_tfilters, i);
-
-            g_hash_table_insert(known_tfilters_idx, (gpointer) q, (gpointer) q);
-        }
-    }
+    ops      = g_array_new(FALSE, FALSE, sizeof(NMPlatformTcOp));
+    ops_plat = g_ptr_array_new();
 
     plat_tfilters =
         nm_platform_lookup_clone(self,
                                  nmp_lookup_init_object(&lookup, NMP_OBJECT_TYPE_TFILTER, ifindex),
                                  NULL,
                                  NULL);
+    if (plat_tfilters)
+        used = g_new0(gboolean, plat_tfilters->len);
+
+    if (known_tfilters) {
+        matched  = g_new0(const NMPObject *, known_tfilters->len);
+        tfilters = g_new(NMPlatformTfilter, known_tfilters->len);
+
+        for (i = 0; i < known_tfilters->len; i++) {
+            tfilters[i] = *NMP_OBJECT_CAST_TFILTER(known_tfilters->pdata[i]);
+            matched[i]  = _tfilter_find_match(plat_tfilters, used, &tfilters[i]);
+            if (matched[i]) {
+                const NMPlatformTfilter *p = NMP_OBJECT_CAST_TFILTER(matched[i]);
+
+                tfilters[i].handle = p->handle;
+                if (TC_H_MAJ(tfilters[i].info) == 0)
+                    tfilters[i].info = p->info;
+            }
+        }
+    }
 
+    /* first delete the tfilters that are no longer needed. */
     if (plat_tfilters) {
         for (i = 0; i < plat_tfilters->len; i++) {
-            const NMPObject *q = g_ptr_array_index(plat_tfilters, i);
-
-            if (!g_hash_table_lookup(known_tfilters_idx, q))
-                success &= nm_platform_object_delete(self, q);
+            const NMPObject *p = g_ptr_array_index(plat_tfilters, i);
+
+            if (!used[i]) {
+                _tc_op_append(ops,
+                              ops_plat,
+                              NMP_OBJECT_TYPE_TFILTER,
+                              NM_PLATFORM_TC_OP_TYPE_DELETE,
+                              &p->tfilter,
+                              p);
+            }
         }
     }
 
     if (known_tfilters) {
         for (i = 0; i < known_tfilters->len; i++) {
-            const NMPObject *q = g_ptr_array_index(known_tfilters, i);
+            const NMPObject *p = matched[i];
+
+            if (!p) {
+                _tc_op_append(ops,
+                              ops_plat,
+                              NMP_OBJECT_TYPE_TFILTER,
+                              NM_PLATFORM_TC_OP_TYPE_ADD,
+                              &tfilters[i],
+                              NULL);
+                continue;
+            }
+
+            if (nm_platform_tfilter_cmp(&tfilters[i], &p->tfilter) == 0) {
+                /* already configured. */
+                continue;
+            }
+
+            if (tfilters[i].info != p->tfilter.info
+                || !nm_streq0(tfilters[i].kind, p->tfilter.kind)) {
+                /* the priority, protocol and kind of a filter can't be changed. */
+                _tc_op_append(ops,
+                              ops_plat,
+                              NMP_OBJECT_TYPE_TFILTER,
+                              NM_PLATFORM_TC_OP_TYPE_DELETE,
+                              &p->tfilter,
+                              p);
+                _tc_op_append(ops,
+                              ops_plat,
+                              NMP_OBJECT_TYPE_TFILTER,
+                              NM_PLATFORM_TC_OP_TYPE_ADD,
+                              &tfilters[i],
+                              NULL);
+                continue;
+            }
 
-            success &=
-                (nm_platform_tfilter_add(self, NMP_NLM_FLAG_ADD, NMP_OBJECT_CAST_TFILTER(q)) >= 0);
+            _tc_op_append(ops,
+                          ops_plat,
+                          NMP_OBJECT_TYPE_TFILTER,
+                          NM_PLATFORM_TC_OP_TYPE_REPLACE,
+                          &tfilters[i],
+                          p);
         }
     }
 
-    return success;
+    return _tc_batch(self, ifindex, ops, ops_plat);
 }
 
 /*****************************************************************************/
@@ -7256,6 +7668,132 @@ nm_platform_bridge_vlan_to_string(const NMPlatformBridgeVlan *vlan, char *buf, g
     return buf;
 }
 
+static void
+_bridge_vlan_to_flags(const NMPlatformBridgeVlan *vlan, guint8 *flags)
+{
+    guint8 f;
+    guint  vid;
+    guint  vid_end;
+
+    f = NM_PLATFORM_BRIDGE_VLAN_FLAG_PRESENT;
+    if (vlan->untagged)
+        f |= NM_PLATFORM_BRIDGE_VLAN_FLAG_UNTAGGED;
+    if (vlan->pvid)
+        f |= NM_PLATFORM_BRIDGE_VLAN_FLAG_PVID;
+
+    vid_end = MIN(vlan->vid_end, NM_PLATFORM_BRIDGE_VLAN_VID_MAX);
+    for (vid = MAX(vlan->vid_start, 1u); vid <= vid_end; vid++)
+        flags[vid] = f;
+}
+
+/**
+ * nm_platform_bridge_vlans_to_flags:
+ * @vlans: the list of VLANs
+ * @n_vlans: the number of VLANs in @vlans
+ * @flags: an array of %NM_PLATFORM_BRIDGE_VLAN_FLAGS_LEN bytes, which
+ *   gets the #NMPlatformBridgeVlanFlags for each VID.
+ */
+void
+nm_platform_bridge_vlans_to_flags(const NMPlatformBridgeVlan *vlans, guint n_vlans, guint8 *flags)
+{
+    guint i;
+
+    memset(flags, 0, NM_PLATFORM_BRIDGE_VLAN_FLAGS_LEN);
+    for (i = 0; i < n_vlans; i++)
+        _bridge_vlan_to_flags(&vlans[i], flags);
+}
+
+/**
+ * nm_platform_bridge_vlans_from_flags:
+ * @flags: the per-VID flags, as filled by nm_platform_bridge_vlans_to_flags().
+ *
+ * Returns: (transfer full): a #GArray of #NMPlatformBridgeVlan. Consecutive VIDs
+ *   with the same flags are merged to ranges. The PVID is never part of a range,
+ *   because the kernel rejects ranges with the PVID flag.
+ */
+GArray *
+nm_platform_bridge_vlans_from_flags(const guint8 *flags)
+{
+    GArray *vlans;
+    guint   vid;
+
+    vlans = g_array_new(FALSE, FALSE, sizeof(NMPlatformBridgeVlan));
+
+    for (vid = 1; vid <= NM_PLATFORM_BRIDGE_VLAN_VID_MAX; vid++) {
+        const guint8 f = flags[vid];
+        guint        vid_end;
+
+        if (!NM_FLAGS_HAS(f, NM_PLATFORM_BRIDGE_VLAN_FLAG_PRESENT))
+            continue;
+
+        vid_end = vid;
+        if (!NM_FLAGS_HAS(f, NM_PLATFORM_BRIDGE_VLAN_FLAG_PVID)) {
+            while (vid_end < NM_PLATFORM_BRIDGE_VLAN_VID_MAX && flags[vid_end + 1] == f)
+                vid_end++;
+        }
+
+        g_array_append_val(vlans,
+                           ((NMPlatformBridgeVlan){
+                               .vid_start = vid,
+                               .vid_end   = vid_end,
+                               .untagged  = NM_FLAGS_HAS(f, NM_PLATFORM_BRIDGE_VLAN_FLAG_UNTAGGED),
+                               .pvid      = NM_FLAGS_HAS(f, NM_PLATFORM_BRIDGE_VLAN_FLAG_PVID),
+                           }));
+        vid = vid_end;
+    }
+
+    return vlans;
+}
+
+/**
+ * nm_platform_bridge_vlans_diff:
+ * @current: the VLANs that are currently configured
+ * @n_current: the number of VLANs in @current
+ * @vlans: (allow-none): the %NULL terminated list of requested VLANs
+ * @out_del: (out) (transfer full): the VLANs that must be deleted
+ * @out_add: (out) (transfer full): the VLANs that must be added. This also
+ *   contains existing VLANs whose flags change, because adding an existing
+ *   VLAN again updates its flags.
+ */
+void
+nm_platform_bridge_vlans_diff(const NMPlatformBridgeVlan *       current,
+                              guint                              n_current,
+                              const NMPlatformBridgeVlan *const *vlans,
+                              GArray **                          out_del,
+                              GArray **                          out_add)
+{
+    guint8 flags_cur[NM_PLATFORM_BRIDGE_VLAN_FLAGS_LEN];
+    guint8 flags_new[NM_PLATFORM_BRIDGE_VLAN_FLAGS_LEN];
+    guint  vid;
+    guint  i;
+
+    nm_assert(out_del);
+    nm_assert(out_add);
+
+    nm_platform_bridge_vlans_to_flags(current, n_current, flags_cur);
+
+    memset(flags_new, 0, sizeof(flags_new));
+    if (vlans) {
+        for (i = 0; vlans[i]; i++)
+            _bridge_vlan_to_flags(vlans[i], flags_new);
+    }
+
+    /* reuse the arrays: @flags_cur gets the VIDs to delete and @flags_new
+     * the VIDs to add. */
+    for (vid = 1; vid <= NM_PLATFORM_BRIDGE_VLAN_VID_MAX; vid++) {
+        if (flags_new[vid] == flags_cur[vid]) {
+            flags_cur[vid] = 0;
+            flags_new[vid] = 0;
+        } else if (flags_new[vid])
+            flags_cur[vid] = 0;
+        else
+            flags_cur[vid] = NM_PLATFORM_BRIDGE_VLAN_FLAG_PRESENT;
+    }
+
+    *out_del = nm_platform_bridge_vlans_from_flags(flags_cur);
+    *out_add = nm_platform_bridge_vlans_from_flags(flags_new);
+}
+
 void
 nm_platform_link_hash_update(const NMPlatformLink *obj, NMHashState *h)
 {
@@ -7269,6 +7807,7 @@ nm_platform_link_hash_update(const NMPlatformLink *obj, NMHashState *h)
                         obj->arptype,
                         obj->inet6_addr_gen_mode_inv,
                         obj->inet6_token,
+                        obj->devconf_valid,
                         obj->rx_packets,
                         obj->rx_bytes,
                         obj->tx_packets,
@@ -7284,6 +7823,7 @@ nm_platform_link_hash_update(const NMPlatformLink *obj, NMHashState *h)
     nm_hash_update_mem(h,
                        obj->l_broadcast.data,
                        NM_MIN(obj->l_broadcast.len, sizeof(obj->l_broadcast.data)));
+    nm_hash_update(h, obj->devconf, sizeof(obj->devconf));
 }
 
 int
@@ -7310,6 +7850,8 @@ nm_platform_link_cmp(const NMPlatformLink *a, const NMPlatformLink *b)
     if (a->l_broadcast.len)
         NM_CMP_FIELD_MEMCMP_LEN(a, b, l_broadcast.data, a->l_broadcast.len);
     NM_CMP_FIELD_MEMCMP(a, b, inet6_token);
+    NM_CMP_FIELD(a, b, devconf_valid);
+    NM_CMP_FIELD_MEMCMP(a, b, devconf);
     NM_CMP_FIELD(a, b, rx_packets);
     NM_CMP_FIELD(a, b, rx_bytes);
     NM_CMP_FIELD(a, b, tx_packets);
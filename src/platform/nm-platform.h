@@ -206,6 +206,18 @@ struct _NMPlatformObjWithIfindex {
     __NMPlatformObjWithIfindex_COMMON;
 };
 
+/* A selection of the per-interface sysctl values below "/proc/sys/net/ipv{4,6}/conf/$IFNAME/".
+ * These are reported via netlink as IFLA_INET_CONF and IFLA_INET6_CONF and
+ * are cached in NMPlatformLink. Only values for which the kernel also sends
+ * RTM_NEWNETCONF on change are included, so that writes by others update
+ * the cache too. */
+typedef enum { /*< skip >*/
+               NM_PLATFORM_DEVCONF_IP4_FORWARDING,
+               NM_PLATFORM_DEVCONF_IP4_RP_FILTER,
+               NM_PLATFORM_DEVCONF_IP6_FORWARDING,
+               _NM_PLATFORM_DEVCONF_NUM,
+} NMPlatformDevconf;
+
 struct _NMPlatformLink {
     __NMPlatformObjWithIfindex_COMMON;
     char       name[NMP_IFNAMSIZ];
@@ -247,6 +259,11 @@ struct _NMPlatformLink {
      * initialized with memset(0) has and unset value.*/
     guint8 inet6_addr_gen_mode_inv;
 
+    /* IFLA_INET_CONF and IFLA_INET6_CONF, indexed by NMPlatformDevconf. A value
+     * is only set if the corresponding bit in @devconf_valid is set. */
+    guint8 devconf_valid;
+    gint32 devconf[_NM_PLATFORM_DEVCONF_NUM];
+
     /* Statistics */
     guint64 rx_packets;
     guint64 rx_bytes;
@@ -760,6 +777,26 @@ typedef struct {
     NMPlatformAction action;
 } NMPlatformTfilter;
 
+typedef enum {
+    NM_PLATFORM_TC_OP_TYPE_DELETE,
+    NM_PLATFORM_TC_OP_TYPE_ADD,
+    NM_PLATFORM_TC_OP_TYPE_REPLACE,
+} NMPlatformTcOpType;
+
+/* One step of nm_platform_qdisc_sync() and nm_platform_tfilter_sync(). All
+ * operations for one interface are sent to the kernel together. */
+typedef struct {
+    union {
+        const NMPlatformQdisc *  qdisc;
+        const NMPlatformTfilter *tfilter;
+    };
+    NMPObjectType      obj_type;
+    NMPlatformTcOpType op_type;
+
+    /* the result of the operation, set by the tc_batch() implementation. */
+    int result;
+} NMPlatformTcOp;
+
 #undef __NMPlatformObjWithIfindex_COMMON
 
 typedef struct {
@@ -810,6 +847,18 @@ typedef struct {
     bool    pvid : 1;
 } NMPlatformBridgeVlan;
 
+#define NM_PLATFORM_BRIDGE_VLAN_VID_MAX 4094
+
+/* The per-VID state used by nm_platform_bridge_vlans_to_flags(). Index
+ * 0 and values above %NM_PLATFORM_BRIDGE_VLAN_VID_MAX are unused. */
+#define NM_PLATFORM_BRIDGE_VLAN_FLAGS_LEN (NM_PLATFORM_BRIDGE_VLAN_VID_MAX + 1)
+
+typedef enum {
+    NM_PLATFORM_BRIDGE_VLAN_FLAG_PRESENT  = 0x1,
+    NM_PLATFORM_BRIDGE_VLAN_FLAG_UNTAGGED = 0x2,
+    NM_PLATFORM_BRIDGE_VLAN_FLAG_PVID     = 0x4,
+} NMPlatformBridgeVlanFlags;
+
 typedef struct {
     NMEtherAddr group_addr;
     bool        mcast_querier : 1;
@@ -1110,6 +1159,10 @@ typedef struct {
 
     int (*link_set_user_ipv6ll_enabled)(NMPlatform *self, int ifindex, gboolean enabled);
     gboolean (*link_set_token)(NMPlatform *self, int ifindex, NMUtilsIPv6IfaceId iid);
+    int (*link_set_devconf)(NMPlatform *      self,
+                            int               ifindex,
+                            NMPlatformDevconf devconf,
+                            gint32            value);
 
     gboolean (*link_get_permanent_address)(NMPlatform *self,
                                            int         ifindex,
@@ -1130,6 +1183,11 @@ typedef struct {
                                       int                                ifindex,
                                       gboolean                           on_master,
                                       const NMPlatformBridgeVlan *const *vlans);
+    gboolean (*link_sync_bridge_vlans)(NMPlatform *                       self,
+                                       int                                ifindex,
+                                       gboolean                           on_master,
+                                       const NMPlatformBridgeVlan *const *vlans);
+    GArray *(*link_get_bridge_vlans)(NMPlatform *self, int ifindex, gboolean on_master);
 
     char *(*link_get_physical_port_id)(NMPlatform *self, int ifindex);
     guint (*link_get_dev_id)(NMPlatform *self, int ifindex);
@@ -1258,6 +1316,8 @@ typedef struct {
     int (*qdisc_add)(NMPlatform *self, NMPNlmFlags flags, const NMPlatformQdisc *qdisc);
 
     int (*tfilter_add)(NMPlatform *self, NMPNlmFlags flags, const NMPlatformTfilter *tfilter);
+
+    int (*tc_batch)(NMPlatform *self, int ifindex, NMPlatformTcOp *ops, guint n_ops);
 } NMPlatformClass;
 
 /* NMPlatform signals
@@ -1829,6 +1889,7 @@ gboolean    nm_platform_link_supports_slaves(NMPlatform *self, int ifindex);
 const char *nm_platform_link_get_type_name(NMPlatform *self, int ifindex);
 
 gboolean nm_platform_link_refresh(NMPlatform *self, int ifindex);
+void     nm_platform_refresh_all(NMPlatform *self, NMPObjectType obj_type);
 void     nm_platform_process_events(NMPlatform *self);
 
 const NMPlatformLink *
@@ -1867,6 +1928,11 @@ gboolean nm_platform_link_set_bridge_vlans(NMPlatform *                       se
                                            int                                ifindex,
                                            gboolean                           on_master,
                                            const NMPlatformBridgeVlan *const *vlans);
+gboolean nm_platform_link_sync_bridge_vlans(NMPlatform *                       self,
+                                            int                                ifindex,
+                                            gboolean                           on_master,
+                                            const NMPlatformBridgeVlan *const *vlans);
+GArray * nm_platform_link_get_bridge_vlans(NMPlatform *self, int ifindex, gboolean on_master);
 
 char *   nm_platform_link_get_physical_port_id(NMPlatform *self, int ifindex);
 guint    nm_platform_link_get_dev_id(NMPlatform *self, int ifindex);
@@ -2216,6 +2282,16 @@ const char *nm_platform_vf_to_string(const NMPlatformVF *vf, char *buf, gsize le
 const char *
 nm_platform_bridge_vlan_to_string(const NMPlatformBridgeVlan *vlan, char *buf, gsize len);
 
+void    nm_platform_bridge_vlans_to_flags(const NMPlatformBridgeVlan *vlans,
+                                          guint                       n_vlans,
+                                          guint8 *                    flags);
+GArray *nm_platform_bridge_vlans_from_flags(const guint8 *flags);
+void    nm_platform_bridge_vlans_diff(const NMPlatformBridgeVlan *       current,
+                                      guint                              n_current,
+                                      const NMPlatformBridgeVlan *const *vlans,
+                                      GArray **                          out_del,
+                                      GArray **                          out_add);
+
 const char *nm_platform_vlan_qos_mapping_to_string(const char *            name,
                                                    const NMVlanQosMapping *map,
                                                    gsize                   n_map,
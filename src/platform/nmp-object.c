@@ -1568,7 +1568,9 @@ nmp_object_id_hash(const NMPObject *obj)
     if (!obj)
         return nm_hash_static(914932607u);
 
-    nm_hash_init(&h, 914932607u);
+    /* this is used for internal indexes of platform objects (for example,
+     * during nm_platform_ip_route_sync()). Use the fast hash. */
+    nm_hash_init_fast(&h, 914932607u);
     nmp_object_id_hash_update(obj, &h);
     return nm_hash_complete(&h);
 }
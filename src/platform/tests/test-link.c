@@ -2672,6 +2672,117 @@ again:
 
 /*****************************************************************************/
 
+static char *
+_bridge_vlans_to_string(int ifindex)
+{
+    gs_unref_array GArray *vlans = NULL;
+    GString *              str;
+    guint                  i;
+
+    vlans = nm_platform_link_get_bridge_vlans(NM_PLATFORM_GET, ifindex, TRUE);
+    if (!vlans)
+        return NULL;
+
+    str = g_string_new(NULL);
+    for (i = 0; i < vlans->len; i++) {
+        if (i > 0)
+            g_string_append(str, ", ");
+        g_string_append(
+            str,
+            nm_platform_bridge_vlan_to_string(&g_array_index(vlans, NMPlatformBridgeVlan, i),
+                                              NULL,
+                                              0));
+    }
+    return g_string_free(str, FALSE);
+}
+
+static void
+_assert_bridge_vlans(int ifindex, const char *expected)
+{
+    gs_free char *str = NULL;
+
+    NMTST_WAIT(500, {
+        nm_platform_process_events(NM_PLATFORM_GET);
+        nm_clear_g_free(&str);
+        str = _bridge_vlans_to_string(ifindex);
+        if (nm_streq0(str, expected))
+            break;
+        nmtstp_wait_for_signal(NM_PLATFORM_GET, 50);
+    });
+    g_assert_cmpstr(str, ==, expected);
+}
+
+static void
+test_bridge_vlans_external(void)
+{
+    const char *                      IFACE_BRIDGE0 = "nm-test-bridge0";
+    const char *                      IFACE_DUMMY0  = "nm-test-dummy0";
+    const NMPlatformBridgeVlan        vlan_1        = {
+        .vid_start = 1,
+        .vid_end   = 1,
+        .pvid      = TRUE,
+        .untagged  = TRUE,
+    };
+    const NMPlatformBridgeVlan        vlan_10       = {
+        .vid_start = 10,
+        .vid_end   = 10,
+    };
+    const NMPlatformBridgeVlan *const vlans[]       = {&vlan_1, &vlan_10, NULL};
+    const NMPlatformLink *            pllink;
+    int                               ifindex_bridge0;
+    int                               ifindex_dummy0;
+
+    nmtstp_run_command_check("ip link add %s type dummy", IFACE_DUMMY0);
+    ifindex_dummy0 =
+        nmtstp_assert_wait_for_link(NM_PLATFORM_GET, IFACE_DUMMY0, NM_LINK_TYPE_DUMMY, 100)
+            ->ifindex;
+
+    nmtstp_run_command_check("ip link add %s type bridge vlan_filtering 1", IFACE_BRIDGE0);
+    ifindex_bridge0 =
+        nmtstp_assert_wait_for_link(NM_PLATFORM_GET, IFACE_BRIDGE0, NM_LINK_TYPE_BRIDGE, 100)
+            ->ifindex;
+
+    nmtstp_run_command_check("ip link set %s master %s", IFACE_DUMMY0, IFACE_BRIDGE0);
+    NMTST_WAIT_ASSERT(100, {
+        nmtstp_wait_for_signal(NM_PLATFORM_GET, 50);
+
+        pllink = nm_platform_link_get(NM_PLATFORM_GET, ifindex_dummy0);
+        g_assert(pllink);
+        if (pllink->master == ifindex_bridge0)
+            break;
+    });
+
+    /* the sync fills the cache. */
+    g_assert(nm_platform_link_sync_bridge_vlans(NM_PLATFORM_GET, ifindex_dummy0, TRUE, vlans));
+    _assert_bridge_vlans(ifindex_dummy0, "1 PVID untagged, 10");
+
+    /* the cache follows changes that we did not do ourselves. */
+    nmtstp_run_command_check("bridge vlan add dev %s vid 20", IFACE_DUMMY0);
+    _assert_bridge_vlans(ifindex_dummy0, "1 PVID untagged, 10, 20");
+
+    nmtstp_run_command_check("bridge vlan add dev %s vid 11", IFACE_DUMMY0);
+    _assert_bridge_vlans(ifindex_dummy0, "1 PVID untagged, 10-11, 20");
+
+    nmtstp_run_command_check("bridge vlan del dev %s vid 10", IFACE_DUMMY0);
+    _assert_bridge_vlans(ifindex_dummy0, "1 PVID untagged, 11, 20");
+
+    nmtstp_run_command_check("bridge vlan add dev %s vid 20 pvid untagged", IFACE_DUMMY0);
+    _assert_bridge_vlans(ifindex_dummy0, "1 untagged, 11, 20 PVID untagged");
+
+    /* syncing again starts from the externally changed state. */
+    g_assert(nm_platform_link_sync_bridge_vlans(NM_PLATFORM_GET, ifindex_dummy0, TRUE, vlans));
+    _assert_bridge_vlans(ifindex_dummy0, "1 PVID untagged, 10");
+
+    /* releasing the port drops it from the cache. */
+    nmtstp_run_command_check("ip link set %s nomaster", IFACE_DUMMY0);
+    _assert_bridge_vlans(ifindex_dummy0, NULL);
+
+    nmtstp_link_delete(NULL, -1, ifindex_bridge0, IFACE_BRIDGE0, TRUE);
+    nmtstp_link_delete(NULL, -1, ifindex_dummy0, IFACE_DUMMY0, TRUE);
+}
+
+/*****************************************************************************/
+
 static void
 _test_netns_setup(gpointer fixture, gconstpointer test_data)
 {
@@ -3524,6 +3635,176 @@ test_sysctl_set_async(void)
     g_main_loop_unref(loop);
 }
 
+static gint64
+_sysctl_ip_conf_get_file(int addr_family, const char *ifname, const char *property)
+{
+    gs_free_error GError *error    = NULL;
+    gs_free char *        contents = NULL;
+    char                  buf[NM_UTILS_SYSCTL_IP_CONF_PATH_BUFSIZE];
+
+    g_file_get_contents(nm_utils_sysctl_ip_conf_path(addr_family, buf, ifname, property),
+                        &contents,
+                        NULL,
+                        &error);
+    g_assert_no_error(error);
+    return _nm_utils_ascii_str_to_int64(g_strstrip(contents), 10, G_MININT32, G_MAXINT32, -1);
+}
+
+static gint64
+_sysctl_ip_conf_get(NMPlatform *platform, int addr_family, const char *ifname, const char *property)
+{
+    return nm_platform_sysctl_ip_conf_get_int_checked(platform,
+                                                      addr_family,
+                                                      ifname,
+                                                      property,
+                                                      10,
+                                                      G_MININT32,
+                                                      G_MAXINT32,
+                                                      -1);
+}
+
+static void
+test_sysctl_devconf_cache(void)
+{
+    NMPlatform *const PL     = NM_PLATFORM_GET;
+    const char *const IFNAME = "nm-dummy-0";
+    static const struct {
+        int         addr_family;
+        const char *property;
+    } props[] = {
+        {AF_INET, "forwarding"},
+        {AF_INET, "rp_filter"},
+        {AF_INET6, "forwarding"},
+    };
+    const NMPlatformLink *pllink;
+    char                  buf[NM_UTILS_SYSCTL_IP_CONF_PATH_BUFSIZE];
+    int                   ifindex;
+    int                   i;
+
+    ifindex = nmtstp_link_dummy_add(PL, -1, IFNAME)->ifindex;
+
+    pllink = nm_platform_link_get(PL, ifindex);
+    g_assert(pllink);
+    if (!NM_FLAGS_ALL(pllink->devconf_valid, (1u << _NM_PLATFORM_DEVCONF_NUM) - 1u)) {
+        /* IPv6 might be disabled on the host. */
+        g_test_skip("kernel does not report IFLA_INET_CONF/IFLA_INET6_CONF");
+        goto out;
+    }
+
+    for (i = 0; i < (int) G_N_ELEMENTS(props); i++) {
+        g_assert_cmpint(_sysctl_ip_conf_get(PL, props[i].addr_family, IFNAME, props[i].property),
+                        ==,
+                        _sysctl_ip_conf_get_file(props[i].addr_family, IFNAME, props[i].property));
+    }
+
+    /* a write via the file system is seen by the next read. */
+    g_assert(nm_platform_sysctl_ip_conf_set(PL, AF_INET6, IFNAME, "forwarding", "1"));
+    g_assert_cmpint(_sysctl_ip_conf_get(PL, AF_INET6, IFNAME, "forwarding"), ==, 1);
+
+    /* a write to "all" changes the value of every link. */
+    g_assert(nm_platform_sysctl_ip_conf_set(PL, AF_INET, "all", "forwarding", "1"));
+    g_assert_cmpint(_sysctl_ip_conf_get(PL, AF_INET, IFNAME, "forwarding"), ==, 1);
+
+    /* a write by somebody else is announced with RTM_NEWNETCONF. */
+    nmtstp_run_command_check("echo 0 > %s",
+                             nm_utils_sysctl_ip_conf_path(AF_INET6, buf, IFNAME, "forwarding"));
+    nm_platform_process_events(PL);
+    pllink = nm_platform_link_get(PL, ifindex);
+    g_assert(pllink);
+    g_assert_cmpint(pllink->devconf[NM_PLATFORM_DEVCONF_IP6_FORWARDING], ==, 0);
+
+    /* keys that are not announced via netconf are read from the file. */
+    nmtstp_run_command_check("echo 255 > %s",
+                             nm_utils_sysctl_ip_conf_path(AF_INET6, buf, IFNAME, "hop_limit"));
+    g_assert_cmpint(_sysctl_ip_conf_get(PL, AF_INET6, IFNAME, "hop_limit"), ==, 255);
+
+    /* rp_filter is set via netlink. */
+    g_assert(nm_platform_sysctl_ip_conf_set(PL, AF_INET, IFNAME, "rp_filter", "2"));
+    g_assert_cmpint(_sysctl_ip_conf_get_file(AF_INET, IFNAME, "rp_filter"), ==, 2);
+    pllink = nm_platform_link_get(PL, ifindex);
+    g_assert(pllink);
+    g_assert_cmpint(pllink->devconf[NM_PLATFORM_DEVCONF_IP4_RP_FILTER], ==, 2);
+    g_assert_cmpint(nm_platform_sysctl_ip_conf_get_rp_filter_ipv4(PL, IFNAME, FALSE, NULL), ==, 2);
+
+    g_assert(nm_platform_sysctl_ip_conf_set(PL, AF_INET, "all", "forwarding", "0"));
+
+out:
+    nmtstp_link_delete(NULL, -1, ifindex, IFNAME, TRUE);
+}
+
+static guint _sysctl_get_count;
+static char *(*_sysctl_get_orig)(NMPlatform *self, const char *pathid, int dirfd, const char *path);
+
+static char *
+_sysctl_get_counting(NMPlatform *self, const char *pathid, int dirfd, const char *path)
+{
+    _sysctl_get_count++;
+    return _sysctl_get_orig(self, pathid, dirfd, path);
+}
+
+static void
+test_sysctl_devconf_cache_reads(void)
+{
+    NMPlatform *const PL     = NM_PLATFORM_GET;
+    const char *const IFNAME = "nm-dummy-0";
+    /* the per-link reads of an activation: save_ip6_properties(), the IPv6 MTU
+     * and the rp_filter and forwarding checks. */
+    static const struct {
+        int         addr_family;
+        const char *property;
+        bool        cached;
+    } props[] = {
+        {AF_INET6, "accept_ra", FALSE},
+        {AF_INET6, "forwarding", TRUE},
+        {AF_INET6, "disable_ipv6", FALSE},
+        {AF_INET6, "hop_limit", FALSE},
+        {AF_INET6, "use_tempaddr", FALSE},
+        {AF_INET6, "mtu", FALSE},
+        {AF_INET, "rp_filter", TRUE},
+        {AF_INET, "forwarding", TRUE},
+    };
+    NMPlatformClass *     klass = NM_PLATFORM_GET_CLASS(PL);
+    const NMPlatformLink *pllink;
+    guint                 n_uncached = 0;
+    int                   ifindex;
+    int                   i;
+
+    ifindex = nmtstp_link_dummy_add(PL, -1, IFNAME)->ifindex;
+
+    pllink = nm_platform_link_get(PL, ifindex);
+    g_assert(pllink);
+    if (!NM_FLAGS_ALL(pllink->devconf_valid, (1u << _NM_PLATFORM_DEVCONF_NUM) - 1u)) {
+        g_test_skip("kernel does not report IFLA_INET_CONF/IFLA_INET6_CONF");
+        goto out;
+    }
+
+    _sysctl_get_orig  = klass->sysctl_get;
+    klass->sysctl_get = _sysctl_get_counting;
+    _sysctl_get_count = 0;
+
+    for (i = 0; i < (int) G_N_ELEMENTS(props); i++) {
+        guint n = _sysctl_get_count;
+
+        g_assert_cmpint(_sysctl_ip_conf_get(PL, props[i].addr_family, IFNAME, props[i].property),
+                        >=,
+                        0);
+        g_assert_cmpint(_sysctl_get_count - n, ==, props[i].cached ? 0 : 1);
+        if (!props[i].cached)
+            n_uncached++;
+    }
+
+    klass->sysctl_get = _sysctl_get_orig;
+
+    g_test_message("devconf cache: %u of %u per-link sysctl reads of an activation still open "
+                   "/proc",
+                   _sysctl_get_count,
+                   (guint) G_N_ELEMENTS(props));
+    g_assert_cmpint(_sysctl_get_count, ==, n_uncached);
+
+out:
+    nmtstp_link_delete(NULL, -1, ifindex, IFNAME, TRUE);
+}
+
 static void
 test_sysctl_set_async_fail(void)
 {
@@ -3782,6 +4063,8 @@ _nmtstp_setup_tests(void)
         g_test_add_func("/link/nl-bugs/spurious-newlink", test_nl_bugs_spuroius_newlink);
         g_test_add_func("/link/nl-bugs/spurious-dellink", test_nl_bugs_spuroius_dellink);
 
+        g_test_add_func("/link/bridge-vlans/external", test_bridge_vlans_external);
+
         g_test_add_vtable("/general/netns/general",
                           0,
                           NULL,
@@ -3813,6 +4096,8 @@ _nmtstp_setup_tests(void)
         g_test_add_func("/general/sysctl/netns-switch", test_sysctl_netns_switch);
         g_test_add_func("/general/sysctl/set-async", test_sysctl_set_async);
         g_test_add_func("/general/sysctl/set-async-fail", test_sysctl_set_async_fail);
+        g_test_add_func("/general/sysctl/devconf-cache", test_sysctl_devconf_cache);
+        g_test_add_func("/general/sysctl/devconf-cache-reads", test_sysctl_devconf_cache_reads);
 
         g_test_add_func("/link/ethtool/features/get", test_ethtool_features_get);
     }
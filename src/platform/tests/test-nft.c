@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include "nm-default.h"
+
+#include "nm-test-utils-core.h"
+#include "nm-nft-utils.h"
+#include "test-common.h"
+
+/*****************************************************************************/
+
+static void
+test_shared_table_to_string(void)
+{
+    gs_free char *ruleset = NULL;
+
+    ruleset = nm_nft_shared_table_to_string("eth0", nmtst_inet4_from_string("10.42.0.1"), 24);
+    g_assert_cmpstr(ruleset,
+                    ==,
+                    "table ip nm-shared-eth0 {\n"
+                    "\tchain postrouting {\n"
+                    "\t\ttype nat hook postrouting priority 100; policy accept;\n"
+                    "\t\tip saddr 10.42.0.0/24 ip daddr != 10.42.0.0/24 masquerade\n"
+                    "\t}\n"
+                    "\tchain forward {\n"
+                    "\t\ttype filter hook forward priority 0; policy accept;\n"
+                    "\t\toifname \"eth0\" ip daddr 10.42.0.0/24 ct state established,related "
+                    "accept\n"
+                    "\t\tiifname \"eth0\" ip saddr 10.42.0.0/24 accept\n"
+                    "\t\tiifname \"eth0\" oifname \"eth0\" accept\n"
+                    "\t\toifname \"eth0\" reject with icmp type port-unreachable\n"
+                    "\t\tiifname \"eth0\" reject with icmp type port-unreachable\n"
+                    "\t}\n"
+                    "\tchain input {\n"
+                    "\t\ttype filter hook input priority 0; policy accept;\n"
+                    "\t\tiifname \"eth0\" meta l4proto udp th dport 67 accept\n"
+                    "\t\tiifname \"eth0\" meta l4proto tcp th dport 67 accept\n"
+                    "\t\tiifname \"eth0\" meta l4proto udp th dport 53 accept\n"
+                    "\t\tiifname \"eth0\" meta l4proto tcp th dport 53 accept\n"
+                    "\t}\n"
+                    "}\n");
+}
+
+static void
+_assert_nft_table(gboolean exists)
+{
+    gs_free char *nft = NULL;
+    int           r;
+
+    /* the netlink API is enough for the daemon, the nft tool is
+     * only used for checking the result if it is installed. */
+    nft = g_find_program_in_path("nft");
+    if (!nft)
+        return;
+
+    r = nmtstp_run_command("%s list table ip " NM_NFT_SHARED_TABLE_PREFIX "%s", nft, DEVICE_NAME);
+    if (exists)
+        g_assert_cmpint(r, ==, 0);
+    else
+        g_assert_cmpint(r, !=, 0);
+}
+
+static void
+test_shared_table(void)
+{
+    const in_addr_t addr = nmtst_inet4_from_string("10.42.0.1");
+    int             r;
+
+    r = nm_nft_shared_table_add(DEVICE_NAME, addr, 24);
+    if (NM_IN_SET(r, -EOPNOTSUPP, -EPROTONOSUPPORT, -ENOENT)) {
+        g_test_skip("nf_tables is not supported by the kernel");
+        return;
+    }
+    g_assert_cmpint(r, ==, 0);
+    _assert_nft_table(TRUE);
+
+    /* adding the table again replaces it. */
+    r = nm_nft_shared_table_add(DEVICE_NAME, addr, 24);
+    g_assert_cmpint(r, ==, 0);
+    _assert_nft_table(TRUE);
+
+    r = nm_nft_shared_table_delete(DEVICE_NAME);
+    g_assert_cmpint(r, ==, 0);
+    _assert_nft_table(FALSE);
+
+    r = nm_nft_shared_table_delete(DEVICE_NAME);
+    g_assert_cmpint(r, ==, -ENOENT);
+}
+
+/*****************************************************************************/
+
+NMTstpSetupFunc const _nmtstp_setup_platform_func = SETUP;
+
+void
+_nmtstp_init_tests(int *argc, char ***argv)
+{
+    nmtst_init_with_logging(argc, argv, NULL, "ALL");
+}
+
+void
+_nmtstp_setup_tests(void)
+{
+    g_test_add_func("/nft/shared-table-to-string", test_shared_table_to_string);
+    if (nmtstp_is_root_test())
+        nmtstp_env1_add_test_func("/nft/shared-table", test_shared_table, TRUE);
+}
@@ -559,6 +559,131 @@ test_cache_qdisc(void)
 
 /*****************************************************************************/
 
+static guint
+_id_hash_siphash(const NMPObject *obj)
+{
+    NMHashState h;
+
+    nm_hash_init(&h, 914932607u);
+    nmp_object_id_hash_update(obj, &h);
+    return nm_hash_complete(&h);
+}
+
+static void
+_id_hash_perf(const char *name, NMPObject *const *objs, guint n_objs)
+{
+    const guint n_rounds = 2000;
+    guint       sum      = 0;
+    gdouble     t_siphash, t_fast;
+    guint       r, i;
+
+    g_test_timer_start();
+    for (r = 0; r < n_rounds; r++) {
+        for (i = 0; i < n_objs; i++)
+            sum += _id_hash_siphash(objs[i]);
+    }
+    t_siphash = g_test_timer_elapsed();
+
+    g_test_timer_start();
+    for (r = 0; r < n_rounds; r++) {
+        for (i = 0; i < n_objs; i++)
+            sum += nmp_object_id_hash(objs[i]);
+    }
+    t_fast = g_test_timer_elapsed();
+
+    g_test_message("id-hash of %u %s objects: siphash %.1f nsec, fast %.1f nsec (%u)",
+                   n_objs,
+                   name,
+                   t_siphash * 1e9 / (n_rounds * n_objs),
+                   t_fast * 1e9 / (n_rounds * n_objs),
+                   sum);
+    g_test_minimized_result(t_fast * 1e9 / (n_rounds * n_objs), "%s fast id-hash [nsec]", name);
+}
+
+static void
+test_id_hash(void)
+{
+    const guint n_objs = 1000;
+    gs_unref_ptrarray GPtrArray *links =
+        g_ptr_array_new_with_free_func((GDestroyNotify) nmp_object_unref);
+    gs_unref_ptrarray GPtrArray *addrs4 =
+        g_ptr_array_new_with_free_func((GDestroyNotify) nmp_object_unref);
+    gs_unref_ptrarray GPtrArray *routes4 =
+        g_ptr_array_new_with_free_func((GDestroyNotify) nmp_object_unref);
+    gs_unref_ptrarray GPtrArray *routes6 =
+        g_ptr_array_new_with_free_func((GDestroyNotify) nmp_object_unref);
+    nm_auto_nmpobj NMPObject *r1 = NULL;
+    nm_auto_nmpobj NMPObject *r2 = NULL;
+    guint                     i;
+
+    /* the host part of the network is not part of the ID. */
+    r1 = nmp_object_new(NMP_OBJECT_TYPE_IP4_ROUTE,
+                        &((const NMPlatformIP4Route){
+                            .ifindex = 5,
+                            .network = nmtst_inet4_from_string("192.168.5.0"),
+                            .plen    = 24,
+                            .metric  = 100,
+                        }));
+    r2 = nmp_object_new(NMP_OBJECT_TYPE_IP4_ROUTE,
+                        &((const NMPlatformIP4Route){
+                            .ifindex = 5,
+                            .network = nmtst_inet4_from_string("192.168.5.7"),
+                            .plen    = 24,
+                            .metric  = 100,
+                        }));
+    g_assert(nmp_object_id_equal(r1, r2));
+    g_assert_cmpint(nmp_object_id_hash(r1), ==, nmp_object_id_hash(r2));
+    g_assert_cmpint(_id_hash_siphash(r1), ==, _id_hash_siphash(r2));
+    g_assert_cmpint(nmp_object_id_hash(r1), !=, 0);
+
+    for (i = 0; i < n_objs; i++) {
+        g_ptr_array_add(links, nmp_object_new_link(i + 1));
+        g_ptr_array_add(addrs4,
+                        nmp_object_new(NMP_OBJECT_TYPE_IP4_ADDRESS,
+                                       &((const NMPlatformIP4Address){
+                                           .ifindex      = 1 + (i % 10),
+                                           .address      = htonl(0x0a000000u + i),
+                                           .peer_address = htonl(0x0a000000u + i),
+                                           .plen         = 8,
+                                       })));
+        g_ptr_array_add(routes4,
+                        nmp_object_new(NMP_OBJECT_TYPE_IP4_ROUTE,
+                                       &((const NMPlatformIP4Route){
+                                           .ifindex = 1 + (i % 10),
+                                           .network = htonl(0x0a000000u + (i << 8)),
+                                           .plen    = 24,
+                                           .metric  = 100 + (i % 3),
+                                       })));
+        g_ptr_array_add(routes6,
+                        nmp_object_new(NMP_OBJECT_TYPE_IP6_ROUTE,
+                                       &((const NMPlatformIP6Route){
+                                           .ifindex = 1 + (i % 10),
+                                           .network = *nmtst_inet6_from_string("2001:db8::"),
+                                           .plen    = 64,
+                                           .metric  = 100 + i,
+                                       })));
+    }
+
+    /* the fast hash should not produce many collisions. */
+    {
+        gs_unref_hashtable GHashTable *hashes = g_hash_table_new(nm_direct_hash, NULL);
+
+        for (i = 0; i < n_objs; i++)
+            g_hash_table_add(hashes, GUINT_TO_POINTER(nmp_object_id_hash(routes4->pdata[i])));
+        g_assert_cmpint(g_hash_table_size(hashes), >=, n_objs - 2);
+    }
+
+    if (!g_test_perf())
+        return;
+
+    _id_hash_perf("link", (NMPObject *const *) links->pdata, links->len);
+    _id_hash_perf("ip4-address", (NMPObject *const *) addrs4->pdata, addrs4->len);
+    _id_hash_perf("ip4-route", (NMPObject *const *) routes4->pdata, routes4->len);
+    _id_hash_perf("ip6-route", (NMPObject *const *) routes6->pdata, routes6->len);
+}
+
+/*****************************************************************************/
+
 NMTST_DEFINE();
 
 int
@@ -603,6 +728,7 @@ main(int argc, char **argv)
     g_test_add_func("/nmp-object/obj-base", test_obj_base);
     g_test_add_func("/nmp-object/cache_link", test_cache_link);
     g_test_add_func("/nmp-object/cache_qdisc", test_cache_qdisc);
+    g_test_add_func("/nmp-object/id-hash", test_id_hash);
 
     result = g_test_run();
 
@@ -748,6 +748,103 @@ test_platform_ip_address_pretty_sort_cmp(gconstpointer test_data)
 
 /*****************************************************************************/
 
+static void
+_assert_bridge_vlan(GArray *vlans, guint idx, guint16 vid_start, guint16 vid_end, guint8 flags)
+{
+    const NMPlatformBridgeVlan *vlan;
+
+    g_assert(idx < vlans->len);
+    vlan = &g_array_index(vlans, NMPlatformBridgeVlan, idx);
+    g_assert_cmpint(vlan->vid_start, ==, vid_start);
+    g_assert_cmpint(vlan->vid_end, ==, vid_end);
+    g_assert_cmpint(vlan->untagged, ==, NM_FLAGS_HAS(flags, NM_PLATFORM_BRIDGE_VLAN_FLAG_UNTAGGED));
+    g_assert_cmpint(vlan->pvid, ==, NM_FLAGS_HAS(flags, NM_PLATFORM_BRIDGE_VLAN_FLAG_PVID));
+}
+
+static void
+test_bridge_vlans_diff(void)
+{
+    const NMPlatformBridgeVlan current[] = {
+        {.vid_start = 1, .vid_end = 1, .untagged = TRUE, .pvid = TRUE},
+        {.vid_start = 10, .vid_end = 20},
+        {.vid_start = 30, .vid_end = 30},
+    };
+    const NMPlatformBridgeVlan requested[] = {
+        {.vid_start = 1, .vid_end = 1, .untagged = TRUE, .pvid = TRUE},
+        {.vid_start = 10, .vid_end = 15},
+        {.vid_start = 30, .vid_end = 30, .untagged = TRUE},
+        {.vid_start = 40, .vid_end = 41},
+    };
+    const NMPlatformBridgeVlan *const vlans[] = {
+        &requested[0],
+        &requested[1],
+        &requested[2],
+        &requested[3],
+        NULL,
+    };
+    const NMPlatformBridgeVlan *const vlans_same[] = {
+        &current[0],
+        &current[1],
+        &current[2],
+        NULL,
+    };
+    guint8                 flags[NM_PLATFORM_BRIDGE_VLAN_FLAGS_LEN];
+    gs_unref_array GArray *vlans_del = NULL;
+    gs_unref_array GArray *vlans_add = NULL;
+    gs_unref_array GArray *merged    = NULL;
+
+    nm_platform_bridge_vlans_diff(current, G_N_ELEMENTS(current), vlans, &vlans_del, &vlans_add);
+    g_assert_cmpint(vlans_del->len, ==, 1);
+    _assert_bridge_vlan(vlans_del, 0, 16, 20, 0);
+    g_assert_cmpint(vlans_add->len, ==, 2);
+    _assert_bridge_vlan(vlans_add, 0, 30, 30, NM_PLATFORM_BRIDGE_VLAN_FLAG_UNTAGGED);
+    _assert_bridge_vlan(vlans_add, 1, 40, 41, 0);
+    nm_clear_pointer(&vlans_del, g_array_unref);
+    nm_clear_pointer(&vlans_add, g_array_unref);
+
+    /* nothing to do, if the VLANs are already configured. */
+    nm_platform_bridge_vlans_diff(current,
+                                  G_N_ELEMENTS(current),
+                                  vlans_same,
+                                  &vlans_del,
+                                  &vlans_add);
+    g_assert_cmpint(vlans_del->len, ==, 0);
+    g_assert_cmpint(vlans_add->len, ==, 0);
+    nm_clear_pointer(&vlans_del, g_array_unref);
+    nm_clear_pointer(&vlans_add, g_array_unref);
+
+    /* without requested VLANs, all are removed. */
+    nm_platform_bridge_vlans_diff(current, G_N_ELEMENTS(current), NULL, &vlans_del, &vlans_add);
+    g_assert_cmpint(vlans_del->len, ==, 3);
+    _assert_bridge_vlan(vlans_del, 0, 1, 1, 0);
+    _assert_bridge_vlan(vlans_del, 1, 10, 20, 0);
+    _assert_bridge_vlan(vlans_del, 2, 30, 30, 0);
+    g_assert_cmpint(vlans_add->len, ==, 0);
+
+    /* adjacent VLANs with the same flags are merged, but never the PVID. */
+    nm_platform_bridge_vlans_to_flags(requested, G_N_ELEMENTS(requested), flags);
+    flags[2]  = NM_PLATFORM_BRIDGE_VLAN_FLAG_PRESENT | NM_PLATFORM_BRIDGE_VLAN_FLAG_UNTAGGED
+                | NM_PLATFORM_BRIDGE_VLAN_FLAG_PVID;
+    flags[16] = NM_PLATFORM_BRIDGE_VLAN_FLAG_PRESENT;
+    merged    = nm_platform_bridge_vlans_from_flags(flags);
+    g_assert_cmpint(merged->len, ==, 5);
+    _assert_bridge_vlan(merged,
+                        0,
+                        1,
+                        1,
+                        NM_PLATFORM_BRIDGE_VLAN_FLAG_UNTAGGED | NM_PLATFORM_BRIDGE_VLAN_FLAG_PVID);
+    _assert_bridge_vlan(merged,
+                        1,
+                        2,
+                        2,
+                        NM_PLATFORM_BRIDGE_VLAN_FLAG_UNTAGGED | NM_PLATFORM_BRIDGE_VLAN_FLAG_PVID);
+    _assert_bridge_vlan(merged, 2, 10, 16, 0);
+    _assert_bridge_vlan(merged, 3, 30, 30, NM_PLATFORM_BRIDGE_VLAN_FLAG_UNTAGGED);
+    _assert_bridge_vlan(merged, 4, 40, 41, 0);
+}
+
+/*****************************************************************************/
+
 NMTST_DEFINE();
 
 int
@@ -758,6 +855,7 @@ main(int argc, char **argv)
     g_test_add_func("/general/init_linux_platform", test_init_linux_platform);
     g_test_add_func("/general/link_get_all", test_link_get_all);
     g_test_add_func("/general/nm_platform_link_flags2str", test_nm_platform_link_flags2str);
+    g_test_add_func("/general/bridge_vlans_diff", test_bridge_vlans_diff);
     g_test_add_data_func("/general/platform_ip_address_pretty_sort_cmp/4",
                          GINT_TO_POINTER(0),
                          test_platform_ip_address_pretty_sort_cmp);
@@ -2,6 +2,7 @@
 
 #include "nm-default.h"
 
+#include <linux/if_ether.h>
 #include <linux/pkt_sched.h>
 
 #include "nm-test-utils-core.h"
@@ -25,6 +26,24 @@ qdisc_new(int ifindex, const char *kind, guint32 parent)
     return obj;
 }
 
+static NMPObject *
+tfilter_new(int ifindex, const char *kind, guint32 parent, guint32 handle, guint16 prio)
+{
+    NMPObject *obj;
+
+    obj          = nmp_object_new(NMP_OBJECT_TYPE_TFILTER, NULL);
+    obj->tfilter = (NMPlatformTfilter){
+        .ifindex     = ifindex,
+        .kind        = g_intern_string(kind),
+        .addr_family = AF_UNSPEC,
+        .handle      = handle,
+        .parent      = parent,
+        .info        = TC_H_MAKE(((guint32) prio) << 16, htons(ETH_P_ALL)),
+    };
+
+    return obj;
+}
+
 static GPtrArray *
 qdiscs_lookup(int ifindex)
 {
@@ -36,6 +55,66 @@ qdiscs_lookup(int ifindex)
                                     NULL);
 }
 
+static GPtrArray *
+tfilters_lookup(int ifindex)
+{
+    NMPLookup lookup;
+
+    return nm_platform_lookup_clone(
+        NM_PLATFORM_GET,
+        nmp_lookup_init_object(&lookup, NMP_OBJECT_TYPE_TFILTER, ifindex),
+        NULL,
+        NULL);
+}
+
+static void
+qdisc_callback(NMPlatform *               platform,
+               NMPObjectType              obj_type,
+               int                        ifindex,
+               NMPlatformQdisc *          received,
+               NMPlatformSignalChangeType change_type,
+               SignalData *               data)
+{
+    g_assert(received);
+    g_assert_cmpint(received->ifindex, ==, ifindex);
+    g_assert(data && data->name);
+    g_assert_cmpstr(data->name, ==, NM_PLATFORM_SIGNAL_QDISC_CHANGED);
+
+    if (data->ifindex && data->ifindex != received->ifindex)
+        return;
+    if (data->change_type != change_type)
+        return;
+
+    if (data->loop)
+        g_main_loop_quit(data->loop);
+
+    data->received_count++;
+}
+
+static void
+tfilter_callback(NMPlatform *               platform,
+                 NMPObjectType              obj_type,
+                 int                        ifindex,
+                 NMPlatformTfilter *        received,
+                 NMPlatformSignalChangeType change_type,
+                 SignalData *               data)
+{
+    g_assert(received);
+    g_assert_cmpint(received->ifindex, ==, ifindex);
+    g_assert(data && data->name);
+    g_assert_cmpstr(data->name, ==, NM_PLATFORM_SIGNAL_TFILTER_CHANGED);
+
+    if (data->ifindex && data->ifindex != received->ifindex)
+        return;
+    if (data->change_type != change_type)
+        return;
+
+    if (data->loop)
+        g_main_loop_quit(data->loop);
+
+    data->received_count++;
+}
+
 static void
 test_qdisc1(void)
 {
@@ -200,6 +279,177 @@ test_qdisc_tbf(void)
     g_assert_cmpint(qdisc->handle, ==, TC_H_MAKE(0x8005 << 16, 0));
 }
 
+static void
+test_qdisc_replace(void)
+{
+    int               ifindex;
+    gs_unref_ptrarray GPtrArray *known = NULL;
+    gs_unref_ptrarray GPtrArray *plat  = NULL;
+    NMPObject *                  obj;
+    NMPlatformQdisc *            qdisc;
+    SignalData *                 qdisc_removed;
+
+    ifindex = nm_platform_link_get_ifindex(NM_PLATFORM_GET, DEVICE_NAME);
+    g_assert_cmpint(ifindex, >, 0);
+
+    nmtstp_run_command("tc qdisc del dev %s root", DEVICE_NAME);
+
+    nmtstp_wait_for_signal(NM_PLATFORM_GET, 0);
+
+    known                     = g_ptr_array_new_with_free_func((GDestroyNotify) nmp_object_unref);
+    obj                       = qdisc_new(ifindex, "fq_codel", TC_H_ROOT);
+    obj->qdisc.handle         = TC_H_MAKE(0x8142 << 16, 0);
+    obj->qdisc.fq_codel.limit = 2048;
+    g_ptr_array_add(known, obj);
+
+    g_assert(nm_platform_qdisc_sync(NM_PLATFORM_GET, ifindex, known));
+
+    /* changing a parameter replaces the qdisc in place, without removing it. */
+    qdisc_removed = add_signal_ifindex(NM_PLATFORM_SIGNAL_QDISC_CHANGED,
+                                       NM_PLATFORM_SIGNAL_REMOVED,
+                                       qdisc_callback,
+                                       ifindex);
+
+    obj->qdisc.fq_codel.limit = 1024;
+    g_assert(nm_platform_qdisc_sync(NM_PLATFORM_GET, ifindex, known));
+
+    plat = qdiscs_lookup(ifindex);
+    g_assert(plat);
+    g_assert_cmpint(plat->len, ==, 1);
+
+    qdisc = NMP_OBJECT_CAST_QDISC(plat->pdata[0]);
+    g_assert_cmpstr(qdisc->kind, ==, "fq_codel");
+    g_assert_cmpint(qdisc->handle, ==, TC_H_MAKE(0x8142 << 16, 0));
+    g_assert_cmpint(qdisc->parent, ==, TC_H_ROOT);
+    g_assert_cmpint(qdisc->fq_codel.limit, ==, 1024);
+
+    /* syncing the same configuration again doesn't change anything. */
+    g_assert(nm_platform_qdisc_sync(NM_PLATFORM_GET, ifindex, known));
+    nmtstp_wait_for_signal(NM_PLATFORM_GET, 50);
+    ensure_no_signal(qdisc_removed);
+
+    free_signal(qdisc_removed);
+}
+
+static void
+test_tfilter_sync(void)
+{
+    const guint32 PARENT_INGRESS = TC_H_MAKE(TC_H_INGRESS, 0);
+    int           ifindex;
+    gs_unref_ptrarray GPtrArray *known = NULL;
+    GPtrArray *                  plat;
+    NMPObject *                  obj;
+    const NMPlatformTfilter *    tfilter;
+    SignalData *                 tfilter_removed;
+    guint32                      handle;
+    guint32                      info;
+
+    ifindex = nm_platform_link_get_ifindex(NM_PLATFORM_GET, DEVICE_NAME);
+    g_assert_cmpint(ifindex, >, 0);
+
+    nmtstp_run_command("tc qdisc del dev %s ingress", DEVICE_NAME);
+    nmtstp_run_command_check("tc qdisc add dev %s ingress", DEVICE_NAME);
+
+    nmtstp_wait_for_signal(NM_PLATFORM_GET, 0);
+
+    /* without handle and priority, the kernel chooses them. */
+    known = g_ptr_array_new_with_free_func((GDestroyNotify) nmp_object_unref);
+    g_ptr_array_add(known, tfilter_new(ifindex, "matchall", PARENT_INGRESS, 0, 0));
+
+    g_assert(nm_platform_tfilter_sync(NM_PLATFORM_GET, ifindex, known));
+    plat = tfilters_lookup(ifindex);
+    g_assert(plat);
+    g_assert_cmpint(plat->len, ==, 1);
+    tfilter = NMP_OBJECT_CAST_TFILTER(plat->pdata[0]);
+    g_assert_cmpstr(tfilter->kind, ==, "matchall");
+    g_assert_cmpint(tfilter->parent, ==, PARENT_INGRESS);
+    g_assert_cmpint(tfilter->handle, !=, 0);
+    g_assert_cmpint(TC_H_MAJ(tfilter->info), !=, 0);
+    handle = tfilter->handle;
+    info   = tfilter->info;
+    nm_clear_pointer(&plat, g_ptr_array_unref);
+
+    tfilter_removed = add_signal_ifindex(NM_PLATFORM_SIGNAL_TFILTER_CHANGED,
+                                         NM_PLATFORM_SIGNAL_REMOVED,
+                                         tfilter_callback,
+                                         ifindex);
+
+    /* the requested filter without handle matches the existing one,
+     * so syncing again doesn't change anything. */
+    g_assert(nm_platform_tfilter_sync(NM_PLATFORM_GET, ifindex, known));
+    nmtstp_wait_for_signal(NM_PLATFORM_GET, 50);
+    ensure_no_signal(tfilter_removed);
+
+    plat = tfilters_lookup(ifindex);
+    g_assert(plat);
+    g_assert_cmpint(plat->len, ==, 1);
+    tfilter = NMP_OBJECT_CAST_TFILTER(plat->pdata[0]);
+    g_assert_cmpint(tfilter->handle, ==, handle);
+    g_assert_cmpint(tfilter->info, ==, info);
+    nm_clear_pointer(&plat, g_ptr_array_unref);
+
+    /* a new action is sent as replace. matchall can't change an existing
+     * filter in place, so the sync falls back to delete and add. */
+    obj                 = known->pdata[0];
+    obj->tfilter.action = (NMPlatformAction){.kind = NM_PLATFORM_ACTION_KIND_SIMPLE};
+    g_strlcpy(obj->tfilter.action.simple.sdata, "Hello", sizeof(obj->tfilter.action.simple.sdata));
+
+    g_assert(nm_platform_tfilter_sync(NM_PLATFORM_GET, ifindex, known));
+    nmtstp_wait_for_signal(NM_PLATFORM_GET, 50);
+    accept_signal(tfilter_removed);
+
+    plat = tfilters_lookup(ifindex);
+    g_assert(plat);
+    g_assert_cmpint(plat->len, ==, 1);
+    tfilter = NMP_OBJECT_CAST_TFILTER(plat->pdata[0]);
+    g_assert_cmpint(tfilter->handle, ==, handle);
+    g_assert_cmpint(tfilter->info, ==, info);
+    nm_clear_pointer(&plat, g_ptr_array_unref);
+
+    /* the priority can't be changed either. The sync deletes the filter
+     * and adds it again right away. */
+    g_ptr_array_set_size(known, 0);
+    g_ptr_array_add(known, tfilter_new(ifindex, "matchall", PARENT_INGRESS, handle, 2));
+    g_ptr_array_add(known, tfilter_new(ifindex, "matchall", PARENT_INGRESS, handle + 1, 3));
+
+    g_assert(nm_platform_tfilter_sync(NM_PLATFORM_GET, ifindex, known));
+    nmtstp_wait_for_signal(NM_PLATFORM_GET, 50);
+    accept_signal(tfilter_removed);
+
+    plat = tfilters_lookup(ifindex);
+    g_assert(plat);
+    g_assert_cmpint(plat->len, ==, 2);
+    nm_clear_pointer(&plat, g_ptr_array_unref);
+
+    g_assert(nm_platform_tfilter_sync(NM_PLATFORM_GET, ifindex, known));
+    nmtstp_wait_for_signal(NM_PLATFORM_GET, 50);
+    ensure_no_signal(tfilter_removed);
+
+    /* filters that are no longer requested are removed. */
+    g_ptr_array_remove_index(known, 0);
+
+    g_assert(nm_platform_tfilter_sync(NM_PLATFORM_GET, ifindex, known));
+    nmtstp_wait_for_signal(NM_PLATFORM_GET, 50);
+    accept_signal(tfilter_removed);
+
+    plat = tfilters_lookup(ifindex);
+    g_assert(plat);
+    g_assert_cmpint(plat->len, ==, 1);
+    tfilter = NMP_OBJECT_CAST_TFILTER(plat->pdata[0]);
+    g_assert_cmpint(tfilter->handle, ==, handle + 1);
+    g_assert_cmpint(TC_H_MAJ(tfilter->info), ==, 3u << 16);
+    nm_clear_pointer(&plat, g_ptr_array_unref);
+
+    g_assert(nm_platform_tfilter_sync(NM_PLATFORM_GET, ifindex, NULL));
+    nmtstp_wait_for_signal(NM_PLATFORM_GET, 50);
+    accept_signal(tfilter_removed);
+    plat = tfilters_lookup(ifindex);
+    g_assert(!plat || plat->len == 0);
+    nm_clear_pointer(&plat, g_ptr_array_unref);
+
+    free_signal(tfilter_removed);
+}
+
 /*****************************************************************************/
 
 NMTstpSetupFunc const _nmtstp_setup_platform_func = SETUP;
@@ -218,5 +468,7 @@ _nmtstp_setup_tests(void)
         nmtstp_env1_add_test_func("/link/qdisc/fq_codel", test_qdisc_fq_codel, TRUE);
         nmtstp_env1_add_test_func("/link/qdisc/sfq", test_qdisc_sfq, TRUE);
         nmtstp_env1_add_test_func("/link/qdisc/tbf", test_qdisc_tbf, TRUE);
+        nmtstp_env1_add_test_func("/link/qdisc/replace", test_qdisc_replace, TRUE);
+        nmtstp_env1_add_test_func("/link/tfilter/sync", test_tfilter_sync, TRUE);
     }
 }
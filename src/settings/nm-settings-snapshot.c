@@ -0,0 +1,397 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright (C) 2020 Red Hat, Inc.
+ */
+
+#include "nm-default.h"
+
+#include "nm-settings-snapshot.h"
+
+#include <sys/stat.h>
+
+#include "nm-glib-aux/nm-io-utils.h"
+#include "nm-core-internal.h"
+
+/*****************************************************************************/
+
+/* The snapshot is a serialized GVariant. When the format changes, bump
+ * the version. Also, a snapshot written by a different NetworkManager
+ * version is ignored, because the way how a file is parsed may have changed.
+ *
+ *   (u     version
+ *    s     NetworkManager version
+ *    a(    entries
+ *      s     plugin name
+ *      s     full filename
+ *      t     st_dev
+ *      t     st_ino
+ *      t     st_size
+ *      t     st_mtim.tv_sec
+ *      t     st_mtim.tv_nsec
+ *      t     st_ctim.tv_sec
+ *      t     st_ctim.tv_nsec
+ *      a{sa{sv}}  the connection
+ *      a{sv}      plugin specific extra data
+ *    ))
+ */
+#define SNAPSHOT_VERSION           1u
+#define SNAPSHOT_ENTRY_TYPE_STRING "(ssttttttta{sa{sv}}a{sv})"
+#define SNAPSHOT_TYPE_STRING       "(usa" SNAPSHOT_ENTRY_TYPE_STRING ")"
+
+#define SNAPSHOT_MAX_SIZE (200u * 1024u * 1024u)
+
+#ifndef NM_DIST_VERSION
+    #define NM_DIST_VERSION VERSION
+#endif
+
+struct _NMSettingsSnapshot {
+    char *filename;
+
+    /* the snapshot as loaded from disk. It keeps the mapped file
+     * alive. */
+    GVariant *root;
+
+    /* the entries from the loaded snapshot. They are indexed by
+     * "$PLUGIN:$FILENAME" and reference (without copying) the memory
+     * of @root. */
+    GHashTable *loaded_entries;
+
+    /* the entries for the next snapshot that we write. */
+    GHashTable *pending_entries;
+};
+
+/*****************************************************************************/
+
+#define _NMLOG_DOMAIN      LOGD_SETTINGS
+#define _NMLOG(level, ...) __NMLOG_DEFAULT(level, _NMLOG_DOMAIN, "settings-snapshot", __VA_ARGS__)
+
+/*****************************************************************************/
+
+static char *
+_entry_key(const char *plugin_name, const char *full_filename)
+{
+    return g_strconcat(plugin_name, ":", full_filename, NULL);
+}
+
+static gboolean
+_entry_matches_stat(GVariant *entry, const struct stat *st)
+{
+    guint64 v_dev;
+    guint64 v_ino;
+    guint64 v_size;
+    guint64 v_mtime_sec;
+    guint64 v_mtime_nsec;
+    guint64 v_ctime_sec;
+    guint64 v_ctime_nsec;
+
+    g_variant_get(entry,
+                  "(&s&sttttttt@a{sa{sv}}@a{sv})",
+                  NULL,
+                  NULL,
+                  &v_dev,
+                  &v_ino,
+                  &v_size,
+                  &v_mtime_sec,
+                  &v_mtime_nsec,
+                  &v_ctime_sec,
+                  &v_ctime_nsec,
+                  NULL,
+                  NULL);
+
+    return v_dev == (guint64) st->st_dev && v_ino == (guint64) st->st_ino
+           && v_size == (guint64) st->st_size && v_mtime_sec == (guint64) st->st_mtim.tv_sec
+           && v_mtime_nsec == (guint64) st->st_mtim.tv_nsec
+           && v_ctime_sec == (guint64) st->st_ctim.tv_sec
+           && v_ctime_nsec == (guint64) st->st_ctim.tv_nsec;
+}
+
+/*****************************************************************************/
+
+gboolean
+nm_settings_snapshot_load(NMSettingsSnapshot *self)
+{
+    gs_free_error GError *error       = NULL;
+    GMappedFile *         mapped_file = NULL;
+    gs_unref_bytes GBytes *bytes      = NULL;
+    gs_unref_variant GVariant *root   = NULL;
+    gs_unref_variant GVariant *entries = NULL;
+    const char *               nm_version;
+    guint32                    version;
+    GVariantIter               iter;
+    GVariant *                 entry;
+
+    g_return_val_if_fail(self, FALSE);
+
+    nm_clear_pointer(&self->root, g_variant_unref);
+    g_hash_table_remove_all(self->loaded_entries);
+
+    mapped_file = g_mapped_file_new(self->filename, FALSE, &error);
+    if (!mapped_file) {
+        if (g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            _LOGD("no snapshot \"%s\"", self->filename);
+        else
+            _LOGD("failure to open snapshot \"%s\": %s", self->filename, error->message);
+        return FALSE;
+    }
+
+    if (g_mapped_file_get_length(mapped_file) > SNAPSHOT_MAX_SIZE) {
+        _LOGD("snapshot \"%s\" is too large. Ignore it", self->filename);
+        g_mapped_file_unref(mapped_file);
+        return FALSE;
+    }
+
+    bytes = g_mapped_file_get_bytes(mapped_file);
+    g_mapped_file_unref(mapped_file);
+
+    /* the file is not trusted. GVariant validates the serialized data
+     * lazily while accessing it. */
+    root = g_variant_new_from_bytes(G_VARIANT_TYPE(SNAPSHOT_TYPE_STRING), bytes, FALSE);
+    g_variant_ref_sink(root);
+
+    g_variant_get(root, "(u&s@a" SNAPSHOT_ENTRY_TYPE_STRING ")", &version, &nm_version, &entries);
+
+    if (version != SNAPSHOT_VERSION || !nm_streq(nm_version, NM_DIST_VERSION)) {
+        _LOGD("snapshot \"%s\" has incompatible version %u (%s). Ignore it",
+              self->filename,
+              (guint) version,
+              nm_version);
+        return FALSE;
+    }
+
+    g_variant_iter_init(&iter, entries);
+    while ((entry = g_variant_iter_next_value(&iter))) {
+        const char *plugin_name;
+        const char *full_filename;
+
+        g_variant_get_child(entry, 0, "&s", &plugin_name);
+        g_variant_get_child(entry, 1, "&s", &full_filename);
+
+        if (!plugin_name[0] || full_filename[0] != '/') {
+            g_variant_unref(entry);
+            continue;
+        }
+
+        g_hash_table_insert(self->loaded_entries, _entry_key(plugin_name, full_filename), entry);
+    }
+
+    _LOGD("loaded snapshot \"%s\" with %u entries",
+          self->filename,
+          g_hash_table_size(self->loaded_entries));
+
+    self->root = g_steal_pointer(&root);
+    return TRUE;
+}
+
+/**
+ * nm_settings_snapshot_lookup:
+ * @self: the snapshot instance
+ * @plugin_name: the name of the settings plugin that owns the file
+ * @full_filename: the absolute path of the profile
+ * @st: the current stat data of @full_filename
+ * @out_extra: (out) (allow-none) (transfer full): the extra data that
+ *   the plugin stored with nm_settings_snapshot_add().
+ *
+ * Looks up the connection for @full_filename. If the snapshot has
+ * an entry with matching stat data, the connection is created from
+ * the snapshot and the entry is retained for the next snapshot that
+ * gets written.
+ *
+ * Returns: (transfer full): the connection or %NULL, if there was no
+ *   (valid) entry in the snapshot.
+ */
+NMConnection *
+nm_settings_snapshot_lookup(NMSettingsSnapshot *self,
+                            const char *        plugin_name,
+                            const char *        full_filename,
+                            const struct stat * st,
+                            GVariant **         out_extra)
+{
+    gs_free_error GError *error          = NULL;
+    gs_unref_variant GVariant *con_dict  = NULL;
+    gs_unref_variant GVariant *extra     = NULL;
+    gs_free char *             key       = NULL;
+    NMConnection *             connection;
+    GVariant *                 entry;
+
+    nm_assert(self);
+    nm_assert(plugin_name);
+    nm_assert(full_filename && full_filename[0] == '/');
+    nm_assert(st);
+
+    key = _entry_key(plugin_name, full_filename);
+
+    entry = g_hash_table_lookup(self->loaded_entries, key);
+    if (!entry)
+        return NULL;
+
+    if (!_entry_matches_stat(entry, st)) {
+        _LOGT("entry for \"%s\" is stale", full_filename);
+        g_hash_table_remove(self->loaded_entries, key);
+        return NULL;
+    }
+
+    g_variant_get_child(entry, 9, "@a{sa{sv}}", &con_dict);
+    g_variant_get_child(entry, 10, "@a{sv}", &extra);
+
+    connection = _nm_simple_connection_new_from_dbus(con_dict, NM_SETTING_PARSE_FLAGS_STRICT, &error);
+    if (!connection || !nm_connection_verify(connection, NULL)) {
+        _LOGD("entry for \"%s\" is invalid: %s",
+              full_filename,
+              error ? error->message : "does not verify");
+        g_clear_object(&connection);
+        g_hash_table_remove(self->loaded_entries, key);
+        return NULL;
+    }
+
+    _LOGT("use entry for \"%s\"", full_filename);
+
+    g_hash_table_insert(self->pending_entries, g_strdup(key), g_variant_ref(entry));
+
+    NM_SET_OUT(out_extra, g_steal_pointer(&extra));
+    return connection;
+}
+
+/**
+ * nm_settings_snapshot_add:
+ * @self: the snapshot instance
+ * @plugin_name: the name of the settings plugin that owns the file
+ * @full_filename: the absolute path of the profile
+ * @st: the stat data of @full_filename, as it was when the
+ *   plugin read the file.
+ * @connection: the connection that was read from @full_filename.
+ * @extra: (allow-none): a "a{sv}" variant with additional data that
+ *   the plugin needs to restore the connection. If floating, the
+ *   reference is consumed.
+ *
+ * Records the connection for the next snapshot that gets written
+ * by nm_settings_snapshot_write().
+ */
+void
+nm_settings_snapshot_add(NMSettingsSnapshot *self,
+                         const char *        plugin_name,
+                         const char *        full_filename,
+                         const struct stat * st,
+                         NMConnection *      connection,
+                         GVariant *          extra)
+{
+    gs_unref_variant GVariant *extra_sink = NULL;
+    GVariant *                 entry;
+
+    nm_assert(self);
+    nm_assert(plugin_name);
+    nm_assert(full_filename && full_filename[0] == '/');
+    nm_assert(st);
+    nm_assert(NM_IS_CONNECTION(connection));
+    nm_assert(!extra || g_variant_is_of_type(extra, G_VARIANT_TYPE_VARDICT));
+
+    if (extra)
+        extra_sink = g_variant_ref_sink(extra);
+
+    entry = g_variant_new("(ssttttttt@a{sa{sv}}@a{sv})",
+                          plugin_name,
+                          full_filename,
+                          (guint64) st->st_dev,
+                          (guint64) st->st_ino,
+                          (guint64) st->st_size,
+                          (guint64) st->st_mtim.tv_sec,
+                          (guint64) st->st_mtim.tv_nsec,
+                          (guint64) st->st_ctim.tv_sec,
+                          (guint64) st->st_ctim.tv_nsec,
+                          nm_connection_to_dbus(connection, NM_CONNECTION_SERIALIZE_ALL),
+                          extra_sink ?: g_variant_new_array(G_VARIANT_TYPE("{sv}"), NULL, 0));
+
+    g_hash_table_insert(self->pending_entries,
+                        _entry_key(plugin_name, full_filename),
+                        g_variant_ref_sink(entry));
+}
+
+/**
+ * nm_settings_snapshot_write:
+ * @self: the snapshot instance
+ * @error: (allow-none): the failure reason
+ *
+ * Writes all entries that were either added with nm_settings_snapshot_add()
+ * or that were successfully looked up with nm_settings_snapshot_lookup()
+ * to disk. Afterwards, the written entries are the ones that can
+ * be looked up.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+nm_settings_snapshot_write(NMSettingsSnapshot *self, GError **error)
+{
+    gs_unref_variant GVariant *root  = NULL;
+    gs_free const char **      keys  = NULL;
+    GVariantBuilder            builder;
+    guint                      len;
+    guint                      i;
+
+    g_return_val_if_fail(self, FALSE);
+
+    keys = nm_utils_strdict_get_keys(self->pending_entries, TRUE, &len);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a" SNAPSHOT_ENTRY_TYPE_STRING));
+    for (i = 0; i < len; i++)
+        g_variant_builder_add_value(&builder, g_hash_table_lookup(self->pending_entries, keys[i]));
+
+    root = g_variant_ref_sink(
+        g_variant_new("(us@a" SNAPSHOT_ENTRY_TYPE_STRING ")",
+                      (guint32) SNAPSHOT_VERSION,
+                      NM_DIST_VERSION,
+                      g_variant_builder_end(&builder)));
+
+    /* the snapshot contains secrets. */
+    if (!nm_utils_file_set_contents(self->filename,
+                                    g_variant_get_data(root),
+                                    g_variant_get_size(root),
+                                    0600,
+                                    NULL,
+                                    error))
+        return FALSE;
+
+    _LOGD("wrote snapshot \"%s\" with %u entries", self->filename, len);
+
+    /* the written entries are now the base for further lookups. Note that
+     * they still reference the old mapped file (if any), which is fine. */
+    g_hash_table_remove_all(self->loaded_entries);
+    for (i = 0; i < len; i++) {
+        g_hash_table_insert(self->loaded_entries,
+                            g_strdup(keys[i]),
+                            g_variant_ref(g_hash_table_lookup(self->pending_entries, keys[i])));
+    }
+    g_hash_table_remove_all(self->pending_entries);
+    return TRUE;
+}
+
+/*****************************************************************************/
+
+NMSettingsSnapshot *
+nm_settings_snapshot_new(const char *filename)
+{
+    NMSettingsSnapshot *self;
+
+    g_return_val_if_fail(filename && filename[0] == '/', NULL);
+
+    self  = g_slice_new(NMSettingsSnapshot);
+    *self = (NMSettingsSnapshot){
+        .filename = g_strdup(filename),
+        .loaded_entries =
+            g_hash_table_new_full(nm_str_hash, g_str_equal, g_free, (GDestroyNotify) g_variant_unref),
+        .pending_entries =
+            g_hash_table_new_full(nm_str_hash, g_str_equal, g_free, (GDestroyNotify) g_variant_unref),
+    };
+    return self;
+}
+
+void
+nm_settings_snapshot_free(NMSettingsSnapshot *self)
+{
+    if (!self)
+        return;
+
+    g_hash_table_destroy(self->loaded_entries);
+    g_hash_table_destroy(self->pending_entries);
+    nm_clear_pointer(&self->root, g_variant_unref);
+    g_free(self->filename);
+    nm_g_slice_free(self);
+}
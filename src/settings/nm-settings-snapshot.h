@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright (C) 2020 Red Hat, Inc.
+ */
+
+#ifndef __NM_SETTINGS_SNAPSHOT_H__
+#define __NM_SETTINGS_SNAPSHOT_H__
+
+/*****************************************************************************/
+
+/* NMSettingsSnapshot is a binary cache of the profiles that the settings
+ * plugins loaded from disk. It is written after the plugins loaded their
+ * connections and on the next start, the plugins can take the connection
+ * from the snapshot instead of parsing the file again. An entry is only
+ * used if the stat data of the file (device, inode, size, mtime and ctime)
+ * is still identical. Otherwise, the plugin falls back to reading the file. */
+
+#define NM_SETTINGS_SNAPSHOT_FILENAME NMSTATEDIR "/settings-snapshot"
+
+typedef struct _NMSettingsSnapshot NMSettingsSnapshot;
+
+struct stat;
+
+NMSettingsSnapshot *nm_settings_snapshot_new(const char *filename);
+
+void nm_settings_snapshot_free(NMSettingsSnapshot *self);
+
+gboolean nm_settings_snapshot_load(NMSettingsSnapshot *self);
+
+NMConnection *nm_settings_snapshot_lookup(NMSettingsSnapshot *self,
+                                          const char *        plugin_name,
+                                          const char *        full_filename,
+                                          const struct stat * st,
+                                          GVariant **         out_extra);
+
+void nm_settings_snapshot_add(NMSettingsSnapshot *self,
+                              const char *        plugin_name,
+                              const char *        full_filename,
+                              const struct stat * st,
+                              NMConnection *      connection,
+                              GVariant *          extra);
+
+gboolean nm_settings_snapshot_write(NMSettingsSnapshot *self, GError **error);
+
+#endif /* __NM_SETTINGS_SNAPSHOT_H__ */
@@ -52,6 +52,7 @@
 #include "devices/nm-device-ethernet.h"
 #include "nm-settings-connection.h"
 #include "nm-settings-plugin.h"
+#include "nm-settings-snapshot.h"
 #include "nm-dbus-manager.h"
 #include "nm-auth-utils.h"
 #include "nm-libnm-core-intern/nm-auth-subject.h"
@@ -65,6 +66,7 @@
 #include "NetworkManagerUtils.h"
 #include "nm-dispatcher.h"
 #include "nm-hostname-manager.h"
+#include "nm-startup-trace.h"
 
 /*****************************************************************************/
 
@@ -363,6 +365,8 @@ typedef struct {
     NMKeyFileDB *kf_db_timestamps;
     NMKeyFileDB *kf_db_seen_bssids;
 
+    NMSettingsSnapshot *snapshot;
+
     GHashTable *sce_idx;
 
     CList sce_dirty_lst_head;
@@ -1437,6 +1441,13 @@ _plugin_connections_reload(NMSettings *self)
 
     for (iter = priv->plugins; iter; iter = iter->next)
         nm_settings_plugin_load_connections_done(iter->data);
+
+    if (priv->snapshot) {
+        gs_free_error GError *error = NULL;
+
+        if (!nm_settings_snapshot_write(priv->snapshot, &error))
+            _LOGW("failure to write settings snapshot: %s", error->message);
+    }
 }
 
 /*****************************************************************************/
@@ -3252,6 +3263,8 @@ load_plugins(NMSettings *self, const char *const *plugins, GError **error)
     for (iter = plugins; iter && *iter; iter++) {
         const char *pname = *iter;
 
+        NM_STARTUP_TRACE_SCOPE("settings-plugin-load", pname);
+
         if (!*pname || strchr(pname, '/')) {
             _LOGW("ignore invalid plugin \"%s\"", pname);
             continue;
@@ -3712,6 +3725,8 @@ nm_settings_start(NMSettings *self, GError **error)
     gs_strfreev char **plugins = NULL;
     GSList *           iter;
 
+    NM_STARTUP_TRACE_SCOPE("settings-start", NULL);
+
     priv = NM_SETTINGS_GET_PRIVATE(self);
 
     nm_assert(!priv->started);
@@ -3755,7 +3770,21 @@ nm_settings_start(NMSettings *self, GError **error)
     _plugin_unmanaged_specs_changed(NULL, self);
     _plugin_unrecognized_specs_changed(NULL, self);
 
-    _plugin_connections_reload(self);
+    if (priv->keyfile_plugin
+        && nm_config_data_get_value_boolean(nm_config_get_data_orig(priv->config),
+                                            NM_CONFIG_KEYFILE_GROUP_MAIN,
+                                            NM_CONFIG_KEYFILE_KEY_MAIN_SETTINGS_SNAPSHOT,
+                                            FALSE)) {
+        priv->snapshot = nm_settings_snapshot_new(NM_SETTINGS_SNAPSHOT_FILENAME);
+        nm_settings_snapshot_load(priv->snapshot);
+        nms_keyfile_plugin_set_snapshot(priv->keyfile_plugin, priv->snapshot);
+    }
+
+    {
+        NM_STARTUP_TRACE_SCOPE("settings-connections-load", NULL);
+
+        _plugin_connections_reload(self);
+    }
 
     g_signal_connect(priv->hostname_manager,
                      "notify::" NM_HOSTNAME_MANAGER_HOSTNAME,
@@ -3932,8 +3961,12 @@ finalize(GObject *object)
         g_signal_handlers_disconnect_by_data(plugin, self);
     }
 
+    if (priv->keyfile_plugin)
+        nms_keyfile_plugin_set_snapshot(priv->keyfile_plugin, NULL);
     g_clear_object(&priv->keyfile_plugin);
 
+    nm_clear_pointer(&priv->snapshot, nm_settings_snapshot_free);
+
     g_clear_object(&priv->agent_mgr);
 
     nm_clear_g_source(&priv->kf_db_flush_idle_id_timestamps);
@@ -30,6 +30,7 @@
 #include "settings/nm-settings-plugin.h"
 #include "settings/nm-settings-storage.h"
 #include "settings/nm-settings-utils.h"
+#include "settings/nm-settings-snapshot.h"
 
 #include "nms-keyfile-storage.h"
 #include "nms-keyfile-writer.h"
@@ -60,6 +61,9 @@ typedef struct {
 
     NMSettUtilStorages storages;
 
+    /* not owned. Set by NMSettings, if a snapshot is enabled. */
+    NMSettingsSnapshot *snapshot;
+
 } NMSKeyfilePluginPrivate;
 
 struct _NMSKeyfilePlugin {
@@ -292,6 +296,82 @@ _nm_assert_storage(gpointer plugin /* NMSKeyfilePlugin  */,
 
 /*****************************************************************************/
 
+static GVariant *
+_snapshot_extra_build(NMTernary   is_nm_generated,
+                      NMTernary   is_volatile,
+                      NMTernary   is_external,
+                      const char *shadowed_storage,
+                      NMTernary   shadowed_owned)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&builder, "{sv}", "nm-generated", g_variant_new_int32(is_nm_generated));
+    g_variant_builder_add(&builder, "{sv}", "volatile", g_variant_new_int32(is_volatile));
+    g_variant_builder_add(&builder, "{sv}", "external", g_variant_new_int32(is_external));
+    g_variant_builder_add(&builder, "{sv}", "shadowed-owned", g_variant_new_int32(shadowed_owned));
+    if (shadowed_storage) {
+        g_variant_builder_add(&builder,
+                              "{sv}",
+                              "shadowed-storage",
+                              g_variant_new_string(shadowed_storage));
+    }
+    return g_variant_builder_end(&builder);
+}
+
+static NMTernary
+_snapshot_ternary(gint32 v)
+{
+    if (v < 0)
+        return NM_TERNARY_DEFAULT;
+    return v ? NM_TERNARY_TRUE : NM_TERNARY_FALSE;
+}
+
+static void
+_snapshot_extra_parse(GVariant * extra,
+                      NMTernary *out_is_nm_generated,
+                      NMTernary *out_is_volatile,
+                      NMTernary *out_is_external,
+                      char **    out_shadowed_storage,
+                      NMTernary *out_shadowed_owned)
+{
+    const char *shadowed_storage  = NULL;
+    gint32      v_is_nm_generated = NM_TERNARY_DEFAULT;
+    gint32      v_is_volatile     = NM_TERNARY_DEFAULT;
+    gint32      v_is_external     = NM_TERNARY_DEFAULT;
+    gint32      v_shadowed_owned  = NM_TERNARY_DEFAULT;
+
+    if (extra) {
+        g_variant_lookup(extra, "nm-generated", "i", &v_is_nm_generated);
+        g_variant_lookup(extra, "volatile", "i", &v_is_volatile);
+        g_variant_lookup(extra, "external", "i", &v_is_external);
+        g_variant_lookup(extra, "shadowed-owned", "i", &v_shadowed_owned);
+        g_variant_lookup(extra, "shadowed-storage", "&s", &shadowed_storage);
+    }
+
+    *out_is_nm_generated = _snapshot_ternary(v_is_nm_generated);
+    *out_is_volatile     = _snapshot_ternary(v_is_volatile);
+    *out_is_external     = _snapshot_ternary(v_is_external);
+    *out_shadowed_owned  = _snapshot_ternary(v_shadowed_owned);
+    *out_shadowed_storage =
+        (shadowed_storage && shadowed_storage[0] == '/') ? g_strdup(shadowed_storage) : NULL;
+}
+
+static gboolean
+_snapshot_connection_allowed(NMConnection *connection)
+{
+    gs_unref_object NMConnection *system_only = NULL;
+
+    /* the snapshot is on persistent storage. Only profiles whose secrets
+     * are all owned by the system can be cached, because that is what the
+     * keyfile on disk contains too. */
+    system_only = nm_simple_connection_new_clone(connection);
+    _nm_connection_clear_secrets_by_secret_flags(system_only, NM_SETTING_SECRET_FLAG_NONE);
+    return nm_connection_compare(system_only, connection, NM_SETTING_COMPARE_FLAG_EXACT);
+}
+
+/*****************************************************************************/
+
 static NMSKeyfileStorage *
 _load_file(NMSKeyfilePlugin *    self,
            const char *          dirname,
@@ -372,21 +452,64 @@ _load_file(NMSKeyfilePlugin *    self,
 
     priv = NMS_KEYFILE_PLUGIN_GET_PRIVATE(self);
 
-    connection = _read_from_file(full_filename,
-                                 _get_plugin_dir(priv),
-                                 &st,
-                                 &is_nm_generated_opt,
-                                 &is_volatile_opt,
-                                 &is_external_opt,
-                                 &shadowed_storage,
-                                 &shadowed_owned_opt,
-                                 &local);
+    /* profiles in /run are volatile. They must not be persisted in the snapshot
+     * under NMSTATEDIR, where they would survive a reboot. */
+    if (priv->snapshot && storage_type != NMS_KEYFILE_STORAGE_TYPE_RUN
+        && nms_keyfile_utils_check_file_permissions(NMS_KEYFILE_FILETYPE_KEYFILE,
+                                                    full_filename,
+                                                    &st,
+                                                    NULL)) {
+        gs_unref_variant GVariant *extra = NULL;
+
+        /* the snapshot entry is only valid if the stat data is unchanged. */
+        connection = nm_settings_snapshot_lookup(priv->snapshot,
+                                                 NM_SETTINGS_PLUGIN_GET_CLASS(self)->plugin_name,
+                                                 full_filename,
+                                                 &st,
+                                                 &extra);
+        if (connection) {
+            _snapshot_extra_parse(extra,
+                                  &is_nm_generated_opt,
+                                  &is_volatile_opt,
+                                  &is_external_opt,
+                                  &shadowed_storage,
+                                  &shadowed_owned_opt);
+        }
+    }
+
     if (!connection) {
-        if (error)
-            g_propagate_error(error, g_steal_pointer(&local));
-        else
-            _LOGW("load: \"%s\": failed to load connection: %s", full_filename, local->message);
-        return NULL;
+        connection = _read_from_file(full_filename,
+                                     _get_plugin_dir(priv),
+                                     &st,
+                                     &is_nm_generated_opt,
+                                     &is_volatile_opt,
+                                     &is_external_opt,
+                                     &shadowed_storage,
+                                     &shadowed_owned_opt,
+                                     &local);
+        if (!connection) {
+            if (error)
+                g_propagate_error(error, g_steal_pointer(&local));
+            else
+                _LOGW("load: \"%s\": failed to load connection: %s",
+                      full_filename,
+                      local->message);
+            return NULL;
+        }
+
+        if (priv->snapshot && storage_type != NMS_KEYFILE_STORAGE_TYPE_RUN
+            && _snapshot_connection_allowed(connection)) {
+            nm_settings_snapshot_add(priv->snapshot,
+                                     NM_SETTINGS_PLUGIN_GET_CLASS(self)->plugin_name,
+                                     full_filename,
+                                     &st,
+                                     connection,
+                                     _snapshot_extra_build(is_nm_generated_opt,
+                                                           is_volatile_opt,
+                                                           is_external_opt,
+                                                           shadowed_storage,
+                                                           shadowed_owned_opt));
+        }
     }
 
     return nms_keyfile_storage_new_connection(self,
@@ -1303,6 +1426,14 @@ constructed(GObject *object)
                      self);
 }
 
+void
+nms_keyfile_plugin_set_snapshot(NMSKeyfilePlugin *self, NMSettingsSnapshot *snapshot)
+{
+    g_return_if_fail(NMS_IS_KEYFILE_PLUGIN(self));
+
+    NMS_KEYFILE_PLUGIN_GET_PRIVATE(self)->snapshot = snapshot;
+}
+
 NMSKeyfilePlugin *
 nms_keyfile_plugin_new(void)
 {
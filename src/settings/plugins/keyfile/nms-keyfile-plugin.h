@@ -30,6 +30,10 @@ GType nms_keyfile_plugin_get_type(void);
 
 NMSKeyfilePlugin *nms_keyfile_plugin_new(void);
 
+struct _NMSettingsSnapshot;
+
+void nms_keyfile_plugin_set_snapshot(NMSKeyfilePlugin *self, struct _NMSettingsSnapshot *snapshot);
+
 gboolean nms_keyfile_plugin_add_connection(NMSKeyfilePlugin *  self,
                                            NMConnection *      connection,
                                            gboolean            in_memory,
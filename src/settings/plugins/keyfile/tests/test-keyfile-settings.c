@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -20,6 +21,7 @@
 #include "settings/plugins/keyfile/nms-keyfile-reader.h"
 #include "settings/plugins/keyfile/nms-keyfile-writer.h"
 #include "settings/plugins/keyfile/nms-keyfile-utils.h"
+#include "settings/nm-settings-snapshot.h"
 
 #include "nm-test-utils-core.h"
 
@@ -2817,6 +2819,57 @@ test_nmmeta(void)
 
 /*****************************************************************************/
 
+static void
+test_settings_snapshot(void)
+{
+    const char *        full_filename     = TEST_KEYFILES_DIR "/Test_Wired_Connection";
+    const char *        snapshot_filename = TEST_SCRATCH_DIR "/settings-snapshot.tmp";
+    NMSettingsSnapshot *snapshot;
+    gs_unref_object NMConnection *connection = NULL;
+    gs_unref_object NMConnection *con2       = NULL;
+    gs_unref_variant GVariant *extra         = NULL;
+    struct stat                st;
+    gint32                     v_i32;
+
+    g_assert_cmpint(stat(full_filename, &st), ==, 0);
+
+    connection = keyfile_read_connection_from_file(full_filename);
+
+    snapshot = nm_settings_snapshot_new(snapshot_filename);
+    g_assert(!nm_settings_snapshot_lookup(snapshot, "keyfile", full_filename, &st, NULL));
+    nm_settings_snapshot_add(snapshot,
+                             "keyfile",
+                             full_filename,
+                             &st,
+                             connection,
+                             g_variant_new_parsed("{'volatile': <int32 1>}"));
+    g_assert(nm_settings_snapshot_write(snapshot, NULL));
+    nm_settings_snapshot_free(snapshot);
+
+    snapshot = nm_settings_snapshot_new(snapshot_filename);
+    g_assert(nm_settings_snapshot_load(snapshot));
+
+    g_assert(!nm_settings_snapshot_lookup(snapshot, "ifcfg-rh", full_filename, &st, NULL));
+
+    con2 = nm_settings_snapshot_lookup(snapshot, "keyfile", full_filename, &st, &extra);
+    g_assert(NM_IS_CONNECTION(con2));
+    nmtst_assert_connection_equals(connection, FALSE, con2, FALSE);
+    g_assert(extra);
+    g_assert(g_variant_lookup(extra, "volatile", "i", &v_i32));
+    g_assert_cmpint(v_i32, ==, 1);
+    g_clear_object(&con2);
+
+    /* a changed mtime invalidates the entry. */
+    st.st_mtim.tv_nsec = (st.st_mtim.tv_nsec + 1) % 1000000000;
+    g_assert(!nm_settings_snapshot_lookup(snapshot, "keyfile", full_filename, &st, NULL));
+
+    nm_settings_snapshot_free(snapshot);
+
+    g_assert_cmpint(unlink(snapshot_filename), ==, 0);
+}
+
+/*****************************************************************************/
+
 NMTST_DEFINE();
 
 int
@@ -2919,5 +2972,7 @@ main(int argc, char **argv)
 
     g_test_add_func("/keyfile/test_nmmeta", test_nmmeta);
 
+    g_test_add_func("/keyfile/test_settings_snapshot", test_settings_snapshot);
+
     return g_test_run();
 }
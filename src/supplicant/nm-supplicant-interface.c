@@ -760,8 +760,20 @@ _bss_info_get_all_cb(GVariant *result, GError *error, gpointer user_data)
     _notify_maybe_scanning(self);
 }
 
+static gboolean
+_bss_info_properties_complete(GVariant *properties)
+{
+    /* wpa_supplicant sends all BSS properties along with the BSSAdded signal.
+     * Only if the ones we require are missing, we fetch them with GetAll. */
+    return properties && g_variant_lookup(properties, "BSSID", "@ay", NULL)
+           && g_variant_lookup(properties, "SSID", "@ay", NULL)
+           && g_variant_lookup(properties, "Frequency", "@q", NULL)
+           && g_variant_lookup(properties, "Signal", "@n", NULL)
+           && g_variant_lookup(properties, "Mode", "@s", NULL);
+}
+
 static void
-_bss_info_add(NMSupplicantInterface *self, const char *object_path)
+_bss_info_add(NMSupplicantInterface *self, const char *object_path, GVariant *properties)
 {
     NMSupplicantInterfacePrivate *priv       = NM_SUPPLICANT_INTERFACE_GET_PRIVATE(self);
     nm_auto_ref_string NMRefString *bss_path = NULL;
@@ -777,6 +789,19 @@ _bss_info_add(NMSupplicantInterface *self, const char *object_path)
         return;
     }
 
+    if (_bss_info_properties_complete(properties)) {
+        bss_info  = g_slice_new(NMSupplicantBssInfo);
+        *bss_info = (NMSupplicantBssInfo){
+            ._self    = self,
+            .bss_path = g_steal_pointer(&bss_path),
+        };
+        c_list_link_tail(&priv->bss_lst_head, &bss_info->_bss_lst);
+        g_hash_table_add(priv->bss_idx, bss_info);
+
+        _bss_info_properties_changed(self, bss_info, properties, TRUE);
+        return;
+    }
+
     bss_info  = g_slice_new(NMSupplicantBssInfo);
     *bss_info = (NMSupplicantBssInfo){
         ._self             = self,
@@ -1145,6 +1170,31 @@ nm_supplicant_interface_get_current_bss(NMSupplicantInterface *self)
     return NM_SUPPLICANT_INTERFACE_GET_PRIVATE(self)->current_bss;
 }
 
+/**
+ * nm_supplicant_interface_get_bss_info:
+ * @self: the #NMSupplicantInterface
+ * @bss_path: the D-Bus path of the BSS
+ *
+ * Returns: (transfer none): the BSS with path @bss_path, or %NULL if the
+ *   BSS is unknown or still being initialized.
+ */
+NMSupplicantBssInfo *
+nm_supplicant_interface_get_bss_info(NMSupplicantInterface *self, NMRefString *bss_path)
+{
+    NMSupplicantBssInfo *bss_info;
+
+    g_return_val_if_fail(NM_IS_SUPPLICANT_INTERFACE(self), NULL);
+
+    if (!bss_path)
+        return NULL;
+
+    bss_info = g_hash_table_lookup(NM_SUPPLICANT_INTERFACE_GET_PRIVATE(self)->bss_idx, &bss_path);
+    if (!bss_info || bss_info->_init_cancellable)
+        return NULL;
+
+    return bss_info;
+}
+
 gboolean
 nm_supplicant_interface_get_scanning(NMSupplicantInterface *self)
 {
@@ -1908,7 +1958,7 @@ _properties_changed_main(NMSupplicantInterface *self, GVariant *properties)
             bss_info->_bss_dirty = TRUE;
 
         for (iter = v_strv; *iter; iter++)
-            _bss_info_add(self, *iter);
+            _bss_info_add(self, *iter, NULL);
 
         g_free(v_strv);
 
@@ -2886,11 +2936,13 @@ _signal_handle(NMSupplicantInterface *self,
             return;
 
         if (nm_streq(signal_name, "BSSAdded")) {
+            gs_unref_variant GVariant *properties = NULL;
+
             if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(oa{sv})")))
                 return;
 
-            g_variant_get(parameters, "(&oa{sv})", &path, NULL);
-            _bss_info_add(self, path);
+            g_variant_get(parameters, "(&o@a{sv})", &path, &properties);
+            _bss_info_add(self, path, properties);
             return;
         }
 
@@ -13,11 +13,16 @@
 
 #include "NetworkManagerUtils.h"
 #include "nm-core-internal.h"
+#include "nm-libnm-core-intern/nm-common-macros.h"
 #include "nm-core-utils.h"
 #include "systemd/nm-sd-utils-core.h"
 
 #include "dns/nm-dns-manager.h"
+#include "nm-auth-manager.h"
 #include "nm-connectivity.h"
+#include "nm-firewall-manager.h"
+#include "nm-ip4-config.h"
+#include "nm-main-loop-profiler.h"
 
 #include "nm-test-utils-core.h"
 
@@ -1193,18 +1198,50 @@ test_connection_sort_autoconnect_priority(void)
 #define MATCH_S390   "S390:"
 #define MATCH_DRIVER "DRIVER:"
 
+static NMMatchSpecMatchType
+_test_match_spec_device_one(const GSList *specs,
+                            const char *  interface_name,
+                            const char *  driver,
+                            const char *  driver_version,
+                            const char *  s390_subchannels)
+{
+    NMMatchSpecDevice *  matcher;
+    NMMatchSpecMatchType m;
+
+    m = nm_match_spec_device(specs,
+                             interface_name,
+                             NULL,
+                             driver,
+                             driver_version,
+                             NULL,
+                             s390_subchannels,
+                             NULL);
+
+    /* the compiled matcher must give the same result. */
+    matcher = nm_match_spec_device_compile(specs);
+    g_assert_cmpint(nm_match_spec_device_eval(matcher,
+                                              interface_name,
+                                              NULL,
+                                              driver,
+                                              driver_version,
+                                              NULL,
+                                              s390_subchannels,
+                                              NULL),
+                    ==,
+                    m);
+    nm_match_spec_device_free(matcher);
+    return m;
+}
+
 static NMMatchSpecMatchType
 _test_match_spec_device(const GSList *specs, const char *match_str)
 {
     if (match_str && g_str_has_prefix(match_str, MATCH_S390))
-        return nm_match_spec_device(specs,
-                                    NULL,
-                                    NULL,
-                                    NULL,
-                                    NULL,
-                                    NULL,
-                                    &match_str[NM_STRLEN(MATCH_S390)],
-                                    NULL);
+        return _test_match_spec_device_one(specs,
+                                           NULL,
+                                           NULL,
+                                           NULL,
+                                           &match_str[NM_STRLEN(MATCH_S390)]);
     if (match_str && g_str_has_prefix(match_str, MATCH_DRIVER)) {
         gs_free char *s = g_strdup(&match_str[NM_STRLEN(MATCH_DRIVER)]);
         char *        t;
@@ -1214,9 +1251,9 @@ _test_match_spec_device(const GSList *specs, const char *match_str)
             t[0] = '\0';
             t++;
         }
-        return nm_match_spec_device(specs, NULL, NULL, s, t, NULL, NULL, NULL);
+        return _test_match_spec_device_one(specs, NULL, s, t, NULL);
     }
-    return nm_match_spec_device(specs, match_str, NULL, NULL, NULL, NULL, NULL, NULL);
+    return _test_match_spec_device_one(specs, match_str, NULL, NULL, NULL);
 }
 
 static void
@@ -1414,6 +1451,52 @@ test_match_spec_device(void)
                                NULL);
 }
 
+static void
+test_match_spec_device_hwaddr(void)
+{
+    static const struct {
+        const char *         specs;
+        const char *         hwaddr;
+        NMMatchSpecMatchType expected;
+    } tests[] = {
+        {"mac:00:11:22:33:44:55", "00:11:22:33:44:55", NM_MATCH_SPEC_MATCH},
+        {"MAC:00:11:22:33:44:55", "00:11:22:33:44:55", NM_MATCH_SPEC_MATCH},
+        {"mac:00:11:22:33:44:55", "00:11:22:33:44:56", NM_MATCH_SPEC_NO_MATCH},
+        {"00:11:22:33:44:55", "00:11:22:33:44:55", NM_MATCH_SPEC_MATCH},
+        {"except:00:11:22:33:44:55", "00:11:22:33:44:55", NM_MATCH_SPEC_MATCH},
+        {"except:mac:00:11:22:33:44:55", "00:11:22:33:44:55", NM_MATCH_SPEC_NEG_MATCH},
+        {"except:mac:00:11:22:33:44:55", "00:11:22:33:44:56", NM_MATCH_SPEC_MATCH},
+        {"*,except:mac:00:11:22:33:44:55", "00:11:22:33:44:55", NM_MATCH_SPEC_NEG_MATCH},
+        {"mac:00:11:22:33:44:55", NULL, NM_MATCH_SPEC_NO_MATCH},
+        {"mac:00:11:22:33:44:55:66:77", "00:11:22:33:44:55", NM_MATCH_SPEC_NO_MATCH},
+        /* infiniband addresses only compare by the last 8 bytes. */
+        {"mac:80:00:02:08:fe:80:00:00:00:00:00:00:00:02:c9:03:00:00:0f:65",
+         "80:00:03:48:fe:80:00:00:00:00:00:00:00:02:c9:03:00:00:0f:65",
+         NM_MATCH_SPEC_MATCH},
+        {"mac:80:00:02:08:fe:80:00:00:00:00:00:00:00:02:c9:03:00:00:0f:65",
+         "80:00:02:08:fe:80:00:00:00:00:00:00:00:02:c9:03:00:00:0f:66",
+         NM_MATCH_SPEC_NO_MATCH},
+    };
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(tests); i++) {
+        GSList *           specs   = nm_match_spec_split(tests[i].specs);
+        NMMatchSpecDevice *matcher = nm_match_spec_device_compile(specs);
+        const char *       hwaddr  = tests[i].hwaddr;
+
+        g_assert_cmpint(nm_match_spec_device(specs, "eth0", NULL, NULL, NULL, hwaddr, NULL, NULL),
+                        ==,
+                        tests[i].expected);
+        g_assert_cmpint(
+            nm_match_spec_device_eval(matcher, "eth0", NULL, NULL, NULL, hwaddr, NULL, NULL),
+            ==,
+            tests[i].expected);
+
+        nm_match_spec_device_free(matcher);
+        g_slist_free_full(specs, g_free);
+    }
+}
+
 /*****************************************************************************/
 
 static void
@@ -2536,6 +2619,327 @@ test_connectivity_state_cmp(void)
 
 /*****************************************************************************/
 
+static void
+test_auth_manager_cache(void)
+{
+    const char *const ACTION_1              = NM_AUTH_PERMISSION_NETWORK_CONTROL;
+    const char *const ACTION_2              = NM_AUTH_PERMISSION_SETTINGS_MODIFY_SYSTEM;
+    const char *const ACTION_3              = NM_AUTH_PERMISSION_ENABLE_DISABLE_WIFI;
+    gs_unref_object NMAuthManager *auth_mgr = NULL;
+    gs_unref_object NMAuthSubject *subject  = NULL;
+    gboolean                       is_authorized;
+
+    auth_mgr = g_object_new(NM_TYPE_AUTH_MANAGER,
+                            NM_AUTH_MANAGER_POLKIT_ENABLED,
+                            (int) NM_AUTH_POLKIT_MODE_ROOT_ONLY,
+                            NULL);
+    subject  = nm_auth_subject_new_unix_process(":1.42", getpid(), 1000);
+
+    /* the results of interactive checks are never cached, neither "yes" nor "no". */
+    _nm_auth_manager_cache_add(auth_mgr, subject, ACTION_1, TRUE, TRUE, FALSE);
+    g_assert(!_nm_auth_manager_cache_lookup(auth_mgr, subject, ACTION_1, FALSE, &is_authorized));
+    g_assert(!_nm_auth_manager_cache_lookup(auth_mgr, subject, ACTION_1, TRUE, &is_authorized));
+
+    _nm_auth_manager_cache_add(auth_mgr, subject, ACTION_1, TRUE, FALSE, FALSE);
+    g_assert(!_nm_auth_manager_cache_lookup(auth_mgr, subject, ACTION_1, FALSE, &is_authorized));
+    g_assert(!_nm_auth_manager_cache_lookup(auth_mgr, subject, ACTION_1, TRUE, &is_authorized));
+
+    /* a "no" without interaction is not used for an interactive check. */
+    _nm_auth_manager_cache_add(auth_mgr, subject, ACTION_1, FALSE, FALSE, FALSE);
+    is_authorized = TRUE;
+    g_assert(_nm_auth_manager_cache_lookup(auth_mgr, subject, ACTION_1, FALSE, &is_authorized));
+    g_assert(!is_authorized);
+    g_assert(!_nm_auth_manager_cache_lookup(auth_mgr, subject, ACTION_1, TRUE, &is_authorized));
+
+    /* a "yes" without interaction holds for interactive checks too. */
+    _nm_auth_manager_cache_add(auth_mgr, subject, ACTION_2, FALSE, TRUE, FALSE);
+    is_authorized = FALSE;
+    g_assert(_nm_auth_manager_cache_lookup(auth_mgr, subject, ACTION_2, FALSE, &is_authorized));
+    g_assert(is_authorized);
+    is_authorized = FALSE;
+    g_assert(_nm_auth_manager_cache_lookup(auth_mgr, subject, ACTION_2, TRUE, &is_authorized));
+    g_assert(is_authorized);
+
+    /* challenges are never cached. */
+    _nm_auth_manager_cache_add(auth_mgr, subject, ACTION_3, FALSE, FALSE, TRUE);
+    g_assert(!_nm_auth_manager_cache_lookup(auth_mgr, subject, ACTION_3, FALSE, &is_authorized));
+
+    /* an interactive "yes" drops a cached "no". */
+    g_assert(_nm_auth_manager_cache_lookup(auth_mgr, subject, ACTION_1, FALSE, &is_authorized));
+    g_assert(!is_authorized);
+    _nm_auth_manager_cache_add(auth_mgr, subject, ACTION_1, TRUE, TRUE, FALSE);
+    g_assert(!_nm_auth_manager_cache_lookup(auth_mgr, subject, ACTION_1, FALSE, &is_authorized));
+}
+
+/*****************************************************************************/
+
+typedef struct {
+    GString *   log;
+    const char *name;
+} FirewallCallData;
+
+static void
+_firewall_call_cb(NMFirewallManager *      fw_mgr,
+                  NMFirewallManagerCallId *call_id,
+                  GError *                 error,
+                  gpointer                 user_data)
+{
+    FirewallCallData *data = user_data;
+
+    g_assert_no_error(error);
+    if (data->log->len > 0)
+        g_string_append_c(data->log, ' ');
+    g_string_append(data->log, data->name);
+}
+
+static void
+_firewall_call(NMFirewallManager *fw_mgr, const char *iface, FirewallCallData *data)
+{
+    gs_free char *op = g_strdup(data->name);
+    char *        zone;
+
+    zone  = strchr(op, ':');
+    *zone = '\0';
+    zone++;
+
+    if (nm_streq(op, "remove"))
+        nm_firewall_manager_remove_from_zone(fw_mgr, iface, zone, _firewall_call_cb, data);
+    else {
+        nm_firewall_manager_add_or_change_zone(fw_mgr,
+                                               iface,
+                                               zone,
+                                               nm_streq(op, "add"),
+                                               _firewall_call_cb,
+                                               data);
+    }
+}
+
+static void
+test_firewall_manager_queue(void)
+{
+    gs_unref_object NMFirewallManager *fw_mgr = NULL;
+    nm_auto_free_gstring GString *log0        = g_string_new(NULL);
+    nm_auto_free_gstring GString *log1        = g_string_new(NULL);
+    FirewallCallData              data0[]     = {
+        {log0, "add:a"},
+        {log0, "add:b"},
+        {log0, "remove:b"},
+        {log0, "add:c"},
+        {log0, "change:d"},
+        {log0, "change:e"},
+    };
+    FirewallCallData              data1[]     = {
+        {log1, "remove:a"},
+        {log1, "remove:b"},
+    };
+    guint                         i;
+
+    /* the requests are queued until firewalld's state is known. */
+    fw_mgr = _nm_firewall_manager_new_paused();
+
+    for (i = 0; i < G_N_ELEMENTS(data0); i++)
+        _firewall_call(fw_mgr, "eth0", &data0[i]);
+    for (i = 0; i < G_N_ELEMENTS(data1); i++)
+        _firewall_call(fw_mgr, "eth1", &data1[i]);
+
+    /* only the last queued request of an interface is superseded, and only
+     * by a request of the same type. The remove before "add:c" is kept. */
+    while (g_main_context_iteration(NULL, FALSE)) {}
+    g_assert_cmpstr(log0->str, ==, "add:a change:d");
+    g_assert_cmpstr(log1->str, ==, "remove:a");
+
+    /* the remaining requests complete in order. */
+    g_string_truncate(log0, 0);
+    g_string_truncate(log1, 0);
+    _nm_firewall_manager_unpause(fw_mgr);
+    while (g_main_context_iteration(NULL, FALSE)) {}
+    g_assert_cmpstr(log0->str, ==, "add:b remove:b add:c change:e");
+    g_assert_cmpstr(log1->str, ==, "remove:b");
+}
+
+/*****************************************************************************/
+
+static gboolean
+_main_loop_stall_cb(gpointer user_data)
+{
+    NM_MAIN_LOOP_PROFILE_SCOPE("test-stall");
+
+    g_usleep(30 * 1000);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+test_main_loop_profiler_stall(void)
+{
+    nm_auto_unref_gmaincontext GMainContext *context = g_main_context_new();
+    gs_unref_variant GVariant *stats                 = NULL;
+    gs_unref_variant GVariant *iteration             = NULL;
+    gs_unref_variant GVariant *sections              = NULL;
+    GVariantIter               iter;
+    GSource *                  source;
+    const char *               name;
+    guint32                    stall_threshold;
+    guint64                    stalls;
+    guint64                    count;
+    guint64                    max_usec;
+    gboolean                   found = FALSE;
+
+    nm_main_loop_profiler_setup(context, 10);
+
+    source = g_idle_source_new();
+    g_source_set_callback(source, _main_loop_stall_cb, NULL, NULL);
+    g_source_attach(source, context);
+    g_source_unref(source);
+
+    /* the first iteration dispatches the idle source. Its busy time is
+     * accounted when the second iteration polls. */
+    g_main_context_iteration(context, FALSE);
+    g_main_context_iteration(context, FALSE);
+
+    stats = g_variant_ref_sink(nm_main_loop_profiler_get_stats());
+
+    g_assert(g_variant_lookup(stats, "stall-threshold", "u", &stall_threshold));
+    g_assert_cmpint(stall_threshold, ==, 10);
+    g_assert(g_variant_lookup(stats, "stalls", "t", &stalls));
+    g_assert_cmpint(stalls, ==, 1);
+
+    iteration = g_variant_lookup_value(stats, "iteration", G_VARIANT_TYPE("(stttat)"));
+    g_assert(iteration);
+    g_variant_get(iteration, "(&sttt*)", NULL, &count, NULL, &max_usec, NULL);
+    g_assert_cmpint(count, ==, 1);
+    g_assert_cmpint(max_usec, >=, 30 * 1000);
+
+    sections = g_variant_lookup_value(stats, "sections", G_VARIANT_TYPE("a(stttat)"));
+    g_assert(sections);
+    g_variant_iter_init(&iter, sections);
+    while (g_variant_iter_next(&iter, "(&sttt*)", &name, &count, NULL, &max_usec, NULL)) {
+        if (!nm_streq(name, "test-stall"))
+            continue;
+        g_assert_cmpint(count, ==, 1);
+        g_assert_cmpint(max_usec, >=, 30 * 1000);
+        found = TRUE;
+    }
+    g_assert(found);
+}
+
+/*****************************************************************************/
+
+static char *
+_route_data_to_string(GVariant *route_data)
+{
+    gs_unref_ptrarray GPtrArray *strs = g_ptr_array_new_with_free_func(g_free);
+    GVariantIter                 iter;
+    GVariant *                   route;
+
+    g_variant_iter_init(&iter, route_data);
+    while (g_variant_iter_next(&iter, "@a{sv}", &route)) {
+        const char *dest;
+        guint32     prefix;
+        guint32     metric;
+
+        g_assert(g_variant_lookup(route, "dest", "&s", &dest));
+        g_assert(g_variant_lookup(route, "prefix", "u", &prefix));
+        g_assert(g_variant_lookup(route, "metric", "u", &metric));
+        g_ptr_array_add(strs, g_strdup_printf("%s/%u/%u", dest, prefix, metric));
+        g_variant_unref(route);
+    }
+
+    g_ptr_array_sort(strs, nm_strcmp_p);
+    g_ptr_array_add(strs, NULL);
+    return g_strjoinv(" ", (char **) strs->pdata);
+}
+
+static gboolean
+_routes_delta(GHashTable **             exported,
+              const NMPlatformIP4Route *routes,
+              guint                     n_routes,
+              guint64                   export_max,
+              gboolean *                out_over_max,
+              char **                   out_added,
+              char **                   out_removed)
+{
+    gs_unref_object NMIP4Config *config  = nmtst_ip4_config_new(1);
+    gs_unref_variant GVariant *  added   = NULL;
+    gs_unref_variant GVariant *  removed = NULL;
+    gboolean                     changed;
+    guint                        i;
+
+    for (i = 0; i < n_routes; i++)
+        nm_ip4_config_add_route(config, &routes[i], NULL);
+
+    changed = nm_utils_ip_routes_to_dbus_delta(AF_INET,
+                                               nm_ip4_config_lookup_routes(config),
+                                               exported,
+                                               export_max,
+                                               out_over_max,
+                                               &added,
+                                               &removed);
+    g_variant_ref_sink(added);
+    g_variant_ref_sink(removed);
+
+    g_free(*out_added);
+    g_free(*out_removed);
+    *out_added   = _route_data_to_string(added);
+    *out_removed = _route_data_to_string(removed);
+    return changed;
+}
+
+static void
+test_ip_routes_to_dbus_delta(void)
+{
+    gs_unref_hashtable GHashTable *exported = NULL;
+    gs_free char *                 added    = NULL;
+    gs_free char *                 removed  = NULL;
+    NMPlatformIP4Route             routes[2];
+    gboolean                       over_max;
+
+    routes[0]        = *nmtst_platform_ip4_route("10.0.0.0", 8, "192.168.1.1");
+    routes[0].metric = 100;
+    routes[1]        = *nmtst_platform_ip4_route("172.16.0.0", 16, NULL);
+    routes[1].metric = 100;
+
+    /* everything is added for the first delta. */
+    g_assert(_routes_delta(&exported, routes, 2, 10, &over_max, &added, &removed));
+    g_assert_cmpstr(added, ==, "10.0.0.0/8/100 172.16.0.0/16/100");
+    g_assert_cmpstr(removed, ==, "");
+    g_assert(!over_max);
+
+    g_assert(!_routes_delta(&exported, routes, 2, 10, &over_max, &added, &removed));
+    g_assert_cmpstr(added, ==, "");
+    g_assert_cmpstr(removed, ==, "");
+
+    /* a field that is not exported on D-Bus is no change. */
+    routes[0].mss       = 1400;
+    routes[0].rt_source = NM_IP_CONFIG_SOURCE_DHCP;
+    g_assert(!_routes_delta(&exported, routes, 2, 10, &over_max, &added, &removed));
+    g_assert_cmpstr(added, ==, "");
+    g_assert_cmpstr(removed, ==, "");
+
+    /* a modified route is removed and added. */
+    routes[0].metric = 200;
+    g_assert(_routes_delta(&exported, routes, 2, 10, &over_max, &added, &removed));
+    g_assert_cmpstr(added, ==, "10.0.0.0/8/200");
+    g_assert_cmpstr(removed, ==, "10.0.0.0/8/100");
+
+    g_assert(_routes_delta(&exported, &routes[1], 1, 10, &over_max, &added, &removed));
+    g_assert_cmpstr(added, ==, "");
+    g_assert_cmpstr(removed, ==, "10.0.0.0/8/200");
+    g_assert(!over_max);
+
+    /* more routes than @export_max. */
+    g_assert(_routes_delta(&exported, routes, 2, 1, &over_max, &added, &removed));
+    g_assert_cmpstr(added, ==, "10.0.0.0/8/200");
+    g_assert_cmpstr(removed, ==, "");
+    g_assert(over_max);
+    g_assert_cmpint(g_hash_table_size(exported), ==, 2);
+
+    g_assert(_routes_delta(&exported, &routes[1], 1, 1, &over_max, &added, &removed));
+    g_assert_cmpstr(removed, ==, "10.0.0.0/8/200");
+    g_assert(!over_max);
+}
+
+/*****************************************************************************/
+
 NMTST_DEFINE();
 
 int
@@ -2582,6 +2986,7 @@ main(int argc, char **argv)
                     test_connection_sort_autoconnect_priority);
 
     g_test_add_func("/general/match-spec/device", test_match_spec_device);
+    g_test_add_func("/general/match-spec/device-hwaddr", test_match_spec_device_hwaddr);
     g_test_add_func("/general/match-spec/config", test_match_spec_config);
     g_test_add_func("/general/duplicate_decl_specifier", test_duplicate_decl_specifier);
 
@@ -2607,6 +3012,10 @@ main(int argc, char **argv)
     g_test_add_func("/core/general/test_connectivity_state_cmp", test_connectivity_state_cmp);
     g_test_add_func("/core/general/test_kernel_cmdline_match_check",
                     test_kernel_cmdline_match_check);
+    g_test_add_func("/core/general/auth-manager/cache", test_auth_manager_cache);
+    g_test_add_func("/core/general/firewall-manager/queue", test_firewall_manager_queue);
+    g_test_add_func("/core/general/main-loop-profiler/stall", test_main_loop_profiler_stall);
+    g_test_add_func("/general/ip-routes-to-dbus-delta", test_ip_routes_to_dbus_delta);
 
     return g_test_run();
 }
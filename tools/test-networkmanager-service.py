@@ -23,6 +23,7 @@ import uuid
 import hashlib
 import socket
 import collections
+import copy
 
 ###############################################################################
 
@@ -406,6 +407,16 @@ IFACE_DHCP6_CONFIG = "org.freedesktop.NetworkManager.DHCP6Config"
 
 
 class BusErr:
+    class NotActiveException(dbus.DBusException):
+        def __init__(self, *args, **kwargs):
+            self._dbus_error_name = "{}.NotActive".format(IFACE_DEVICE)
+            dbus.DBusException.__init__(self, *args, **kwargs)
+
+    class VersionIdMismatchException(dbus.DBusException):
+        def __init__(self, *args, **kwargs):
+            self._dbus_error_name = "{}.VersionIdMismatch".format(IFACE_DEVICE)
+            dbus.DBusException.__init__(self, *args, **kwargs)
+
     class UnknownInterfaceException(dbus.DBusException):
         def __init__(self, *args, **kwargs):
             self._dbus_error_name = "{}.UnknownInterface".format(IFACE_DBUS)
@@ -831,6 +842,10 @@ class Device(ExportedObj):
     path_counter_next = 1
     path_prefix = "/org/freedesktop/NetworkManager/Devices/"
 
+    # like NetworkManager, the version-id of the applied connection is
+    # a global counter, so that 0 is never a valid version-id.
+    version_id_counter = 0
+
     def __init__(self, iface, devtype, ident=None):
 
         if ident is None:
@@ -845,6 +860,12 @@ class Device(ExportedObj):
 
         self.prp_state = NM.DeviceState.UNAVAILABLE
 
+        self.settings_con_hash = None
+        self.applied_con_hash = None
+        self.applied_version_id = 0
+        self.get_applied_connection_count = 0
+        self.reapply_count = 0
+
         if devtype == NM.DeviceType.MODEM:
             udi = "/org/freedesktop/ModemManager1/Modem/0"
         else:
@@ -1085,6 +1106,42 @@ class Device(ExportedObj):
     def set_active_connection(self, ac):
         self._dbus_property_set(IFACE_DEVICE, PRP_DEVICE_ACTIVE_CONNECTION, ac)
 
+    def set_applied_connection(self, con_hash, settings_con_hash=None):
+        if con_hash is None:
+            self.settings_con_hash = None
+            self.applied_con_hash = None
+            self.applied_version_id = 0
+            return
+        if settings_con_hash is not None:
+            self.settings_con_hash = settings_con_hash
+        Device.version_id_counter += 1
+        self.applied_con_hash = copy.deepcopy(con_hash)
+        self.applied_version_id = Device.version_id_counter
+
+    @dbus.service.method(
+        dbus_interface=IFACE_DEVICE, in_signature="u", out_signature="a{sa{sv}}t"
+    )
+    def GetAppliedConnection(self, flags):
+        self.get_applied_connection_count += 1
+        if self.applied_con_hash is None:
+            raise BusErr.NotActiveException("Device is not activated")
+        return (self.applied_con_hash, dbus.UInt64(self.applied_version_id))
+
+    @dbus.service.method(
+        dbus_interface=IFACE_DEVICE, in_signature="a{sa{sv}}tu", out_signature=""
+    )
+    def Reapply(self, con_hash, version_id, flags):
+        if self.applied_con_hash is None:
+            raise BusErr.NotActiveException("Device is not activated")
+        if version_id != 0 and version_id != self.applied_version_id:
+            raise BusErr.VersionIdMismatchException(
+                "Reapply failed: the version-id of the applied connection changed"
+            )
+        self.reapply_count += 1
+        if not con_hash:
+            con_hash = self.applied_con_hash
+        self.set_applied_connection(con_hash)
+
     def connection_is_available(self, con_inst):
         if con_inst.is_vpn():
             return False
@@ -1116,6 +1173,21 @@ class Device(ExportedObj):
     def Stop(self):
         self.stop()
 
+    @dbus.service.method(IFACE_TEST, in_signature="", out_signature="uu")
+    def GetAppliedConnectionStats(self):
+        return (
+            dbus.UInt32(self.get_applied_connection_count),
+            dbus.UInt32(self.reapply_count),
+        )
+
+    @dbus.service.method(IFACE_TEST, in_signature="", out_signature="")
+    def ResetAppliedConnection(self):
+        # like a re-activation by somebody else: the applied connection
+        # is again the settings connection, with a new version-id.
+        if self.applied_con_hash is None:
+            raise BusErr.NotActiveException("Device is not activated")
+        self.set_applied_connection(self.settings_con_hash)
+
 
 ###############################################################################
 
@@ -1497,6 +1569,10 @@ class ActiveConnection(ExportedObj):
         assert self._activation_id is not None
         self._activation_id = GLib.timeout_add(50, self._activation_step2)
         self.device.set_active_connection(self)
+        if not self.is_vpn:
+            self.device.set_applied_connection(
+                self.con_inst.con_hash, self.con_inst.con_hash
+            )
         self.device.set_state(NM.DeviceState.PREPARE, NM.DeviceStateReason.NONE)
         self._set_state(
             NM.ActiveConnectionState.ACTIVATING, NM.ActiveConnectionStateReason.UNKNOWN
@@ -1506,6 +1582,8 @@ class ActiveConnection(ExportedObj):
     def _deactivation_step1(self):
         assert self._deactivation_id is not None
         self._deactivation_id = None
+        if not self.is_vpn:
+            self.device.set_applied_connection(None)
         self.device.set_state(
             NM.DeviceState.DISCONNECTED, NM.DeviceStateReason.USER_REQUESTED
         )